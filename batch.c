@@ -0,0 +1,546 @@
+/**
+ * @file batch.c
+ * @brief Implementation of the length-aware batch scheduler.
+ *
+ * Work is split into tasks of three kinds: a group of short reads, a chunk of a
+ * long read, and the stitching of the chunks of a long read. The first two kinds
+ * are executed in the first phase and the stitching in the second one, after all
+ * the chunks are available. In both phases, threads claim tasks by atomically
+ * incrementing a shared counter.
+ *
+ * Chunk `k` of a long read covers [k * BATCH_CHUNK_SIZE, (k + 1) * BATCH_CHUNK_SIZE +
+ * BATCH_CHUNK_OVERLAP), and the last chunk extends to the end of the read. Two
+ * consecutive chunks are stitched at the first core of the latter starting after
+ * the middle of their overlap, provided that `BATCH_AGREEMENT_COUNT` cores from
+ * there on are identical in both chunks.
+ *
+ * Lockstep parsing stores the encoded characters of `BATCH_LANE_COUNT` reads
+ * column by column, so that one column fits a 256-bit register. Comparing two
+ * consecutive columns yields, for every position, 32-bit lane masks of the reads in
+ * which the character is equal to, less than or greater than its successor. The
+ * core predicates are evaluated on these masks with bitwise operations, and the
+ * resulting masks are transposed into one bitset per read with 32x32 bit matrix
+ * transposes. The AVX2 comparisons are selected at runtime, with SSE2 and portable
+ * fallbacks.
+ */
+
+#include "batch.h"
+#include "pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86
+#endif
+
+enum batch_task_kind {
+    BATCH_SHORT,
+    BATCH_CHUNK,
+    BATCH_STITCH
+};
+
+struct batch_task {
+    enum batch_task_kind kind;
+    int first;
+    int last;
+};
+
+struct long_read {
+    int read;
+    int chunk_offset;
+    int chunk_count;
+};
+
+struct batch_context {
+    struct lps *lps_arr;
+    const char **reads;
+    const int *lengths;
+    int lcp_level;
+    int *order;
+    struct long_read *long_reads;
+    struct lps *chunks;
+    struct batch_task *tasks;
+    int task_count;
+    int next_task;
+    int fallback_count;
+};
+
+struct lockstep_buffer {
+    int8_t *codes;
+    uint32_t *eqs;
+    uint32_t *lts;
+    uint32_t *gts;
+    uint32_t *starts;
+    uint64_t *lane_starts;
+    uint64_t *lane_eqs;
+};
+
+struct batch_worker {
+    struct batch_context *ctx;
+    struct core *scratch;
+    struct lockstep_buffer lockstep;
+};
+
+/**
+ * @brief Returns the bin of a read, i.e. the binary logarithm of its length.
+ */
+static inline int batch_bin(int len) {
+    return len < 2 ? 0 : minimum(BATCH_BIN_COUNT - 1, 31 - __builtin_clz((unsigned int)len));
+}
+
+/**
+ * @brief Moves the cores of the scratch buffer into an exactly sized array and deepens them.
+ */
+static void finish_piece(struct lps *lps_ptr, const struct core *scratch, int size, int lcp_level) {
+    lps_ptr->level = 1;
+    lps_ptr->size = size;
+    lps_ptr->cores = (struct core *)malloc((size ? size : 1) * sizeof(struct core));
+    memcpy(lps_ptr->cores, scratch, size * sizeof(struct core));
+
+    lps_deepen(lps_ptr, lcp_level);
+}
+
+/**
+ * @brief Parses [begin, end) of `str` into the scratch buffer and finishes the piece.
+ */
+static void parse_piece(struct lps *lps_ptr, const char *str, int begin, int end, int lcp_level, struct core *scratch) {
+    finish_piece(lps_ptr, scratch, parse1(str + begin, str + end, scratch, begin), lcp_level);
+}
+
+static void init_lockstep(struct lockstep_buffer *buf, int max_len) {
+    int words = (max_len + 63) / 64;
+    buf->codes = (int8_t *)malloc((max_len + 1) * BATCH_LANE_COUNT);
+    buf->eqs = (uint32_t *)malloc(64 * words * sizeof(uint32_t));
+    buf->lts = (uint32_t *)malloc(64 * words * sizeof(uint32_t));
+    buf->gts = (uint32_t *)malloc(64 * words * sizeof(uint32_t));
+    buf->starts = (uint32_t *)malloc(64 * words * sizeof(uint32_t));
+    buf->lane_starts = (uint64_t *)malloc(BATCH_LANE_COUNT * words * sizeof(uint64_t));
+    buf->lane_eqs = (uint64_t *)malloc(BATCH_LANE_COUNT * words * sizeof(uint64_t));
+}
+
+static void free_lockstep(struct lockstep_buffer *buf) {
+    free(buf->codes);
+    free(buf->eqs);
+    free(buf->lts);
+    free(buf->gts);
+    free(buf->starts);
+    free(buf->lane_starts);
+    free(buf->lane_eqs);
+}
+
+/**
+ * @brief Computes the lane masks of the comparisons of each column with the next one.
+ */
+static void lane_masks_generic(const int8_t *codes, int len, uint32_t *eqs, uint32_t *lts, uint32_t *gts) {
+    for (int j = 0; j + 1 < len; j++) {
+        const int8_t *curr = codes + j * BATCH_LANE_COUNT;
+        const int8_t *next = curr + BATCH_LANE_COUNT;
+        uint32_t eq = 0, lt = 0, gt = 0;
+        for (int l = 0; l < BATCH_LANE_COUNT; l++) {
+            eq |= (uint32_t)(curr[l] == next[l]) << l;
+            lt |= (uint32_t)(curr[l] < next[l]) << l;
+            gt |= (uint32_t)(curr[l] > next[l]) << l;
+        }
+        eqs[j] = eq;
+        lts[j] = lt;
+        gts[j] = gt;
+    }
+}
+
+#ifdef BATCH_X86
+__attribute__((target("sse2")))
+static void lane_masks_sse2(const int8_t *codes, int len, uint32_t *eqs, uint32_t *lts, uint32_t *gts) {
+    for (int j = 0; j + 1 < len; j++) {
+        const int8_t *curr = codes + j * BATCH_LANE_COUNT;
+        __m128i a0 = _mm_loadu_si128((const __m128i *)curr);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(curr + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(curr + BATCH_LANE_COUNT));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(curr + BATCH_LANE_COUNT + 16));
+        eqs[j] = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0)) | (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1)) << 16;
+        lts[j] = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(b0, a0)) | (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(b1, a1)) << 16;
+        gts[j] = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(a0, b0)) | (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(a1, b1)) << 16;
+    }
+}
+
+__attribute__((target("avx2")))
+static void lane_masks_avx2(const int8_t *codes, int len, uint32_t *eqs, uint32_t *lts, uint32_t *gts) {
+    for (int j = 0; j + 1 < len; j++) {
+        const int8_t *curr = codes + j * BATCH_LANE_COUNT;
+        __m256i a = _mm256_loadu_si256((const __m256i *)curr);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(curr + BATCH_LANE_COUNT));
+        eqs[j] = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        lts[j] = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(b, a));
+        gts[j] = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(a, b));
+    }
+}
+#endif
+
+static void lane_masks(const int8_t *codes, int len, uint32_t *eqs, uint32_t *lts, uint32_t *gts) {
+#ifdef BATCH_X86
+    if (__builtin_cpu_supports("avx2")) {
+        lane_masks_avx2(codes, len, eqs, lts, gts);
+    } else if (__builtin_cpu_supports("sse2")) {
+        lane_masks_sse2(codes, len, eqs, lts, gts);
+    } else {
+        lane_masks_generic(codes, len, eqs, lts, gts);
+    }
+#else
+    lane_masks_generic(codes, len, eqs, lts, gts);
+#endif
+}
+
+/**
+ * @brief Transposes a 32x32 bit matrix, i.e. bit `j` of `a[i]` becomes bit `i` of `a[j]`.
+ */
+static void transpose32(uint32_t *a) {
+    uint32_t m = 0x0000FFFF;
+    for (int j = 16; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 32; k = (k + j + 1) & ~j) {
+            uint32_t t = ((a[k] >> j) ^ a[k + j]) & m;
+            a[k] ^= t << j;
+            a[k + j] ^= t;
+        }
+    }
+}
+
+/**
+ * @brief Transposes per-position lane masks into one bitset per lane.
+ */
+static void transpose_lanes(const uint32_t *masks, int words, uint64_t *lane_bits) {
+    uint32_t block[BATCH_LANE_COUNT];
+
+    memset(lane_bits, 0, BATCH_LANE_COUNT * words * sizeof(uint64_t));
+
+    for (int b = 0; b < 2 * words; b++) {
+        memcpy(block, masks + 32 * b, sizeof(block));
+        transpose32(block);
+        for (int l = 0; l < BATCH_LANE_COUNT; l++) {
+            lane_bits[l * words + b / 2] |= (uint64_t)block[l] << (32 * (b % 2));
+        }
+    }
+}
+
+/**
+ * @brief Parses up to `BATCH_LANE_COUNT` reads of the same length in lockstep.
+ */
+static void parse_lockstep(struct batch_worker *worker, const int *reads, int lane_count, int len) {
+    struct batch_context *ctx = worker->ctx;
+    struct lockstep_buffer *buf = &(worker->lockstep);
+    int words = (len + 63) / 64;
+
+    // transpose the encoded reads into lanes
+    for (int j = 0; j < len; j++) {
+        int8_t *column = buf->codes + j * BATCH_LANE_COUNT;
+        for (int l = 0; l < lane_count; l++) {
+            column[l] = (int8_t)lcp_default_context.rank[(unsigned char)ctx->reads[reads[l]][j]];
+        }
+        for (int l = lane_count; l < BATCH_LANE_COUNT; l++) {
+            column[l] = 0;
+        }
+    }
+
+    memset(buf->eqs + len - 1, 0, (64 * words - len + 1) * sizeof(uint32_t));
+    lane_masks(buf->codes, len, buf->eqs, buf->lts, buf->gts);
+
+    // evaluate the core predicates of `parse_masks` for all lanes at once
+    const uint32_t *eqs = buf->eqs, *lts = buf->lts, *gts = buf->gts;
+    for (int j = 0; j + 2 < len; j++) {
+        uint32_t lmax = (0 < j && j + 3 < len) ? lts[j] & gts[j+1] & ~gts[j-1] & ~lts[j+2] : 0;
+        buf->starts[j] = ~eqs[j] & (eqs[j+1] | (gts[j] & lts[j+1]) | lmax);
+    }
+    memset(buf->starts + len - 2, 0, (64 * words - len + 2) * sizeof(uint32_t));
+
+    transpose_lanes(buf->starts, words, buf->lane_starts);
+    transpose_lanes(buf->eqs, words, buf->lane_eqs);
+
+    for (int l = 0; l < lane_count; l++) {
+        const char *str = ctx->reads[reads[l]];
+        int size = parse_masks(str, str + len, buf->lane_starts + l * words, buf->lane_eqs + l * words, worker->scratch, 0);
+        finish_piece(&(ctx->lps_arr[reads[l]]), worker->scratch, size, ctx->lcp_level);
+    }
+}
+
+/**
+ * @brief Checks whether `BATCH_AGREEMENT_COUNT` cores starting from the given indices
+ * are identical in both arrays.
+ */
+static int agree(const struct core *lhs, int lhs_size, int i, const struct core *rhs, int rhs_size, int j) {
+    if (lhs_size < i + BATCH_AGREEMENT_COUNT || rhs_size < j + BATCH_AGREEMENT_COUNT) {
+        return 0;
+    }
+
+    for (int a = 0; a < BATCH_AGREEMENT_COUNT; a++) {
+        if (lhs[i+a].start != rhs[j+a].start || core_neq(&(lhs[i+a]), &(rhs[j+a]))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int batch_join(const struct core *lhs, int lhs_size, const struct core *rhs, int rhs_size, uint64_t cut,
+               int *lhs_index, int *rhs_index) {
+
+    // first core of the second piece starting after the cut
+    int j = 0;
+    while (j < rhs_size && rhs[j].start < cut) {
+        j++;
+    }
+
+    // the same core in the first piece
+    int i = lhs_size - 1;
+    while (0 <= i && j < rhs_size && rhs[j].start < lhs[i].start) {
+        i--;
+    }
+
+    *lhs_index = i;
+    *rhs_index = j;
+
+    return 0 <= i && agree(lhs, lhs_size, i, rhs, rhs_size, j);
+}
+
+/**
+ * @brief Stitches the chunks of a long read into a single `lps` object.
+ * @return 1 if the chunks agree on every overlap, 0 otherwise. The chunks are freed
+ * in both cases, and `lps_ptr` is not initialized in the latter.
+ */
+static int stitch(struct lps *lps_ptr, struct lps *chunks, int chunk_count) {
+
+    int64_t total = 0;
+    for (int k = 0; k < chunk_count; k++) {
+        total += chunks[k].size;
+    }
+
+    struct core *cores = (struct core *)malloc((total ? total : 1) * sizeof(struct core));
+    int size = chunks[0].size;
+    int success = 1;
+
+    memcpy(cores, chunks[0].cores, chunks[0].size * sizeof(struct core));
+    free(chunks[0].cores);
+
+    for (int k = 1; k < chunk_count; k++) {
+        const struct lps *chunk = &(chunks[k]);
+        uint64_t cut = (uint64_t)k * BATCH_CHUNK_SIZE + BATCH_CHUNK_OVERLAP / 2;
+        int i, j;
+
+        success = success && batch_join(cores, size, chunk->cores, chunk->size, cut, &i, &j);
+
+        if (success) {
+            for (int t = i; t < size; t++) {
+                free(cores[t].bit_rep);
+            }
+            for (int t = 0; t < j; t++) {
+                free(chunk->cores[t].bit_rep);
+            }
+            memcpy(cores + i, chunk->cores + j, (chunk->size - j) * sizeof(struct core));
+            size = i + chunk->size - j;
+            free(chunk->cores);
+        } else {
+            free_lps(&(chunks[k]));
+        }
+    }
+
+    if (!success) {
+        for (int t = 0; t < size; t++) {
+            free(cores[t].bit_rep);
+        }
+        free(cores);
+        return 0;
+    }
+
+    lps_ptr->level = chunks[0].level;
+    lps_ptr->size = size;
+    lps_ptr->cores = size ? (struct core *)realloc(cores, size * sizeof(struct core)) : cores;
+
+    return 1;
+}
+
+static void run_task(struct batch_worker *worker, const struct batch_task *task) {
+    struct batch_context *ctx = worker->ctx;
+
+    switch (task->kind) {
+        case BATCH_SHORT:
+            for (int i = task->first; i < task->last; ) {
+                int len = ctx->lengths[ctx->order[i]];
+                int run = 1;
+                while (i + run < task->last && ctx->lengths[ctx->order[i+run]] == len) {
+                    run++;
+                }
+
+                if (BATCH_LOCKSTEP_MIN <= run && 3 <= len && len <= BATCH_LOCKSTEP_LENGTH) {
+                    for (int g = 0; g < run; g += BATCH_LANE_COUNT) {
+                        parse_lockstep(worker, ctx->order + i + g, minimum(BATCH_LANE_COUNT, run - g), len);
+                    }
+                } else {
+                    for (int k = i; k < i + run; k++) {
+                        int read = ctx->order[k];
+                        parse_piece(&(ctx->lps_arr[read]), ctx->reads[read], 0, len, ctx->lcp_level, worker->scratch);
+                    }
+                }
+
+                i += run;
+            }
+            break;
+
+        case BATCH_CHUNK: {
+            const struct long_read *lr = &(ctx->long_reads[task->first]);
+            int len = ctx->lengths[lr->read];
+            int begin = task->last * BATCH_CHUNK_SIZE;
+            int end = task->last == lr->chunk_count - 1 ? len : begin + BATCH_CHUNK_SIZE + BATCH_CHUNK_OVERLAP;
+            parse_piece(&(ctx->chunks[lr->chunk_offset + task->last]), ctx->reads[lr->read], begin, end, ctx->lcp_level, worker->scratch);
+            break;
+        }
+
+        case BATCH_STITCH: {
+            const struct long_read *lr = &(ctx->long_reads[task->first]);
+            struct lps *lps_ptr = &(ctx->lps_arr[lr->read]);
+            if (!stitch(lps_ptr, ctx->chunks + lr->chunk_offset, lr->chunk_count)) {
+                // chunks disagree, process the read as a whole
+                init_lps(lps_ptr, ctx->reads[lr->read], ctx->lengths[lr->read]);
+                lps_deepen(lps_ptr, ctx->lcp_level);
+                __atomic_fetch_add(&(ctx->fallback_count), 1, __ATOMIC_RELAXED);
+            }
+            break;
+        }
+    }
+}
+
+static void *work(void *arg) {
+    struct batch_worker *worker = (struct batch_worker *)arg;
+    struct batch_context *ctx = worker->ctx;
+    int t;
+
+    while ((t = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < ctx->task_count) {
+        run_task(worker, &(ctx->tasks[t]));
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs the tasks of the context with all workers.
+ */
+static void run_workers(struct batch_worker *workers, int thread_count) {
+    workers[0].ctx->next_task = 0;
+    run_pool(work, workers, sizeof(struct batch_worker), thread_count);
+}
+
+int lps_batch(struct lps *lps_arr, const char **reads, const int *lengths, int count, int lcp_level, int thread_count) {
+
+    if (count <= 0) {
+        return 0;
+    }
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    // bin the reads by length, longest bin first
+    int bin_sizes[BATCH_BIN_COUNT] = {0};
+    int bin_offsets[BATCH_BIN_COUNT];
+    int max_short = 0, long_count = 0, chunk_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        bin_sizes[batch_bin(lengths[i])]++;
+        if (lengths[i] < BATCH_LONG_READ) {
+            max_short = maximum(max_short, lengths[i]);
+        } else {
+            long_count++;
+            chunk_count += (lengths[i] - BATCH_CHUNK_OVERLAP + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+        }
+    }
+
+    int offset = 0;
+    for (int b = BATCH_BIN_COUNT - 1; 0 <= b; b--) {
+        bin_offsets[b] = offset;
+        offset += bin_sizes[b];
+    }
+
+    struct batch_context ctx;
+    ctx.lps_arr = lps_arr;
+    ctx.reads = reads;
+    ctx.lengths = lengths;
+    ctx.lcp_level = lcp_level;
+    ctx.order = (int *)malloc(count * sizeof(int));
+    ctx.long_reads = (struct long_read *)malloc((long_count ? long_count : 1) * sizeof(struct long_read));
+    ctx.chunks = (struct lps *)malloc((chunk_count ? chunk_count : 1) * sizeof(struct lps));
+    ctx.tasks = (struct batch_task *)malloc((count + chunk_count) * sizeof(struct batch_task));
+    ctx.task_count = 0;
+    ctx.fallback_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        ctx.order[bin_offsets[batch_bin(lengths[i])]++] = i;
+    }
+
+    // chunks of the long reads first, as they are the most expensive tasks
+    long_count = 0;
+    chunk_count = 0;
+    int first_short = 0;
+
+    while (first_short < count && BATCH_LONG_READ <= lengths[ctx.order[first_short]]) {
+        struct long_read *lr = &(ctx.long_reads[long_count]);
+        lr->read = ctx.order[first_short];
+        lr->chunk_offset = chunk_count;
+        lr->chunk_count = (lengths[lr->read] - BATCH_CHUNK_OVERLAP + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+
+        for (int k = 0; k < lr->chunk_count; k++) {
+            struct batch_task *task = &(ctx.tasks[ctx.task_count++]);
+            task->kind = BATCH_CHUNK;
+            task->first = long_count;
+            task->last = k;
+        }
+
+        chunk_count += lr->chunk_count;
+        long_count++;
+        first_short++;
+    }
+
+    // pack the short reads, whose bins are contiguous in `order`
+    for (int i = first_short; i < count; ) {
+        struct batch_task *task = &(ctx.tasks[ctx.task_count++]);
+        int64_t bases = 0;
+
+        task->kind = BATCH_SHORT;
+        task->first = i;
+        do {
+            bases += lengths[ctx.order[i]];
+            i++;
+        } while (i < count && bases + lengths[ctx.order[i]] <= BATCH_TASK_SIZE);
+        task->last = i;
+    }
+
+    // scratch buffers are sized for the longest piece a worker can parse
+    int max_piece = long_count ? maximum(max_short, BATCH_CHUNK_SIZE + BATCH_CHUNK_OVERLAP) : max_short;
+    struct batch_worker *workers = (struct batch_worker *)malloc(thread_count * sizeof(struct batch_worker));
+
+    for (int t = 0; t < thread_count; t++) {
+        workers[t].ctx = &ctx;
+        workers[t].scratch = (struct core *)malloc((max_piece / CONSTANT_FACTOR + 1) * sizeof(struct core));
+        init_lockstep(&(workers[t].lockstep), minimum(max_short, BATCH_LOCKSTEP_LENGTH));
+    }
+
+    run_workers(workers, thread_count);
+
+    // stitch the long reads
+    if (long_count) {
+        ctx.task_count = 0;
+        for (int j = 0; j < long_count; j++) {
+            struct batch_task *task = &(ctx.tasks[ctx.task_count++]);
+            task->kind = BATCH_STITCH;
+            task->first = j;
+            task->last = 0;
+        }
+        run_workers(workers, thread_count);
+    }
+
+    for (int t = 0; t < thread_count; t++) {
+        free(workers[t].scratch);
+        free_lockstep(&(workers[t].lockstep));
+    }
+    free(workers);
+    free(ctx.order);
+    free(ctx.long_reads);
+    free(ctx.chunks);
+    free(ctx.tasks);
+
+    return ctx.fallback_count;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file batch.h
+ * @brief Multi-threaded processing of read batches with mixed read lengths.
+ *
+ * Processing every read of a batch as a separate unit of work gives poor load
+ * balance when short reads (e.g. 150 bp) and long reads (e.g. 100 kbp) are mixed,
+ * since a single long read can keep one thread busy while the others are idle.
+ * This file declares the batch API which schedules the work by read length.
+ *
+ * Key functionalities include:
+ * - Binning the reads by the binary logarithm of their lengths.
+ * - Packing short reads of similar lengths into tasks of about `BATCH_TASK_SIZE`
+ * bases, so that the cost of a task does not depend on the length mix.
+ * - Splitting long reads into overlapping chunks processed by different threads,
+ * in the way `init_lps4` processes a sequence chunk by chunk, and stitching the
+ * chunks where their cores agree.
+ * - Parsing runs of equal-length short reads in lockstep: up to `BATCH_LANE_COUNT`
+ * reads are transposed into the lanes of SIMD registers, so that the core
+ * predicates are evaluated for all of them with a few vector comparisons per
+ * position, and the cores of each read are emitted with `parse_masks`.
+ * - Sizing the per-thread parsing buffers once from the largest non-empty bin, so
+ * no per-read buffer is allocated.
+ *
+ * Tasks are claimed by the threads from a shared counter, longest first. The
+ * resulting `lps` objects are identical to the ones obtained with `init_lps` and
+ * `lps_deepen`. If the chunks of a long read do not agree on their overlap, the
+ * read is processed without chunking.
+ *
+ * @see lps.h
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+
+#define BATCH_BIN_COUNT         32
+#define BATCH_TASK_SIZE         (1 << 20)
+#define BATCH_CHUNK_SIZE        32768
+#define BATCH_CHUNK_OVERLAP     4096
+#define BATCH_LONG_READ         (2 * BATCH_CHUNK_SIZE)
+#define BATCH_AGREEMENT_COUNT   4
+#define BATCH_LANE_COUNT        32
+#define BATCH_LOCKSTEP_MIN      8
+#define BATCH_LOCKSTEP_LENGTH   1024
+
+/**
+ * @brief Processes a batch of reads with multiple threads.
+ *
+ * Each read is parsed and deepened to `lcp_level`. The `lps` object at index `i`
+ * is identical to the one obtained with `init_lps` followed by `lps_deepen` on the
+ * read at index `i`.
+ *
+ * @param lps_arr Array of at least `count` `lps` objects to be initialized.
+ * @param reads The reads to be processed.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param lcp_level The level the reads will be deepened to.
+ * @param thread_count Number of threads to be used.
+ * @return Number of long reads processed without chunking because their chunks
+ * did not agree.
+ */
+int lps_batch(struct lps *lps_arr, const char **reads, const int *lengths, int count, int lcp_level, int thread_count);
+
+/**
+ * @brief Finds where the cores of two overlapping pieces of a sequence are joined.
+ *
+ * The pieces are joined at the first core of `rhs` starting at or after `cut`, which
+ * should lie in their overlap, provided that `BATCH_AGREEMENT_COUNT` cores from there
+ * on are identical in both pieces. The cores of `lhs` before `*lhs_index` followed by
+ * the cores of `rhs` from `*rhs_index` on are then the cores of both pieces together.
+ *
+ * @param lhs Cores of the first piece.
+ * @param lhs_size Number of cores of the first piece.
+ * @param rhs Cores of the second piece.
+ * @param rhs_size Number of cores of the second piece.
+ * @param cut Position in the sequence from which the cores of `rhs` are taken.
+ * @param lhs_index Pointer where the index of the joining core in `lhs` will be stored.
+ * @param rhs_index Pointer where the index of the joining core in `rhs` will be stored.
+ * @return 1 if the pieces agree, 0 otherwise.
+ */
+int batch_join(const struct core *lhs, int lhs_size, const struct core *rhs, int rhs_size, uint64_t cut,
+               int *lhs_index, int *rhs_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file claim.h
+ * @brief Concurrent insertion into the open addressing tables whose slots are
+ * claimed with compare-and-swap.
+ *
+ * The deduplication sets and the node table of the graph builder are filled by
+ * many threads at once. A slot holds a 64-bit key and a 32-bit published word,
+ * which is written last, along with whatever else the table stores per slot. This
+ * file holds the insertion protocol they share. It is internal to the library and
+ * is not installed.
+ *
+ * Key functionalities include:
+ * - Claiming an empty slot by swapping the key in with compare-and-swap, filling the
+ * slot and publishing its word with a release store.
+ * - Waiting for the word of a slot holding the key to be published, and comparing
+ * the slot with the inserted item, so that items whose keys collide are stored in
+ * different slots.
+ *
+ */
+
+#ifndef CLAIM_H
+#define CLAIM_H
+
+#include <stdint.h>
+
+struct claim_table {
+    uint64_t slot_count; // a power of two
+    uint64_t empty_key;
+    uint32_t unpublished;
+    uint64_t *keys;
+    uint32_t *words;
+};
+
+/**
+ * @brief Finds the slot of an item, claiming an empty slot for it if it is absent.
+ *
+ * Probing starts at `slot` and goes on linearly. The key of an item should never
+ * be `empty_key`, nor its word `unpublished`. Being inlined, `fill` and `matches`
+ * are usually inlined as well.
+ *
+ * @param table The table.
+ * @param key The key of the item.
+ * @param slot The home slot of the key.
+ * @param word The word published when the item claims a slot.
+ * @param fill Stores the rest of the item into a claimed slot, before its word is
+ * published.
+ * @param matches Returns whether a slot holding the key, whose published word is
+ * `word`, holds the item.
+ * @param arg Argument passed to `fill` and `matches`.
+ * @return The slot of the item, or `slot_count` if the table is full.
+ */
+static inline uint64_t claim_slot(struct claim_table *table, uint64_t key, uint64_t slot, uint32_t word,
+                                  void (*fill)(void *arg, uint64_t slot), int (*matches)(void *arg, uint64_t slot, uint32_t word),
+                                  void *arg) {
+    uint64_t mask = table->slot_count - 1;
+
+    for (uint64_t probe = 0; probe < table->slot_count; probe++) {
+        uint64_t current = __atomic_load_n(&(table->keys[slot]), __ATOMIC_ACQUIRE);
+
+        if (current == table->empty_key) {
+            uint64_t expected = table->empty_key;
+            if (__atomic_compare_exchange_n(&(table->keys[slot]), &expected, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                fill(arg, slot);
+                __atomic_store_n(&(table->words[slot]), word, __ATOMIC_RELEASE);
+                return slot;
+            }
+            current = expected;
+        }
+
+        if (current == key) {
+            uint32_t published;
+            // the slot is filled and its word published right after the key is claimed
+            while ((published = __atomic_load_n(&(table->words[slot]), __ATOMIC_ACQUIRE)) == table->unpublished)
+                ;
+            if (matches(arg, slot, published)) {
+                return slot;
+            }
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return table->slot_count;
+}
+
+#endif
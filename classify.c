@@ -0,0 +1,423 @@
+/**
+ * @file classify.c
+ * @brief Implementation of the core label database and the read classifier.
+ *
+ * The database file consists of a fixed header, the parent array padded to a
+ * multiple of 8 bytes, and the slots of the table, so that every array of the
+ * mapped file is aligned.
+ */
+
+#include "classify.h"
+#include "pool.h"
+#include "probe.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct classify_header {
+    char magic[8];
+    int32_t level;
+    uint32_t taxon_count;
+    uint64_t slot_count;
+    uint64_t label_count;
+};
+
+struct build_context {
+    struct classify_db *db;
+    const char **refs;
+    const int *lengths;
+    const uint32_t *ref_taxa;
+    int ref_count;
+    int next_ref;
+    struct ltuples tuples;
+};
+
+struct build_worker {
+    struct build_context *ctx;
+    struct ltuples tuples;
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct classify_context {
+    const struct classify_db *db;
+    const char **reads;
+    const int *lengths;
+    int count;
+    struct classify_result *results;
+    int next_task;
+    int classified_count;
+};
+
+struct batch_lookup {
+    const struct classify_db *db;
+    const ulabel *labels;
+    uint32_t *taxa;
+};
+
+static inline uint32_t taxon_depth(const uint32_t *parents, uint32_t taxon) {
+    uint32_t depth = 0;
+    while (taxon != 0) {
+        taxon = parents[taxon];
+        depth++;
+    }
+    return depth;
+}
+
+uint32_t taxonomy_lca(const uint32_t *parents, uint32_t lhs, uint32_t rhs) {
+    uint32_t lhs_depth = taxon_depth(parents, lhs);
+    uint32_t rhs_depth = taxon_depth(parents, rhs);
+
+    while (rhs_depth < lhs_depth) {
+        lhs = parents[lhs];
+        lhs_depth--;
+    }
+    while (lhs_depth < rhs_depth) {
+        rhs = parents[rhs];
+        rhs_depth--;
+    }
+    while (lhs != rhs) {
+        lhs = parents[lhs];
+        rhs = parents[rhs];
+    }
+
+    return lhs;
+}
+
+static void *parse_refs(void *arg) {
+    struct build_worker *worker = (struct build_worker *)arg;
+    struct build_context *ctx = worker->ctx;
+    int r;
+
+    while ((r = __atomic_fetch_add(&(ctx->next_ref), 1, __ATOMIC_RELAXED)) < ctx->ref_count) {
+        struct lps lps_obj;
+        init_lps(&lps_obj, ctx->refs[r], ctx->lengths[r]);
+        lps_deepen(&lps_obj, ctx->db->level);
+        ltuples_add_lps(&(worker->tuples), &lps_obj, r);
+        free_lps(&lps_obj);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Reduces the label groups of a slice of the sorted tuples to their LCA and
+ * inserts them into the table.
+ */
+static void *insert_labels(void *arg) {
+    struct build_worker *worker = (struct build_worker *)arg;
+    struct build_context *ctx = worker->ctx;
+    struct classify_db *db = ctx->db;
+    const struct ltuple *tuples = ctx->tuples.tuples;
+    uint64_t mask = db->slot_count - 1;
+    uint64_t i = worker->begin;
+
+    while (i < worker->end) {
+        ulabel label = tuples[i].label;
+        uint32_t taxon = ctx->ref_taxa[tuples[i].record];
+
+        for (i++; i < worker->end && tuples[i].label == label; i++) {
+            uint32_t other = ctx->ref_taxa[tuples[i].record];
+            if (other != taxon) {
+                taxon = taxonomy_lca(db->parents, taxon, other);
+            }
+        }
+
+        uint64_t packed = ((uint64_t)label << 32) | taxon;
+        uint64_t slot = label_hash(label) & mask;
+        uint64_t expected = CLASSIFY_EMPTY_SLOT;
+        while (!__atomic_compare_exchange_n(&(db->slots[slot]), &expected, packed, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            slot = (slot + 1) & mask;
+            expected = CLASSIFY_EMPTY_SLOT;
+        }
+    }
+
+    return NULL;
+}
+
+void init_classify_db(struct classify_db *db, const char **refs, const int *lengths, const uint32_t *ref_taxa, int ref_count,
+                      const uint32_t *parents, uint32_t taxon_count, int lcp_level, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    db->level = lcp_level;
+    db->taxon_count = taxon_count;
+    db->parents = (uint32_t *)malloc((taxon_count ? taxon_count : 1) * sizeof(uint32_t));
+    memcpy(db->parents, parents, taxon_count * sizeof(uint32_t));
+    db->map = NULL;
+    db->map_size = 0;
+
+    struct build_context ctx = {db, refs, lengths, ref_taxa, ref_count, 0, {0, 0, NULL}};
+    struct build_worker *workers = (struct build_worker *)malloc(thread_count * sizeof(struct build_worker));
+
+    // parse the references in parallel
+    for (int t = 0; t < thread_count; t++) {
+        workers[t].ctx = &ctx;
+        init_ltuples(&(workers[t].tuples), 0);
+    }
+
+    run_pool(parse_refs, workers, sizeof(struct build_worker), thread_count);
+
+    uint64_t total = 0;
+    for (int t = 0; t < thread_count; t++) {
+        total += workers[t].tuples.size;
+    }
+
+    init_ltuples(&(ctx.tuples), total);
+    for (int t = 0; t < thread_count; t++) {
+        memcpy(ctx.tuples.tuples + ctx.tuples.size, workers[t].tuples.tuples, workers[t].tuples.size * sizeof(struct ltuple));
+        ctx.tuples.size += workers[t].tuples.size;
+        free_ltuples(&(workers[t].tuples));
+    }
+
+    ltuples_sort(&(ctx.tuples), thread_count);
+
+    // size the table
+    db->label_count = 0;
+    for (uint64_t i = 0; i < ctx.tuples.size; i++) {
+        if (i == 0 || ctx.tuples.tuples[i].label != ctx.tuples.tuples[i-1].label) {
+            db->label_count++;
+        }
+    }
+
+    db->slot_count = 1;
+    while (db->slot_count * CLASSIFY_LOAD_FACTOR < db->label_count + 1) {
+        db->slot_count *= 2;
+    }
+    db->slots = (uint64_t *)malloc(db->slot_count * sizeof(uint64_t));
+    memset(db->slots, 0xFF, db->slot_count * sizeof(uint64_t));
+
+    // split the sorted tuples into slices at label boundaries and insert them in parallel
+    uint64_t slice = (ctx.tuples.size + thread_count - 1) / thread_count;
+    uint64_t begin = 0;
+    for (int t = 0; t < thread_count; t++) {
+        uint64_t end = minimum(begin + slice, ctx.tuples.size);
+        while (0 < end && end < ctx.tuples.size && ctx.tuples.tuples[end].label == ctx.tuples.tuples[end-1].label) {
+            end++;
+        }
+        workers[t].begin = begin;
+        workers[t].end = end;
+        begin = end;
+    }
+
+    run_pool(insert_labels, workers, sizeof(struct build_worker), thread_count);
+
+    free_ltuples(&(ctx.tuples));
+    free(workers);
+}
+
+void free_classify_db(struct classify_db *db) {
+    if (db->map) {
+        munmap(db->map, db->map_size);
+    } else {
+        free(db->parents);
+        free(db->slots);
+    }
+    db->map = NULL;
+    db->parents = NULL;
+    db->slots = NULL;
+    db->slot_count = 0;
+    db->label_count = 0;
+}
+
+int classify_db_save(const struct classify_db *db, const char *filename) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        return 0;
+    }
+
+    struct classify_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CLASSIFY_MAGIC, sizeof(header.magic));
+    header.level = db->level;
+    header.taxon_count = db->taxon_count;
+    header.slot_count = db->slot_count;
+    header.label_count = db->label_count;
+
+    uint32_t padding = 0;
+    int success = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(db->parents, sizeof(uint32_t), db->taxon_count, out) == db->taxon_count &&
+                  fwrite(&padding, sizeof(uint32_t), db->taxon_count % 2, out) == db->taxon_count % 2 &&
+                  fwrite(db->slots, sizeof(uint64_t), db->slot_count, out) == db->slot_count;
+
+    return fclose(out) == 0 && success;
+}
+
+int classify_db_open(struct classify_db *db, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(struct classify_header)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    const struct classify_header *header = (const struct classify_header *)map;
+    uint64_t parents_size = (header->taxon_count + header->taxon_count % 2) * sizeof(uint32_t);
+
+    // the table should be a power of two with an empty slot, so that probing wraps around and stops
+    if (memcmp(header->magic, CLASSIFY_MAGIC, sizeof(header->magic)) != 0 ||
+        !header->slot_count || (header->slot_count & (header->slot_count - 1)) != 0 ||
+        header->slot_count >= ((uint64_t)1 << 60) || header->slot_count <= header->label_count ||
+        (uint64_t)st.st_size != sizeof(struct classify_header) + parents_size + header->slot_count * sizeof(uint64_t)) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    db->level = header->level;
+    db->taxon_count = header->taxon_count;
+    db->slot_count = header->slot_count;
+    db->label_count = header->label_count;
+    db->parents = (uint32_t *)((char *)map + sizeof(struct classify_header));
+    db->slots = (uint64_t *)((char *)map + sizeof(struct classify_header) + parents_size);
+    db->map = map;
+    db->map_size = st.st_size;
+
+    return 1;
+}
+
+static inline uint32_t probe(const struct classify_db *db, ulabel label, uint64_t slot) {
+    uint64_t mask = db->slot_count - 1;
+
+    while (db->slots[slot] != CLASSIFY_EMPTY_SLOT) {
+        if ((ulabel)(db->slots[slot] >> 32) == label) {
+            return (uint32_t)db->slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return CLASSIFY_NONE;
+}
+
+uint32_t classify_db_lookup(const struct classify_db *db, ulabel label) {
+    return probe(db, label, label_hash(label) & (db->slot_count - 1));
+}
+
+/**
+ * @brief Probes a label of a batch, storing its taxon.
+ */
+static inline void lookup_taxon(void *arg, uint64_t i, uint64_t slot) {
+    struct batch_lookup *lookup = (struct batch_lookup *)arg;
+    lookup->taxa[i] = probe(lookup->db, lookup->labels[i], slot);
+}
+
+void classify_lps(const struct classify_db *db, const struct lps *read, struct classify_result *result) {
+
+    ulabel *labels = (ulabel *)malloc((read->size ? read->size : 1) * sizeof(ulabel));
+    uint32_t *hit_taxa = (uint32_t *)malloc((read->size ? read->size : 1) * sizeof(uint32_t));
+    uint32_t *taxa = (uint32_t *)malloc((read->size ? read->size : 1) * sizeof(uint32_t));
+    uint32_t *votes = (uint32_t *)malloc((read->size ? read->size : 1) * sizeof(uint32_t));
+    int taxon_count = 0;
+
+    result->taxon = CLASSIFY_NONE;
+    result->hits = 0;
+    result->cores = read->size;
+
+    // look up the labels with the slots prefetched ahead of their probes
+    for (int i = 0; i < read->size; i++) {
+        labels[i] = read->cores[i].label;
+    }
+
+    struct batch_lookup lookup = {db, labels, hit_taxa};
+    probe_batch(db->slots, sizeof(uint64_t), db->slot_count, labels, read->size, CLASSIFY_PREFETCH_DISTANCE, lookup_taxon,
+                &lookup);
+
+    for (int i = 0; i < read->size; i++) {
+        uint32_t taxon = hit_taxa[i];
+
+        if (taxon == CLASSIFY_NONE) {
+            continue;
+        }
+
+        result->hits++;
+
+        int j = 0;
+        while (j < taxon_count && taxa[j] != taxon) {
+            j++;
+        }
+        if (j == taxon_count) {
+            taxa[taxon_count] = taxon;
+            votes[taxon_count] = 0;
+            taxon_count++;
+        }
+        votes[j]++;
+    }
+
+    // score each taxon by the votes on its path to the root
+    uint32_t best_score = 0;
+    for (int j = 0; j < taxon_count; j++) {
+        uint32_t score = 0;
+        uint32_t taxon = taxa[j];
+        while (1) {
+            for (int k = 0; k < taxon_count; k++) {
+                if (taxa[k] == taxon) {
+                    score += votes[k];
+                }
+            }
+            if (taxon == 0) {
+                break;
+            }
+            taxon = db->parents[taxon];
+        }
+
+        if (best_score < score) {
+            best_score = score;
+            result->taxon = taxa[j];
+        } else if (best_score == score) {
+            result->taxon = taxonomy_lca(db->parents, result->taxon, taxa[j]);
+        }
+    }
+
+    free(labels);
+    free(hit_taxa);
+    free(taxa);
+    free(votes);
+}
+
+static void *classify_work(void *arg) {
+    struct classify_context *ctx = (struct classify_context *)arg;
+    int task;
+
+    while ((task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * CLASSIFY_TASK_SIZE < ctx->count) {
+        int classified_count = 0;
+
+        for (int i = task * CLASSIFY_TASK_SIZE; i < minimum(ctx->count, (task + 1) * CLASSIFY_TASK_SIZE); i++) {
+            struct lps lps_obj;
+            init_lps(&lps_obj, ctx->reads[i], ctx->lengths[i]);
+            lps_deepen(&lps_obj, ctx->db->level);
+            classify_lps(ctx->db, &lps_obj, &(ctx->results[i]));
+            free_lps(&lps_obj);
+
+            classified_count += ctx->results[i].taxon != CLASSIFY_NONE;
+        }
+
+        __atomic_fetch_add(&(ctx->classified_count), classified_count, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+int classify_reads(const struct classify_db *db, const char **reads, const int *lengths, int count,
+                   struct classify_result *results, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    struct classify_context ctx = {db, reads, lengths, count, results, 0, 0};
+    run_pool(classify_work, &ctx, 0, thread_count);
+
+    return ctx.classified_count;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file classify.h
+ * @brief Taxonomic classification of reads against a database of LCP core labels.
+ *
+ * The database maps each core label of a set of reference sequences to a taxon.
+ * Labels occurring in references of different taxa are mapped to the lowest common
+ * ancestor (LCA) of these taxa in the taxonomy, which is given as a parent array
+ * with the root at taxon 0. A read is classified by looking up the labels of its
+ * cores and voting over the taxa found: each taxon is scored by the votes of the
+ * taxa on its path to the root, and the taxon with the highest score is reported.
+ * Ties are resolved to the LCA of the tied taxa.
+ *
+ * Key functionalities include:
+ * - Building the database in parallel: references are parsed by multiple threads,
+ * their tuples are sorted with `ltuples_sort`, and the LCA of each label group is
+ * inserted into an open addressing table with compare-and-swap.
+ * - Saving the database into a single file and opening it with `mmap`, so that it
+ * is shared by all processes on a node and loaded on demand.
+ * - Classifying batches of reads with multiple threads, with the table slots of the
+ * labels prefetched ahead of their probes.
+ *
+ * Each slot of the table packs a label and its taxon into 64 bits, so that a slot
+ * is claimed and filled with a single atomic operation.
+ *
+ * @see sort.h
+ * @see index.h
+ *
+ * @struct classify_db
+ * @struct classify_result
+ *
+ */
+
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sort.h"
+#include <stdint.h>
+
+#define CLASSIFY_NONE               UINT32_MAX
+#define CLASSIFY_EMPTY_SLOT         UINT64_MAX
+#define CLASSIFY_LOAD_FACTOR        0.5
+#define CLASSIFY_PREFETCH_DISTANCE  16
+#define CLASSIFY_TASK_SIZE          1024
+#define CLASSIFY_MAGIC              "LCPCDB1"
+
+struct classify_db {
+    int level;
+    uint32_t taxon_count;
+    uint64_t slot_count;
+    uint64_t label_count;
+    uint32_t *parents;
+    uint64_t *slots;
+    void *map;
+    uint64_t map_size;
+};
+
+struct classify_result {
+    uint32_t taxon;
+    uint32_t hits;
+    uint32_t cores;
+};
+
+/**
+ * @brief Returns the lowest common ancestor of two taxa.
+ *
+ * @param parents Parent of each taxon, the root being taxon 0.
+ * @param lhs The first taxon.
+ * @param rhs The second taxon.
+ * @return The lowest common ancestor.
+ */
+uint32_t taxonomy_lca(const uint32_t *parents, uint32_t lhs, uint32_t rhs);
+
+/**
+ * @brief Builds a database from reference sequences with multiple threads.
+ *
+ * @param db Pointer to the database to initialize.
+ * @param refs The reference sequences.
+ * @param lengths Lengths of the reference sequences.
+ * @param ref_taxa Taxon of each reference sequence.
+ * @param ref_count Number of reference sequences.
+ * @param parents Parent of each taxon, the root being taxon 0. It is copied.
+ * @param taxon_count Number of taxa.
+ * @param lcp_level The level of the cores stored in the database.
+ * @param thread_count Number of threads to be used.
+ */
+void init_classify_db(struct classify_db *db, const char **refs, const int *lengths, const uint32_t *ref_taxa, int ref_count,
+                      const uint32_t *parents, uint32_t taxon_count, int lcp_level, int thread_count);
+
+/**
+ * @brief Frees or unmaps the memory of the database.
+ *
+ * @param db Pointer to the database to deallocate.
+ */
+void free_classify_db(struct classify_db *db);
+
+/**
+ * @brief Saves the database into a file which can be opened with `classify_db_open`.
+ *
+ * @param db The database.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 otherwise.
+ */
+int classify_db_save(const struct classify_db *db, const char *filename);
+
+/**
+ * @brief Opens a database saved with `classify_db_save` by mapping it into memory.
+ *
+ * @param db Pointer to the database to initialize.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 if the file cannot be mapped or is not a database.
+ */
+int classify_db_open(struct classify_db *db, const char *filename);
+
+/**
+ * @brief Returns the taxon of a label.
+ *
+ * @param db The database.
+ * @param label The label to look up.
+ * @return The taxon of the label, or `CLASSIFY_NONE` if the label is absent.
+ */
+uint32_t classify_db_lookup(const struct classify_db *db, ulabel label);
+
+/**
+ * @brief Classifies a read by voting over the taxa of its cores.
+ *
+ * @param db The database.
+ * @param read The cores of the read, at the level of the database.
+ * @param result Pointer where the result will be stored. The taxon is
+ * `CLASSIFY_NONE` if no core is found in the database.
+ */
+void classify_lps(const struct classify_db *db, const struct lps *read, struct classify_result *result);
+
+/**
+ * @brief Parses and classifies a batch of reads with multiple threads.
+ *
+ * @param db The database.
+ * @param reads The reads.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param results Array of at least `count` results.
+ * @param thread_count Number of threads to be used.
+ * @return Number of classified reads.
+ */
+int classify_reads(const struct classify_db *db, const char **reads, const int *lengths, int count,
+                   struct classify_result *results, int thread_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,11 @@
 
 #include "core.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CORE_X86
+#endif
+
 /**
  * @brief Computes the 32-bit MurmurHash3 hash for a given key.
  *
@@ -89,15 +94,361 @@ uint32_t MurmurHash3_32(const void *key, int len, uint32_t seed) {
     return h1;
 }
 
-void init_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index) {
+/**
+ * @brief Returns the number of blocks needed for `bit_size` bits.
+ */
+static inline ubit_size blocks_of(ubit_size bit_size) {
+    return (bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+}
+
+/**
+ * @brief Returns `count` bits, at most `UBLOCK_BIT_SIZE`, of a right-aligned bit
+ * array of `size` bits, starting `pos` bits above its least significant bit.
+ */
+static inline ublock get_bits(const ublock *rep, ubit_size size, ubit_size pos, ubit_size count) {
+    ubit_size block_index = blocks_of(size) - 1 - pos / UBLOCK_BIT_SIZE;
+    ubit_size shift = pos % UBLOCK_BIT_SIZE;
+    uint64_t value = rep[block_index] >> shift;
+
+    if (shift && shift + count > UBLOCK_BIT_SIZE) {
+        value |= (uint64_t)rep[block_index - 1] << (UBLOCK_BIT_SIZE - shift);
+    }
+
+    return (ublock)(value & ((1ULL << count) - 1));
+}
+
+/**
+ * @brief Pastes the `count` bits of `value` into a zero-initialized right-aligned bit
+ * array of `size` bits, starting `pos` bits above its least significant bit.
+ */
+static inline void put_bits(ublock *rep, ubit_size size, ubit_size pos, ublock value, ubit_size count) {
+    ubit_size block_index = blocks_of(size) - 1 - pos / UBLOCK_BIT_SIZE;
+    ubit_size shift = pos % UBLOCK_BIT_SIZE;
+
+    rep[block_index] |= (value << shift);
+
+    if (shift && shift + count > UBLOCK_BIT_SIZE) {
+        rep[block_index - 1] |= (value >> (UBLOCK_BIT_SIZE - shift));
+    }
+}
+
+/**
+ * @brief Returns the left context, unit and right context arrays of a run-length encoded core.
+ */
+static inline ublock *run_left(const struct core *cr) {
+    return cr->bit_rep + 2;
+}
+
+static inline ublock *run_unit(const struct core *cr) {
+    return run_left(cr) + blocks_of(cr->bit_rep[0]);
+}
+
+static inline ublock *run_right(const struct core *cr) {
+    return run_unit(cr) + blocks_of(cr->bit_rep[1]);
+}
+
+/**
+ * @brief Returns the size of the right context of a run-length encoded core.
+ */
+static inline ubit_size run_right_size(const struct core *cr) {
+    return cr->bit_size - cr->bit_rep[0] - cr->run * cr->bit_rep[1];
+}
+
+/**
+ * @brief Allocates a zero-initialized run-length encoded representation.
+ */
+static void init_run(struct core *cr, ubit_size left_size, ubit_size unit_size, uint32_t run, ubit_size right_size) {
+    cr->bit_size = left_size + run * unit_size + right_size;
+    cr->run = run;
+
+    ubit_size block_number = 2 + blocks_of(left_size) + blocks_of(unit_size) + blocks_of(right_size);
+    cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
+    memset(cr->bit_rep, 0, block_number * sizeof(ublock));
+
+    cr->bit_rep[0] = left_size;
+    cr->bit_rep[1] = unit_size;
+}
+
+/**
+ * @brief Returns a block of any core, reading `bit_rep` directly unless the core is run-length encoded.
+ */
+static inline ublock block_at(const struct core *cr, ubit_size index) {
+    return cr->run ? core_block(cr, index) : cr->bit_rep[index];
+}
+
+/**
+ * @brief Pastes the expanded bit representation of `src` into a zero-initialized
+ * right-aligned bit array of `size` bits, starting `pos` bits above its least
+ * significant bit.
+ */
+static void put_core(ublock *rep, ubit_size size, ubit_size pos, const struct core *src) {
+    ubit_size last = blocks_of(src->bit_size) - 1;
+
+    for (ubit_size i = last; ; i--) {
+        ubit_size count = i ? UBLOCK_BIT_SIZE : src->bit_size - last * UBLOCK_BIT_SIZE;
+        put_bits(rep, size, pos, block_at(src, i), count);
+        pos += count;
+
+        if (i == 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Writes a bit string into blocks from its least significant bits, one block
+ * at a time, by funnel shifting the appended bits through a 64-bit accumulator.
+ */
+struct bit_writer {
+    ublock *rep;
+    int64_t block_index;
+    uint64_t acc;
+    ubit_size filled;
+};
+
+/**
+ * @brief Appends the `count` bits of `bits`, at most `UBLOCK_BIT_SIZE`, above the bits written so far.
+ */
+static inline void writer_put(struct bit_writer *w, uint64_t bits, ubit_size count) {
+    w->acc |= (bits << w->filled);
+    w->filled += count;
+
+    if (w->filled >= UBLOCK_BIT_SIZE) {
+        w->rep[w->block_index--] = (ublock)w->acc;
+        w->acc >>= UBLOCK_BIT_SIZE;
+        w->filled -= UBLOCK_BIT_SIZE;
+    }
+}
+
+/**
+ * @brief Writes the remaining bits into the most significant block.
+ */
+static inline void writer_finish(struct bit_writer *w) {
+    if (w->filled) {
+        w->rep[w->block_index] = (ublock)w->acc;
+    }
+}
+
+/**
+ * @brief Returns the code of a character as an integer, -1 if it has no code.
+ */
+static inline int code_of(const uint8_t *table, char c) {
+    uint8_t code = table[(unsigned char)c];
+    return code == LCP_NO_CODE ? -1 : code;
+}
+
+/**
+ * @brief Gathers the codes of 8 characters, read from `first` in steps of `step`, into
+ * the bytes of a word, the first character into the lowest byte.
+ *
+ * @return 1 if all characters have a code, 0 otherwise.
+ */
+static inline int gather8(const char *first, int64_t step, const uint8_t *table, uint64_t *codes) {
+    int invalid = 0;
+    uint64_t word = 0;
+
+    for (int j = 0; j < 8; j++) {
+        uint8_t code = table[(unsigned char)(*(first + j * step))];
+        invalid |= (code == LCP_NO_CODE);
+        word |= (uint64_t)code << (8 * j);
+    }
+
+    *codes = word;
+    return !invalid;
+}
+
+/**
+ * @brief Packs the codes of `count` characters, read from `first` in steps of `step`
+ * from the least significant one, into `block_number` blocks.
+ *
+ * Eight codes are gathered at a time and packed with shifts. Requires `bit_size`
+ * to be at most 4.
+ *
+ * @return 1 on success, 0 if any of the characters has no code.
+ */
+static int pack_chars_generic(ublock *rep, ubit_size block_number, const char *first, int64_t step, uint64_t count, const uint8_t *table, int bit_size) {
+    struct bit_writer w = {rep, (int64_t)block_number - 1, 0, 0};
+    uint64_t low = (1ULL << bit_size) - 1, codes;
+    uint64_t k = 0;
+
+    for (; k + 8 <= count; k += 8) {
+        if (!gather8(first + (int64_t)k * step, step, table, &codes)) {
+            return 0;
+        }
+
+        uint64_t packed = 0;
+        for (int j = 0; j < 8; j++) {
+            packed |= ((codes >> (8 * j)) & low) << (bit_size * j);
+        }
+        writer_put(&w, packed, 8 * bit_size);
+    }
+
+    for (; k < count; k++) {
+        uint8_t code = table[(unsigned char)(*(first + (int64_t)k * step))];
+        if (code == LCP_NO_CODE) {
+            return 0;
+        }
+        writer_put(&w, code, bit_size);
+    }
+
+    writer_finish(&w);
+    return 1;
+}
+
+#ifdef CORE_X86
+/**
+ * @brief Same as `pack_chars_generic`, but packs eight gathered codes with a single `pext`.
+ */
+__attribute__((target("bmi2")))
+static int pack_chars_bmi2(ublock *rep, ubit_size block_number, const char *first, int64_t step, uint64_t count, const uint8_t *table, int bit_size) {
+    struct bit_writer w = {rep, (int64_t)block_number - 1, 0, 0};
+    uint64_t mask = ((1ULL << bit_size) - 1) * 0x0101010101010101ULL, codes;
+    uint64_t k = 0;
+
+    for (; k + 8 <= count; k += 8) {
+        if (!gather8(first + (int64_t)k * step, step, table, &codes)) {
+            return 0;
+        }
+        writer_put(&w, _pext_u64(codes, mask), 8 * bit_size);
+    }
+
+    for (; k < count; k++) {
+        uint8_t code = table[(unsigned char)(*(first + (int64_t)k * step))];
+        if (code == LCP_NO_CODE) {
+            return 0;
+        }
+        writer_put(&w, code, bit_size);
+    }
+
+    writer_finish(&w);
+    return 1;
+}
+#endif
+
+/**
+ * @brief Packs the codes of characters into blocks, selecting the `pext` kernel at runtime.
+ *
+ * @return 1 on success, 0 if the characters cannot be packed, in which case the caller
+ * should fall back to encoding them one at a time.
+ */
+static inline int pack_chars(ublock *rep, ubit_size block_number, const char *first, int64_t step, uint64_t count, const uint8_t *table, int bit_size) {
+    if (4 < bit_size) {
+        return 0;
+    }
+#ifdef CORE_X86
+    if (__builtin_cpu_supports("bmi2")) {
+        return pack_chars_bmi2(rep, block_number, first, step, count, table, bit_size);
+    }
+#endif
+    return pack_chars_generic(rep, block_number, first, step, count, table, bit_size);
+}
+
+/**
+ * @brief Initializes a run-length encoded core from characters if all characters but
+ * the first and the last have the same code.
+ *
+ * The characters are read from `first` in steps of `step`, from the most significant
+ * one. The unit consists of `UBLOCK_BIT_SIZE` characters, so that its size is a
+ * multiple of the block size, and the remaining repeated characters are placed into
+ * the right context.
+ *
+ * @return 1 if the core is initialized, 0 otherwise.
+ */
+static int init_char_run(struct core *cr, const char *first, int64_t step, uint64_t distance, const uint8_t *table, int bit_size) {
+
+    uint8_t code = table[(unsigned char)(*(first + step))];
+    uint8_t left = table[(unsigned char)(*first)];
+    uint8_t right = table[(unsigned char)(*(first + (int64_t)(distance - 1) * step))];
+    if (code == LCP_NO_CODE || left == LCP_NO_CODE || right == LCP_NO_CODE) {
+        return 0;
+    }
+
+    for (uint64_t i = 2; i < distance - 1; i++) {
+        if (table[(unsigned char)(*(first + (int64_t)i * step))] != code) {
+            return 0;
+        }
+    }
+
+    uint64_t middle = distance - 2;
+    ubit_size unit_length = UBLOCK_BIT_SIZE;
+    ubit_size right_size = (middle % unit_length + 1) * bit_size;
+    init_run(cr, bit_size, unit_length * bit_size, middle / unit_length, right_size);
+
+    put_bits(run_left(cr), bit_size, 0, left, bit_size);
+    for (ubit_size i = 0; i < unit_length; i++) {
+        put_bits(run_unit(cr), cr->bit_rep[1], i * bit_size, code, bit_size);
+    }
+    put_bits(run_right(cr), right_size, 0, right, bit_size);
+    for (ubit_size i = 1; i < right_size / bit_size; i++) {
+        put_bits(run_right(cr), right_size, i * bit_size, code, bit_size);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Initializes a run-length encoded core from child cores if all children but
+ * the first and the last are equal.
+ *
+ * The unit consists of as many copies of the repeated child as needed to make its
+ * size a multiple of the block size, and the remaining copies are placed into the
+ * right context.
+ *
+ * @return 1 if the core is initialized, 0 otherwise.
+ */
+static int init_core_run(struct core *cr, const struct core *begin, uint64_t distance) {
+
+    const struct core *repeated = begin + 1, *last = begin + distance - 1;
+    for (const struct core *it = repeated + 1; it < last; it++) {
+        if (!core_eq(repeated, it)) {
+            return 0;
+        }
+    }
+
+    uint64_t middle = distance - 2;
+    ubit_size copies = UBLOCK_BIT_SIZE / (1U << __builtin_ctz(repeated->bit_size | UBLOCK_BIT_SIZE));
+    ubit_size right_size = (middle % copies) * repeated->bit_size + last->bit_size;
+    init_run(cr, begin->bit_size, copies * repeated->bit_size, middle / copies, right_size);
+
+    put_core(run_left(cr), begin->bit_size, 0, begin);
+    for (ubit_size i = 0; i < copies; i++) {
+        put_core(run_unit(cr), cr->bit_rep[1], i * repeated->bit_size, repeated);
+    }
+    put_core(run_right(cr), right_size, 0, last);
+    for (ubit_size i = 0; i < middle % copies; i++) {
+        put_core(run_right(cr), right_size, last->bit_size + i * repeated->bit_size, repeated);
+    }
+
+    return 1;
+}
+
+void init_core1_ctx(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, const struct lcp_context *ctx) {
 
     cr->start = start_index;
     cr->end = end_index;
-    cr->bit_size = alphabet_bit_size * distance;
+    cr->run = 0;
+
+    cr->label = 0;
+    cr->label |= ((distance-2) << (3 * ctx->bit_size));
+    cr->label |= (code_of(ctx->encode, *(begin) & 0xDF) << (2 * ctx->bit_size));
+    cr->label |= (code_of(ctx->encode, *(begin+distance-2) & 0xDF) << ctx->bit_size);
+    cr->label |= (code_of(ctx->encode, *(begin+distance-1) & 0xDF));
+
+    if (CORE_RUN_MIN_LENGTH + 2 <= distance && init_char_run(cr, begin, 1, distance, ctx->encode, ctx->bit_size)) {
+        return;
+    }
+
+    cr->bit_size = ctx->bit_size * distance;
 
     /* allocate memory for representation */
     ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
     cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
+
+    if (pack_chars(cr->bit_rep, block_number, begin + distance - 1, -1, distance, ctx->encode, ctx->bit_size)) {
+        return;
+    }
+
+    /* characters without codes are encoded one at a time */
     memset(cr->bit_rep, 0, block_number * sizeof(ublock));
 
     ubit_size shift = 0;
@@ -105,69 +456,83 @@ void init_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t
 
     for (const char *it = begin + distance - 1; begin <= it; it--) {
 
-        int o_bit_rep = alphabet[(int)(*it)];
+        int o_bit_rep = code_of(ctx->encode, *it);
 
         /* shift and paste */
         cr->bit_rep[block_index] |= (o_bit_rep << shift);
 
         /* if there is an overflow after shifting, it pastes the */
         /* overfloaw to the left block. */
-        if (shift + alphabet_bit_size > UBLOCK_BIT_SIZE) {
+        if (shift + ctx->bit_size > UBLOCK_BIT_SIZE) {
             cr->bit_rep[block_index - 1] |= (o_bit_rep >> (UBLOCK_BIT_SIZE - shift));
         }
 
-        if (shift + alphabet_bit_size >= UBLOCK_BIT_SIZE) {
+        if (shift + ctx->bit_size >= UBLOCK_BIT_SIZE) {
             block_index--;
         }
 
-        shift = (shift + alphabet_bit_size) % UBLOCK_BIT_SIZE;
+        shift = (shift + ctx->bit_size) % UBLOCK_BIT_SIZE;
     }
-    
-    cr->label = 0;
-    cr->label |= ((distance-2) << (3 * alphabet_bit_size));
-    cr->label |= (alphabet[(*(begin)) & 0xDF] << (2 * alphabet_bit_size));
-    cr->label |= (alphabet[(*(begin+distance-2)) & 0xDF] << alphabet_bit_size);
-    cr->label |= (alphabet[(*(begin+distance-1)) & 0xDF]);
 }
 
-void init_core2(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index) {
+void init_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index) {
+    init_core1_ctx(cr, begin, distance, start_index, end_index, &lcp_default_context);
+}
+
+void init_core2_ctx(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, const struct lcp_context *ctx) {
 
     cr->start = start_index;
     cr->end = end_index;
-    cr->bit_size = alphabet_bit_size * distance;
+    cr->run = 0;
+
+    cr->label = 0;
+    cr->label |= ((distance-2) << (3 * ctx->bit_size));
+    cr->label |= (code_of(ctx->complement, *(begin) & 0xDF) << (2 * ctx->bit_size));
+    cr->label |= (code_of(ctx->complement, *(begin-distance+2) & 0xDF) << ctx->bit_size);
+    cr->label |= (code_of(ctx->complement, *(begin-distance+1) & 0xDF));
+
+    if (CORE_RUN_MIN_LENGTH + 2 <= distance && init_char_run(cr, begin, -1, distance, ctx->complement, ctx->bit_size)) {
+        return;
+    }
+
+    cr->bit_size = ctx->bit_size * distance;
 
     /* allocate memory for representation */
     ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
     cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
+
+    if (pack_chars(cr->bit_rep, block_number, begin - distance + 1, 1, distance, ctx->complement, ctx->bit_size)) {
+        return;
+    }
+
+    /* characters without codes are encoded one at a time */
     memset(cr->bit_rep, 0, block_number * sizeof(ublock));
 
     ubit_size shift = 0;
     int block_index = block_number - 1;
 
     for (const char *it = begin - distance + 1; it <= begin; it++) {
-        int o_bit_rep = rc_alphabet[(int)(*it)];
+        int o_bit_rep = code_of(ctx->complement, *it);
 
         /* shift and paste */
         cr->bit_rep[block_index] |= (o_bit_rep << shift);
 
         /* if there is an overflow after shifting, it pastes the */
         /* overfloaw to the left block. */
-        if (shift + alphabet_bit_size > UBLOCK_BIT_SIZE) {
+        if (shift + ctx->bit_size > UBLOCK_BIT_SIZE) {
             cr->bit_rep[block_index - 1] |= (o_bit_rep >> (UBLOCK_BIT_SIZE - shift));
         }
 
-        if (shift + alphabet_bit_size >= UBLOCK_BIT_SIZE) {
+        if (shift + ctx->bit_size >= UBLOCK_BIT_SIZE) {
             block_index--;
         }
 
-        shift = (shift + alphabet_bit_size) % UBLOCK_BIT_SIZE;
+        shift = (shift + ctx->bit_size) % UBLOCK_BIT_SIZE;
     }
+}
 
-    cr->label = 0;
-    cr->label |= ((distance-2) << (3 * alphabet_bit_size));
-    cr->label |= (rc_alphabet[(*(begin)) & 0xDF] << (2 * alphabet_bit_size));
-    cr->label |= (rc_alphabet[(*(begin+distance-2)) & 0xDF] << alphabet_bit_size);
-    cr->label |= (rc_alphabet[(*(begin+distance-1)) & 0xDF]);
+void init_core2(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index) {
+    init_core2_ctx(cr, begin, distance, start_index, end_index, &lcp_default_context);
 }
 
 void init_core3(struct core *cr, struct core *begin, uint64_t distance) {
@@ -177,6 +542,19 @@ void init_core3(struct core *cr, struct core *begin, uint64_t distance) {
 
     cr->start = begin->start;
     cr->end = (begin+distance-1)->end;
+    cr->run = 0;
+
+    ulabel data[4];
+    data[0] = (begin)->label;
+    data[1] = (begin+distance-2)->label;
+    data[2] = (begin+distance-1)->label;
+    data[3] = distance-2;
+    cr->label = MurmurHash3_32((void*)data, 4 * sizeof(ulabel), 42);
+
+    if (CORE_RUN_MIN_LENGTH + 2 <= distance && init_core_run(cr, begin, distance)) {
+        return;
+    }
+
     cr->bit_size = 0;
 
     for (struct core *it = begin; it < begin + distance; it++) {
@@ -186,46 +564,103 @@ void init_core3(struct core *cr, struct core *begin, uint64_t distance) {
     /* allocate memory for representation */
     ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
     cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
-    memset(cr->bit_rep, 0, block_number * sizeof(ublock));
 
-    ubit_size shift = 0;
-    int block_index = block_number - 1;
+    struct bit_writer w = {cr->bit_rep, (int64_t)block_number - 1, 0, 0};
 
     for (struct core *it = begin + distance - 1; begin <= it; it--) {
 
-        ublock *o_bit_rep = it->bit_rep;
+        ubit_size last = (it->bit_size - 1) / UBLOCK_BIT_SIZE;
+
+        /* block-aligned children are copied, except for their most significant block */
+        if (w.filled == 0 && !it->run && last) {
+            memcpy(cr->bit_rep + w.block_index - last + 1, it->bit_rep + 1, last * sizeof(ublock));
+            w.block_index -= last;
+            writer_put(&w, it->bit_rep[0], it->bit_size - last * UBLOCK_BIT_SIZE);
+            continue;
+        }
+
+        for (ubit_size i = last; 0 < i; i--) {
+            writer_put(&w, block_at(it, i), UBLOCK_BIT_SIZE);
+        }
+        writer_put(&w, block_at(it, 0), it->bit_size - last * UBLOCK_BIT_SIZE);
+    }
 
-        for (int i = (it->bit_size - 1) / UBLOCK_BIT_SIZE; 0 <= i; i--) {
+    writer_finish(&w);
+}
+
+void core_signatures(const struct core *begin, uint64_t distance, ulabel *sigs) {
+    ulabel data[4];
 
-            ubit_size curr_block_size = (i > 0 ? UBLOCK_BIT_SIZE : it->bit_size % UBLOCK_BIT_SIZE);
+    for (int i = 0; i < CORE_SIGNATURE_COUNT; i++) {
+        data[0] = (begin)->label;
+        data[1] = (begin+distance-2)->label;
+        data[2] = (begin+distance-1)->label;
+        data[3] = distance-2;
 
-            /* shift and paste */
-            cr->bit_rep[block_index] |= (o_bit_rep[i] << shift);
+        // leave out one of the children, and use distinct seeds so that the signatures do not collide
+        data[i] = 0;
+        sigs[i] = MurmurHash3_32((void*)data, 4 * sizeof(ulabel), 43 + i);
+    }
+}
 
-            /* if there is an overflow after shifting, it pastes the */
-            /* overfloaw to the left block. */
-            if (shift + curr_block_size > UBLOCK_BIT_SIZE) {
-                cr->bit_rep[block_index - 1] |= (o_bit_rep[i] >> (UBLOCK_BIT_SIZE - shift));
-            }
+ublock core_block(const struct core *cr, ubit_size index) {
 
-            if (shift + curr_block_size >= UBLOCK_BIT_SIZE) {
-                block_index--;
-            }
+    if (!cr->run) {
+        return cr->bit_rep[index];
+    }
 
-            shift = (shift + curr_block_size) % UBLOCK_BIT_SIZE;
+    ubit_size left_size = cr->bit_rep[0], unit_size = cr->bit_rep[1];
+    ubit_size right_size = run_right_size(cr), middle_end = cr->bit_size - left_size;
+    ubit_size last = blocks_of(cr->bit_size) - 1;
+    ubit_size pos = (last - index) * UBLOCK_BIT_SIZE;
+    ubit_size count = index ? UBLOCK_BIT_SIZE : cr->bit_size - last * UBLOCK_BIT_SIZE;
+
+    // collect the bits from the right context, the repeated unit and the left context
+    ublock block = 0;
+    ubit_size done = 0;
+    while (done < count) {
+        ubit_size curr = pos + done, take;
+        ublock bits;
+
+        if (curr < right_size) {
+            take = minimum(count - done, right_size - curr);
+            bits = get_bits(run_right(cr), right_size, curr, take);
+        } else if (curr < middle_end) {
+            ubit_size offset = (curr - right_size) % unit_size;
+            take = minimum(count - done, unit_size - offset);
+            bits = get_bits(run_unit(cr), unit_size, offset, take);
+        } else {
+            take = count - done;
+            bits = get_bits(run_left(cr), left_size, curr - middle_end, take);
         }
+
+        block |= (bits << done);
+        done += take;
     }
 
-    ulabel data[4];
-    data[0] = (begin)->label;
-    data[1] = (begin+distance-2)->label;
-    data[2] = (begin+distance-1)->label;
-    data[3] = distance-2;
-    cr->label = MurmurHash3_32((void*)data, 4 * sizeof(ulabel), 42);
+    return block;
+}
+
+void core_expand(struct core *cr) {
+
+    if (!cr->run) {
+        return;
+    }
+
+    ubit_size block_number = blocks_of(cr->bit_size);
+    ublock *bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
+    for (ubit_size i = 0; i < block_number; i++) {
+        bit_rep[i] = core_block(cr, i);
+    }
+
+    free(cr->bit_rep);
+    cr->bit_rep = bit_rep;
+    cr->run = 0;
 }
 
 void init_core4(struct core *cr, ubit_size bit_size, ublock *bit_rep, ulabel label, uint64_t start, uint64_t end) {
     cr->bit_size = bit_size;
+    cr->run = 0;
     cr->bit_rep = bit_rep;
     cr->label = label;
     cr->start = start;
@@ -243,14 +678,14 @@ void core_compress(const struct core *left_core, struct core *right_core) {
     ubit_size left_block = (left_core->bit_size - 1) / UBLOCK_BIT_SIZE,
               right_block = (right_core->bit_size - 1) / UBLOCK_BIT_SIZE;
 
-    while (index >= UBLOCK_BIT_SIZE && left_core->bit_rep[left_block] == right_core->bit_rep[right_block]) {
+    while (index >= UBLOCK_BIT_SIZE && block_at(left_core, left_block) == block_at(right_core, right_block)) {
         left_block--;
         right_block--;
         index -= UBLOCK_BIT_SIZE;
     }
 
-    left_block = left_core->bit_rep[left_block];
-    right_block = right_core->bit_rep[right_block];
+    left_block = block_at(left_core, left_block);
+    right_block = block_at(right_core, right_block);
 
     while (index > 0 && left_block % 2 == right_block % 2) {
         left_block /= 2;
@@ -258,9 +693,10 @@ void core_compress(const struct core *left_core, struct core *right_core) {
         index--;
     }
 
-    if (right_core->bit_size > UBLOCK_BIT_SIZE) {
+    if (right_core->run || right_core->bit_size > UBLOCK_BIT_SIZE) {
         free(right_core->bit_rep);
         right_core->bit_rep = (ublock *)malloc(sizeof(ublock));
+        right_core->run = 0;
     }
 
     right_core->bit_rep[0] = 0;
@@ -280,13 +716,16 @@ void core_compress(const struct core *left_core, struct core *right_core) {
 }
 
 uint64_t core_memsize(const struct core *cr) {
+    if (cr->run) {
+        return sizeof(struct core) + sizeof(ublock) * (2 + blocks_of(cr->bit_rep[0]) + blocks_of(cr->bit_rep[1]) + blocks_of(run_right_size(cr)));
+    }
     return sizeof(struct core) + sizeof(ublock) * ((cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE);
 }
 
 void print_core(const struct core *cr) {
     uint64_t block_number = (cr->bit_size - 1) / UBLOCK_BIT_SIZE + 1;
     for (int index = cr->bit_size - 1; 0 <= index; index--) {
-        printf("%d", (cr->bit_rep[block_number - index / UBLOCK_BIT_SIZE - 1] >> (index % UBLOCK_BIT_SIZE)) & 1);
+        printf("%d", (block_at(cr, block_number - index / UBLOCK_BIT_SIZE - 1) >> (index % UBLOCK_BIT_SIZE)) & 1);
     }
 }
 
@@ -301,7 +740,7 @@ int core_eq(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] != rhs->bit_rep[index / UBLOCK_BIT_SIZE])
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) != block_at(rhs, index / UBLOCK_BIT_SIZE))
             return 0;
 
         index += UBLOCK_BIT_SIZE;
@@ -319,7 +758,7 @@ int core_neq(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] != rhs->bit_rep[index / UBLOCK_BIT_SIZE])
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) != block_at(rhs, index / UBLOCK_BIT_SIZE))
             return 1;
 
         index += UBLOCK_BIT_SIZE;
@@ -337,12 +776,12 @@ int core_gt(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] == rhs->bit_rep[index / UBLOCK_BIT_SIZE]) {
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) == block_at(rhs, index / UBLOCK_BIT_SIZE)) {
             index += UBLOCK_BIT_SIZE;
             continue;
         }
 
-        return lhs->bit_rep[index / UBLOCK_BIT_SIZE] > rhs->bit_rep[index / UBLOCK_BIT_SIZE];
+        return block_at(lhs, index / UBLOCK_BIT_SIZE) > block_at(rhs, index / UBLOCK_BIT_SIZE);
     }
 
     return 0;
@@ -357,12 +796,12 @@ int core_lt(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] == rhs->bit_rep[index / UBLOCK_BIT_SIZE]) {
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) == block_at(rhs, index / UBLOCK_BIT_SIZE)) {
             index += UBLOCK_BIT_SIZE;
             continue;
         }
 
-        return lhs->bit_rep[index / UBLOCK_BIT_SIZE] < rhs->bit_rep[index / UBLOCK_BIT_SIZE];
+        return block_at(lhs, index / UBLOCK_BIT_SIZE) < block_at(rhs, index / UBLOCK_BIT_SIZE);
     }
 
     return 0;
@@ -377,8 +816,8 @@ int core_geq(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] != rhs->bit_rep[index / UBLOCK_BIT_SIZE]) {
-            return lhs->bit_rep[index / UBLOCK_BIT_SIZE] >= rhs->bit_rep[index / UBLOCK_BIT_SIZE];
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) != block_at(rhs, index / UBLOCK_BIT_SIZE)) {
+            return block_at(lhs, index / UBLOCK_BIT_SIZE) >= block_at(rhs, index / UBLOCK_BIT_SIZE);
         }
 
         index += UBLOCK_BIT_SIZE;
@@ -396,8 +835,8 @@ int core_leq(const struct core *lhs, const struct core *rhs) {
     ubit_size index = 0;
 
     while (index < lhs->bit_size) {
-        if (lhs->bit_rep[index / UBLOCK_BIT_SIZE] != rhs->bit_rep[index / UBLOCK_BIT_SIZE]) {
-            return lhs->bit_rep[index / UBLOCK_BIT_SIZE] <= rhs->bit_rep[index / UBLOCK_BIT_SIZE];
+        if (block_at(lhs, index / UBLOCK_BIT_SIZE) != block_at(rhs, index / UBLOCK_BIT_SIZE)) {
+            return block_at(lhs, index / UBLOCK_BIT_SIZE) <= block_at(rhs, index / UBLOCK_BIT_SIZE);
         }
 
         index += UBLOCK_BIT_SIZE;
@@ -15,6 +15,9 @@
  * - Supporting reverse complement encoding of DNA sequences.
  * - Saving and loading core from files.
  * - Calculating memory usage of the constructed core structure.
+ * - Storing long RINT cores run-length encoded, as a left context, a repeated
+ * unit, a repeat count and a right context, while comparing them exactly like
+ * their expanded bit representations.
  *
  * Dependencies:
  * - Requires constant.h and encoding.h for auxiliary data structures and
@@ -48,6 +51,8 @@ extern "C" {
 
 #define UBLOCK_BIT_SIZE 32
 #define DCT_ITERATION_COUNT 1
+#define CORE_SIGNATURE_COUNT 3
+#define CORE_RUN_MIN_LENGTH 256
 
 #define minimum(a, b) ((a) < (b) ? (a) : (b))
 
@@ -55,8 +60,30 @@ typedef unsigned int ublock;
 typedef uint32_t ubit_size;
 typedef uint32_t ulabel;
 
+/**
+ * @brief SplitMix64 finalizer, used to spread 64-bit keys over hash tables and
+ * sketches.
+ */
+static inline uint64_t lcp_mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * A core with a nonzero `run` is run-length encoded. Its `bit_size` is still the size
+ * of the expanded bit representation, while `bit_rep` holds the sizes of the left
+ * context and of the unit in its first two blocks, followed by the left context, the
+ * unit and the right context, each in its own right-aligned blocks. The unit is
+ * repeated `run` times between the contexts. Such cores should be read through
+ * `core_block` instead of `bit_rep`.
+ */
 struct core {
     ubit_size bit_size;
+    uint32_t run;
     ublock *bit_rep;
     ulabel label;
     uint64_t start;
@@ -68,6 +95,8 @@ struct core {
  * 
  * This function processes a given substring starting at `begin` with a specified 
  * distance (length of the substring) and assigns start and end indices for tracking.
+ * If all characters but the first and the last are the same and there are at least
+ * `CORE_RUN_MIN_LENGTH` of them, the core is stored run-length encoded.
  * 
  * @param cr Pointer to the core structure to initialize.
  * @param begin Pointer to the start of the string data.
@@ -77,6 +106,19 @@ struct core {
  */
 void init_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index);
 
+/**
+ * @brief Same as `init_core1`, but encodes the characters with the given context
+ * instead of the default one.
+ *
+ * @param cr Pointer to the core structure to initialize.
+ * @param begin Pointer to the start of the string data.
+ * @param distance Length of the substring to process.
+ * @param start_index Start index of the substring within the data.
+ * @param end_index End index of the substring within the data.
+ * @param ctx The encoding context.
+ */
+void init_core1_ctx(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, const struct lcp_context *ctx);
+
 /**
  * @brief Initializes a core structure with the provided string data and index range.
  * 
@@ -91,12 +133,27 @@ void init_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t
  */
 void init_core2(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index);
 
+/**
+ * @brief Same as `init_core2`, but encodes the characters with the given context
+ * instead of the default one.
+ *
+ * @param cr Pointer to the core structure to initialize.
+ * @param begin Pointer to the start of the string data.
+ * @param distance Length of the substring to process.
+ * @param start_index Start index of the substring within the data.
+ * @param end_index End index of the substring within the data.
+ * @param ctx The encoding context.
+ */
+void init_core2_ctx(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, const struct lcp_context *ctx);
+
 /**
  * @brief Initializes a core structure by combining data from other core structures.
  * 
  * This function initializes a new core structure (`cr`) using a sequence of 
  * `core` objects starting from `begin` with the specified `distance` (number 
- * of `core` objects to process).
+ * of `core` objects to process). If all children but the first and the last are
+ * equal and there are at least `CORE_RUN_MIN_LENGTH` of them, the core is stored
+ * run-length encoded.
  * 
  * @param cr Pointer to the core structure to initialize.
  * @param begin Pointer to the start of the sequence of core structures.
@@ -104,6 +161,44 @@ void init_core2(struct core *cr, const char *begin, uint64_t distance, uint64_t
  */
 void init_core3(struct core *cr, struct core *begin, uint64_t distance);
 
+/**
+ * @brief Returns a block of the expanded bit representation of a core.
+ *
+ * Blocks are indexed as in `bit_rep` of a core that is not run-length encoded: the
+ * first block holds the most significant bits, and the last block holds the least
+ * significant `UBLOCK_BIT_SIZE` bits.
+ *
+ * @param cr The `core` object.
+ * @param index Index of the block.
+ * @return The block at `index`.
+ */
+ublock core_block(const struct core *cr, ubit_size index);
+
+/**
+ * @brief Replaces the run-length encoding of a core with its expanded bit representation.
+ *
+ * Cores that are not run-length encoded are left unchanged.
+ *
+ * @param cr Pointer to the core structure to expand.
+ */
+void core_expand(struct core *cr);
+
+/**
+ * @brief Computes the error-tolerant signatures of the core that `init_core3` builds
+ * from the same children.
+ *
+ * The label of such a core is a hash of the labels of its first, second to last and
+ * last children together with the child count. Each of the `CORE_SIGNATURE_COUNT`
+ * signatures is computed in the same way, except that one of these three child labels
+ * is left out. Hence, two cores whose children differ in exactly one of the labels
+ * used for hashing still share a signature.
+ *
+ * @param begin Pointer to the start of the sequence of child core structures.
+ * @param distance Number of child core structures.
+ * @param sigs Array of at least `CORE_SIGNATURE_COUNT` labels where the signatures will be stored.
+ */
+void core_signatures(const struct core *begin, uint64_t distance, ulabel *sigs);
+
 /**
  * @brief Directly initializes a core structure with precomputed representation and metadata.
  * 
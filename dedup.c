@@ -0,0 +1,266 @@
+/**
+ * @file dedup.c
+ * @brief Implementation of read signatures and the concurrent deduplication sets.
+ *
+ * A set maps 64-bit keys to read ids with linear probing, inserting with the
+ * protocol of `claim.h`: the id is the published word of a slot. Key 0 marks empty
+ * slots, so a key of 0 is stored as 1. The set of exact hashes also stores a second
+ * hash of the bases per slot, which is filled before the id is published and
+ * compared when the keys match.
+ */
+
+#include "dedup.h"
+#include "claim.h"
+#include "pool.h"
+
+struct dedup_context {
+    struct dedup *d;
+    const char **reads;
+    const int *lengths;
+    int count;
+    int lcp_level;
+    uint32_t first_id;
+    struct dedup_result *results;
+    int next_task;
+    int duplicate_count;
+};
+
+struct set_item {
+    struct dedup_set *set;
+    uint64_t check;
+};
+
+/**
+ * @brief Hashes the bases of a read 8 at a time, multiplying each word by `factor`
+ * before it is mixed in, so that different seeds and factors give independent
+ * hashes.
+ */
+static uint64_t hash_bases(const char *read, int len, uint64_t seed, uint64_t factor) {
+    uint64_t h = lcp_mix64(seed ^ (uint64_t)len);
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, read + i, 8);
+        h = lcp_mix64(h ^ (word * factor));
+    }
+    if (i < len) {
+        uint64_t word = 0;
+        memcpy(&word, read + i, len - i);
+        h = lcp_mix64(h ^ (word * factor));
+    }
+
+    return h;
+}
+
+uint64_t read_hash(const char *read, int len) {
+    return hash_bases(read, len, 0, 1);
+}
+
+/**
+ * @brief Computes the second hash of the bases of a read, which is compared when
+ * the hashes of two reads are equal.
+ */
+static uint64_t read_check(const char *read, int len) {
+    return hash_bases(read, len, 0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL);
+}
+
+/**
+ * @brief Computes the bands and the core count of a signature.
+ */
+static void signature_bands(const struct lps *lps_ptr, struct read_signature *sig) {
+
+    // minhash of the (label, position) pairs of the cores
+    uint64_t mins[DEDUP_SKETCH_SIZE];
+    for (int j = 0; j < DEDUP_SKETCH_SIZE; j++) {
+        mins[j] = UINT64_MAX;
+    }
+
+    for (int c = 0; c < lps_ptr->size; c++) {
+        uint64_t element = lcp_mix64(((uint64_t)lps_ptr->cores[c].label << 32) ^ lps_ptr->cores[c].start);
+        for (int j = 0; j < DEDUP_SKETCH_SIZE; j++) {
+            uint64_t value = lcp_mix64(element + (j + 1) * 0x9e3779b97f4a7c15ULL);
+            mins[j] = minimum(mins[j], value);
+        }
+    }
+
+    for (int b = 0; b < DEDUP_BAND_COUNT; b++) {
+        uint64_t band = lcp_mix64(b + 1);
+        for (int r = 0; r < DEDUP_BAND_SIZE; r++) {
+            band = lcp_mix64(band ^ mins[b * DEDUP_BAND_SIZE + r]);
+        }
+        sig->bands[b] = band;
+    }
+
+    sig->core_count = lps_ptr->size;
+}
+
+void read_signature(const char *read, int len, const struct lps *lps_ptr, struct read_signature *sig) {
+    sig->exact = read_hash(read, len);
+    sig->check = read_check(read, len);
+    signature_bands(lps_ptr, sig);
+}
+
+static void init_dedup_set(struct dedup_set *set, uint64_t capacity, int checked) {
+    set->slot_count = 1;
+    while (set->slot_count * DEDUP_LOAD_FACTOR < capacity + 1) {
+        set->slot_count *= 2;
+    }
+    set->keys = (uint64_t *)calloc(set->slot_count, sizeof(uint64_t));
+    set->values = (uint32_t *)malloc(set->slot_count * sizeof(uint32_t));
+    set->checks = checked ? (uint64_t *)malloc(set->slot_count * sizeof(uint64_t)) : NULL;
+    for (uint64_t i = 0; i < set->slot_count; i++) {
+        set->values[i] = DEDUP_NONE;
+    }
+}
+
+static void free_dedup_set(struct dedup_set *set) {
+    free(set->keys);
+    free(set->values);
+    free(set->checks);
+    set->keys = NULL;
+    set->values = NULL;
+    set->checks = NULL;
+    set->slot_count = 0;
+}
+
+static inline void fill_check(void *arg, uint64_t slot) {
+    struct set_item *item = (struct set_item *)arg;
+    if (item->set->checks) {
+        item->set->checks[slot] = item->check;
+    }
+}
+
+static inline int matches_check(void *arg, uint64_t slot, uint32_t word) {
+    struct set_item *item = (struct set_item *)arg;
+    (void)word;
+    return item->set->checks == NULL || item->set->checks[slot] == item->check;
+}
+
+/**
+ * @brief Inserts the key with the given id unless it is present.
+ *
+ * In a set with checks, a slot holding the key is only a match if its check is
+ * `check` as well; otherwise probing goes on, so that reads whose hashes collide
+ * are stored in different slots.
+ *
+ * @return The id stored with the key, which is `id` if the key is inserted, or
+ * `DEDUP_NONE` if the set is full.
+ */
+static uint32_t dedup_set_insert(struct dedup_set *set, uint64_t key, uint64_t check, uint32_t id) {
+    struct claim_table table = {set->slot_count, 0, DEDUP_NONE, set->keys, set->values};
+    struct set_item item = {set, check};
+
+    // normalized before hashing, so that keys 0 and 1 are probed from the same slot
+    key = key ? key : 1;
+    uint64_t slot = claim_slot(&table, key, lcp_mix64(key) & (set->slot_count - 1), id, fill_check, matches_check, &item);
+
+    return slot == set->slot_count ? DEDUP_NONE : set->values[slot];
+}
+
+void init_dedup(struct dedup *d, uint64_t capacity) {
+    d->parse_count = 0;
+    init_dedup_set(&(d->exact), capacity, 1);
+    for (int b = 0; b < DEDUP_BAND_COUNT; b++) {
+        init_dedup_set(&(d->bands[b]), capacity, 0);
+    }
+}
+
+void free_dedup(struct dedup *d) {
+    free_dedup_set(&(d->exact));
+    for (int b = 0; b < DEDUP_BAND_COUNT; b++) {
+        free_dedup_set(&(d->bands[b]));
+    }
+}
+
+/**
+ * @brief Looks up the hashes of the bases of a read, registering them if they are
+ * new.
+ * @return 1 if the read is an exact duplicate, 0 otherwise.
+ */
+static int insert_exact(struct dedup *d, uint64_t exact, uint64_t check, uint32_t id, struct dedup_result *result) {
+    result->representative = id;
+    result->kind = DEDUP_UNIQUE;
+
+    uint32_t representative = dedup_set_insert(&(d->exact), exact, check, id);
+    if (representative != id && representative != DEDUP_NONE) {
+        result->representative = representative;
+        result->kind = DEDUP_EXACT;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Registers a read which is not an exact duplicate in all bands, keeping the
+ * first representative found.
+ */
+static void insert_bands(struct dedup *d, const struct read_signature *sig, uint32_t id, struct dedup_result *result) {
+    if (!sig->core_count) {
+        return;
+    }
+
+    for (int b = 0; b < DEDUP_BAND_COUNT; b++) {
+        uint32_t representative = dedup_set_insert(&(d->bands[b]), sig->bands[b], 0, id);
+        if (representative != id && representative != DEDUP_NONE && result->kind == DEDUP_UNIQUE) {
+            result->representative = representative;
+            result->kind = DEDUP_NEAR;
+        }
+    }
+}
+
+void dedup_insert(struct dedup *d, const struct read_signature *sig, uint32_t id, struct dedup_result *result) {
+    if (!insert_exact(d, sig->exact, sig->check, id, result)) {
+        insert_bands(d, sig, id, result);
+    }
+}
+
+static void *dedup_work(void *arg) {
+    struct dedup_context *ctx = (struct dedup_context *)arg;
+    int task;
+
+    while ((task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * DEDUP_TASK_SIZE < ctx->count) {
+        int duplicate_count = 0;
+        uint64_t parse_count = 0;
+
+        for (int i = task * DEDUP_TASK_SIZE; i < minimum(ctx->count, (task + 1) * DEDUP_TASK_SIZE); i++) {
+            struct dedup_result *result = &(ctx->results[i]);
+
+            // exact duplicates are found from the bases alone
+            const char *read = ctx->reads[i];
+            int len = ctx->lengths[i];
+            if (!insert_exact(ctx->d, read_hash(read, len), read_check(read, len), ctx->first_id + i, result)) {
+                struct lps lps_obj;
+                struct read_signature sig;
+
+                init_lps(&lps_obj, read, len);
+                lps_deepen(&lps_obj, ctx->lcp_level);
+                signature_bands(&lps_obj, &sig);
+                free_lps(&lps_obj);
+                parse_count++;
+
+                insert_bands(ctx->d, &sig, ctx->first_id + i, result);
+            }
+
+            duplicate_count += result->kind != DEDUP_UNIQUE;
+        }
+
+        __atomic_fetch_add(&(ctx->duplicate_count), duplicate_count, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&(ctx->d->parse_count), parse_count, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+int dedup_reads(struct dedup *d, const char **reads, const int *lengths, int count, int lcp_level, uint32_t first_id,
+                struct dedup_result *results, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    struct dedup_context ctx = {d, reads, lengths, count, lcp_level, first_id, results, 0, 0};
+    run_pool(dedup_work, &ctx, 0, thread_count);
+
+    return ctx.duplicate_count;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file dedup.h
+ * @brief Streaming detection of duplicate and near-duplicate reads.
+ *
+ * PCR and optical duplicates are copies of the same fragment, so parsing, deepening
+ * and mapping them again produces the results of their first copy. This file
+ * declares a deduplication stage which assigns each read the first read it
+ * duplicates, its representative, so that the results of the representative can be
+ * reused instead of processing the read.
+ *
+ * Key functionalities include:
+ * - Computing a compact signature per read: two independent 64-bit hashes of its
+ * bases for exact duplicates, and a MinHash sketch of its (label, position) core pairs at a low LCP
+ * level, split into `DEDUP_BAND_COUNT` bands of `DEDUP_BAND_SIZE` values, for near
+ * duplicates.
+ * - Keeping the signatures of the reads seen so far in concurrent hash sets, whose
+ * slots are claimed with compare-and-swap, so that many threads can deduplicate
+ * reads at the same time.
+ * - Processing batches of reads in a streaming fashion, with read ids continuing
+ * from one batch to the next.
+ *
+ * Two reads are exact duplicates if both hashes of their bases are equal, so reads
+ * with different bases are only taken for exact duplicates if two 64-bit hashes
+ * collide at once. Two reads are near duplicates if all the values of one of the bands of their
+ * sketches are equal, which is likely for reads differing in a few bases since the
+ * cores away from the differences are shared. Core positions take part in the
+ * sketch, as duplicates of a fragment start at the same base.
+ *
+ * @see lps.h
+ *
+ * @struct read_signature
+ * @struct dedup_set
+ * @struct dedup
+ *
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+
+#define DEDUP_SKETCH_SIZE       32
+#define DEDUP_BAND_SIZE         4
+#define DEDUP_BAND_COUNT        (DEDUP_SKETCH_SIZE / DEDUP_BAND_SIZE)
+#define DEDUP_LOAD_FACTOR       0.5
+#define DEDUP_TASK_SIZE         1024
+#define DEDUP_NONE              UINT32_MAX
+
+enum dedup_kind {
+    DEDUP_UNIQUE,
+    DEDUP_EXACT,
+    DEDUP_NEAR
+};
+
+struct read_signature {
+    uint64_t exact;
+    uint64_t check; // second hash of the bases, compared when `exact` matches
+    uint64_t bands[DEDUP_BAND_COUNT];
+    int core_count;
+};
+
+struct dedup_set {
+    uint64_t slot_count;
+    uint64_t *keys;
+    uint32_t *values;
+    uint64_t *checks; // NULL unless the keys are exact hashes
+};
+
+struct dedup {
+    struct dedup_set exact;
+    struct dedup_set bands[DEDUP_BAND_COUNT];
+    uint64_t parse_count; // reads parsed by `dedup_reads`, exact duplicates are not
+};
+
+struct dedup_result {
+    uint32_t representative;
+    enum dedup_kind kind;
+};
+
+/**
+ * @brief Computes the hash of the bases of a read, i.e. the `exact` field of its
+ * signature, without parsing it.
+ *
+ * @param read The read.
+ * @param len Length of the read.
+ * @return The hash.
+ */
+uint64_t read_hash(const char *read, int len);
+
+/**
+ * @brief Computes the signature of a read.
+ *
+ * @param read The read.
+ * @param len Length of the read.
+ * @param lps_ptr The cores of the read at the level used for deduplication.
+ * @param sig Pointer where the signature will be stored.
+ */
+void read_signature(const char *read, int len, const struct lps *lps_ptr, struct read_signature *sig);
+
+/**
+ * @brief Initializes an empty deduplication stage.
+ *
+ * The hash sets are not resized, so `capacity` should be at least the total number
+ * of reads to be deduplicated. Reads seen after the sets are full are reported as
+ * unique.
+ *
+ * @param d Pointer to the deduplication stage to initialize.
+ * @param capacity Expected number of distinct reads.
+ */
+void init_dedup(struct dedup *d, uint64_t capacity);
+
+/**
+ * @brief Frees the memory allocated for the deduplication stage.
+ *
+ * @param d Pointer to the deduplication stage to deallocate.
+ */
+void free_dedup(struct dedup *d);
+
+/**
+ * @brief Finds the representative of a read, registering the read if it is unique.
+ *
+ * This function is thread-safe. Reads without cores are always unique, as their
+ * sketches carry no information.
+ *
+ * @param d Pointer to the deduplication stage.
+ * @param sig The signature of the read.
+ * @param id Id of the read.
+ * @param result Pointer where the representative and the kind of duplication will
+ * be stored. The representative of a unique read is the read itself.
+ */
+void dedup_insert(struct dedup *d, const struct read_signature *sig, uint32_t id, struct dedup_result *result);
+
+/**
+ * @brief Deduplicates a batch of reads with multiple threads.
+ *
+ * The hash of the bases of each read is looked up first, so exact duplicates are
+ * found without parsing them. The other reads are parsed and deepened to
+ * `lcp_level` to compute the bands of their signatures, which are counted in
+ * `parse_count`. Read
+ * `i` of the batch gets the id `first_id + i`, so consecutive batches of a stream
+ * should be given consecutive ids. Within a batch, which of two concurrent copies
+ * becomes the representative depends on the scheduling of the threads.
+ *
+ * @param d Pointer to the deduplication stage.
+ * @param reads The reads.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param lcp_level The level of the cores used in the signatures.
+ * @param first_id Id of the first read of the batch.
+ * @param results Array of at least `count` results.
+ * @param thread_count Number of threads to be used.
+ * @return Number of exact and near duplicates in the batch.
+ */
+int dedup_reads(struct dedup *d, const char **reads, const int *lengths, int count, int lcp_level, uint32_t first_id,
+                struct dedup_result *results, int thread_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,15 +6,21 @@
  * initialize the alphabet with their corresponding coefficients. The encodings
  * support initialization with default coefficients, specific coefficients, or
  * by reading coefficients from a file.
+ *
+ * The encodings are held in `lcp_context` objects, and the global tables are
+ * written from the default context whenever it is initialized.
  */
 
 #include "encoding.h"
+#include <string.h>
 
 int alphabet[128];
 int rc_alphabet[128];
 char characters[128];
 int alphabet_bit_size;
 
+struct lcp_context lcp_default_context;
+
 void LCP_SUMMARY(void) {
     printf("# Alphabet encoding summary\n");
     printf("# Coefficients: ");
@@ -27,73 +33,124 @@ void LCP_SUMMARY(void) {
     printf("# Alphabet bit size: %d", alphabet_bit_size);
 }
 
-void LCP_INIT(void) {
-    LCP_INIT2(0);
+/**
+ * @brief Clears the tables of a context.
+ */
+static void context_clear(struct lcp_context *ctx) {
+    memset(ctx->encode, LCP_NO_CODE, sizeof(ctx->encode));
+    memset(ctx->complement, LCP_NO_CODE, sizeof(ctx->complement));
+    memset(ctx->characters, 126, sizeof(ctx->characters));
 }
 
-void LCP_INIT2(int verbose) {
+/**
+ * @brief Computes the ranks and the bit size of a context from its codes.
+ */
+static void context_finish(struct lcp_context *ctx) {
+    int mx = 0;
+
+    for (int c = 0; c < 256; c++) {
+        ctx->rank[c] = ctx->encode[c] == LCP_NO_CODE ? 0 : ctx->encode[c] + 1;
+        ctx->rc_rank[c] = ctx->complement[c] == LCP_NO_CODE ? 0 : ctx->complement[c] + 1;
 
-    // init coefficients A/a=0, T/t=3, G/g=2, C/c=1
-    for (int current_index = 0; current_index < 128; current_index++) {
-        alphabet[current_index] = -1;
-        characters[current_index] = 126;
+        if (ctx->encode[c] != LCP_NO_CODE) {
+            mx = maximum(ctx->encode[c], mx);
+            mx = maximum(ctx->complement[c], mx);
+        }
     }
-    alphabet['A'] = 0; alphabet['a'] = 0;
-    alphabet['T'] = 3; alphabet['t'] = 3;
-    alphabet['G'] = 2; alphabet['g'] = 2;
-    alphabet['C'] = 1; alphabet['c'] = 1;
 
-    rc_alphabet['A'] = 3; rc_alphabet['a'] = 3;
-    rc_alphabet['T'] = 0; rc_alphabet['t'] = 0;
-    rc_alphabet['G'] = 1; rc_alphabet['g'] = 1;
-    rc_alphabet['C'] = 2; rc_alphabet['c'] = 2;
+    int bit_count = 0;
+    while (mx > 0) {
+        bit_count++;
+        mx = mx / 2;
+    }
 
-    characters[0] = 'A';
-    characters[1] = 'C';
-    characters[2] = 'G';
-    characters[3] = 'T';
+    ctx->bit_size = bit_count;
+}
 
-    alphabet_bit_size = 2;
+/**
+ * @brief Writes the default context into the global tables.
+ */
+static void export_default_context(void) {
+    const struct lcp_context *ctx = &lcp_default_context;
 
-    if (verbose)
-        LCP_SUMMARY();
+    for (int c = 0; c < 128; c++) {
+        alphabet[c] = ctx->encode[c] == LCP_NO_CODE ? -1 : ctx->encode[c];
+        rc_alphabet[c] = ctx->complement[c] == LCP_NO_CODE ? 0 : ctx->complement[c];
+        characters[c] = ctx->characters[c];
+    }
+
+    alphabet_bit_size = ctx->bit_size;
 }
 
-int LCP_INIT_FILE(const char *encoding_file, int verbose) {
-    
-    FILE *encodings = fopen(encoding_file, "r");
+void lcp_context_init(struct lcp_context *ctx) {
+    context_clear(ctx);
+
+    const char *bases = "ACGT";
+    for (int code = 0; code < 4; code++) {
+        unsigned char upper = bases[code], lower = bases[code] + 32;
+        ctx->encode[upper] = code; ctx->encode[lower] = code;
+        ctx->complement[upper] = 3 - code; ctx->complement[lower] = 3 - code;
+        ctx->characters[code] = bases[code];
+    }
+
+    context_finish(ctx);
+}
+
+int lcp_context_init_file(struct lcp_context *ctx, const char *filename) {
+
+    FILE *encodings = fopen(filename, "r");
     if (!encodings) {
-        if (verbose) {
-            fprintf(stderr, "Error: Could not open file %s\n", encoding_file);
-        }
         return -1;
     }
 
-    // clear arrays
-    for (int current_index = 0; current_index < 128; current_index++) {
-        alphabet[current_index] = -1;
-        characters[current_index] = 126;
-    }
+    // parsed aside, so that `ctx` is left untouched if the file is invalid
+    struct lcp_context parsed;
+    context_clear(&parsed);
 
     char character;
-    int encoding, rev_encoding, mx = -1;
+    int encoding, rev_encoding;
     while (fscanf(encodings, " %c %d %d", &character, &encoding, &rev_encoding) == 3) {
-        alphabet[(unsigned char)character] = encoding;
-        rc_alphabet[(unsigned char)character] = rev_encoding;
+        if (encoding < 0 || LCP_NO_CODE <= encoding || rev_encoding < 0 || LCP_NO_CODE <= rev_encoding) {
+            fclose(encodings);
+            return -1;
+        }
 
-        mx = maximum(encoding, mx);
-        mx = maximum(rev_encoding, mx);
+        parsed.encode[(unsigned char)character] = encoding;
+        parsed.complement[(unsigned char)character] = rev_encoding;
+        parsed.characters[encoding] = character;
     }
 
     fclose(encodings);
 
-    int bit_count = 0;
-    while (mx > 0) {
-        bit_count++;
-        mx = mx / 2;
+    context_finish(&parsed);
+    *ctx = parsed;
+
+    return 0;
+}
+
+void LCP_INIT(void) {
+    LCP_INIT2(0);
+}
+
+void LCP_INIT2(int verbose) {
+
+    lcp_context_init(&lcp_default_context);
+    export_default_context();
+
+    if (verbose)
+        LCP_SUMMARY();
+}
+
+int LCP_INIT_FILE(const char *encoding_file, int verbose) {
+
+    if (lcp_context_init_file(&lcp_default_context, encoding_file) != 0) {
+        if (verbose) {
+            fprintf(stderr, "Error: Could not read encodings from file %s\n", encoding_file);
+        }
+        return -1;
     }
 
-    alphabet_bit_size = bit_count;
+    export_default_context();
 
     return 0;
 }
@@ -21,6 +21,10 @@
  * bit size.
  *   - Loads encoding mappings from an external file, making it easy to extend
  * the encoding system for custom alphabets or symbols.
+ *   - Holds encodings in `lcp_context` objects, so that several alphabets can be
+ * used concurrently in one process. The global tables, set by the `LCP_INIT*`
+ * functions, mirror the default context used by the functions without a context
+ * argument.
  *
  * Example usage:
  * @code
@@ -36,6 +40,7 @@
  * @see core.h
  *
  * @namespace lcp
+ * @struct lcp_context
  *
  * @note Initialization functions throw std::invalid_argument exceptions for
  * invalid maps or file formats.
@@ -55,14 +60,59 @@ extern "C" {
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define maximum(a, b) ((a) > (b) ? (a) : (b))
 
+#define LCP_NO_CODE 0xFF
+
 extern int alphabet[128];
 extern int rc_alphabet[128];
 extern char characters[128];
 extern int alphabet_bit_size;
 
+/**
+ * An encoding of an alphabet. `encode` and `complement` map each character to its
+ * code and to the code of its complement, or to `LCP_NO_CODE` if the character is not
+ * in the alphabet. `rank` and `rc_rank` map each character to its code plus one, or
+ * to 0 if it is not in the alphabet, so that comparing them orders characters without
+ * a code before all others, as core detection expects. A context is only read while
+ * parsing, so it can be shared by any number of threads.
+ */
+struct lcp_context {
+    uint8_t encode[256];
+    uint8_t complement[256];
+    uint8_t rank[256];
+    uint8_t rc_rank[256];
+    char characters[256];
+    int bit_size;
+};
+
+/**
+ * @brief The context set by the `LCP_INIT*` functions and used by the functions
+ * without a context argument.
+ */
+extern struct lcp_context lcp_default_context;
+
+/**
+ * @brief Initializes a context with the standard DNA encoding, A/a=0, C/c=1, G/g=2,
+ * T/t=3, and their reverse complements.
+ *
+ * @param ctx Pointer to the context to initialize.
+ */
+void lcp_context_init(struct lcp_context *ctx);
+
+/**
+ * @brief Initializes a context from a file in the format of `LCP_INIT_FILE`.
+ *
+ * The context is only changed on success.
+ *
+ * @param ctx Pointer to the context to initialize.
+ * @param filename Path to the file containing the character encodings.
+ * @return 0 on success, -1 if the file cannot be opened or a code is not in [0, 254].
+ */
+int lcp_context_init_file(struct lcp_context *ctx, const char *filename);
+
 /**
  * @brief Displays the alphabet encoding summary including coefficients
  * and dictionary bit size.
@@ -91,7 +141,8 @@ void LCP_INIT2(int verbose);
  * @param filename Path to the file containing the character encodings.
  * @param verbose If true, prints the encoding summary after
  * initialization.
- * @return Always returns 0 upon successful initialization.
+ * @return 0 upon successful initialization, -1 if the file cannot be read or a
+ * code is not in [0, 254], in which case the previous encoding is kept.
  * @throws std::invalid_argument if any invalid data is found in the
  * file.
  */
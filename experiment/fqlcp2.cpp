@@ -48,10 +48,17 @@ void calculate_metrics(stats_type results[LCP_LEVEL_COUNT][3]) {
     }
 };
 
-void findLcpCores(std::string &sequence, bool rc, int lcpLevel, std::map<kmer_type, std::vector<uint64_t>>& lcpCoresMap) {
+void findLcpCores(std::string &sequence, bool rc, int lcpLevel, std::map<kmer_type, std::vector<uint64_t>>& lcpCoresMap, const std::string *quality = nullptr, int minQuality = 0) {
     struct lps str;
 
-    if (rc) {
+    if (quality && 0 < minQuality) {
+        // drop the cores covering low quality bases while parsing
+        if (rc) {
+            init_lps2_qual(&str, sequence.c_str(), quality->c_str(), sequence.size(), minQuality);
+        } else {
+            init_lps_qual(&str, sequence.c_str(), quality->c_str(), sequence.size(), minQuality);
+        }
+    } else if (rc) {
         init_lps2(&str, sequence.c_str(), sequence.size());
     } else {
         init_lps(&str, sequence.c_str(), sequence.size());
@@ -64,7 +71,7 @@ void findLcpCores(std::string &sequence, bool rc, int lcpLevel, std::map<kmer_ty
     free_lps(&str);
 };
 
-void t_process(int thread_index, const char *fa, const char *mf, const char *ff, int lcpLevel, stats_type (&results)[3], stats_type (&stats)[5]) {
+void t_process(int thread_index, const char *fa, const char *mf, const char *ff, int lcpLevel, int minQuality, stats_type (&results)[3], stats_type (&stats)[5]) {
 
     {
         std::lock_guard<std::mutex> lock(mtx);
@@ -96,7 +103,7 @@ void t_process(int thread_index, const char *fa, const char *mf, const char *ff,
 
     std::string fa_line;
     std::string fq_id, maf_id;
-    std::string fq_line, maf_line;
+    std::string fq_line, fq_quality, maf_line;
     std::string maf_sign;
 
     std::map<kmer_type, std::vector<uint64_t>> mapReference;
@@ -136,6 +143,8 @@ void t_process(int thread_index, const char *fa, const char *mf, const char *ff,
 
         fq_id = fq_line.substr(1, fq_line.rfind('/') - 1);
         getline(fastqFile, fq_line); // fq_line contains high quality read now
+        getline(fastqFile, fq_quality); // move +
+        getline(fastqFile, fq_quality); // fq_quality contains quality score line now
 
         // process maf file to find the reference sequence
         while (true) {
@@ -182,7 +191,7 @@ void t_process(int thread_index, const char *fa, const char *mf, const char *ff,
         findLcpCores(sequence, false, lcpLevel, mapGTRead);
 
         std::map<kmer_type, std::vector<uint64_t>> mapSimRead;
-        findLcpCores(fq_line, maf_sign == "-", lcpLevel, mapSimRead);
+        findLcpCores(fq_line, maf_sign == "-", lcpLevel, mapSimRead, &fq_quality, minQuality);
 
         if (maf_sign == "-") {
             stats[0]++;
@@ -195,10 +204,6 @@ void t_process(int thread_index, const char *fa, const char *mf, const char *ff,
 
         // DONE
 
-        // MOVE FASTQ FILE
-        getline(fastqFile, fq_line); // move +
-        getline(fastqFile, fq_line); // move quality score line
-
         // MOVE MAF FILE
         for(int i=1; i<PASS_NUMBER; i++) { // skip other simulated reads
             getline(mafFile, maf_line);
@@ -220,10 +225,12 @@ void t_process(int thread_index, const char *fa, const char *mf, const char *ff,
 int main(int argc, char **argv) {
     // check if the correct number of arguments is provided
     if (argc < 4) {
-        std::cerr << "Wrong format: " << argv[0] << " [fa-file] [maf-file] [fq-file]" << std::endl;
+        std::cerr << "Wrong format: " << argv[0] << " [fa-file] [maf-file] [fq-file] [min-quality (optional)]" << std::endl;
         return -1;
     }
 
+    int minQuality = argc < 5 ? 0 : atoi(argv[4]);
+
     stats_type results[LCP_LEVEL_COUNT][3];
     stats_type stats[LCP_LEVEL_COUNT][5];
 
@@ -242,7 +249,7 @@ int main(int argc, char **argv) {
     int thread_id = 0;
 
     for (int i=0; i<LCP_LEVEL_COUNT; i++) {
-        threads[i] = std::thread(t_process, thread_id, argv[1], argv[2], argv[3], i+LCP_LEVEL_MIN, std::ref(results[i]), std::ref(stats[i]));
+        threads[i] = std::thread(t_process, thread_id, argv[1], argv[2], argv[3], i+LCP_LEVEL_MIN, minQuality, std::ref(results[i]), std::ref(stats[i]));
         thread_id++;
     }
 
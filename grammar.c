@@ -0,0 +1,625 @@
+/**
+ * @file grammar.c
+ * @brief Implementation of the LCP grammar.
+ *
+ * Rules are interned through an open addressing table of rule ids, hashed by the
+ * content of the rules, so that adding a segment whose rule already exists returns
+ * the existing id. A sequence is kept as a list of symbols with their start
+ * positions while it is deepened; at each level the symbols between consecutive
+ * cuts are replaced by the rule of their segment.
+ *
+ * Terminal bases are compared and hashed `GRAMMAR_UNPACK_SIZE` bases at a time,
+ * after unpacking them into a buffer on the stack.
+ */
+
+#include "grammar.h"
+#include <ctype.h>
+
+#define GRAMMAR_UNPACK_SIZE 256
+
+struct grammar_header {
+    int32_t level;
+    uint32_t rule_count;
+    uint64_t item_count;
+    uint64_t base_count;
+    uint32_t sequence_count;
+    int32_t bit_size;
+    uint64_t top_count;
+    uint64_t escape_count;
+    char characters[256];
+};
+
+/**
+ * @brief Grows `ptr` to hold at least `needed` elements, doubling its capacity.
+ */
+static void *reserve(void *ptr, uint64_t needed, uint64_t *capacity, size_t element_size) {
+    if (needed <= *capacity) {
+        return ptr;
+    }
+    uint64_t new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    *capacity = new_capacity;
+    return realloc(ptr, new_capacity * element_size);
+}
+
+static inline uint64_t packed_words(const struct grammar *g, uint64_t base_count) {
+    return (base_count * g->bit_size + 63) / 64;
+}
+
+/**
+ * @brief Grows the packed bases to hold at least `base_count` bases, clearing the new
+ * words.
+ */
+static void reserve_packed(struct grammar *g, uint64_t base_count) {
+    uint64_t capacity = g->packed_capacity;
+    g->packed = (uint64_t *)reserve(g->packed, packed_words(g, base_count) + 1, &(g->packed_capacity), sizeof(uint64_t));
+    memset(g->packed + capacity, 0, (g->packed_capacity - capacity) * sizeof(uint64_t));
+}
+
+static inline void pack_code(uint64_t *packed, uint64_t index, int bit_size, uint64_t code) {
+    uint64_t bit = index * bit_size, shift = bit % 64;
+    packed[bit / 64] |= code << shift;
+    if (64 < shift + bit_size) {
+        packed[bit / 64 + 1] |= code >> (64 - shift);
+    }
+}
+
+static inline uint64_t unpack_code(const uint64_t *packed, uint64_t index, int bit_size) {
+    uint64_t bit = index * bit_size, shift = bit % 64;
+    uint64_t value = packed[bit / 64] >> shift;
+    if (64 < shift + bit_size) {
+        value |= packed[bit / 64 + 1] << (64 - shift);
+    }
+    return value & ((1ULL << bit_size) - 1);
+}
+
+/**
+ * @brief Decodes `count` packed bases from the base at index `first` into `out`.
+ */
+static void unpack(const struct grammar *g, uint64_t first, uint64_t count, char *out) {
+    for (uint64_t i = 0; i < count; i++) {
+        out[i] = g->characters[unpack_code(g->packed, first + i, g->bit_size)];
+    }
+
+    // first escape ending after the first base, as escapes are sorted and disjoint
+    uint64_t low = 0, high = g->escape_count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (g->escape_positions[mid] + g->escape_lengths[mid] <= first) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (uint64_t e = low; e < g->escape_count && g->escape_positions[e] < first + count; e++) {
+        uint64_t begin = maximum(first, g->escape_positions[e]);
+        uint64_t end = minimum(first + count, g->escape_positions[e] + g->escape_lengths[e]);
+        for (uint64_t p = begin; p < end; p++) {
+            out[p - first] = g->escape_bases[e] == GRAMMAR_LOWERCASE ? (char)tolower((unsigned char)out[p - first]) : g->escape_bases[e];
+        }
+    }
+}
+
+/**
+ * @brief Adds the base at index `position` to the escapes, extending the last run if
+ * it ends right before the base with the same escaped base.
+ */
+static void escape(struct grammar *g, uint64_t position, char base) {
+    uint64_t last = g->escape_count - 1;
+    if (g->escape_count && g->escape_positions[last] + g->escape_lengths[last] == position &&
+        g->escape_bases[last] == base && g->escape_lengths[last] < UINT32_MAX) {
+        g->escape_lengths[last]++;
+        return;
+    }
+
+    g->escape_positions = (uint64_t *)reserve(g->escape_positions, g->escape_count + 1, &(g->escape_capacity), sizeof(uint64_t));
+    g->escape_lengths = (uint32_t *)realloc(g->escape_lengths, g->escape_capacity * sizeof(uint32_t));
+    g->escape_bases = (char *)realloc(g->escape_bases, g->escape_capacity * sizeof(char));
+    g->escape_positions[g->escape_count] = position;
+    g->escape_lengths[g->escape_count] = 1;
+    g->escape_bases[g->escape_count] = base;
+    g->escape_count++;
+}
+
+/**
+ * @brief Appends the bases of a terminal, escaping those which cannot be restored
+ * from their codes.
+ */
+static void pack(struct grammar *g, const char *bases, uint32_t size) {
+    reserve_packed(g, g->base_count + size);
+
+    for (uint32_t i = 0; i < size; i++) {
+        unsigned char c = bases[i];
+        uint64_t code = lcp_default_context.encode[c];
+
+        if (code == LCP_NO_CODE || code >> g->bit_size) {
+            escape(g, g->base_count + i, bases[i]);
+            code = 0;
+        } else if (g->characters[code] != bases[i]) {
+            // soft-masked bases keep their codes
+            if (tolower((unsigned char)g->characters[code]) == c) {
+                escape(g, g->base_count + i, GRAMMAR_LOWERCASE);
+            } else {
+                escape(g, g->base_count + i, bases[i]);
+                code = 0;
+            }
+        }
+
+        pack_code(g->packed, g->base_count + i, g->bit_size, code);
+    }
+
+    g->base_count += size;
+}
+
+/**
+ * @brief Mixes `size` bases into the hash, 8 at a time.
+ */
+static uint64_t hash_bases(uint64_t h, const char *bases, uint32_t size) {
+    uint32_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bases + i, 8);
+        h = lcp_mix64(h ^ word);
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        memcpy(&word, bases + i, size - i);
+        h = lcp_mix64(h ^ word);
+    }
+    return h;
+}
+
+static uint64_t content_hash(const void *content, uint32_t size, int terminal) {
+    uint64_t h = lcp_mix64(terminal ? size | GRAMMAR_TERMINAL : size);
+
+    if (terminal) {
+        h = hash_bases(h, (const char *)content, size);
+    } else {
+        const uint32_t *items = (const uint32_t *)content;
+        uint32_t i = 0;
+        for (; i + 2 <= size; i += 2) {
+            h = lcp_mix64(h ^ (((uint64_t)items[i] << 32) | items[i+1]));
+        }
+        if (i < size) {
+            h = lcp_mix64(h ^ items[i]);
+        }
+    }
+
+    return h;
+}
+
+static inline uint64_t rule_hash(const struct grammar *g, uint32_t id) {
+    const struct grammar_rule *rule = &(g->rules[id]);
+    if (!(rule->size & GRAMMAR_TERMINAL)) {
+        return content_hash(g->items + rule->offset, rule->size, 0);
+    }
+
+    // the same hash as `content_hash` over the unpacked bases, as chunks are multiples of 8
+    char buffer[GRAMMAR_UNPACK_SIZE];
+    uint64_t h = lcp_mix64(rule->size);
+    for (uint32_t i = 0; i < rule->length; i += GRAMMAR_UNPACK_SIZE) {
+        uint32_t count = minimum(GRAMMAR_UNPACK_SIZE, rule->length - i);
+        unpack(g, rule->offset + i, count, buffer);
+        h = hash_bases(h, buffer, count);
+    }
+    return h;
+}
+
+/**
+ * @brief Checks whether the bases of a terminal rule are the given ones.
+ */
+static int terminal_equal(const struct grammar *g, const struct grammar_rule *rule, const char *bases) {
+    char buffer[GRAMMAR_UNPACK_SIZE];
+    for (uint32_t i = 0; i < rule->length; i += GRAMMAR_UNPACK_SIZE) {
+        uint32_t count = minimum(GRAMMAR_UNPACK_SIZE, rule->length - i);
+        unpack(g, rule->offset + i, count, buffer);
+        if (memcmp(buffer, bases + i, count) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void rehash(struct grammar *g, uint64_t slot_count) {
+    free(g->slots);
+    g->slot_count = slot_count;
+    g->slots = (uint32_t *)malloc(slot_count * sizeof(uint32_t));
+    memset(g->slots, 0xFF, slot_count * sizeof(uint32_t));
+
+    uint64_t mask = slot_count - 1;
+    for (uint32_t id = 0; id < g->rule_count; id++) {
+        uint64_t slot = rule_hash(g, id) & mask;
+        while (g->slots[slot] != GRAMMAR_EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        g->slots[slot] = id;
+    }
+}
+
+/**
+ * @brief Returns the id of the rule with the given content, adding the rule if it is
+ * new. The content is `size` bases for a terminal, and `size` symbols otherwise.
+ */
+static uint32_t intern(struct grammar *g, const void *content, uint32_t size, int terminal) {
+    if (g->slot_count * GRAMMAR_LOAD_FACTOR < g->rule_count + 1) {
+        rehash(g, g->slot_count * 2);
+    }
+
+    uint32_t tagged_size = terminal ? size | GRAMMAR_TERMINAL : size;
+    uint64_t mask = g->slot_count - 1;
+    uint64_t slot = content_hash(content, size, terminal) & mask;
+
+    while (g->slots[slot] != GRAMMAR_EMPTY_SLOT) {
+        const struct grammar_rule *rule = &(g->rules[g->slots[slot]]);
+        if (rule->size == tagged_size && (terminal ? terminal_equal(g, rule, (const char *)content) :
+                                          memcmp(g->items + rule->offset, content, size * sizeof(uint32_t)) == 0)) {
+            return g->slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    g->rules = (struct grammar_rule *)reserve(g->rules, g->rule_count + 1, &(g->rule_capacity), sizeof(struct grammar_rule));
+    struct grammar_rule *rule = &(g->rules[g->rule_count]);
+    rule->size = tagged_size;
+
+    if (terminal) {
+        rule->offset = g->base_count;
+        rule->length = size;
+        pack(g, (const char *)content, size);
+    } else {
+        g->items = (uint32_t *)reserve(g->items, g->item_count + size, &(g->item_capacity), sizeof(uint32_t));
+        memcpy(g->items + g->item_count, content, size * sizeof(uint32_t));
+        rule->offset = g->item_count;
+        rule->length = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            rule->length += g->rules[g->items[g->item_count + i]].length;
+        }
+        g->item_count += size;
+    }
+
+    g->slots[slot] = g->rule_count;
+    return g->rule_count++;
+}
+
+/**
+ * @brief Returns the symbol of the segment made of `size` symbols, which is the
+ * symbol itself for a single one.
+ */
+static inline uint32_t group(struct grammar *g, const uint32_t *symbols, uint32_t size) {
+    return size == 1 ? symbols[0] : intern(g, symbols, size, 0);
+}
+
+void init_grammar(struct grammar *g, int lcp_level) {
+    memset(g, 0, sizeof(struct grammar));
+    g->level = lcp_level;
+    g->bit_size = lcp_default_context.bit_size;
+    memcpy(g->characters, lcp_default_context.characters, sizeof(g->characters));
+    g->sequences = (uint64_t *)reserve(NULL, 1, &(g->sequence_capacity), sizeof(uint64_t));
+    g->sequences[0] = 0;
+    rehash(g, 1024);
+}
+
+void free_grammar(struct grammar *g) {
+    free(g->rules);
+    free(g->items);
+    free(g->packed);
+    free(g->escape_positions);
+    free(g->escape_lengths);
+    free(g->escape_bases);
+    free(g->sequences);
+    free(g->tops);
+    free(g->top_positions);
+    free(g->slots);
+    memset(g, 0, sizeof(struct grammar));
+}
+
+uint32_t grammar_add(struct grammar *g, const char *seq, int len) {
+    struct lps lps_obj;
+    init_lps(&lps_obj, seq, len);
+    lps_deepen(&lps_obj, minimum(GRAMMAR_TERMINAL_LEVEL, g->level));
+
+    // the symbols of the sequence and their start positions, ending with the length
+    uint64_t capacity = lps_obj.size + 2;
+    uint32_t *symbols = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    uint64_t *starts = (uint64_t *)malloc((capacity + 1) * sizeof(uint64_t));
+    uint64_t count = 0;
+
+    // the segments of the terminal level are terminals
+    uint64_t position = 0;
+    for (int i = 0; i <= lps_obj.size; i++) {
+        uint64_t cut = i < lps_obj.size ? lps_obj.cores[i].start : (uint64_t)len;
+        if (position < cut) {
+            symbols[count] = intern(g, seq + position, cut - position, 1);
+            starts[count] = position;
+            count++;
+            position = cut;
+        }
+    }
+    starts[count] = len;
+
+    // the segments of higher levels are rules over the symbols between their cuts
+    while (lps_obj.level < g->level && lps_deepen1(&lps_obj) && lps_obj.size) {
+        uint64_t new_count = 0, first = 0, e = 0;
+
+        for (int j = 0; j <= lps_obj.size; j++) {
+            uint64_t cut = j < lps_obj.size ? lps_obj.cores[j].start : (uint64_t)len;
+            while (e < count && starts[e] < cut) {
+                e++;
+            }
+            if (first < e && (starts[e] == cut || j == lps_obj.size)) {
+                symbols[new_count] = group(g, symbols + first, e - first);
+                starts[new_count] = starts[first];
+                new_count++;
+                first = e;
+            }
+        }
+
+        count = new_count;
+        starts[count] = len;
+    }
+
+    g->tops = (uint32_t *)reserve(g->tops, g->top_count + count, &(g->top_capacity), sizeof(uint32_t));
+    g->top_positions = (uint64_t *)realloc(g->top_positions, g->top_capacity * sizeof(uint64_t));
+    memcpy(g->tops + g->top_count, symbols, count * sizeof(uint32_t));
+    memcpy(g->top_positions + g->top_count, starts, count * sizeof(uint64_t));
+    g->top_count += count;
+
+    g->sequences = (uint64_t *)reserve(g->sequences, g->sequence_count + 2, &(g->sequence_capacity), sizeof(uint64_t));
+    g->sequences[g->sequence_count + 1] = g->top_count;
+
+    free(symbols);
+    free(starts);
+    free_lps(&lps_obj);
+
+    return g->sequence_count++;
+}
+
+uint64_t grammar_length(const struct grammar *g, uint32_t sequence) {
+    uint64_t first = g->sequences[sequence], last = g->sequences[sequence + 1];
+    if (first == last) {
+        return 0;
+    }
+    return g->top_positions[last - 1] + g->rules[g->tops[last - 1]].length;
+}
+
+/**
+ * @brief Writes up to `count` bases of the expansion of `symbol` from `from` into `out`.
+ * @return Number of written bases.
+ */
+static uint64_t expand(const struct grammar *g, uint32_t symbol, uint64_t from, uint64_t count, char *out) {
+    const struct grammar_rule *rule = &(g->rules[symbol]);
+
+    if (rule->size & GRAMMAR_TERMINAL) {
+        uint64_t written = minimum(count, rule->length - from);
+        unpack(g, rule->offset + from, written, out);
+        return written;
+    }
+
+    const uint32_t *items = g->items + rule->offset;
+    uint64_t written = 0;
+
+    for (uint32_t i = 0; i < rule->size && written < count; i++) {
+        uint64_t length = g->rules[items[i]].length;
+        if (length <= from) {
+            from -= length;
+            continue;
+        }
+        written += expand(g, items[i], from, count - written, out + written);
+        from = 0;
+    }
+
+    return written;
+}
+
+uint64_t grammar_extract(const struct grammar *g, uint32_t sequence, uint64_t position, uint64_t len, char *out) {
+    uint64_t low = g->sequences[sequence], high = g->sequences[sequence + 1];
+    uint64_t last = high;
+
+    if (low == high) {
+        return 0;
+    }
+
+    // find the last top level symbol starting at or before the position
+    while (low + 1 < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (g->top_positions[mid] <= position) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    uint64_t written = 0;
+    uint64_t from = position - g->top_positions[low];
+
+    for (uint64_t i = low; i < last && written < len; i++) {
+        uint64_t length = g->rules[g->tops[i]].length;
+        if (length <= from) {
+            from -= length;
+            continue;
+        }
+        written += expand(g, g->tops[i], from, len - written, out + written);
+        from = 0;
+    }
+
+    return written;
+}
+
+void grammar_decompress(const struct grammar *g, uint32_t sequence, char *out) {
+    grammar_extract(g, sequence, 0, grammar_length(g, sequence), out);
+}
+
+uint64_t grammar_memsize(const struct grammar *g) {
+    return sizeof(struct grammar_header) +
+           g->rule_count * sizeof(uint32_t) +
+           g->item_count * sizeof(uint32_t) +
+           packed_words(g, g->base_count) * sizeof(uint64_t) +
+           g->escape_count * (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(char)) +
+           (g->sequence_count + 1) * sizeof(uint64_t) +
+           g->top_count * sizeof(uint32_t);
+}
+
+int write_grammar(const struct grammar *g, FILE *out) {
+    struct grammar_header header;
+    memset(&header, 0, sizeof(header));
+    header.level = g->level;
+    header.rule_count = g->rule_count;
+    header.item_count = g->item_count;
+    header.base_count = g->base_count;
+    header.sequence_count = g->sequence_count;
+    header.bit_size = g->bit_size;
+    header.top_count = g->top_count;
+    header.escape_count = g->escape_count;
+    memcpy(header.characters, g->characters, sizeof(header.characters));
+
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        return 0;
+    }
+
+    for (uint32_t id = 0; id < g->rule_count; id++) {
+        if (fwrite(&(g->rules[id].size), sizeof(uint32_t), 1, out) != 1) {
+            return 0;
+        }
+    }
+
+    uint64_t word_count = packed_words(g, g->base_count);
+
+    return fwrite(g->items, sizeof(uint32_t), g->item_count, out) == g->item_count &&
+           fwrite(g->packed, sizeof(uint64_t), word_count, out) == word_count &&
+           fwrite(g->escape_positions, sizeof(uint64_t), g->escape_count, out) == g->escape_count &&
+           fwrite(g->escape_lengths, sizeof(uint32_t), g->escape_count, out) == g->escape_count &&
+           fwrite(g->escape_bases, sizeof(char), g->escape_count, out) == g->escape_count &&
+           fwrite(g->sequences, sizeof(uint64_t), g->sequence_count + 1, out) == g->sequence_count + 1 &&
+           fwrite(g->tops, sizeof(uint32_t), g->top_count, out) == g->top_count;
+}
+
+int read_grammar(struct grammar *g, FILE *in) {
+    struct grammar_header header;
+
+    init_grammar(g, 0);
+
+    if (fread(&header, sizeof(header), 1, in) != 1) {
+        return 0;
+    }
+
+    if (header.bit_size < 0 || 8 < header.bit_size) {
+        free_grammar(g);
+        return 0;
+    }
+
+    g->level = header.level;
+    g->bit_size = header.bit_size;
+    memcpy(g->characters, header.characters, sizeof(g->characters));
+    uint64_t word_count = packed_words(g, header.base_count);
+
+    g->rules = (struct grammar_rule *)reserve(g->rules, header.rule_count, &(g->rule_capacity), sizeof(struct grammar_rule));
+    g->items = (uint32_t *)reserve(g->items, header.item_count, &(g->item_capacity), sizeof(uint32_t));
+    reserve_packed(g, header.base_count);
+    g->escape_positions = (uint64_t *)reserve(g->escape_positions, header.escape_count, &(g->escape_capacity), sizeof(uint64_t));
+    g->escape_lengths = (uint32_t *)malloc((g->escape_capacity ? g->escape_capacity : 1) * sizeof(uint32_t));
+    g->escape_bases = (char *)malloc((g->escape_capacity ? g->escape_capacity : 1) * sizeof(char));
+    g->sequences = (uint64_t *)reserve(g->sequences, header.sequence_count + 1, &(g->sequence_capacity), sizeof(uint64_t));
+    g->tops = (uint32_t *)reserve(g->tops, header.top_count, &(g->top_capacity), sizeof(uint32_t));
+    g->top_positions = (uint64_t *)malloc((g->top_capacity ? g->top_capacity : 1) * sizeof(uint64_t));
+
+    for (uint32_t id = 0; id < header.rule_count; id++) {
+        if (fread(&(g->rules[id].size), sizeof(uint32_t), 1, in) != 1) {
+            free_grammar(g);
+            return 0;
+        }
+    }
+
+    if (fread(g->items, sizeof(uint32_t), header.item_count, in) != header.item_count ||
+        fread(g->packed, sizeof(uint64_t), word_count, in) != word_count ||
+        fread(g->escape_positions, sizeof(uint64_t), header.escape_count, in) != header.escape_count ||
+        fread(g->escape_lengths, sizeof(uint32_t), header.escape_count, in) != header.escape_count ||
+        fread(g->escape_bases, sizeof(char), header.escape_count, in) != header.escape_count ||
+        fread(g->sequences, sizeof(uint64_t), header.sequence_count + 1, in) != header.sequence_count + 1 ||
+        fread(g->tops, sizeof(uint32_t), header.top_count, in) != header.top_count) {
+        free_grammar(g);
+        return 0;
+    }
+
+    // rebuild the offsets and lengths of the rules, children being interned before their parents
+    uint64_t item_offset = 0, base_offset = 0;
+    for (uint32_t id = 0; id < header.rule_count; id++) {
+        struct grammar_rule *rule = &(g->rules[id]);
+        if (rule->size & GRAMMAR_TERMINAL) {
+            rule->offset = base_offset;
+            rule->length = rule->size & ~GRAMMAR_TERMINAL;
+            base_offset += rule->length;
+        } else {
+            rule->offset = item_offset;
+            rule->length = 0;
+            for (uint32_t i = 0; i < rule->size; i++) {
+                if (header.item_count <= item_offset + i || id <= g->items[item_offset + i]) {
+                    free_grammar(g);
+                    return 0;
+                }
+                rule->length += g->rules[g->items[item_offset + i]].length;
+            }
+            item_offset += rule->size;
+        }
+    }
+
+    if (item_offset != header.item_count || base_offset != header.base_count) {
+        free_grammar(g);
+        return 0;
+    }
+
+    // escapes should be sorted, disjoint and nonempty runs of packed bases
+    for (uint64_t e = 0; e < header.escape_count; e++) {
+        if (!g->escape_lengths[e] || header.base_count < g->escape_positions[e] + g->escape_lengths[e] ||
+            (e && g->escape_positions[e] < g->escape_positions[e-1] + g->escape_lengths[e-1])) {
+            free_grammar(g);
+            return 0;
+        }
+    }
+
+    // top level symbols should be rules, split into consecutive sequences covering all of them
+    for (uint64_t i = 0; i < header.top_count; i++) {
+        if (header.rule_count <= g->tops[i]) {
+            free_grammar(g);
+            return 0;
+        }
+    }
+
+    if (g->sequences[0] != 0 || g->sequences[header.sequence_count] != header.top_count) {
+        free_grammar(g);
+        return 0;
+    }
+
+    for (uint32_t s = 0; s < header.sequence_count; s++) {
+        if (g->sequences[s + 1] < g->sequences[s]) {
+            free_grammar(g);
+            return 0;
+        }
+    }
+
+    g->rule_count = header.rule_count;
+    g->item_count = header.item_count;
+    g->base_count = header.base_count;
+    g->escape_count = header.escape_count;
+    g->sequence_count = header.sequence_count;
+    g->top_count = header.top_count;
+
+    // rebuild the positions of the top level symbols and the table of the rules
+    for (uint32_t s = 0; s < g->sequence_count; s++) {
+        uint64_t position = 0;
+        for (uint64_t i = g->sequences[s]; i < g->sequences[s + 1]; i++) {
+            g->top_positions[i] = position;
+            position += g->rules[g->tops[i]].length;
+        }
+    }
+
+    uint64_t slot_count = 1024;
+    while (slot_count * GRAMMAR_LOAD_FACTOR < g->rule_count + 1) {
+        slot_count *= 2;
+    }
+    rehash(g, slot_count);
+
+    return 1;
+}
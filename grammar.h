@@ -0,0 +1,193 @@
+/**
+ * @file grammar.h
+ * @brief Grammar compression of sequence collections along the LCP hierarchy.
+ *
+ * The cores of consecutive levels form a parse tree of a sequence: each core of
+ * level `k` starts at the start of its first child, a core of level `k-1`. The
+ * starts of the cores of a level are therefore a subset of the starts of the
+ * previous level, and cutting the sequence at the starts of each level gives a
+ * hierarchy of nested segments. This file declares a grammar which stores every
+ * distinct segment once, as a rule, and each sequence as the short list of its top
+ * level rules.
+ *
+ * A rule is either a terminal, holding the bases of a segment of level
+ * `GRAMMAR_TERMINAL_LEVEL`, or the list of the rules of the segments of the previous
+ * level it contains. Rules are deduplicated by their content rather than by core
+ * labels, since a label of a level above 1 does not determine the bases of its
+ * core. As LCP parsing is locally consistent, similar sequences share most of their
+ * rules, and each additional sequence of a collection only adds its top level
+ * symbols and the rules around its differences. The bases before the first cut and
+ * after the last cut of a level are kept as the rules of the previous level.
+ *
+ * The bases of the terminals are packed with the codes of the encoding context set
+ * when the grammar is created, `bit_size` bits per base. Bases which cannot be
+ * restored from their codes are kept in a sorted list of escapes, runs of equal
+ * escaped bases given by their first position among the packed bases and their
+ * length: bases without a code, e.g. N, are stored with code 0 and restored from the
+ * escape, and soft-masked bases keep their codes and are restored in lowercase, so
+ * that runs of N and masked regions take a single escape.
+ *
+ * Key functionalities include:
+ * - Adding sequences to a grammar one at a time, sharing the rules of all of them.
+ * - Decompressing whole sequences and extracting substrings by descending from the
+ * top level symbol containing the first base, in time proportional to the depth of
+ * the grammar and the length of the substring.
+ * - Reading and writing grammars from and to binary files.
+ *
+ * @see lps.h
+ *
+ * @struct grammar_rule
+ * @struct grammar
+ *
+ */
+
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+
+#define GRAMMAR_LOAD_FACTOR     0.5
+#define GRAMMAR_TERMINAL_LEVEL  3
+#define GRAMMAR_TERMINAL        0x80000000U
+#define GRAMMAR_EMPTY_SLOT      UINT32_MAX
+#define GRAMMAR_LOWERCASE       '\0'
+
+struct grammar_rule {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t size;
+};
+
+struct grammar {
+    int level;
+
+    uint32_t rule_count;
+    uint64_t rule_capacity;
+    struct grammar_rule *rules;
+
+    uint64_t item_count;
+    uint64_t item_capacity;
+    uint32_t *items;
+
+    int bit_size;
+    char characters[256];
+    uint64_t base_count;
+    uint64_t packed_capacity;
+    uint64_t *packed;
+
+    uint64_t escape_count;
+    uint64_t escape_capacity;
+    uint64_t *escape_positions;
+    uint32_t *escape_lengths;
+    char *escape_bases; // `GRAMMAR_LOWERCASE` for soft-masked bases
+
+    uint32_t sequence_count;
+    uint64_t sequence_capacity;
+    uint64_t *sequences;
+
+    uint64_t top_count;
+    uint64_t top_capacity;
+    uint32_t *tops;
+    uint64_t *top_positions;
+
+    uint64_t slot_count;
+    uint32_t *slots;
+};
+
+/**
+ * @brief Initializes an empty grammar, packing bases with the codes of
+ * `lcp_default_context`.
+ *
+ * @param g Pointer to the grammar to initialize.
+ * @param lcp_level The level of the top level rules of the sequences.
+ */
+void init_grammar(struct grammar *g, int lcp_level);
+
+/**
+ * @brief Frees the memory allocated for the grammar.
+ *
+ * @param g Pointer to the grammar to deallocate.
+ */
+void free_grammar(struct grammar *g);
+
+/**
+ * @brief Parses a sequence up to the level of the grammar and adds it.
+ *
+ * @param g Pointer to the grammar.
+ * @param seq The sequence.
+ * @param len Length of the sequence.
+ * @return Id of the sequence, consecutive from 0.
+ */
+uint32_t grammar_add(struct grammar *g, const char *seq, int len);
+
+/**
+ * @brief Returns the length of a sequence of the grammar.
+ *
+ * @param g The grammar.
+ * @param sequence Id of the sequence.
+ * @return Length of the sequence.
+ */
+uint64_t grammar_length(const struct grammar *g, uint32_t sequence);
+
+/**
+ * @brief Extracts a substring of a sequence of the grammar.
+ *
+ * @param g The grammar.
+ * @param sequence Id of the sequence.
+ * @param position Position of the first base, less than the length of the sequence.
+ * @param len Number of bases, clipped at the end of the sequence.
+ * @param out Buffer of at least `len` characters. It is not null-terminated.
+ * @return Number of extracted bases.
+ */
+uint64_t grammar_extract(const struct grammar *g, uint32_t sequence, uint64_t position, uint64_t len, char *out);
+
+/**
+ * @brief Decompresses a whole sequence of the grammar.
+ *
+ * @param g The grammar.
+ * @param sequence Id of the sequence.
+ * @param out Buffer of at least `grammar_length(g, sequence)` characters.
+ */
+void grammar_decompress(const struct grammar *g, uint32_t sequence, char *out);
+
+/**
+ * @brief Returns the size of the grammar as written by `write_grammar`.
+ *
+ * Only the tagged sizes of the rules are written; their offsets and lengths, the
+ * positions of the top level symbols and the table used to deduplicate rules are
+ * rebuilt when reading a grammar.
+ *
+ * @param g The grammar.
+ * @return Size of the grammar in bytes.
+ */
+uint64_t grammar_memsize(const struct grammar *g);
+
+/**
+ * @brief Writes the grammar to a binary file.
+ *
+ * @param g The grammar.
+ * @param out File pointer to the binary file.
+ * @return 1 on success, 0 otherwise.
+ */
+int write_grammar(const struct grammar *g, FILE *out);
+
+/**
+ * @brief Reads a grammar written by `write_grammar`. More sequences can be added to
+ * it afterwards.
+ *
+ * @param g Pointer to the grammar to initialize.
+ * @param in File pointer to the binary file.
+ * @return 1 on success, 0 if the file is malformed.
+ */
+int read_grammar(struct grammar *g, FILE *in);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,366 @@
+/**
+ * @file graph.c
+ * @brief Implementation of the concurrent graph builder and the CSR core graph.
+ *
+ * Node slots never move once claimed, as the tables are not resized, so an edge is
+ * keyed by the slots of its nodes packed into 64 bits. Slot numbers are below
+ * `GRAPH_MAX_NODE_SLOTS`, so that distinct edges never share a key and no edge has
+ * the key of an empty slot. Slot numbers are replaced by node indices when the
+ * builder is compacted.
+ *
+ * Node slots are claimed with the protocol of `claim.h`: the label of the core is
+ * filled after the key, and the bit size is the published word of the slot.
+ */
+
+#include "graph.h"
+#include "claim.h"
+#include "pool.h"
+
+#define GRAPH_NONE UINT64_MAX
+#define GRAPH_UNPUBLISHED UINT32_MAX
+
+struct graph_context {
+    struct graph_builder *b;
+    const struct lps *lps_arr;
+    int count;
+    int next_task;
+    int failed;
+};
+
+struct node_item {
+    struct graph_builder *b;
+    const struct core *cr;
+};
+
+struct node_key {
+    uint64_t key;
+    ulabel label;
+    ubit_size bit_size;
+    uint64_t slot;
+};
+
+struct edge_triple {
+    uint32_t source;
+    uint32_t target;
+    uint32_t count;
+};
+
+static inline uint64_t core_key(const struct core *cr) {
+    uint64_t h = lcp_mix64(((uint64_t)cr->label << 32) | cr->bit_size);
+    uint64_t block_count = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+
+    for (uint64_t i = 0; i < block_count; i++) {
+        h = lcp_mix64(h ^ core_block(cr, i));
+    }
+
+    return h == GRAPH_EMPTY_KEY ? 1 : h;
+}
+
+static inline uint64_t table_size(uint64_t capacity) {
+    uint64_t slot_count = 1;
+    while (slot_count * GRAPH_LOAD_FACTOR < capacity + 1) {
+        slot_count *= 2;
+    }
+    return slot_count;
+}
+
+int init_graph_builder(struct graph_builder *b, uint64_t node_capacity, uint64_t edge_capacity) {
+    memset(b, 0, sizeof(struct graph_builder));
+
+    uint64_t node_slot_count = table_size(node_capacity);
+    if (GRAPH_MAX_NODE_SLOTS < node_slot_count) {
+        return 0;
+    }
+
+    b->node_slot_count = node_slot_count;
+    b->node_keys = (uint64_t *)calloc(b->node_slot_count, sizeof(uint64_t));
+    b->node_labels = (ulabel *)malloc(b->node_slot_count * sizeof(ulabel));
+    b->node_bit_sizes = (ubit_size *)malloc(b->node_slot_count * sizeof(ubit_size));
+    b->node_counts = (uint32_t *)calloc(b->node_slot_count, sizeof(uint32_t));
+    memset(b->node_bit_sizes, 0xFF, b->node_slot_count * sizeof(ubit_size));
+
+    b->edge_slot_count = table_size(edge_capacity);
+    b->edge_keys = (uint64_t *)malloc(b->edge_slot_count * sizeof(uint64_t));
+    b->edge_counts = (uint32_t *)calloc(b->edge_slot_count, sizeof(uint32_t));
+    memset(b->edge_keys, 0xFF, b->edge_slot_count * sizeof(uint64_t));
+
+    b->full = 0;
+
+    return 1;
+}
+
+void free_graph_builder(struct graph_builder *b) {
+    free(b->node_keys);
+    free(b->node_labels);
+    free(b->node_bit_sizes);
+    free(b->node_counts);
+    free(b->edge_keys);
+    free(b->edge_counts);
+    b->node_keys = NULL;
+    b->node_labels = NULL;
+    b->node_bit_sizes = NULL;
+    b->node_counts = NULL;
+    b->edge_keys = NULL;
+    b->edge_counts = NULL;
+    b->node_slot_count = 0;
+    b->edge_slot_count = 0;
+}
+
+static inline void fill_label(void *arg, uint64_t slot) {
+    struct node_item *item = (struct node_item *)arg;
+    item->b->node_labels[slot] = item->cr->label;
+}
+
+static inline int matches_label(void *arg, uint64_t slot, uint32_t bit_size) {
+    struct node_item *item = (struct node_item *)arg;
+    return bit_size == item->cr->bit_size && item->b->node_labels[slot] == item->cr->label;
+}
+
+/**
+ * @brief Counts an occurrence of the core in the node table.
+ * @return The slot of the core, or `GRAPH_NONE` if the table is full.
+ */
+static uint64_t insert_node(struct graph_builder *b, const struct core *cr) {
+    struct claim_table table = {b->node_slot_count, GRAPH_EMPTY_KEY, GRAPH_UNPUBLISHED, b->node_keys, b->node_bit_sizes};
+    struct node_item item = {b, cr};
+    uint64_t key = core_key(cr);
+
+    uint64_t slot = claim_slot(&table, key, key & (b->node_slot_count - 1), cr->bit_size, fill_label, matches_label, &item);
+    if (slot == b->node_slot_count) {
+        return GRAPH_NONE;
+    }
+
+    __atomic_fetch_add(&(b->node_counts[slot]), 1, __ATOMIC_RELAXED);
+    return slot;
+}
+
+/**
+ * @brief Counts an occurrence of the adjacency in the edge table.
+ * @return 1 on success, 0 if the table is full.
+ */
+static int insert_edge(struct graph_builder *b, uint64_t source, uint64_t target) {
+    uint64_t key = (source << 32) | target;
+    uint64_t mask = b->edge_slot_count - 1;
+    uint64_t slot = lcp_mix64(key) & mask;
+
+    for (uint64_t probe = 0; probe < b->edge_slot_count; probe++) {
+        uint64_t current = __atomic_load_n(&(b->edge_keys[slot]), __ATOMIC_RELAXED);
+
+        if (current == GRAPH_EMPTY_EDGE) {
+            uint64_t expected = GRAPH_EMPTY_EDGE;
+            __atomic_compare_exchange_n(&(b->edge_keys[slot]), &expected, key, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            current = expected == GRAPH_EMPTY_EDGE ? key : expected;
+        }
+
+        if (current == key) {
+            __atomic_fetch_add(&(b->edge_counts[slot]), 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return 0;
+}
+
+int graph_builder_add_lps(struct graph_builder *b, const struct lps *lps_ptr) {
+    uint64_t previous = GRAPH_NONE;
+    int success = 1;
+
+    for (int i = 0; i < lps_ptr->size; i++) {
+        uint64_t slot = insert_node(b, &(lps_ptr->cores[i]));
+
+        if (slot != GRAPH_NONE && previous != GRAPH_NONE) {
+            success &= insert_edge(b, previous, slot);
+        }
+        success &= slot != GRAPH_NONE;
+
+        previous = slot;
+    }
+
+    if (!success) {
+        __atomic_store_n(&(b->full), 1, __ATOMIC_RELAXED);
+    }
+
+    return success;
+}
+
+static void *graph_work(void *arg) {
+    struct graph_context *ctx = (struct graph_context *)arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < ctx->count) {
+        if (!graph_builder_add_lps(ctx->b, &(ctx->lps_arr[i]))) {
+            __atomic_store_n(&(ctx->failed), 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+int graph_builder_add_batch(struct graph_builder *b, const struct lps *lps_arr, int count, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    struct graph_context ctx = {b, lps_arr, count, 0, 0};
+    run_pool(graph_work, &ctx, 0, thread_count);
+
+    return !ctx.failed;
+}
+
+int graph_builder_add_lcpt(struct graph_builder *b, FILE *in, int thread_count) {
+    struct lps batch[GRAPH_BATCH_SIZE];
+    int record_count = 0, status = 1, added = 1;
+
+    while (status == 1 && added) {
+        int count = 0;
+        while (count < GRAPH_BATCH_SIZE && (status = read_lps(&(batch[count]), in)) == 1) {
+            count++;
+        }
+
+        added = graph_builder_add_batch(b, batch, count, thread_count);
+
+        for (int i = 0; i < count; i++) {
+            free_lps(&(batch[i]));
+        }
+        record_count += count;
+    }
+
+    return status < 0 || !added ? -1 : record_count;
+}
+
+static int compare_node_keys(const void *lhs, const void *rhs) {
+    const struct node_key *a = (const struct node_key *)lhs;
+    const struct node_key *b = (const struct node_key *)rhs;
+    if (a->key != b->key) {
+        return (a->key > b->key) - (a->key < b->key);
+    }
+    // nodes sharing a key are ordered by their labels and bit sizes
+    if (a->label != b->label) {
+        return (a->label > b->label) - (a->label < b->label);
+    }
+    return (a->bit_size > b->bit_size) - (a->bit_size < b->bit_size);
+}
+
+static int compare_edges(const void *lhs, const void *rhs) {
+    const struct edge_triple *a = (const struct edge_triple *)lhs;
+    const struct edge_triple *b = (const struct edge_triple *)rhs;
+    if (a->source != b->source) {
+        return (a->source > b->source) - (a->source < b->source);
+    }
+    return (a->target > b->target) - (a->target < b->target);
+}
+
+void init_core_graph(struct core_graph *g, const struct graph_builder *b) {
+
+    // number the nodes in the order of their keys
+    uint64_t node_count = 0;
+    for (uint64_t slot = 0; slot < b->node_slot_count; slot++) {
+        node_count += b->node_keys[slot] != GRAPH_EMPTY_KEY;
+    }
+
+    struct node_key *keys = (struct node_key *)malloc((node_count ? node_count : 1) * sizeof(struct node_key));
+    node_count = 0;
+    for (uint64_t slot = 0; slot < b->node_slot_count; slot++) {
+        if (b->node_keys[slot] != GRAPH_EMPTY_KEY) {
+            keys[node_count].key = b->node_keys[slot];
+            keys[node_count].label = b->node_labels[slot];
+            keys[node_count].bit_size = b->node_bit_sizes[slot];
+            keys[node_count].slot = slot;
+            node_count++;
+        }
+    }
+    qsort(keys, node_count, sizeof(struct node_key), compare_node_keys);
+
+    uint32_t *ids = (uint32_t *)malloc(b->node_slot_count * sizeof(uint32_t));
+    g->node_count = node_count;
+    g->labels = (ulabel *)malloc((node_count ? node_count : 1) * sizeof(ulabel));
+    g->node_counts = (uint32_t *)malloc((node_count ? node_count : 1) * sizeof(uint32_t));
+    for (uint64_t i = 0; i < node_count; i++) {
+        ids[keys[i].slot] = i;
+        g->labels[i] = b->node_labels[keys[i].slot];
+        g->node_counts[i] = b->node_counts[keys[i].slot];
+    }
+    free(keys);
+
+    // group the edges by their sources
+    uint64_t edge_count = 0;
+    for (uint64_t slot = 0; slot < b->edge_slot_count; slot++) {
+        edge_count += b->edge_keys[slot] != GRAPH_EMPTY_EDGE;
+    }
+
+    struct edge_triple *edges = (struct edge_triple *)malloc((edge_count ? edge_count : 1) * sizeof(struct edge_triple));
+    edge_count = 0;
+    for (uint64_t slot = 0; slot < b->edge_slot_count; slot++) {
+        if (b->edge_keys[slot] != GRAPH_EMPTY_EDGE) {
+            edges[edge_count].source = ids[b->edge_keys[slot] >> 32];
+            edges[edge_count].target = ids[b->edge_keys[slot] & 0xFFFFFFFF];
+            edges[edge_count].count = b->edge_counts[slot];
+            edge_count++;
+        }
+    }
+    qsort(edges, edge_count, sizeof(struct edge_triple), compare_edges);
+    free(ids);
+
+    g->edge_count = edge_count;
+    g->offsets = (uint64_t *)calloc(node_count + 1, sizeof(uint64_t));
+    g->targets = (uint32_t *)malloc((edge_count ? edge_count : 1) * sizeof(uint32_t));
+    g->edge_counts = (uint32_t *)malloc((edge_count ? edge_count : 1) * sizeof(uint32_t));
+    for (uint64_t i = 0; i < edge_count; i++) {
+        g->offsets[edges[i].source + 1]++;
+        g->targets[i] = edges[i].target;
+        g->edge_counts[i] = edges[i].count;
+    }
+    for (uint64_t i = 0; i < node_count; i++) {
+        g->offsets[i + 1] += g->offsets[i];
+    }
+    free(edges);
+}
+
+void free_core_graph(struct core_graph *g) {
+    free(g->labels);
+    free(g->node_counts);
+    free(g->offsets);
+    free(g->targets);
+    free(g->edge_counts);
+    g->labels = NULL;
+    g->node_counts = NULL;
+    g->offsets = NULL;
+    g->targets = NULL;
+    g->edge_counts = NULL;
+    g->node_count = 0;
+    g->edge_count = 0;
+}
+
+uint32_t core_graph_edge(const struct core_graph *g, uint32_t source, uint32_t target) {
+    uint64_t low = g->offsets[source], high = g->offsets[source + 1];
+
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (g->targets[mid] < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low < g->offsets[source + 1] && g->targets[low] == target ? g->edge_counts[low] : 0;
+}
+
+int core_graph_write_gfa(const struct core_graph *g, FILE *out) {
+    int success = fprintf(out, "H\tVN:Z:1.0\n") > 0;
+
+    for (uint32_t i = 0; i < g->node_count && success; i++) {
+        success = fprintf(out, "S\t%u\t*\tKC:i:%u\tlb:i:%u\n", i + 1, g->node_counts[i], g->labels[i]) > 0;
+    }
+
+    for (uint32_t i = 0; i < g->node_count && success; i++) {
+        for (uint64_t j = g->offsets[i]; j < g->offsets[i + 1] && success; j++) {
+            success = fprintf(out, "L\t%u\t+\t%u\t+\t*\tEC:i:%u\n", i + 1, g->targets[j] + 1, g->edge_counts[j]) > 0;
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file graph.h
+ * @brief Construction of core adjacency graphs.
+ *
+ * A core adjacency graph has a node for each distinct core of a level and an edge
+ * from a core to the next core of the same sequence, similarly to a sparse de Bruijn
+ * graph whose nodes are cores instead of k-mers. Nodes and edges carry the number of
+ * times they are observed.
+ *
+ * Key functionalities include:
+ * - Building the graph from `lps` objects or `.lcpt` streams with multiple threads.
+ * Nodes are deduplicated by their label and bit representation in a concurrent hash
+ * table, and edges, keyed by the slots of their nodes, are counted in a second
+ * concurrent hash table. Slots are claimed with compare-and-swap and counts are
+ * incremented atomically.
+ * - Compacting the tables into a graph in compressed sparse row (CSR) form, with
+ * nodes ordered by their keys so that the graph does not depend on the scheduling of
+ * the threads.
+ * - Exporting the graph in GFA format.
+ *
+ * Node identity is by hash: the key of a node is a 64-bit hash of the label, bit
+ * size and bit representation of its cores, and the bit representations are not
+ * stored. The label and the bit size are stored next to the key, and cores whose
+ * keys are equal but whose labels or bit sizes differ are kept as distinct nodes, so
+ * only cores of the same label and size whose bit representations differ can be
+ * merged by a hash collision, which happens with negligible probability.
+ *
+ * Edges are keyed by the slots of their nodes packed into 64 bits, so the node table
+ * has at most `GRAPH_MAX_NODE_SLOTS` slots.
+ *
+ * @see lps.h
+ *
+ * @struct graph_builder
+ * @struct core_graph
+ *
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+
+#define GRAPH_LOAD_FACTOR       0.5
+#define GRAPH_EMPTY_KEY         0
+#define GRAPH_EMPTY_EDGE        UINT64_MAX
+#define GRAPH_BATCH_SIZE        256
+#define GRAPH_MAX_NODE_SLOTS    (1ULL << 31)
+
+struct graph_builder {
+    uint64_t node_slot_count;
+    uint64_t *node_keys;
+    ulabel *node_labels;
+    ubit_size *node_bit_sizes;
+    uint32_t *node_counts;
+
+    uint64_t edge_slot_count;
+    uint64_t *edge_keys;
+    uint32_t *edge_counts;
+
+    int full;
+};
+
+struct core_graph {
+    uint32_t node_count;
+    uint64_t edge_count;
+    ulabel *labels;
+    uint32_t *node_counts;
+    uint64_t *offsets;
+    uint32_t *targets;
+    uint32_t *edge_counts;
+};
+
+/**
+ * @brief Initializes an empty graph builder.
+ *
+ * The hash tables are not resized, so the capacities should be at least the numbers
+ * of distinct cores and adjacencies to be added.
+ *
+ * @param b Pointer to the builder to initialize.
+ * @param node_capacity Expected number of distinct cores.
+ * @param edge_capacity Expected number of distinct adjacencies.
+ * @return 1 on success, 0 if the node table would need more than
+ * `GRAPH_MAX_NODE_SLOTS` slots, in which case the builder is empty and can only be
+ * freed.
+ */
+int init_graph_builder(struct graph_builder *b, uint64_t node_capacity, uint64_t edge_capacity);
+
+/**
+ * @brief Frees the memory allocated for the builder.
+ *
+ * @param b Pointer to the builder to deallocate.
+ */
+void free_graph_builder(struct graph_builder *b);
+
+/**
+ * @brief Adds the cores of an `lps` object and the adjacencies between them.
+ *
+ * This function is thread-safe.
+ *
+ * @param b Pointer to the builder.
+ * @param lps_ptr The cores.
+ * @return 1 on success, 0 if a table is full, in which case the remaining cores or
+ * adjacencies are dropped and `b->full` is set.
+ */
+int graph_builder_add_lps(struct graph_builder *b, const struct lps *lps_ptr);
+
+/**
+ * @brief Adds a batch of `lps` objects with multiple threads.
+ *
+ * @param b Pointer to the builder.
+ * @param lps_arr The `lps` objects.
+ * @param count Number of `lps` objects.
+ * @param thread_count Number of threads to be used.
+ * @return 1 on success, 0 if a table is full.
+ */
+int graph_builder_add_batch(struct graph_builder *b, const struct lps *lps_arr, int count, int thread_count);
+
+/**
+ * @brief Adds all records of an `.lcpt` stream, reading `GRAPH_BATCH_SIZE` records at
+ * a time and adding them with multiple threads.
+ *
+ * @param b Pointer to the builder.
+ * @param in File pointer to the stream.
+ * @param thread_count Number of threads to be used.
+ * @return Number of records added, or -1 on a malformed stream or if a table is full,
+ * in which case reading stops at the batch that did not fit.
+ */
+int graph_builder_add_lcpt(struct graph_builder *b, FILE *in, int thread_count);
+
+/**
+ * @brief Compacts the tables of a builder into a graph in CSR form.
+ *
+ * Nodes are numbered in the order of their keys, and the edges of each node are
+ * ordered by their targets. The builder is left unchanged.
+ *
+ * @param g Pointer to the graph to initialize.
+ * @param b The builder.
+ */
+void init_core_graph(struct core_graph *g, const struct graph_builder *b);
+
+/**
+ * @brief Frees the memory allocated for the graph.
+ *
+ * @param g Pointer to the graph to deallocate.
+ */
+void free_core_graph(struct core_graph *g);
+
+/**
+ * @brief Returns the count of the edge between two nodes.
+ *
+ * @param g The graph.
+ * @param source The source node.
+ * @param target The target node.
+ * @return The number of times the adjacency is observed, 0 if there is no edge.
+ */
+uint32_t core_graph_edge(const struct core_graph *g, uint32_t source, uint32_t target);
+
+/**
+ * @brief Writes the graph in GFA 1.0 format.
+ *
+ * Each node is written as a segment without sequence, named by its 1-based index and
+ * tagged with its count (`KC`) and label (`lb`). Each edge is written as a link with
+ * unspecified overlap, tagged with its count (`EC`).
+ *
+ * @param g The graph.
+ * @param out File pointer to the output.
+ * @return 1 on success, 0 otherwise.
+ */
+int core_graph_write_gfa(const struct core_graph *g, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
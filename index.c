@@ -0,0 +1,222 @@
+/**
+ * @file index.c
+ * @brief Implementation of the `lcp_index` struct and its lookups.
+ *
+ * Labels are hashed and probed in batches with the helpers of `probe.h`, which the
+ * classification database shares.
+ *
+ * The index file consists of a fixed header, the hash slots, the entries and the
+ * record names. Slots and entries are 16 bytes each and the header is a multiple of
+ * 8 bytes, so both arrays are aligned when the file is mapped.
+ */
+
+#include "index.h"
+#include "probe.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct index_header {
+    char magic[8];
+    uint32_t lcp_level;
+    uint32_t record_count;
+    uint64_t slot_count;
+    uint64_t label_count;
+    uint64_t entry_count;
+    uint64_t names_size;
+};
+
+struct batch_lookup {
+    const struct lcp_index *index;
+    const ulabel *labels;
+    struct index_span *spans;
+};
+
+static inline struct index_span probe(const struct lcp_index *index, ulabel label, uint64_t slot) {
+    struct index_span span = {NULL, 0};
+    uint64_t mask = index->slot_count - 1;
+
+    while (index->slots[slot].size) {
+        if (index->slots[slot].label == label) {
+            span.entries = index->entries + index->slots[slot].offset;
+            span.size = index->slots[slot].size;
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return span;
+}
+
+void init_index(struct lcp_index *index, const struct ltuples *tuples) {
+
+    index->entry_count = tuples->size;
+    index->label_count = 0;
+
+    for (uint64_t i = 0; i < tuples->size; i++) {
+        if (i == 0 || tuples->tuples[i].label != tuples->tuples[i-1].label) {
+            index->label_count++;
+        }
+    }
+
+    index->slot_count = 1;
+    while (index->slot_count * INDEX_LOAD_FACTOR < index->label_count + 1) {
+        index->slot_count *= 2;
+    }
+
+    index->slots = (struct index_slot *)calloc(index->slot_count, sizeof(struct index_slot));
+    index->entries = (struct index_entry *)malloc((tuples->size ? tuples->size : 1) * sizeof(struct index_entry));
+    index->map = NULL;
+    index->map_size = 0;
+
+    uint64_t mask = index->slot_count - 1;
+    uint64_t begin = 0;
+
+    while (begin < tuples->size) {
+        ulabel label = tuples->tuples[begin].label;
+        uint64_t end = begin;
+
+        while (end < tuples->size && tuples->tuples[end].label == label) {
+            index->entries[end].record = tuples->tuples[end].record;
+            index->entries[end].position = tuples->tuples[end].position;
+            end++;
+        }
+
+        uint64_t slot = label_hash(label) & mask;
+        while (index->slots[slot].size) {
+            slot = (slot + 1) & mask;
+        }
+        index->slots[slot].label = label;
+        index->slots[slot].size = end - begin;
+        index->slots[slot].offset = begin;
+
+        begin = end;
+    }
+}
+
+void free_index(struct lcp_index *index) {
+    if (index->map) {
+        munmap(index->map, index->map_size);
+    } else {
+        free(index->slots);
+        free(index->entries);
+    }
+    index->map = NULL;
+    index->map_size = 0;
+    index->slots = NULL;
+    index->entries = NULL;
+    index->slot_count = 0;
+    index->label_count = 0;
+    index->entry_count = 0;
+}
+
+int index_save(const struct lcp_index *index, const struct index_info *info, const char *filename) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        return 0;
+    }
+
+    struct index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.lcp_level = info->lcp_level;
+    header.record_count = info->record_count;
+    header.slot_count = index->slot_count;
+    header.label_count = index->label_count;
+    header.entry_count = index->entry_count;
+    header.names_size = info->names_size;
+
+    int success = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(index->slots, sizeof(struct index_slot), index->slot_count, out) == index->slot_count &&
+                  fwrite(index->entries, sizeof(struct index_entry), index->entry_count, out) == index->entry_count &&
+                  fwrite(info->names, 1, info->names_size, out) == info->names_size;
+
+    return fclose(out) == 0 && success;
+}
+
+int index_open(struct lcp_index *index, struct index_info *info, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(struct index_header)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    const struct index_header *header = (const struct index_header *)map;
+    uint64_t slots_size = header->slot_count * sizeof(struct index_slot);
+    uint64_t entries_size = header->entry_count * sizeof(struct index_entry);
+    const char *names = (const char *)map + sizeof(struct index_header) + slots_size + entries_size;
+
+    int valid = memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                header->slot_count && (header->slot_count & (header->slot_count - 1)) == 0 &&
+                header->slot_count < ((uint64_t)1 << 59) && header->entry_count < ((uint64_t)1 << 59) &&
+                (uint64_t)st.st_size == sizeof(struct index_header) + slots_size + entries_size + header->names_size;
+
+    // every record should have a null-terminated name
+    uint64_t name_count = 0;
+    for (uint64_t i = 0; valid && i < header->names_size; i++) {
+        name_count += names[i] == '\0';
+    }
+
+    if (!valid || name_count != header->record_count || (header->names_size && names[header->names_size-1] != '\0')) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    index->slot_count = header->slot_count;
+    index->label_count = header->label_count;
+    index->entry_count = header->entry_count;
+    index->slots = (struct index_slot *)((char *)map + sizeof(struct index_header));
+    index->entries = (struct index_entry *)((char *)map + sizeof(struct index_header) + slots_size);
+    index->map = map;
+    index->map_size = st.st_size;
+
+    info->lcp_level = header->lcp_level;
+    info->record_count = header->record_count;
+    info->names_size = header->names_size;
+    info->names = names;
+
+    // the slots and the entries are read in random order
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    return 1;
+}
+
+struct index_span index_lookup(const struct lcp_index *index, ulabel label) {
+    return probe(index, label, label_hash(label) & (index->slot_count - 1));
+}
+
+/**
+ * @brief Probes a label of a batch, prefetching the first entry of its span.
+ */
+static inline void lookup_span(void *arg, uint64_t i, uint64_t slot) {
+    struct batch_lookup *lookup = (struct batch_lookup *)arg;
+
+    lookup->spans[i] = probe(lookup->index, lookup->labels[i], slot);
+    if (lookup->spans[i].size) {
+        __builtin_prefetch(lookup->spans[i].entries, 0, 1);
+    }
+}
+
+void index_lookup_batch(const struct lcp_index *index, const ulabel *labels, uint64_t count, struct index_span *spans) {
+    struct batch_lookup lookup = {index, labels, spans};
+    probe_batch(index->slots, sizeof(struct index_slot), index->slot_count, labels, count, INDEX_PREFETCH_DISTANCE,
+                lookup_span, &lookup);
+}
+
+uint64_t index_memsize(const struct lcp_index *index) {
+    return sizeof(struct lcp_index) +
+           index->slot_count * sizeof(struct index_slot) +
+           index->entry_count * sizeof(struct index_entry);
+}
@@ -0,0 +1,152 @@
+/**
+ * @file index.h
+ * @brief Declares the `lcp_index` struct, a label index over LCP cores.
+ *
+ * The index maps each core label to the span of (record, position) entries of the
+ * cores carrying that label. Entries are stored in a single array in CSR form,
+ * grouped by label, and labels are located through an open addressing hash table
+ * with linear probing.
+ *
+ * Key functionalities include:
+ * - Building the index from label-sorted tuples (see `sort.h`).
+ * - Looking up single labels.
+ * - Looking up batches of labels while keeping many cache misses in flight by
+ * software prefetching the hash slots ahead of the probes.
+ * - Saving the index into a single file together with the level and the record
+ * names of the reference, and opening it with `mmap`, so that queries start without
+ * rebuilding the index and processes share the pages of the same file.
+ *
+ * Since the tuples are sorted stably, entries of a label are ordered by record and
+ * position when the tuples were added in that order.
+ *
+ * @see sort.h
+ *
+ * @struct lcp_index
+ * @struct index_info
+ *
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sort.h"
+#include <stdint.h>
+
+#define INDEX_LOAD_FACTOR 0.5
+#define INDEX_PREFETCH_DISTANCE 16
+#define INDEX_MAGIC "LCPIDX1"
+
+struct index_slot {
+    ulabel label;
+    uint32_t size;
+    uint64_t offset;
+};
+
+struct index_entry {
+    uint32_t record;
+    uint64_t position;
+};
+
+struct index_span {
+    const struct index_entry *entries;
+    uint32_t size;
+};
+
+struct lcp_index {
+    uint64_t slot_count;
+    uint64_t label_count;
+    uint64_t entry_count;
+    struct index_slot *slots;
+    struct index_entry *entries;
+    void *map;
+    uint64_t map_size;
+};
+
+struct index_info {
+    int lcp_level;
+    uint32_t record_count;
+    uint64_t names_size;
+    const char *names;
+};
+
+/**
+ * @brief Builds an index from tuples sorted by label.
+ *
+ * @param index Pointer to the index to initialize.
+ * @param tuples Tuples sorted by label, e.g. with `ltuples_sort`.
+ */
+void init_index(struct lcp_index *index, const struct ltuples *tuples);
+
+/**
+ * @brief Frees the memory allocated for the index, or unmaps it if it was opened
+ * with `index_open`.
+ *
+ * @param index Pointer to the index to deallocate.
+ */
+void free_index(struct lcp_index *index);
+
+/**
+ * @brief Saves the index into a file which can be opened with `index_open`.
+ *
+ * @param index Pointer to the index.
+ * @param info The level the cores were deepened to and the names of the records,
+ * `names_size` bytes of consecutive null-terminated strings, one per record.
+ * @param filename Path of the file to write.
+ * @return 1 on success, 0 otherwise.
+ */
+int index_save(const struct lcp_index *index, const struct index_info *info, const char *filename);
+
+/**
+ * @brief Opens an index saved with `index_save` by mapping it into memory.
+ *
+ * The slots and the entries are used in place, so opening does not depend on the
+ * size of the index. The names of `info` point into the mapping and remain valid
+ * until the index is freed.
+ *
+ * @param index Pointer to the index to initialize.
+ * @param info Pointer where the level and the record names will be stored.
+ * @param filename Path of the file to open.
+ * @return 1 on success, 0 if the file cannot be opened or is not a valid index.
+ */
+int index_open(struct lcp_index *index, struct index_info *info, const char *filename);
+
+/**
+ * @brief Looks up the entries of a single label.
+ *
+ * @param index Pointer to the index.
+ * @param label The label to look up.
+ * @return Span of the entries of the label; its size is 0 if the label is absent.
+ */
+struct index_span index_lookup(const struct lcp_index *index, ulabel label);
+
+/**
+ * @brief Looks up the entries of many labels at once.
+ *
+ * The hash slot of each label is prefetched `INDEX_PREFETCH_DISTANCE` labels ahead
+ * of its probe, and the first entry of each found span is prefetched as well, so
+ * that the latency of the memory accesses overlap. The spans are written in the
+ * order of the given labels.
+ *
+ * @param index Pointer to the index.
+ * @param labels Labels to look up.
+ * @param count Number of labels.
+ * @param spans Array of at least `count` spans where the results will be stored.
+ */
+void index_lookup_batch(const struct lcp_index *index, const ulabel *labels, uint64_t count, struct index_span *spans);
+
+/**
+ * @brief Calculates the memory size used by the index.
+ *
+ * @return The memory size in bytes.
+ */
+uint64_t index_memsize(const struct lcp_index *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,4 +1,11 @@
+#include "batch.h"
 #include "lps.h"
+#include "map.h"
+#include "pool.h"
+#include "sketch.h"
+#include "stats.h"
+#include <inttypes.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,12 +13,29 @@
 
 #define MAX_LINE_LENGTH 1024
 #define SEQUENCE_CAPACITY 250000000
+#define BATCH_BASES (1 << 28)
+#define COMPARE_ROWS 1024
 
 void print_usage(const char *lcptools) {
-	printf("Usage: %s <command> <filename> <lcp-level> [sequence-size]\n", lcptools);
+	printf("Usage: %s <command> <filename> <lcp-level> [sequence-size | options]\n", lcptools);
 	printf("Commands:\n");
 	printf("  falcpt   Process the fasta file.\n");
+	printf("           Many files: %s falcpt --batch <list> <lcp-level> [-t <threads>]\n", lcptools);
+	printf("  stats    Report per-level core statistics without writing the cores.\n");
+	printf("  index    Build a core index of a reference: %s index <reference> -l <lcp-level> [-o <index>] [-t <threads>]\n", lcptools);
+	printf("  query    Map reads against an index:        %s query <index> <reads> [-t <threads>]\n", lcptools);
+	printf("  compare  Pairwise distances of genomes:     %s compare -l <lcp-level> [options] <genome>...\n", lcptools);
 	// printf("  fqlcpt   Process the fasta file.\n");
+	printf("Options of stats:\n");
+	printf("  -t <threads>  Number of threads (default: 1).\n");
+	printf("  --json        Write JSON instead of TSV.\n");
+	printf("Options of index:\n");
+	printf("  -o <index>    Output file (default: <reference>.lcpi).\n");
+	printf("Options of compare:\n");
+	printf("  -t <threads>  Number of threads (default: 1).\n");
+	printf("  -o <matrix>   Output file (default: standard output).\n");
+	printf("  --list <file> Read the genome paths from a file, one per line.\n");
+	printf("  --no-cache    Neither read nor write <genome>.sketch files.\n");
 	printf("File extensions:\n");
 	printf("  .fasta, .fa, .fastq, .fq\n");
 }
@@ -52,6 +76,869 @@ void done(FILE *out) {
     fwrite(&isDone, 1, 1, out);
 }
 
+struct seq_reader {
+    FILE *in;
+    char *line;
+    size_t line_capacity;
+    ssize_t line_length;
+};
+
+struct seq_record {
+    char *name;
+    size_t name_capacity;
+    char *seq;
+    size_t length;
+    size_t capacity;
+};
+
+/**
+ * @brief Starts reading a file, reusing the line buffer of the previous file.
+ */
+static void open_seq_reader(struct seq_reader *reader, FILE *in) {
+    reader->in = in;
+    reader->line_length = getline(&(reader->line), &(reader->line_capacity), in);
+}
+
+static void init_seq_reader(struct seq_reader *reader, FILE *in) {
+    reader->line = NULL;
+    reader->line_capacity = 0;
+    open_seq_reader(reader, in);
+}
+
+static void free_seq_reader(struct seq_reader *reader) {
+    free(reader->line);
+    reader->line = NULL;
+}
+
+static void next_line(struct seq_reader *reader) {
+    reader->line_length = getline(&(reader->line), &(reader->line_capacity), reader->in);
+    while (0 < reader->line_length && (reader->line[reader->line_length-1] == '\n' || reader->line[reader->line_length-1] == '\r')) {
+        reader->line[--(reader->line_length)] = '\0';
+    }
+}
+
+static void append(char **buffer, size_t *length, size_t *capacity, const char *str, size_t len) {
+    if (*capacity < *length + len + 1) {
+        *capacity = maximum(2 * *capacity, *length + len + 1);
+        *buffer = (char *)realloc(*buffer, *capacity);
+    }
+    memcpy(*buffer + *length, str, len);
+    *length += len;
+    (*buffer)[*length] = '\0';
+}
+
+/**
+ * @brief Reads the next record of a fasta or fastq file.
+ *
+ * @return 1 if a record is read, 0 at the end of the file.
+ */
+static int next_record(struct seq_reader *reader, struct seq_record *record) {
+
+    // skip anything before the next header
+    while (0 <= reader->line_length && reader->line[0] != '>' && reader->line[0] != '@') {
+        next_line(reader);
+    }
+    if (reader->line_length < 0) {
+        return 0;
+    }
+
+    // the name is the first word of the header
+    size_t name_length = 0;
+    reader->line[strcspn(reader->line, "\r\n")] = '\0';
+    append(&(record->name), &name_length, &(record->name_capacity), reader->line + 1, strcspn(reader->line + 1, " \t"));
+
+    int fastq = reader->line[0] == '@';
+    record->length = 0;
+    append(&(record->seq), &(record->length), &(record->capacity), "", 0);
+
+    next_line(reader);
+    while (0 <= reader->line_length && reader->line[0] != '>' && !(fastq ? reader->line[0] == '+' : 0)) {
+        append(&(record->seq), &(record->length), &(record->capacity), reader->line, reader->line_length);
+        next_line(reader);
+    }
+
+    if (fastq && 0 <= reader->line_length) {
+        // skip the qualities, which are as long as the sequence
+        size_t quality_length = 0;
+        next_line(reader);
+        while (0 <= reader->line_length && quality_length < record->length) {
+            quality_length += reader->line_length;
+            next_line(reader);
+        }
+    }
+
+    return 1;
+}
+
+struct seq_batch {
+    char **names;
+    char **seqs;
+    int *lengths;
+    int count;
+    int capacity;
+    uint64_t bases;
+};
+
+static void init_seq_batch(struct seq_batch *batch) {
+    batch->count = 0;
+    batch->capacity = 1024;
+    batch->bases = 0;
+    batch->names = (char **)malloc(batch->capacity * sizeof(char *));
+    batch->seqs = (char **)malloc(batch->capacity * sizeof(char *));
+    batch->lengths = (int *)malloc(batch->capacity * sizeof(int));
+}
+
+static void clear_seq_batch(struct seq_batch *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        free(batch->names[i]);
+        free(batch->seqs[i]);
+    }
+    batch->count = 0;
+    batch->bases = 0;
+}
+
+static void free_seq_batch(struct seq_batch *batch) {
+    clear_seq_batch(batch);
+    free(batch->names);
+    free(batch->seqs);
+    free(batch->lengths);
+}
+
+/**
+ * @brief Copies a record into the batch.
+ *
+ * @return 1 once the batch holds at least `BATCH_BASES` bases, 0 otherwise.
+ */
+static int seq_batch_push(struct seq_batch *batch, const struct seq_record *record) {
+    if (batch->count == batch->capacity) {
+        batch->capacity *= 2;
+        batch->names = (char **)realloc(batch->names, batch->capacity * sizeof(char *));
+        batch->seqs = (char **)realloc(batch->seqs, batch->capacity * sizeof(char *));
+        batch->lengths = (int *)realloc(batch->lengths, batch->capacity * sizeof(int));
+    }
+    batch->names[batch->count] = strdup(record->name);
+    batch->seqs[batch->count] = (char *)malloc(record->length + 1);
+    memcpy(batch->seqs[batch->count], record->seq, record->length + 1);
+    batch->lengths[batch->count] = record->length;
+    batch->count++;
+    batch->bases += record->length;
+
+    return BATCH_BASES <= batch->bases;
+}
+
+static int parse_level(const char *arg, int *lcp_level) {
+    if (isNumber(arg) || atol(arg) < 1) {
+        fprintf(stderr, "Error: The lcp level argument must be a positive integer.\n");
+        return 1;
+    }
+    *lcp_level = atol(arg);
+    return 0;
+}
+
+static int parse_threads(int argc, char *argv[], int i, int *thread_count) {
+    if (argc <= i + 1 || isNumber(argv[i + 1]) || atol(argv[i + 1]) < 1) {
+        fprintf(stderr, "Error: The thread count must be a positive integer.\n");
+        return 1;
+    }
+    *thread_count = atol(argv[i + 1]);
+    return 0;
+}
+
+int process_stats(const char *infilename, int lcp_level, int thread_count, int json) {
+
+    FILE *infile = fopen(infilename, "rb");
+    if (!infile) {
+        fprintf(stderr, "Error opening file\n");
+        return 1;
+    }
+
+    LCP_INIT();
+
+    struct lcp_stats stats;
+    init_lcp_stats(&stats, lcp_level);
+
+    struct seq_reader reader;
+    struct seq_record record = {NULL, 0, NULL, 0, 0};
+    init_seq_reader(&reader, infile);
+
+    // records are processed in batches of about `BATCH_BASES` bases
+    struct seq_batch batch;
+    init_seq_batch(&batch);
+
+    int more = 1;
+    while (more) {
+        more = next_record(&reader, &record);
+        if (more ? seq_batch_push(&batch, &record) : 1) {
+            lcp_stats_add_batch(&stats, (const char **)batch.seqs, batch.lengths, batch.count, thread_count);
+            clear_seq_batch(&batch);
+        }
+    }
+
+    if (json) {
+        write_lcp_stats_json(&stats, stdout);
+    } else {
+        write_lcp_stats_tsv(&stats, stdout);
+    }
+
+    free_seq_batch(&batch);
+    free(record.name);
+    free(record.seq);
+    free_seq_reader(&reader);
+    free_lcp_stats(&stats);
+    fclose(infile);
+
+    return 0;
+}
+
+int run_stats(int argc, char *argv[]) {
+
+    const char *infilename = argv[2];
+    int lcp_level, thread_count = 1, json = 0;
+
+    if (validate_extension(infilename)) {
+        fprintf(stderr, "Error: Invalid file extension. Supported extensions are .fasta, .fa, .fastq, .fq\n");
+        return 1;
+    }
+
+    if (parse_level(argv[3], &lcp_level)) {
+        return 1;
+    }
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            if (parse_threads(argc, argv, i, &thread_count)) {
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    return process_stats(infilename, lcp_level, thread_count, json);
+}
+
+/**
+ * @brief Adds the cores of the records of a batch to the tuples, numbering the records
+ * from `*record_count` on, and appends their names.
+ */
+static void add_index_batch(struct ltuples *tuples, struct seq_batch *batch, int lcp_level, int thread_count,
+                            uint32_t *record_count, char **names, size_t *names_size, size_t *names_capacity) {
+
+    struct lps *lps_arr = (struct lps *)malloc((batch->count ? batch->count : 1) * sizeof(struct lps));
+    lps_batch(lps_arr, (const char **)batch->seqs, batch->lengths, batch->count, lcp_level, thread_count);
+
+    for (int i = 0; i < batch->count; i++) {
+        ltuples_add_lps(tuples, &(lps_arr[i]), *record_count + i);
+        append(names, names_size, names_capacity, batch->names[i], strlen(batch->names[i]) + 1);
+        free_lps(&(lps_arr[i]));
+    }
+
+    *record_count += batch->count;
+    free(lps_arr);
+    clear_seq_batch(batch);
+}
+
+int process_index(const char *infilename, const char *outfilename, int lcp_level, int thread_count) {
+
+    FILE *infile = fopen(infilename, "rb");
+    if (!infile) {
+        fprintf(stderr, "Error opening file\n");
+        return 1;
+    }
+
+    LCP_INIT();
+
+    struct ltuples tuples;
+    init_ltuples(&tuples, 0);
+
+    struct seq_reader reader;
+    struct seq_record record = {NULL, 0, NULL, 0, 0};
+    init_seq_reader(&reader, infile);
+
+    struct seq_batch batch;
+    init_seq_batch(&batch);
+
+    uint32_t record_count = 0;
+    char *names = NULL;
+    size_t names_size = 0, names_capacity = 0;
+
+    int more = 1;
+    while (more) {
+        more = next_record(&reader, &record);
+        if (more ? seq_batch_push(&batch, &record) : 1) {
+            add_index_batch(&tuples, &batch, lcp_level, thread_count, &record_count, &names, &names_size, &names_capacity);
+        }
+    }
+
+    ltuples_sort(&tuples, thread_count);
+
+    struct lcp_index index;
+    init_index(&index, &tuples);
+    free_ltuples(&tuples);
+
+    struct index_info info = {lcp_level, record_count, names_size, names};
+    int success = index_save(&index, &info, outfilename);
+
+    if (success) {
+        printf("Output: %s\n", outfilename);
+        printf("Records: %u, labels: %" PRIu64 ", cores: %" PRIu64 "\n", record_count, index.label_count, index.entry_count);
+    } else {
+        fprintf(stderr, "Error writing index %s\n", outfilename);
+    }
+
+    free_index(&index);
+    free(names);
+    free_seq_batch(&batch);
+    free(record.name);
+    free(record.seq);
+    free_seq_reader(&reader);
+    fclose(infile);
+
+    return !success;
+}
+
+int run_index(int argc, char *argv[]) {
+
+    const char *infilename = argv[2];
+    const char *outfilename = NULL;
+    int lcp_level = 0, thread_count = 1;
+
+    if (validate_extension(infilename)) {
+        fprintf(stderr, "Error: Invalid file extension. Supported extensions are .fasta, .fa, .fastq, .fq\n");
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (parse_level(argv[++i], &lcp_level)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outfilename = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0) {
+            if (parse_threads(argc, argv, i, &thread_count)) {
+                return 1;
+            }
+            i++;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!lcp_level) {
+        fprintf(stderr, "Error: The lcp level must be given with -l.\n");
+        return 1;
+    }
+
+    // generate output filename
+    char defaultname[1024];
+    if (!outfilename) {
+        snprintf(defaultname, sizeof(defaultname), "%s.lcpi", infilename);
+        outfilename = defaultname;
+    }
+
+    return process_index(infilename, outfilename, lcp_level, thread_count);
+}
+
+/**
+ * @brief Maps the reads of a batch and writes one line per read.
+ */
+static void query_batch(const struct lcp_index *index, const struct index_info *info, const char **record_names,
+                        struct seq_batch *batch, struct map_read *results, int thread_count, FILE *out) {
+
+    map_reads(index, (const char **)batch->seqs, batch->lengths, batch->count, info->lcp_level, results, thread_count);
+
+    for (int i = 0; i < batch->count; i++) {
+        const struct map_read *result = &(results[i]);
+        if (result->chain.score) {
+            fprintf(out, "%s\t%d\t%c\t%s\t%" PRId64 "\t%u\n", batch->names[i], batch->lengths[i], result->reverse ? '-' : '+',
+                    record_names[result->chain.record], result->chain.position, result->chain.score);
+        } else {
+            fprintf(out, "%s\t%d\t*\t*\t*\t0\n", batch->names[i], batch->lengths[i]);
+        }
+    }
+
+    clear_seq_batch(batch);
+}
+
+int process_query(const char *indexfilename, const char *infilename, int thread_count) {
+
+    struct lcp_index index;
+    struct index_info info;
+    if (!index_open(&index, &info, indexfilename)) {
+        fprintf(stderr, "Error: %s is not a valid index\n", indexfilename);
+        return 1;
+    }
+
+    FILE *infile = fopen(infilename, "rb");
+    if (!infile) {
+        fprintf(stderr, "Error opening file\n");
+        free_index(&index);
+        return 1;
+    }
+
+    LCP_INIT();
+
+    // names of the reference records, in record order
+    const char **record_names = (const char **)malloc((info.record_count ? info.record_count : 1) * sizeof(char *));
+    const char *name = info.names;
+    for (uint32_t r = 0; r < info.record_count; r++) {
+        record_names[r] = name;
+        name += strlen(name) + 1;
+    }
+
+    struct seq_reader reader;
+    struct seq_record record = {NULL, 0, NULL, 0, 0};
+    init_seq_reader(&reader, infile);
+
+    struct seq_batch batch;
+    init_seq_batch(&batch);
+    struct map_read *results = NULL;
+    int results_capacity = 0;
+
+    printf("read\tlength\tstrand\treference\tposition\tseeds\n");
+
+    int more = 1;
+    while (more) {
+        more = next_record(&reader, &record);
+        if (more ? seq_batch_push(&batch, &record) : 1) {
+            if (results_capacity < batch.count) {
+                results_capacity = batch.capacity;
+                results = (struct map_read *)realloc(results, results_capacity * sizeof(struct map_read));
+            }
+            query_batch(&index, &info, record_names, &batch, results, thread_count, stdout);
+        }
+    }
+
+    free(results);
+    free(record_names);
+    free_seq_batch(&batch);
+    free(record.name);
+    free(record.seq);
+    free_seq_reader(&reader);
+    free_index(&index);
+    fclose(infile);
+
+    return 0;
+}
+
+int run_query(int argc, char *argv[]) {
+
+    const char *indexfilename = argv[2];
+    const char *infilename = argv[3];
+    int thread_count = 1;
+
+    if (validate_extension(infilename)) {
+        fprintf(stderr, "Error: Invalid file extension. Supported extensions are .fasta, .fa, .fastq, .fq\n");
+        return 1;
+    }
+
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            if (parse_threads(argc, argv, i, &thread_count)) {
+                return 1;
+            }
+            i++;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    return process_query(indexfilename, infilename, thread_count);
+}
+
+struct file_pool;
+
+typedef int (*file_fn)(struct file_pool *pool, int file, struct seq_reader *reader, struct seq_record *record);
+
+struct file_pool {
+    char **files;
+    int count;
+    int lcp_level;
+    file_fn process;
+    void *arg;
+    const int *order;
+    int next_task;
+    int failed_count;
+};
+
+struct compare_state {
+    struct genome_sketch *sketches;
+    int cache;
+};
+
+struct file_worker {
+    struct file_pool *pool;
+    struct seq_reader reader;
+    struct seq_record record;
+};
+
+/**
+ * @brief Reads the paths listed in a file, one per line, skipping empty lines and
+ * lines starting with '#'.
+ *
+ * @return 0 on success, 1 if the file cannot be opened.
+ */
+static int read_file_list(const char *listname, char ***files, int *count, int *capacity) {
+    FILE *list = fopen(listname, "r");
+    if (!list) {
+        fprintf(stderr, "Error opening file %s\n", listname);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_length;
+
+    while ((line_length = getline(&line, &line_capacity, list)) >= 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (*count == *capacity) {
+            *capacity = *capacity ? 2 * *capacity : 64;
+            *files = (char **)realloc(*files, *capacity * sizeof(char *));
+        }
+        (*files)[(*count)++] = strdup(line);
+    }
+
+    free(line);
+    fclose(list);
+
+    return 0;
+}
+
+static void *file_work(void *arg) {
+    struct file_worker *worker = (struct file_worker *)arg;
+    struct file_pool *pool = worker->pool;
+    int i;
+
+    while ((i = __atomic_fetch_add(&(pool->next_task), 1, __ATOMIC_RELAXED)) < pool->count) {
+        if (pool->process(pool, pool->order[i], &(worker->reader), &(worker->record))) {
+            __atomic_fetch_add(&(pool->failed_count), 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Processes the files of the pool with multiple threads. Each worker keeps its
+ * line and record buffers across files, and files are taken in `pool_order` of their
+ * sizes on disk.
+ *
+ * @return Number of files that failed.
+ */
+static int run_file_pool(struct file_pool *pool, int thread_count) {
+    // files which cannot be stat'ed sort last and fail when they are opened
+    uint64_t *sizes = (uint64_t *)malloc((pool->count ? pool->count : 1) * sizeof(uint64_t));
+    for (int i = 0; i < pool->count; i++) {
+        struct stat st;
+        sizes[i] = stat(pool->files[i], &st) == 0 ? (uint64_t)st.st_size : 0;
+    }
+    int *order = pool_order(sizes, pool->count);
+    free(sizes);
+
+    pool->order = order;
+    pool->next_task = 0;
+    pool->failed_count = 0;
+
+    struct file_worker *workers = (struct file_worker *)malloc(thread_count * sizeof(struct file_worker));
+
+    for (int t = 0; t < thread_count; t++) {
+        memset(&(workers[t]), 0, sizeof(struct file_worker));
+        workers[t].pool = pool;
+    }
+
+    run_pool(file_work, workers, sizeof(struct file_worker), thread_count);
+
+    for (int t = 0; t < thread_count; t++) {
+        free_seq_reader(&(workers[t].reader));
+        free(workers[t].record.name);
+        free(workers[t].record.seq);
+    }
+
+    free(workers);
+    free(order);
+
+    return pool->failed_count;
+}
+
+/**
+ * @brief Sketches the records of a genome file together, or loads the sketch cached
+ * next to the file if it is not older than the file and has the same level.
+ */
+static int sketch_file(struct file_pool *pool, int file, struct seq_reader *reader, struct seq_record *record) {
+    const char *infilename = pool->files[file];
+    struct compare_state *state = (struct compare_state *)pool->arg;
+    struct genome_sketch *sketch = &(state->sketches[file]);
+    int cache = state->cache, lcp_level = pool->lcp_level;
+
+    char *cachename = (char *)malloc(strlen(infilename) + 8);
+    sprintf(cachename, "%s.sketch", infilename);
+
+    struct stat in_st, cache_st;
+    if (cache && stat(infilename, &in_st) == 0 && stat(cachename, &cache_st) == 0 && in_st.st_mtime <= cache_st.st_mtime &&
+        sketch_load(sketch, lcp_level, cachename)) {
+        free(cachename);
+        return 0;
+    }
+
+    FILE *infile = fopen(infilename, "rb");
+    if (!infile) {
+        fprintf(stderr, "Error opening file %s\n", infilename);
+        free(cachename);
+        return 1;
+    }
+
+    open_seq_reader(reader, infile);
+    init_genome_sketch(sketch);
+
+    while (next_record(reader, record)) {
+        struct lps lps_obj;
+        init_lps(&lps_obj, record->seq, record->length);
+        lps_deepen(&lps_obj, lcp_level);
+        sketch_add_lps(&lps_obj, sketch);
+        free_lps(&lps_obj);
+    }
+
+    sketch_densify(sketch);
+    fclose(infile);
+
+    if (cache && !sketch_save(sketch, lcp_level, cachename)) {
+        fprintf(stderr, "Warning: Cannot write %s\n", cachename);
+    }
+
+    free(cachename);
+
+    return 0;
+}
+
+int process_compare(char **files, int count, int lcp_level, int thread_count, int cache, const char *outfilename) {
+
+    FILE *outfile = outfilename ? fopen(outfilename, "w") : stdout;
+    if (!outfile) {
+        fprintf(stderr, "Error opening file %s\n", outfilename);
+        return 1;
+    }
+
+    LCP_INIT();
+
+    struct genome_sketch *sketches = (struct genome_sketch *)malloc((count ? count : 1) * sizeof(struct genome_sketch));
+    struct compare_state state = {sketches, cache};
+    struct file_pool pool = {files, count, lcp_level, sketch_file, &state, NULL, 0, 0};
+
+    if (run_file_pool(&pool, thread_count)) {
+        free(sketches);
+        if (outfilename) fclose(outfile);
+        return 1;
+    }
+
+    // distances only depend on the number of equal bins
+    char distances[SKETCH_SIZE + 1][16];
+    for (int e = 0; e <= SKETCH_SIZE; e++) {
+        snprintf(distances[e], sizeof(distances[e]), "\t%.6f", 1.0 - (double)e / SKETCH_SIZE);
+    }
+
+    fprintf(outfile, "genome");
+    for (int j = 0; j < count; j++) {
+        fprintf(outfile, "\t%s", files[j]);
+    }
+    fprintf(outfile, "\n");
+
+    // the matrix is computed and written `COMPARE_ROWS` rows at a time
+    uint16_t *equal_counts = (uint16_t *)malloc((uint64_t)minimum(count, COMPARE_ROWS) * count * sizeof(uint16_t) + 1);
+    for (int first = 0; first < count; first += COMPARE_ROWS) {
+        int rows = minimum(COMPARE_ROWS, count - first);
+        sketch_compare(sketches + first, rows, sketches, count, equal_counts, thread_count);
+
+        for (int i = 0; i < rows; i++) {
+            fputs(files[first + i], outfile);
+            for (int j = 0; j < count; j++) {
+                fputs(distances[equal_counts[(uint64_t)i * count + j]], outfile);
+            }
+            fputc('\n', outfile);
+        }
+    }
+
+    int success = !ferror(outfile);
+    if (!success) {
+        fprintf(stderr, "Error writing the distance matrix\n");
+    }
+
+    free(equal_counts);
+    free(sketches);
+    if (outfilename) fclose(outfile);
+
+    return !success;
+}
+
+int run_compare(int argc, char *argv[]) {
+
+    char **files = NULL;
+    int count = 0, capacity = 0;
+    const char *outfilename = NULL;
+    int lcp_level = 0, thread_count = 1, cache = 1, status = 0;
+
+    for (int i = 2; i < argc && !status; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            status = parse_level(argv[++i], &lcp_level);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            status = parse_threads(argc, argv, i, &thread_count);
+            i++;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outfilename = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+            status = read_file_list(argv[++i], &files, &count, &capacity);
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            cache = 0;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            status = 1;
+        } else {
+            if (count == capacity) {
+                capacity = capacity ? 2 * capacity : 64;
+                files = (char **)realloc(files, capacity * sizeof(char *));
+            }
+            files[count++] = strdup(argv[i]);
+        }
+    }
+
+    for (int i = 0; !status && i < count; i++) {
+        if (validate_extension(files[i])) {
+            fprintf(stderr, "Error: Invalid file extension of %s. Supported extensions are .fasta, .fa, .fastq, .fq\n", files[i]);
+            status = 1;
+        }
+    }
+
+    if (!status && !lcp_level) {
+        fprintf(stderr, "Error: The lcp level must be given with -l.\n");
+        status = 1;
+    }
+
+    if (!status) {
+        status = process_compare(files, count, lcp_level, thread_count, cache, outfilename);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(files[i]);
+    }
+    free(files);
+
+    return status;
+}
+
+/**
+ * @brief Writes the cores of the records of a file into `<file>.lcpt`.
+ */
+static int lcpt_file(struct file_pool *pool, int file, struct seq_reader *reader, struct seq_record *record) {
+    const char *infilename = pool->files[file];
+
+    char *outfilename = (char *)malloc(strlen(infilename) + 6);
+    sprintf(outfilename, "%s.lcpt", infilename);
+
+    FILE *infile = fopen(infilename, "rb");
+    FILE *outfile = fopen(outfilename, "wb");
+
+    if (!infile || !outfile) {
+        fprintf(stderr, "Error opening file %s\n", infile ? outfilename : infilename);
+        if (infile) fclose(infile);
+        if (outfile) fclose(outfile);
+        free(outfilename);
+        return 1;
+    }
+
+    open_seq_reader(reader, infile);
+
+    while (next_record(reader, record)) {
+        if (!record->length) {
+            continue;
+        }
+        struct lps str;
+        init_lps(&str, record->seq, record->length);
+        lps_deepen(&str, pool->lcp_level);
+        write_lps(&str, outfile);
+        free_lps(&str);
+    }
+
+    done(outfile);
+
+    int success = !ferror(outfile);
+    success &= fclose(outfile) == 0;
+    fclose(infile);
+
+    if (!success) {
+        fprintf(stderr, "Error writing %s\n", outfilename);
+    }
+    free(outfilename);
+
+    return !success;
+}
+
+int run_falcpt_batch(int argc, char *argv[]) {
+
+    char **files = NULL;
+    int count = 0, capacity = 0;
+    int lcp_level, thread_count = 1;
+
+    if (argc < 5 || parse_level(argv[4], &lcp_level)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = 5; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            if (parse_threads(argc, argv, i, &thread_count)) {
+                return 1;
+            }
+            i++;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (read_file_list(argv[3], &files, &count, &capacity)) {
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 0; !status && i < count; i++) {
+        if (validate_extension(files[i])) {
+            fprintf(stderr, "Error: Invalid file extension of %s. Supported extensions are .fasta, .fa, .fastq, .fq\n", files[i]);
+            status = 1;
+        }
+    }
+
+    if (!status) {
+        LCP_INIT();
+
+        struct file_pool pool = {files, count, lcp_level, lcpt_file, NULL, NULL, 0, 0};
+        int failed_count = run_file_pool(&pool, thread_count);
+
+        printf("Processed %d of %d files\n", count - failed_count, count);
+        status = failed_count != 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(files[i]);
+    }
+    free(files);
+
+    return status;
+}
+
 int process_fasta(const char *infilename, const char *outfilename, int lcp_level, long unsigned int sequence_size) {
 
     FILE *infile = fopen(infilename, "rb");
@@ -78,7 +965,7 @@ int process_fasta(const char *infilename, const char *outfilename, int lcp_level
     char line[1024];
 
 	// Initialize lcp encoding
-    LCP_INIT(0);
+    LCP_INIT();
 
 	while (fgets(line, sizeof(line), infile)) {
 
@@ -140,12 +1027,29 @@ int main(int argc, char *argv[]) {
 	const char *command = argv[1];
 	const char *infilename = argv[2];
 
+	if (strcmp(command, "stats") == 0) {
+		return run_stats(argc, argv);
+	}
+	if (strcmp(command, "index") == 0) {
+		return run_index(argc, argv);
+	}
+	if (strcmp(command, "query") == 0) {
+		return run_query(argc, argv);
+	}
+	if (strcmp(command, "compare") == 0) {
+		return run_compare(argc, argv);
+	}
+
 	if (strcmp(command, "falcpt") != 0) {
 		fprintf(stderr, "Error: Unsupported command %s\n", command);
 		print_usage(argv[0]);
 		return 1;
 	}
 
+	if (strcmp(infilename, "--batch") == 0) {
+		return run_falcpt_batch(argc, argv);
+	}
+
 	if (validate_extension(infilename)) {
 		fprintf(stderr, "Error: Invalid file extension. Supported extensions are .fasta, .fa, .fastq, .fq\n");
 		return 1;
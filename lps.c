@@ -1,4 +1,5 @@
 #include "lps.h"
+#include "trace.h"
 
 void init_lps(struct lps *lps_ptr, const char *str, int len) {   
     lps_ptr->level = 1;
@@ -21,7 +22,23 @@ void init_lps2(struct lps *lps_ptr, const char *str, int len) {
     lps_ptr->size = parse2(str, str+len, lps_ptr->cores, 0);
 }
 
+void init_lps_ctx(struct lps *lps_ptr, const char *str, int len, const struct lcp_context *ctx) {
+    lps_ptr->level = 1;
+    lps_ptr->size = 0;
+    lps_ptr->cores = (struct core *)malloc((len/CONSTANT_FACTOR)*sizeof(struct core));
+    lps_ptr->size = parse1_ctx(str, str+len, lps_ptr->cores, 0, ctx);
+}
+
+void init_lps2_ctx(struct lps *lps_ptr, const char *str, int len, const struct lcp_context *ctx) {
+    lps_ptr->level = 1;
+    lps_ptr->size = 0;
+    lps_ptr->cores = (struct core *)malloc((len/CONSTANT_FACTOR)*sizeof(struct core));
+    lps_ptr->size = parse2_ctx(str, str+len, lps_ptr->cores, 0, ctx);
+}
+
 void init_lps3(struct lps *lps_ptr, FILE *in) {
+    TRACE_BEGIN(TRACE_INIT_LPS3, 0);
+
     // read the level from the binary file
     if (fread(&(lps_ptr->level), sizeof(int), 1, in) != 1) {
         fprintf(stderr, "Error reading level from file\n");
@@ -48,6 +65,7 @@ void init_lps3(struct lps *lps_ptr, FILE *in) {
                 fprintf(stderr, "Error reading bit_size from file at %d\n", i);
                 exit(EXIT_FAILURE);
             }
+            cr->run = 0;
     
             ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
             cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
@@ -70,6 +88,67 @@ void init_lps3(struct lps *lps_ptr, FILE *in) {
             }
         }
     }
+
+    TRACE_END(TRACE_INIT_LPS3, lps_ptr->size);
+}
+
+int read_core(struct core *cr, FILE *in) {
+    if (fread(&(cr->bit_size), sizeof(ubit_size), 1, in) != 1) {
+        return -1;
+    }
+    cr->run = 0;
+
+    ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+    cr->bit_rep = (ublock *)malloc(block_number * sizeof(ublock));
+    if (fread(cr->bit_rep, sizeof(ublock), block_number, in) != block_number ||
+        fread(&(cr->label), sizeof(ulabel), 1, in) != 1 ||
+        fread(&(cr->start), sizeof(uint64_t), 1, in) != 1 ||
+        fread(&(cr->end), sizeof(uint64_t), 1, in) != 1) {
+        free(cr->bit_rep);
+        cr->bit_rep = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int read_lps(struct lps *lps_ptr, FILE *in) {
+    unsigned char header[sizeof(int)];
+
+    lps_ptr->size = 0;
+    lps_ptr->cores = NULL;
+
+    // the stream ends either with eof or with the single `done` byte
+    size_t read = fread(header, 1, sizeof(int), in);
+    if (read == 0 || (read == 1 && header[0] == 0)) {
+        return 0;
+    }
+    if (read != sizeof(int)) {
+        fprintf(stderr, "Error reading level from file\n");
+        return -1;
+    }
+    memcpy(&(lps_ptr->level), header, sizeof(int));
+
+    int size;
+    if (fread(&size, sizeof(int), 1, in) != 1 || size < 0) {
+        fprintf(stderr, "Error reading size from file\n");
+        return -1;
+    }
+
+    if (size) {
+        lps_ptr->cores = (struct core *)malloc(size * sizeof(struct core));
+
+        for (int i = 0; i < size; i++) {
+            if (read_core(&(lps_ptr->cores[i]), in) < 0) {
+                fprintf(stderr, "Error reading core from file at %d\n", i);
+                free_lps(lps_ptr);
+                return -1;
+            }
+            lps_ptr->size++;
+        }
+    }
+
+    return 1;
 }
 
 void init_lps4(struct lps *lps_ptr, const char *str, int len, int lcp_level, int chunk_size) {
@@ -131,12 +210,12 @@ void init_lps4(struct lps *lps_ptr, const char *str, int len, int lcp_level, int
         
         // find next start point
         for(int i=str_index+str_len-1; str_index <= i; i--) {
-            if (alphabet[(unsigned char)*(str+i)] == -1) {
+            if (lcp_default_context.encode[(unsigned char)*(str+i)] == LCP_NO_CODE) {
                 str_index = i+1;
                 break;
             }
         }
-        if (alphabet[(unsigned char)*(str+str_index)] != -1) { // all of the characters are valid, so not valid cores found
+        if (lcp_default_context.encode[(unsigned char)*(str+str_index)] != LCP_NO_CODE) { // all of the characters are valid, so not valid cores found
             str_index += str_len;
         }
         
@@ -155,7 +234,28 @@ void free_lps(struct lps *lps_ptr) {
     lps_ptr->size = 0;
 }
 
+void write_core(const struct core *cr, FILE *out) {
+    fwrite(&(cr->bit_size), sizeof(ubit_size), 1, out);
+
+    ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+    if (cr->run) {
+        // run-length encoded cores are written expanded
+        for (ubit_size j = 0; j < block_number; j++) {
+            ublock block = core_block(cr, j);
+            fwrite(&block, sizeof(ublock), 1, out);
+        }
+    } else {
+        fwrite(cr->bit_rep, sizeof(ublock), block_number, out);
+    }
+
+    fwrite(&(cr->label), sizeof(ulabel), 1, out);
+    fwrite(&(cr->start), sizeof(uint64_t), 1, out);
+    fwrite(&(cr->end), sizeof(uint64_t), 1, out);
+}
+
 void write_lps(struct lps *lps_ptr, FILE *out) {
+    TRACE_BEGIN(TRACE_WRITE_LPS, lps_ptr->size);
+
     // write the level field
     fwrite(&(lps_ptr->level), sizeof(int), 1, out);
 
@@ -163,75 +263,134 @@ void write_lps(struct lps *lps_ptr, FILE *out) {
     fwrite(&(lps_ptr->size), sizeof(int), 1, out);
 
     // write each core object iteratively
-    if (lps_ptr->size) {
-        for (int i = 0; i < lps_ptr->size; i++) {
-            const struct core *cr = &(lps_ptr->cores[i]);
+    for (int i = 0; i < lps_ptr->size; i++) {
+        write_core(&(lps_ptr->cores[i]), out);
+    }
 
-            fwrite(&(cr->bit_size), sizeof(ubit_size), 1, out);
-            
-            ubit_size block_number = (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
-            fwrite(cr->bit_rep, sizeof(ublock), block_number, out);
-            
-            fwrite(&(cr->label), sizeof(ulabel), 1, out);
-            fwrite(&(cr->start), sizeof(uint64_t), 1, out);
-            fwrite(&(cr->end), sizeof(uint64_t), 1, out);
-        }
+    TRACE_END(TRACE_WRITE_LPS, lps_ptr->size);
+}
+
+struct quality_filter {
+    const char *seq;
+    const char *qual;
+    int64_t len;
+    char threshold;
+    int64_t cursor;
+};
+
+/**
+ * @brief Initializes a filter over the quality string `qual` of the sequence starting at `seq`.
+ * The cursor points at the next low quality base for forward scans, and at the
+ * previous one for backward scans.
+ */
+static void init_quality_filter(struct quality_filter *filter, const char *seq, const char *qual, int64_t len, int min_quality, int backward) {
+    filter->seq = seq;
+    filter->qual = qual;
+    filter->len = len;
+    filter->threshold = (char)(min_quality + QUALITY_OFFSET);
+    filter->cursor = backward ? len - 1 : 0;
+}
+
+/**
+ * @brief Checks whether a base in [lo, hi] has quality below the threshold. The lower
+ * ends of the queried intervals must be non-decreasing, so the cursor moves forward only.
+ */
+static inline int low_quality_forward(struct quality_filter *filter, int64_t lo, int64_t hi) {
+    while (filter->cursor < filter->len && (filter->cursor < lo || filter->threshold <= filter->qual[filter->cursor])) {
+        filter->cursor++;
     }
+    return filter->cursor <= hi;
 }
 
-int parse1(const char *begin, const char *end, struct core *cores, uint64_t offset) {
+/**
+ * @brief Same as `low_quality_forward`, for intervals with non-increasing upper ends.
+ */
+static inline int low_quality_backward(struct quality_filter *filter, int64_t lo, int64_t hi) {
+    while (0 <= filter->cursor && (hi < filter->cursor || filter->threshold <= filter->qual[filter->cursor])) {
+        filter->cursor--;
+    }
+    return lo <= filter->cursor;
+}
 
+/**
+ * @brief Creates a core with `init_core1_ctx` unless the filter rejects its span.
+ * @return 1 if the core is created, 0 otherwise.
+ */
+static inline int create_core1(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, struct quality_filter *filter, const struct lcp_context *ctx) {
+    if (filter && low_quality_forward(filter, begin - filter->seq, begin - filter->seq + distance - 1)) {
+        return 0;
+    }
+    init_core1_ctx(cr, begin, distance, start_index, end_index, ctx);
+    return 1;
+}
+
+/**
+ * @brief Creates a core with `init_core2_ctx` unless the filter rejects its span.
+ * @return 1 if the core is created, 0 otherwise.
+ */
+static inline int create_core2(struct core *cr, const char *begin, uint64_t distance, uint64_t start_index, uint64_t end_index, struct quality_filter *filter, const struct lcp_context *ctx) {
+    if (filter && low_quality_backward(filter, begin - filter->seq - distance + 1, begin - filter->seq)) {
+        return 0;
+    }
+    init_core2_ctx(cr, begin, distance, start_index, end_index, ctx);
+    return 1;
+}
+
+/**
+ * @brief Implementation of `parse1_ctx`, which drops the cores rejected by `filter` if it is not NULL.
+ */
+static int parse1_ext(const char *begin, const char *end, struct core *cores, uint64_t offset, struct quality_filter *filter, const struct lcp_context *ctx) {
+
+    const uint8_t *rank = ctx->rank;
     const char *it1 = begin;
     const char *it2 = end;
     int core_index = 0;
 
+    TRACE_BEGIN(TRACE_PARSE1, end - begin);
+
     // find lcp cores
     for (; it1 + 2 < end; it1++) {
 
         // skip invalid character
-        if (alphabet[(unsigned char)*it1] == alphabet[(unsigned char)*(it1+1)]) {
+        if (rank[(unsigned char)*it1] == rank[(unsigned char)*(it1+1)]) {
             continue;
         }
 
         // check for RINT core
-        if (alphabet[(unsigned char)*(it1+1)] == alphabet[(unsigned char)*(it1+2)]) {
+        if (rank[(unsigned char)*(it1+1)] == rank[(unsigned char)*(it1+2)]) {
 
             // count middle characters
             uint32_t middle_count = 1;
             const char *temp = it1 + 2;
-            while (temp < end && alphabet[(unsigned char)*(temp-1)] == alphabet[(unsigned char)*temp]) {
+            while (temp < end && rank[(unsigned char)*(temp-1)] == rank[(unsigned char)*temp]) {
                 temp++;
                 middle_count++;
             }
             if (temp != end) {
                 // check if there is any SSEQ cores left behind
                 if (it2 < it1) {
-                    init_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset);
-                    core_index++;
+                    core_index += create_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset, filter, ctx);
                 }
 
                 // create RINT core
                 it2 = it1 + 2 + middle_count;
-                init_core1(&(cores[core_index]), it1, it2-it1, it1-begin+offset, it2-begin+offset);
-                core_index++;
+                core_index += create_core1(&(cores[core_index]), it1, it2-it1, it1-begin+offset, it2-begin+offset, filter, ctx);
 
                 continue;
             }
         }
 
-        if (alphabet[(unsigned char)*it1] > alphabet[(unsigned char)*(it1+1)] &&
-            alphabet[(unsigned char)*(it1+1)] < alphabet[(unsigned char)*(it1+2)]) {
+        if (rank[(unsigned char)*it1] > rank[(unsigned char)*(it1+1)] &&
+            rank[(unsigned char)*(it1+1)] < rank[(unsigned char)*(it1+2)]) {
 
             // check if there is any SSEQ cores left behind
             if (it2 < it1) {
-                init_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset);
-                core_index++;
+                core_index += create_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset, filter, ctx);
             }
 
             // create LMIN core
             it2 = it1 + 3;
-            init_core1(&(cores[core_index]), it1, 3, it1-begin+offset, it2-begin+offset);
-            core_index++;
+            core_index += create_core1(&(cores[core_index]), it1, 3, it1-begin+offset, it2-begin+offset, filter, ctx);
 
             continue;
         }
@@ -242,82 +401,147 @@ int parse1(const char *begin, const char *end, struct core *cores, uint64_t offs
 
         // check for LMAX
         if (it1+3 < end &&
-            alphabet[(unsigned char)*it1] < alphabet[(unsigned char)*(it1+1)] &&
-            alphabet[(unsigned char)*(it1+1)] > alphabet[(unsigned char)*(it1+2)] &&
-            alphabet[(unsigned char)*(it1-1)] <= alphabet[(unsigned char)*(it1)] &&
-            alphabet[(unsigned char)*(it1+2)] >= alphabet[(unsigned char)*(it1+3)]) {
+            rank[(unsigned char)*it1] < rank[(unsigned char)*(it1+1)] &&
+            rank[(unsigned char)*(it1+1)] > rank[(unsigned char)*(it1+2)] &&
+            rank[(unsigned char)*(it1-1)] <= rank[(unsigned char)*(it1)] &&
+            rank[(unsigned char)*(it1+2)] >= rank[(unsigned char)*(it1+3)]) {
 
             // check if there is any SSEQ cores left behind
             if (it2 < it1) {
-                init_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset);
-                core_index++;
+                core_index += create_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset, filter, ctx);
             }
 
             // create LMAX core
             it2 = it1 + 3;
-            init_core1(&(cores[core_index]), it1, 3, it1-begin+offset, it2-begin+offset);
-            core_index++;
+            core_index += create_core1(&(cores[core_index]), it1, 3, it1-begin+offset, it2-begin+offset, filter, ctx);
 
             continue;
         }
     }
 
+    TRACE_END(TRACE_PARSE1, core_index);
+
     return core_index;
 }
 
-int parse2(const char *begin, const char *end, struct core *cores, uint64_t offset) {
+int parse1(const char *begin, const char *end, struct core *cores, uint64_t offset) {
+    return parse1_ext(begin, end, cores, offset, NULL, &lcp_default_context);
+}
+
+int parse1_ctx(const char *begin, const char *end, struct core *cores, uint64_t offset, const struct lcp_context *ctx) {
+    return parse1_ext(begin, end, cores, offset, NULL, ctx);
+}
+
+/**
+ * @brief Returns the first position in [pos, limit) whose bit in `bits` is 0, or
+ * `limit` if there is none.
+ */
+static inline int64_t next_zero(const uint64_t *bits, int64_t pos, int64_t limit) {
+    while (pos < limit) {
+        uint64_t word = ~bits[pos / 64] >> (pos % 64);
+        if (word) {
+            pos += __builtin_ctzll(word);
+            return pos < limit ? pos : limit;
+        }
+        pos += 64 - pos % 64;
+    }
+    return limit;
+}
+
+int parse_masks(const char *begin, const char *end, const uint64_t *starts, const uint64_t *eqs, struct core *cores, uint64_t offset) {
 
+    int64_t len = end - begin;
+    const char *it2 = end;
+    int core_index = 0;
+
+    for (int64_t w = 0; 64 * w < len; w++) {
+        uint64_t word = starts[w];
+
+        while (word) {
+            int64_t pos = 64 * w + __builtin_ctzll(word);
+            const char *it1 = begin + pos;
+            const char *core_end = it1 + 3;
+            word &= word - 1;
+
+            if ((eqs[(pos + 1) / 64] >> ((pos + 1) % 64)) & 1) {
+                // RINT core, unless the run reaches the end of the sequence
+                int64_t run_end = next_zero(eqs, pos + 2, len - 1);
+                if (run_end == len - 1) {
+                    continue;
+                }
+                core_end = begin + run_end + 2;
+            }
+
+            // check if there is any SSEQ cores left behind
+            if (it2 < it1) {
+                init_core1(&(cores[core_index]), it2-1, it1-it2+2, it2-begin-1+offset, it1-begin+1+offset);
+                core_index++;
+            }
+
+            it2 = core_end;
+            init_core1(&(cores[core_index]), it1, it2-it1, it1-begin+offset, it2-begin+offset);
+            core_index++;
+        }
+    }
+
+    return core_index;
+}
+
+/**
+ * @brief Implementation of `parse2_ctx`, which drops the cores rejected by `filter` if it is not NULL.
+ */
+static int parse2_ext(const char *begin, const char *end, struct core *cores, uint64_t offset, struct quality_filter *filter, const struct lcp_context *ctx) {
+
+    const uint8_t *rc_rank = ctx->rc_rank;
     const char *it1 = end - 1;
     const char *it2 = begin - 1;
     int core_index = 0;
 
+    TRACE_BEGIN(TRACE_PARSE2, end - begin);
+
     // find lcp cores
     for (; begin <= it1 - 2; it1--) {
 
         // skip invalid character
-        if (rc_alphabet[(unsigned char)*it1] == rc_alphabet[(unsigned char)*(it1-1)]) {
+        if (rc_rank[(unsigned char)*it1] == rc_rank[(unsigned char)*(it1-1)]) {
             continue;
         }
 
         // check for RINT core
-        if (rc_alphabet[(unsigned char)*(it1-1)] == rc_alphabet[(unsigned char)*(it1-2)]) {
+        if (rc_rank[(unsigned char)*(it1-1)] == rc_rank[(unsigned char)*(it1-2)]) {
 
             // count middle characters
             uint32_t middle_count = 1;
             const char *temp = it1 - 2;
-            while (begin <= temp && rc_alphabet[(unsigned char)*(temp+1)] == rc_alphabet[(unsigned char)*temp]) {
+            while (begin <= temp && rc_rank[(unsigned char)*(temp+1)] == rc_rank[(unsigned char)*temp]) {
                 temp--;
                 middle_count++;
             }
             if (begin <= temp) {
                 // check if there is any SSEQ cores left behind
                 if (it1 < it2) {
-                    init_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset);
-                    core_index++;
+                    core_index += create_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset, filter, ctx);
                 }
 
                 // create RINT core
                 it2 = it1 - 2 - middle_count;
-                init_core2(&(cores[core_index]), it1, 2+middle_count, end-it1-1+offset, end-it2-1+offset);
-                core_index++;
+                core_index += create_core2(&(cores[core_index]), it1, 2+middle_count, end-it1-1+offset, end-it2-1+offset, filter, ctx);
 
                 continue;
             }
         }
 
-        if (rc_alphabet[(unsigned char)*it1] > rc_alphabet[(unsigned char)*(it1-1)] &&
-            rc_alphabet[(unsigned char)*(it1-1)] < rc_alphabet[(unsigned char)*(it1-2)]) {
+        if (rc_rank[(unsigned char)*it1] > rc_rank[(unsigned char)*(it1-1)] &&
+            rc_rank[(unsigned char)*(it1-1)] < rc_rank[(unsigned char)*(it1-2)]) {
 
             // check if there is any SSEQ cores left behind
             if (it1 < it2) {
-                init_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset);
-                core_index++;
+                core_index += create_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset, filter, ctx);
             }
 
             // create LMIN core
             it2 = it1 - 3;
-            init_core2(&(cores[core_index]), it1, 3, end-it1-1+offset, end-it2-1+offset);
-            core_index++;
+            core_index += create_core2(&(cores[core_index]), it1, 3, end-it1-1+offset, end-it2-1+offset, filter, ctx);
 
             continue;
         }
@@ -328,35 +552,85 @@ int parse2(const char *begin, const char *end, struct core *cores, uint64_t offs
 
         // check for LMAX
         if (begin <= it1-3 &&
-            rc_alphabet[(unsigned char)*it1] < rc_alphabet[(unsigned char)*(it1-1)] &&
-            rc_alphabet[(unsigned char)*(it1-1)] > rc_alphabet[(unsigned char)*(it1-2)] &&
-            rc_alphabet[(unsigned char)*(it1+1)] <= rc_alphabet[(unsigned char)*(it1)] &&
-            rc_alphabet[(unsigned char)*(it1-2)] >= rc_alphabet[(unsigned char)*(it1-3)]) {
+            rc_rank[(unsigned char)*it1] < rc_rank[(unsigned char)*(it1-1)] &&
+            rc_rank[(unsigned char)*(it1-1)] > rc_rank[(unsigned char)*(it1-2)] &&
+            rc_rank[(unsigned char)*(it1+1)] <= rc_rank[(unsigned char)*(it1)] &&
+            rc_rank[(unsigned char)*(it1-2)] >= rc_rank[(unsigned char)*(it1-3)]) {
 
             // check if there is any SSEQ cores left behind
             if (it1 < it2) {
-                init_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset);
-                core_index++;
+                core_index += create_core2(&(cores[core_index]), it2+1, it2-it1+2, end-it2-1+offset, end-it1-1+offset, filter, ctx);
             }
 
             // create LMAX core
             it2 = it1 - 3;
-            init_core2(&(cores[core_index]), it1, 3, end-it1-1+offset, end-it2-1+offset);
-            core_index++;
+            core_index += create_core2(&(cores[core_index]), it1, 3, end-it1-1+offset, end-it2-1+offset, filter, ctx);
 
             continue;
         }
     }
 
+    TRACE_END(TRACE_PARSE2, core_index);
+
     return core_index;
 }
 
-int parse3(struct core *begin, struct core *end, struct core *cores) {
+int parse2(const char *begin, const char *end, struct core *cores, uint64_t offset) {
+    return parse2_ext(begin, end, cores, offset, NULL, &lcp_default_context);
+}
+
+int parse2_ctx(const char *begin, const char *end, struct core *cores, uint64_t offset, const struct lcp_context *ctx) {
+    return parse2_ext(begin, end, cores, offset, NULL, ctx);
+}
+
+void init_lps_qual(struct lps *lps_ptr, const char *str, const char *qual, int len, int min_quality) {
+    struct quality_filter filter;
+    init_quality_filter(&filter, str, qual, len, min_quality, 0);
+
+    lps_ptr->level = 1;
+    lps_ptr->size = 0;
+    lps_ptr->cores = (struct core *)malloc((len/CONSTANT_FACTOR)*sizeof(struct core));
+    lps_ptr->size = parse1_ext(str, str+len, lps_ptr->cores, 0, &filter, &lcp_default_context);
+}
+
+void init_lps2_qual(struct lps *lps_ptr, const char *str, const char *qual, int len, int min_quality) {
+    struct quality_filter filter;
+    init_quality_filter(&filter, str, qual, len, min_quality, 1);
+
+    lps_ptr->level = 1;
+    lps_ptr->size = 0;
+    lps_ptr->cores = (struct core *)malloc((len/CONSTANT_FACTOR)*sizeof(struct core));
+    lps_ptr->size = parse2_ext(str, str+len, lps_ptr->cores, 0, &filter, &lcp_default_context);
+}
+
+/**
+ * @brief Creates the core spanning `distance` cores starting at `begin` into `cores[core_index]`,
+ * storing its signatures first if requested, as the children may be overwritten by the new core.
+ */
+static inline void create_core3(struct core *cores, int core_index, struct core *begin, uint64_t distance, ulabel *sigs, struct lps_level *links) {
+    if (sigs) {
+        core_signatures(begin, distance, sigs + CORE_SIGNATURE_COUNT * core_index);
+    }
+    if (links) {
+        links->first_child[core_index] = begin - cores;
+        links->child_count[core_index] = distance;
+    }
+    init_core3(&(cores[core_index]), begin, distance);
+}
+
+/**
+ * @brief Implementation of `parse3`, which optionally stores the `CORE_SIGNATURE_COUNT`
+ * signatures of each new core into `sigs`, and the range of its children, as indices
+ * into `cores`, into the child links of `links`.
+ */
+static int parse3_ext(struct core *begin, struct core *end, struct core *cores, ulabel *sigs, struct lps_level *links) {
 
     struct core *it1 = begin;
     struct core *it2 = end;
     int core_index = 0;
 
+    TRACE_BEGIN(TRACE_PARSE3, end - begin);
+
     // find lcp cores
     for (; it1 + 2 < end; it1++) {
 
@@ -378,13 +652,13 @@ int parse3(struct core *begin, struct core *end, struct core *cores) {
             if (temp != end) {
                 // check if there is any SSEQ cores left behind
                 if (it2 < it1) {
-                    init_core3(&(cores[core_index]), it2-1, it1-it2+2);
+                    create_core3(cores, core_index, it2-1, it1-it2+2, sigs, links);
                     core_index++;
                 }
 
                 // create RINT core
                 it2 = it1 + 2 + middle_count;
-                init_core3(&(cores[core_index]), it1, it2-it1);
+                create_core3(cores, core_index, it1, it2-it1, sigs, links);
                 core_index++;
 
                 continue;
@@ -396,13 +670,13 @@ int parse3(struct core *begin, struct core *end, struct core *cores) {
             
             // check if there is any SSEQ cores left behind
             if (it2 < it1) {
-                init_core3(&(cores[core_index]), it2-1, it1-it2+2);
+                create_core3(cores, core_index, it2-1, it1-it2+2, sigs, links);
                 core_index++;
             }
 
             // create LMIN core
             it2 = it1 + 3;
-            init_core3(&(cores[core_index]), it1, it2-it1);
+            create_core3(cores, core_index, it1, it2-it1, sigs, links);
             core_index++;
 
             continue;
@@ -421,21 +695,28 @@ int parse3(struct core *begin, struct core *end, struct core *cores) {
 
             // check if there is any SSEQ cores left behind
             if (it2 < it1) {
-                init_core3(&(cores[core_index]), it2-1, it1-it2+2);
+                create_core3(cores, core_index, it2-1, it1-it2+2, sigs, links);
                 core_index++;
             }
 
             // create LMAX core
             it2 = it1 + 3;
-            init_core3(&(cores[core_index]), it1, it2-it1);
+            create_core3(cores, core_index, it1, it2-it1, sigs, links);
             core_index++;
 
             continue;
         }
     }
+
+    TRACE_END(TRACE_PARSE3, core_index);
+
     return core_index;
 }
 
+int parse3(struct core *begin, struct core *end, struct core *cores) {
+    return parse3_ext(begin, end, cores, NULL, NULL);
+}
+
 int64_t lps_memsize(const struct lps *lps_ptr) {
     uint64_t total = sizeof(struct lps);
     
@@ -461,8 +742,11 @@ int64_t lps_memsize(const struct lps *lps_ptr) {
  */
 int lcp_dct(struct lps *lps_ptr) {
 
+    TRACE_BEGIN(TRACE_DCT, lps_ptr->size);
+
     // at least 2 cores are needed for compression
     if (lps_ptr->size < DCT_ITERATION_COUNT + 1) {
+        TRACE_END(TRACE_DCT, 0);
         return -1;
     }
 
@@ -474,10 +758,48 @@ int lcp_dct(struct lps *lps_ptr) {
         }
     }
 
+    TRACE_END(TRACE_DCT, lps_ptr->size);
+
     return 0;
 }
 
-int lps_deepen1(struct lps *lps_ptr) {
+/**
+ * @brief Starts a level of a hierarchy from the cores of an `lps` object, copying their
+ * labels and positions if `keep` is nonzero.
+ */
+static void snapshot_level(struct lps_level *level, const struct lps *lps_ptr, int keep) {
+    level->size = lps_ptr->size;
+    level->labels = NULL;
+    level->starts = NULL;
+    level->ends = NULL;
+
+    if (!keep) {
+        return;
+    }
+
+    level->labels = (ulabel *)malloc((lps_ptr->size ? lps_ptr->size : 1) * sizeof(ulabel));
+    level->starts = (uint64_t *)malloc((lps_ptr->size ? lps_ptr->size : 1) * sizeof(uint64_t));
+    level->ends = (uint64_t *)malloc((lps_ptr->size ? lps_ptr->size : 1) * sizeof(uint64_t));
+
+    for (int i = 0; i < lps_ptr->size; i++) {
+        level->labels[i] = lps_ptr->cores[i].label;
+        level->starts[i] = lps_ptr->cores[i].start;
+        level->ends[i] = lps_ptr->cores[i].end;
+    }
+}
+
+/**
+ * @brief Implementation of `lps_deepen1`. If `sigs` is not NULL, the signatures of the
+ * new cores are stored into a newly allocated array assigned to `*sigs`. If `links` is
+ * not NULL, the new level, with the child links of its cores, is stored into it, and
+ * the labels and positions of the new cores as well if `keep` is nonzero.
+ */
+static int deepen1(struct lps *lps_ptr, ulabel **sigs, struct lps_level *links, int keep) {
+
+    if (links) {
+        links->first_child = (uint32_t *)malloc((lps_ptr->size ? lps_ptr->size : 1) * sizeof(uint32_t));
+        links->child_count = (uint32_t *)malloc((lps_ptr->size ? lps_ptr->size : 1) * sizeof(uint32_t));
+    }
 
     // compress cores
     if (lcp_dct(lps_ptr) < 0) {
@@ -486,11 +808,19 @@ int lps_deepen1(struct lps *lps_ptr) {
         }
         lps_ptr->size = 0;
         lps_ptr->level++;
+        if (links) {
+            snapshot_level(links, lps_ptr, keep);
+        }
         return 0;
     }
 
+    ulabel *new_sigs = NULL;
+    if (sigs) {
+        new_sigs = (ulabel *)malloc(CORE_SIGNATURE_COUNT * lps_ptr->size * sizeof(ulabel));
+    }
+
     // find new cores
-    int new_size = parse3(lps_ptr->cores + DCT_ITERATION_COUNT, lps_ptr->cores + lps_ptr->size, lps_ptr->cores);
+    int new_size = parse3_ext(lps_ptr->cores + DCT_ITERATION_COUNT, lps_ptr->cores + lps_ptr->size, lps_ptr->cores, new_sigs, links);
     int temp = new_size;
 
     // remove old cores
@@ -505,9 +835,34 @@ int lps_deepen1(struct lps *lps_ptr) {
     if (lps_ptr->size)
         lps_ptr->cores = (struct core*)realloc(lps_ptr->cores, lps_ptr->size * sizeof(struct core));
 
+    if (sigs) {
+        if (lps_ptr->size) {
+            new_sigs = (ulabel *)realloc(new_sigs, CORE_SIGNATURE_COUNT * lps_ptr->size * sizeof(ulabel));
+        } else {
+            free(new_sigs);
+            new_sigs = NULL;
+        }
+        *sigs = new_sigs;
+    }
+
+    if (links) {
+        snapshot_level(links, lps_ptr, keep);
+        if (lps_ptr->size) {
+            links->first_child = (uint32_t *)realloc(links->first_child, lps_ptr->size * sizeof(uint32_t));
+            links->child_count = (uint32_t *)realloc(links->child_count, lps_ptr->size * sizeof(uint32_t));
+        }
+    }
+
     return 1;
 }
 
+int lps_deepen1(struct lps *lps_ptr) {
+    TRACE_BEGIN(TRACE_DEEPEN1, lps_ptr->level);
+    int result = deepen1(lps_ptr, NULL, NULL, 0);
+    TRACE_END(TRACE_DEEPEN1, lps_ptr->size);
+    return result;
+}
+
 int lps_deepen(struct lps *lps_ptr, int lcp_level) {
 
     if (lcp_level <= lps_ptr->level)
@@ -519,6 +874,105 @@ int lps_deepen(struct lps *lps_ptr, int lcp_level) {
     return 1;
 }
 
+int lps_deepen_sigs(struct lps *lps_ptr, int lcp_level, ulabel **sigs) {
+
+    *sigs = NULL;
+
+    if (lcp_level <= lps_ptr->level)
+        return 0;
+
+    while (lps_ptr->level < lcp_level - 1 && lps_deepen1(lps_ptr))
+        ;
+
+    if (lps_ptr->level == lcp_level - 1)
+        deepen1(lps_ptr, sigs, NULL, 0);
+
+    return 1;
+}
+
+void init_lps_hierarchy(struct lps_hierarchy *h, const struct lps *lps_ptr, int keep_levels) {
+    h->first_level = lps_ptr->level;
+    h->level_count = 1;
+    h->keep_levels = keep_levels;
+    h->levels = (struct lps_level *)malloc(sizeof(struct lps_level));
+    snapshot_level(&(h->levels[0]), lps_ptr, 1);
+    h->levels[0].first_child = NULL;
+    h->levels[0].child_count = NULL;
+}
+
+void free_lps_hierarchy(struct lps_hierarchy *h) {
+    for (int i = 0; i < h->level_count; i++) {
+        free(h->levels[i].labels);
+        free(h->levels[i].starts);
+        free(h->levels[i].ends);
+        free(h->levels[i].first_child);
+        free(h->levels[i].child_count);
+    }
+    free(h->levels);
+    h->levels = NULL;
+    h->level_count = 0;
+}
+
+int lps_deepen_hierarchy(struct lps *lps_ptr, int lcp_level, struct lps_hierarchy *h) {
+
+    if (lcp_level <= lps_ptr->level || h->first_level + h->level_count - 1 != lps_ptr->level)
+        return 0;
+
+    int deepened = 1;
+    while (lps_ptr->level < lcp_level && deepened) {
+        h->levels = (struct lps_level *)realloc(h->levels, (h->level_count + 1) * sizeof(struct lps_level));
+        deepened = deepen1(lps_ptr, NULL, &(h->levels[h->level_count]), h->keep_levels);
+        h->level_count++;
+    }
+
+    return 1;
+}
+
+uint32_t lps_children(const struct lps_hierarchy *h, int level, uint32_t index, uint32_t *first) {
+    *first = 0;
+
+    if (level <= h->first_level || h->first_level + h->level_count <= level) {
+        return 0;
+    }
+
+    const struct lps_level *lvl = &(h->levels[level - h->first_level]);
+    if ((uint32_t)lvl->size <= index) {
+        return 0;
+    }
+
+    *first = lvl->first_child[index];
+    return lvl->child_count[index];
+}
+
+uint64_t lps_hierarchy_start(const struct lps_hierarchy *h, int level, uint32_t index) {
+    // a core starts with the core `DCT_ITERATION_COUNT` positions before its first child
+    for (int l = level - h->first_level; 0 < l; l--) {
+        index = h->levels[l].first_child[index] - DCT_ITERATION_COUNT;
+    }
+    return h->levels[0].starts[index];
+}
+
+uint64_t lps_hierarchy_end(const struct lps_hierarchy *h, int level, uint32_t index) {
+    // a core ends with its last child
+    for (int l = level - h->first_level; 0 < l; l--) {
+        index = h->levels[l].first_child[index] + h->levels[l].child_count[index] - 1;
+    }
+    return h->levels[0].ends[index];
+}
+
+uint64_t lps_hierarchy_memsize(const struct lps_hierarchy *h) {
+    uint64_t total = sizeof(struct lps_hierarchy) + h->level_count * sizeof(struct lps_level);
+    for (int i = 0; i < h->level_count; i++) {
+        if (h->levels[i].labels) {
+            total += h->levels[i].size * (sizeof(ulabel) + 2 * sizeof(uint64_t));
+        }
+        if (h->levels[i].first_child) {
+            total += h->levels[i].size * 2 * sizeof(uint32_t);
+        }
+    }
+    return total;
+}
+
 void print_lps(const struct lps *lps_ptr) {
     printf("Level: %d \n", lps_ptr->level);
     for(int i=0; i<lps_ptr->size; i++) {
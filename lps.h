@@ -17,6 +17,7 @@
  * - Performing multi-level compression of LCP cores (deepening).
  * - Saving and loading LCP cores from files.
  * - Calculating memory usage of the constructed LCP structure.
+ * - Optionally keeping the cores of every level with links to their children.
  *
  * Dependencies:
  * - Requires core.h, encoding.h, hash.h, and constant.h for auxiliary data structures and utilities.
@@ -36,6 +37,8 @@
  *
  * @namespace lcp
  * @struct lps
+ * @struct lps_level
+ * @struct lps_hierarchy
  *
  * @note Destructor handles clean-up of allocated memory for cores.
  *
@@ -58,6 +61,7 @@ extern "C" {
 #include <math.h>
 
 #define CONSTANT_FACTOR         1.5
+#define QUALITY_OFFSET          33
 
 struct lps {
     int level;
@@ -65,6 +69,22 @@ struct lps {
     struct core *cores;
 };
 
+struct lps_level {
+    int size;
+    ulabel *labels;
+    uint64_t *starts;
+    uint64_t *ends;
+    uint32_t *first_child;
+    uint32_t *child_count;
+};
+
+struct lps_hierarchy {
+    int first_level;
+    int level_count;
+    int keep_levels;
+    struct lps_level *levels;
+};
+
 /**
  * @brief Constructs an lps object from a string.
  * 
@@ -93,6 +113,59 @@ void init_lps_offset(struct lps *lps_ptr, const char *str, int len, uint64_t off
  * @param len The length of the string to be parsed.
  */
 void init_lps2(struct lps *lps_ptr, const char *str, int len);
+
+/**
+ * @brief Constructs an lps object from a string, encoding it with the given context
+ * instead of the default one.
+ *
+ * Deepening does not depend on the alphabet, so the object is deepened with
+ * `lps_deepen` as usual.
+ *
+ * @param lps_ptr The `lps` object that will be initialized
+ * @param str The input string to be parsed.
+ * @param len The length of the string to be parsed.
+ * @param ctx The encoding context.
+ */
+void init_lps_ctx(struct lps *lps_ptr, const char *str, int len, const struct lcp_context *ctx);
+
+/**
+ * @brief Same as `init_lps_ctx`, with reverse complement transformation.
+ *
+ * @param lps_ptr The `lps` object that will be initialized
+ * @param str The input string to be parsed.
+ * @param len The length of the string to be parsed.
+ * @param ctx The encoding context.
+ */
+void init_lps2_ctx(struct lps *lps_ptr, const char *str, int len, const struct lcp_context *ctx);
+
+/**
+ * @brief Constructs an lps object from a FASTQ read, dropping the cores whose span
+ * contains a base with quality below `min_quality`.
+ *
+ * Qualities are checked while the cores are found, so no extra pass over the read
+ * is made and the dropped cores never reach deepening or lookups. The remaining
+ * cores are identical to the ones created by `init_lps`.
+ *
+ * @param lps_ptr The `lps` object that will be initialized
+ * @param str The input string to be parsed.
+ * @param qual The quality string of the read, Phred+33 encoded (`QUALITY_OFFSET`).
+ * @param len The length of the string to be parsed.
+ * @param min_quality Minimum Phred quality a base must have to be part of a core.
+ */
+void init_lps_qual(struct lps *lps_ptr, const char *str, const char *qual, int len, int min_quality);
+
+/**
+ * @brief Constructs an lps object from a FASTQ read with reverse complement
+ * transformation, dropping the cores whose span contains a low quality base.
+ *
+ * @param lps_ptr The `lps` object that will be initialized
+ * @param str The input string to be parsed.
+ * @param qual The quality string of the read, Phred+33 encoded (`QUALITY_OFFSET`).
+ * @param len The length of the string to be parsed.
+ * @param min_quality Minimum Phred quality a base must have to be part of a core.
+ */
+void init_lps2_qual(struct lps *lps_ptr, const char *str, const char *qual, int len, int min_quality);
+
 /**
  * @brief Initializes an lps object by reading its contents from a binary file.
  *
@@ -110,6 +183,31 @@ void init_lps2(struct lps *lps_ptr, const char *str, int len);
  */
 void init_lps3(struct lps *lps_ptr, FILE *in);
 
+/**
+ * @brief Reads a single core written by `write_core` from a binary stream.
+ *
+ * @param cr The core that will be initialized.
+ * @param in File pointer to the binary stream.
+ * @return 0 if the core is read, -1 otherwise. On failure no memory is left allocated.
+ */
+int read_core(struct core *cr, FILE *in);
+
+/**
+ * @brief Reads the next lps object from a binary stream written by `write_lps`.
+ *
+ * Unlike `init_lps3`, this function does not terminate the program on a malformed
+ * stream and it recognizes the end of a `.lcpt` stream, which is either the end of
+ * the file or the single zero byte written after the last record. It is intended
+ * for iterating over all records of a file.
+ *
+ * @param lps_ptr The `lps` object that will be initialized
+ * @param in File pointer to the binary file containing the serialized lps data.
+ * @return 1 if a record is read, 0 if the end of the stream is reached, -1 on error.
+ *
+ * @note On success, the caller is responsible for freeing the object with `free_lps`.
+ */
+int read_lps(struct lps *lps_ptr, FILE *in);
+
 /**
  * @brief Constructs an lps object from a string, using split and merge paradigm.
  * The give string will be roughly split into the length of `chunk_size`
@@ -127,6 +225,16 @@ void init_lps4(struct lps *lps_ptr, const char *str, int len, int lcp_level, int
  */
 void free_lps(struct lps *lps_ptr);
 
+/**
+ * @brief Writes a single core to a binary stream in the layout used by `write_lps`.
+ *
+ * Run-length encoded cores are written with their expanded bit representation.
+ *
+ * @param cr The core to be written.
+ * @param out File pointer to the binary stream.
+ */
+void write_core(const struct core *cr, FILE *out);
+
 /**
  * @brief Serializes and writes an lps object to a binary file.
  *
@@ -160,6 +268,19 @@ void write_lps(struct lps *lps_ptr, FILE *out);
  */
 int parse1(const char *begin, const char *end, struct core *cores, uint64_t offset);
 
+/**
+ * @brief Same as `parse1`, but compares and encodes the characters with the given
+ * context instead of the default one.
+ *
+ * @param begin Iterator pointing to the beginning of the sequence to parse.
+ * @param end Iterator pointing to the end of the sequence to parse.
+ * @param cores Pointer to a array where the identified LCP cores will be stored.
+ * @param offset The distance measure where the indecies of the core will be shifted by.
+ * @param ctx The encoding context.
+ * @return Size of the cores identified in the given string.
+ */
+int parse1_ctx(const char *begin, const char *end, struct core *cores, uint64_t offset, const struct lcp_context *ctx);
+
 /**
  * @brief Parses a sequence to extract Locally Consisted Parsing (LCP) cores and stores them in a 
  * array of cores using complement alphabet.
@@ -177,6 +298,44 @@ int parse1(const char *begin, const char *end, struct core *cores, uint64_t offs
  */
 int parse2(const char *begin, const char *end, struct core *cores, uint64_t offset);
 
+/**
+ * @brief Same as `parse2`, but compares and encodes the characters with the given
+ * context instead of the default one.
+ *
+ * @param begin Iterator pointing to the beginning of the sequence to parse.
+ * @param end Iterator pointing to the end of the sequence to parse.
+ * @param cores Pointer to a array where the identified LCP cores will be stored.
+ * @param offset The distance measure where the indecies of the core will be shifted by.
+ * @param ctx The encoding context.
+ * @return Size of the cores identified in the given string.
+ */
+int parse2_ctx(const char *begin, const char *end, struct core *cores, uint64_t offset, const struct lcp_context *ctx);
+
+/**
+ * @brief Creates the cores of a sequence from precomputed predicate bitsets, producing
+ * the same cores as `parse1`.
+ *
+ * With `a[i]` denoting `alphabet[begin[i]]`, `n` the length of the sequence and
+ * `eq(i)`, `lt(i)`, `gt(i)` denoting `a[i] == a[i+1]`, `a[i] < a[i+1]` and `a[i] > a[i+1]`,
+ * bit `i` of `eqs` must be `eq(i)` for `i < n - 1`, and bit `i` of `starts` must be set
+ * for `i < n - 2` if and only if `!eq(i)` and one of the following holds:
+ * - `eq(i+1)`, i.e. a RINT core may start at `i`,
+ * - `gt(i) && lt(i+1)`, i.e. an LMIN core starts at `i`,
+ * - `0 < i && i + 3 < n && lt(i) && gt(i+1) && !gt(i-1) && !lt(i+2)`, i.e. an LMAX
+ * core starts at `i`.
+ * The remaining bits must be 0. This allows the predicates to be computed for many
+ * positions, or many sequences, at once.
+ *
+ * @param begin Iterator pointing to the beginning of the sequence to parse.
+ * @param end Iterator pointing to the end of the sequence to parse.
+ * @param starts Bitset of the positions where a core may start, 64 positions per word.
+ * @param eqs Bitset of the positions equal to their successor, 64 positions per word.
+ * @param cores Pointer to a array where the identified LCP cores will be stored.
+ * @param offset The distance measure where the indecies of the core will be shifted by.
+ * @return Size of the cores identified in the given string.
+ */
+int parse_masks(const char *begin, const char *end, const uint64_t *starts, const uint64_t *eqs, struct core *cores, uint64_t offset);
+
 /**
  * @brief Parses a array of cores to extract Locally Consisted Parsing (LCP) cores and stores them in a 
  * array of cores.
@@ -218,6 +377,108 @@ int lps_deepen1(struct lps *lps_ptr);
  */
 int lps_deepen(struct lps *lps_ptr, int lcp_level);
 
+/**
+ * @brief Deepens the LCP structure to a specific level, and computes the error-tolerant
+ * signatures of the cores at that level.
+ *
+ * For each core of the final level, `CORE_SIGNATURE_COUNT` signatures are stored
+ * consecutively (see `core_signatures`). A core built from children of which only one
+ * differs from another core's children shares at least one signature with it, which
+ * allows matching cores affected by a single sequencing error.
+ *
+ * @param lps_ptr The `lps` object that will be parsed over.
+ * @param lcp_level The target compression level to deepen to.
+ * @param sigs Pointer where the newly allocated array of `CORE_SIGNATURE_COUNT * size`
+ *             signatures will be stored. It is set to NULL if no core remains.
+ *             The caller is responsible for freeing it.
+ * @return 1 if deepening was successful, 0 otherwise.
+ */
+int lps_deepen_sigs(struct lps *lps_ptr, int lcp_level, ulabel **sigs);
+
+/**
+ * @brief Starts a core hierarchy from the current level of an `lps` object.
+ *
+ * A hierarchy keeps the labels and positions of the cores of its first level, and
+ * child links for every level that `lps_deepen_hierarchy` goes through: each core
+ * above the first level stores the index of its first child and its number of
+ * children in the level below, i.e. the cores it was built from by `init_core3`.
+ * This allows descending from a core of a high level to its lower-level cores in
+ * constant time, without parsing the region again.
+ *
+ * The children of a core are consecutive, and consecutive cores may share boundary
+ * children. A core ends where its last child ends, and starts where the core
+ * `DCT_ITERATION_COUNT` positions before its first child starts, so the positions
+ * of the cores of every level are recovered from the first level by
+ * `lps_hierarchy_start` and `lps_hierarchy_end`.
+ *
+ * The links take 8 bytes per core of each level above the first. If `keep_levels`
+ * is nonzero, the labels, starts and ends of the cores of every level are kept as
+ * well, which takes another 20 bytes per core of each level; otherwise they are
+ * NULL above the first level.
+ *
+ * @param h Pointer to the hierarchy to initialize.
+ * @param lps_ptr The `lps` object, whose cores form the first level.
+ * @param keep_levels If nonzero, the labels and positions of all levels are kept.
+ */
+void init_lps_hierarchy(struct lps_hierarchy *h, const struct lps *lps_ptr, int keep_levels);
+
+/**
+ * @brief Frees the memory allocated for the hierarchy.
+ *
+ * @param h Pointer to the hierarchy to deallocate.
+ */
+void free_lps_hierarchy(struct lps_hierarchy *h);
+
+/**
+ * @brief Deepens an `lps` object like `lps_deepen`, appending each new level to the
+ * hierarchy.
+ *
+ * @param lps_ptr The `lps` object that will be parsed over.
+ * @param lcp_level The target compression level to deepen to.
+ * @param h The hierarchy, whose last level must be the current level of `lps_ptr`.
+ * @return 1 if deepening was successful, 0 otherwise.
+ */
+int lps_deepen_hierarchy(struct lps *lps_ptr, int lcp_level, struct lps_hierarchy *h);
+
+/**
+ * @brief Returns the children of a core in constant time.
+ *
+ * @param h The hierarchy.
+ * @param level The level of the core, above the first level of the hierarchy.
+ * @param index The index of the core in its level.
+ * @param first Pointer where the index of the first child in the level below will be stored.
+ * @return The number of children, or 0 if there is no such core.
+ */
+uint32_t lps_children(const struct lps_hierarchy *h, int level, uint32_t index, uint32_t *first);
+
+/**
+ * @brief Returns the start of a core by descending to the first level.
+ *
+ * @param h The hierarchy.
+ * @param level The level of the core.
+ * @param index The index of the core in its level, which must exist.
+ * @return The start of the core.
+ */
+uint64_t lps_hierarchy_start(const struct lps_hierarchy *h, int level, uint32_t index);
+
+/**
+ * @brief Returns the end of a core by descending to the first level.
+ *
+ * @param h The hierarchy.
+ * @param level The level of the core.
+ * @param index The index of the core in its level, which must exist.
+ * @return The end of the core.
+ */
+uint64_t lps_hierarchy_end(const struct lps_hierarchy *h, int level, uint32_t index);
+
+/**
+ * @brief Calculates the memory size used by the hierarchy.
+ *
+ * @param h The hierarchy.
+ * @return The memory size in bytes.
+ */
+uint64_t lps_hierarchy_memsize(const struct lps_hierarchy *h);
+
 /**
  * @brief Outputs the representation of a `lcp` pointer.
  *
@@ -0,0 +1,419 @@
+/**
+ * @file map.c
+ * @brief Implementation of single and paired-end seeding and chaining.
+ *
+ * Seeds with at most `MAP_MAX_OCCURRENCE` entries are expanded into (record,
+ * diagonal) hits, which are sorted and split into chains wherever the record
+ * changes or two consecutive diagonals are more than `MAP_DIAGONAL_TOLERANCE`
+ * apart. Window searches binary search the entries of every seed of a mate for the
+ * diagonals inside the window, so their cost does not depend on the number of
+ * occurrences of the seeds.
+ */
+
+#include "map.h"
+#include "pool.h"
+
+struct map_hit {
+    uint32_t record;
+    int64_t diagonal;
+};
+
+struct mate_seeds {
+    const struct lps *read;
+    ulabel *labels;
+    struct index_span *spans;
+    int capacity;
+    struct map_chain *chains;
+    uint64_t chain_count;
+    uint64_t chain_capacity;
+};
+
+struct map_buffer {
+    struct mate_seeds mates[2];
+    struct map_hit *hits;
+    uint64_t hit_capacity;
+};
+
+struct map_context {
+    const struct lcp_index *index;
+    const char **mates1;
+    const int *lengths1;
+    const char **mates2;
+    const int *lengths2;
+    int count;
+    int lcp_level;
+    int64_t min_insert;
+    int64_t max_insert;
+    struct map_pair *results;
+    struct map_read *read_results;
+    int next_task;
+    int success_count; // proper pairs or reads with a chain
+};
+
+struct map_worker {
+    struct map_context *ctx;
+    struct map_buffer buf;
+};
+
+void init_read_pair(struct read_pair *pair, const char *mate1, int len1, const char *mate2, int len2, int lcp_level) {
+    init_lps(&(pair->mate1), mate1, len1);
+    lps_deepen(&(pair->mate1), lcp_level);
+    init_lps2(&(pair->mate2), mate2, len2);
+    lps_deepen(&(pair->mate2), lcp_level);
+}
+
+void free_read_pair(struct read_pair *pair) {
+    free_lps(&(pair->mate1));
+    free_lps(&(pair->mate2));
+}
+
+static void init_map_buffer(struct map_buffer *buf) {
+    memset(buf, 0, sizeof(struct map_buffer));
+}
+
+static void free_map_buffer(struct map_buffer *buf) {
+    for (int m = 0; m < 2; m++) {
+        free(buf->mates[m].labels);
+        free(buf->mates[m].spans);
+        free(buf->mates[m].chains);
+    }
+    free(buf->hits);
+}
+
+static int hit_cmp(const void *lhs, const void *rhs) {
+    const struct map_hit *a = (const struct map_hit *)lhs;
+    const struct map_hit *b = (const struct map_hit *)rhs;
+    if (a->record != b->record) {
+        return a->record < b->record ? -1 : 1;
+    }
+    return (a->diagonal > b->diagonal) - (a->diagonal < b->diagonal);
+}
+
+/**
+ * @brief Looks up the labels of all cores of a read with a single batched lookup.
+ */
+static void lookup_seeds(const struct lcp_index *index, struct mate_seeds *seeds, const struct lps *read) {
+    if (seeds->capacity < read->size) {
+        seeds->capacity = read->size;
+        seeds->labels = (ulabel *)realloc(seeds->labels, seeds->capacity * sizeof(ulabel));
+        seeds->spans = (struct index_span *)realloc(seeds->spans, seeds->capacity * sizeof(struct index_span));
+    }
+
+    for (int i = 0; i < read->size; i++) {
+        seeds->labels[i] = read->cores[i].label;
+    }
+
+    seeds->read = read;
+    index_lookup_batch(index, seeds->labels, read->size, seeds->spans);
+}
+
+static void push_chain(struct mate_seeds *seeds, uint32_t record, int64_t position, uint32_t score) {
+    if (seeds->chain_count == seeds->chain_capacity) {
+        seeds->chain_capacity = seeds->chain_capacity ? 2 * seeds->chain_capacity : 64;
+        seeds->chains = (struct map_chain *)realloc(seeds->chains, seeds->chain_capacity * sizeof(struct map_chain));
+    }
+
+    struct map_chain *chain = &(seeds->chains[seeds->chain_count++]);
+    chain->record = record;
+    chain->position = position;
+    chain->score = score;
+}
+
+/**
+ * @brief Expands the non-repetitive seeds of a mate into hits and chains them. The
+ * chains are sorted by record and position.
+ */
+static void build_chains(struct map_buffer *buf, struct mate_seeds *seeds) {
+    uint64_t hit_count = 0;
+
+    for (int i = 0; i < seeds->read->size; i++) {
+        if (MAP_MAX_OCCURRENCE < seeds->spans[i].size) {
+            continue;
+        }
+        if (buf->hit_capacity < hit_count + seeds->spans[i].size) {
+            buf->hit_capacity = maximum(2 * buf->hit_capacity, hit_count + seeds->spans[i].size);
+            buf->hits = (struct map_hit *)realloc(buf->hits, buf->hit_capacity * sizeof(struct map_hit));
+        }
+        for (uint32_t j = 0; j < seeds->spans[i].size; j++) {
+            buf->hits[hit_count].record = seeds->spans[i].entries[j].record;
+            buf->hits[hit_count].diagonal = (int64_t)seeds->spans[i].entries[j].position - (int64_t)seeds->read->cores[i].start;
+            hit_count++;
+        }
+    }
+
+    qsort(buf->hits, hit_count, sizeof(struct map_hit), hit_cmp);
+
+    seeds->chain_count = 0;
+    uint64_t first = 0;
+
+    for (uint64_t i = 1; i <= hit_count; i++) {
+        if (i == hit_count || buf->hits[i].record != buf->hits[i-1].record ||
+            MAP_DIAGONAL_TOLERANCE < buf->hits[i].diagonal - buf->hits[i-1].diagonal) {
+            push_chain(seeds, buf->hits[first].record, buf->hits[(first + i - 1) / 2].diagonal, i - first);
+            first = i;
+        }
+    }
+}
+
+/**
+ * @brief Returns the best chain of a mate, or a chain with score 0 if there is none.
+ */
+static struct map_chain best_chain(const struct mate_seeds *seeds) {
+    struct map_chain best = {0, 0, 0};
+    for (uint64_t i = 0; i < seeds->chain_count; i++) {
+        if (best.score < seeds->chains[i].score) {
+            best = seeds->chains[i];
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Returns the index of the first entry of the span not less than (record, position).
+ */
+static uint32_t lower_bound_entry(const struct index_span *span, uint32_t record, int64_t position) {
+    uint32_t lo = 0, hi = span->size;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const struct index_entry *entry = &(span->entries[mid]);
+        if (entry->record < record || (entry->record == record && (int64_t)entry->position < position)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Counts the seeds of a mate with an entry on the given record whose diagonal
+ * lies in [lo, hi], including repetitive seeds.
+ */
+static struct map_chain window_chain(const struct mate_seeds *seeds, uint32_t record, int64_t lo, int64_t hi) {
+    struct map_chain chain = {record, 0, 0};
+
+    for (int i = 0; i < seeds->read->size; i++) {
+        const struct index_span *span = &(seeds->spans[i]);
+        int64_t start = seeds->read->cores[i].start;
+        uint32_t j = lower_bound_entry(span, record, lo + start);
+
+        if (j < span->size && span->entries[j].record == record && (int64_t)span->entries[j].position <= hi + start) {
+            if (chain.score == 0) {
+                chain.position = (int64_t)span->entries[j].position - start;
+            }
+            chain.score++;
+        }
+    }
+
+    return chain;
+}
+
+/**
+ * @brief Returns the best chain of a mate on the given record within [lo, hi].
+ */
+static struct map_chain partner_chain(const struct mate_seeds *seeds, uint32_t record, int64_t lo, int64_t hi) {
+    struct map_chain best = {record, 0, 0};
+
+    // chains are sorted by record and position
+    uint64_t l = 0, h = seeds->chain_count;
+    while (l < h) {
+        uint64_t mid = l + (h - l) / 2;
+        const struct map_chain *chain = &(seeds->chains[mid]);
+        if (chain->record < record || (chain->record == record && chain->position < lo)) {
+            l = mid + 1;
+        } else {
+            h = mid;
+        }
+    }
+
+    for (; l < seeds->chain_count && seeds->chains[l].record == record && seeds->chains[l].position <= hi; l++) {
+        if (best.score < seeds->chains[l].score) {
+            best = seeds->chains[l];
+        }
+    }
+
+    return best;
+}
+
+static void consider(struct map_pair *best, struct map_chain mate1, struct map_chain mate2) {
+    if (!best->proper || best->mate1.score + best->mate2.score < mate1.score + mate2.score) {
+        best->mate1 = mate1;
+        best->mate2 = mate2;
+        best->proper = 1;
+    }
+}
+
+static int map_pair_buffered(struct map_buffer *buf, const struct lcp_index *index, const struct read_pair *pair, int len2,
+                             int64_t min_insert, int64_t max_insert, struct map_pair *result) {
+
+    struct mate_seeds *seeds1 = &(buf->mates[0]), *seeds2 = &(buf->mates[1]);
+
+    lookup_seeds(index, seeds1, &(pair->mate1));
+    lookup_seeds(index, seeds2, &(pair->mate2));
+    build_chains(buf, seeds1);
+    build_chains(buf, seeds2);
+
+    result->proper = 0;
+
+    // pair the chains of the first mate, rescuing the second mate if needed
+    for (uint64_t i = 0; i < seeds1->chain_count; i++) {
+        struct map_chain chain1 = seeds1->chains[i];
+        int64_t lo = chain1.position + min_insert - len2;
+        int64_t hi = chain1.position + max_insert - len2;
+
+        struct map_chain chain2 = partner_chain(seeds2, chain1.record, lo, hi);
+        if (!chain2.score) {
+            chain2 = window_chain(seeds2, chain1.record, lo - MAP_DIAGONAL_TOLERANCE, hi + MAP_DIAGONAL_TOLERANCE);
+        }
+        if (chain2.score) {
+            consider(result, chain1, chain2);
+        }
+    }
+
+    // rescue the first mate of the chains of the second mate without partner
+    for (uint64_t i = 0; i < seeds2->chain_count; i++) {
+        struct map_chain chain2 = seeds2->chains[i];
+        int64_t lo = chain2.position + len2 - max_insert;
+        int64_t hi = chain2.position + len2 - min_insert;
+
+        if (partner_chain(seeds1, chain2.record, lo, hi).score) {
+            continue;
+        }
+
+        struct map_chain chain1 = window_chain(seeds1, chain2.record, lo - MAP_DIAGONAL_TOLERANCE, hi + MAP_DIAGONAL_TOLERANCE);
+        if (chain1.score) {
+            consider(result, chain1, chain2);
+        }
+    }
+
+    if (!result->proper) {
+        result->mate1 = best_chain(seeds1);
+        result->mate2 = best_chain(seeds2);
+    }
+
+    return result->proper;
+}
+
+int map_single(const struct lcp_index *index, const struct lps *read, struct map_chain *chain) {
+    struct map_buffer buf;
+    init_map_buffer(&buf);
+
+    lookup_seeds(index, &(buf.mates[0]), read);
+    build_chains(&buf, &(buf.mates[0]));
+    *chain = best_chain(&(buf.mates[0]));
+
+    free_map_buffer(&buf);
+
+    return chain->score != 0;
+}
+
+int map_pair(const struct lcp_index *index, const struct read_pair *pair, int len2, int64_t min_insert, int64_t max_insert, struct map_pair *result) {
+    struct map_buffer buf;
+    init_map_buffer(&buf);
+
+    int proper = map_pair_buffered(&buf, index, pair, len2, min_insert, max_insert, result);
+
+    free_map_buffer(&buf);
+
+    return proper;
+}
+
+static void *map_work(void *arg) {
+    struct map_worker *worker = (struct map_worker *)arg;
+    struct map_context *ctx = worker->ctx;
+    int task;
+
+    while ((task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * MAP_TASK_SIZE < ctx->count) {
+        int proper_count = 0;
+
+        for (int i = task * MAP_TASK_SIZE; i < minimum(ctx->count, (task + 1) * MAP_TASK_SIZE); i++) {
+            struct read_pair pair;
+            init_read_pair(&pair, ctx->mates1[i], ctx->lengths1[i], ctx->mates2[i], ctx->lengths2[i], ctx->lcp_level);
+            proper_count += map_pair_buffered(&(worker->buf), ctx->index, &pair, ctx->lengths2[i], ctx->min_insert, ctx->max_insert, &(ctx->results[i]));
+            free_read_pair(&pair);
+        }
+
+        __atomic_fetch_add(&(ctx->success_count), proper_count, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static void *map_read_work(void *arg) {
+    struct map_worker *worker = (struct map_worker *)arg;
+    struct map_context *ctx = worker->ctx;
+    struct mate_seeds *forward = &(worker->buf.mates[0]), *reverse = &(worker->buf.mates[1]);
+    int task;
+
+    while ((task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * MAP_TASK_SIZE < ctx->count) {
+        int mapped_count = 0;
+
+        for (int i = task * MAP_TASK_SIZE; i < minimum(ctx->count, (task + 1) * MAP_TASK_SIZE); i++) {
+            // the second mate of a pair is parsed in reverse complement
+            struct read_pair strands;
+            init_read_pair(&strands, ctx->mates1[i], ctx->lengths1[i], ctx->mates1[i], ctx->lengths1[i], ctx->lcp_level);
+
+            lookup_seeds(ctx->index, forward, &(strands.mate1));
+            lookup_seeds(ctx->index, reverse, &(strands.mate2));
+            build_chains(&(worker->buf), forward);
+            build_chains(&(worker->buf), reverse);
+
+            struct map_read *result = &(ctx->read_results[i]);
+            struct map_chain chain = best_chain(reverse);
+            result->chain = best_chain(forward);
+            result->reverse = result->chain.score < chain.score;
+            if (result->reverse) {
+                result->chain = chain;
+            }
+            mapped_count += result->chain.score != 0;
+
+            free_read_pair(&strands);
+        }
+
+        __atomic_fetch_add(&(ctx->success_count), mapped_count, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs `fn` on `thread_count` workers sharing the context, the first one on
+ * the calling thread.
+ */
+static void run_map_workers(void *(*fn)(void *), struct map_context *ctx, int thread_count) {
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    struct map_worker *workers = (struct map_worker *)malloc(thread_count * sizeof(struct map_worker));
+
+    for (int t = 0; t < thread_count; t++) {
+        workers[t].ctx = ctx;
+        init_map_buffer(&(workers[t].buf));
+    }
+
+    run_pool(fn, workers, sizeof(struct map_worker), thread_count);
+
+    for (int t = 0; t < thread_count; t++) {
+        free_map_buffer(&(workers[t].buf));
+    }
+    free(workers);
+}
+
+int map_reads(const struct lcp_index *index, const char **reads, const int *lengths, int count, int lcp_level,
+              struct map_read *results, int thread_count) {
+
+    struct map_context ctx = {index, reads, lengths, NULL, NULL, count, lcp_level, 0, 0, NULL, results, 0, 0};
+    run_map_workers(map_read_work, &ctx, thread_count);
+
+    return ctx.success_count;
+}
+
+int map_pairs(const struct lcp_index *index, const char **mates1, const int *lengths1, const char **mates2, const int *lengths2, int count,
+              int lcp_level, int64_t min_insert, int64_t max_insert, struct map_pair *results, int thread_count) {
+
+    struct map_context ctx = {index, mates1, lengths1, mates2, lengths2, count, lcp_level, min_insert, max_insert, results, NULL, 0, 0};
+    run_map_workers(map_work, &ctx, thread_count);
+
+    return ctx.success_count;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file map.h
+ * @brief Seeding and chaining of single and paired-end reads against a label index.
+ *
+ * The cores of a read are used as seeds: each entry of the index sharing the label
+ * of a core votes for the reference diagonal, i.e. the reference position of the
+ * first base of the read. Votes on the same record within `MAP_DIAGONAL_TOLERANCE`
+ * bases are chained together, and the chain with the most votes is reported.
+ *
+ * Paired-end reads are expected in forward-reverse orientation. The first mate is
+ * parsed as is and the second one in reverse complement with `init_lps2`, so the
+ * cores of both mates are compared with the forward strand of the reference. The
+ * chains of the two mates are then paired under the insert size constraint:
+ * - Seeds occurring more than `MAP_MAX_OCCURRENCE` times are not expanded; they are
+ * only searched inside the windows implied by the chains of the other mate, with a
+ * binary search over their entries.
+ * - A chain without a partner chain within the insert size range is rescued by
+ * searching the seeds of the other mate inside its window.
+ * Candidates outside the insert size range are pruned without looking at the
+ * entries of repetitive seeds.
+ *
+ * Pairs from the reverse strand of the fragment (second mate forward) are mapped by
+ * swapping the mates.
+ *
+ * Single reads of unknown orientation are mapped in batches with `map_reads`, which
+ * chains the cores of both the read and its reverse complement and keeps the strand
+ * with the better chain.
+ *
+ * The entries of each label must be sorted by record and position, which holds for
+ * indexes built from tuples added in record order (see `index.h`).
+ *
+ * @see index.h
+ *
+ * @struct read_pair
+ * @struct map_chain
+ * @struct map_pair
+ * @struct map_read
+ *
+ */
+
+#ifndef MAP_H
+#define MAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "index.h"
+#include <stdint.h>
+
+#define MAP_MAX_OCCURRENCE      64
+#define MAP_DIAGONAL_TOLERANCE  32
+#define MAP_TASK_SIZE           256
+
+struct read_pair {
+    struct lps mate1;
+    struct lps mate2;
+};
+
+struct map_chain {
+    uint32_t record;
+    int64_t position;
+    uint32_t score;
+};
+
+struct map_pair {
+    struct map_chain mate1;
+    struct map_chain mate2;
+    int proper;
+};
+
+struct map_read {
+    struct map_chain chain;
+    int reverse;
+};
+
+/**
+ * @brief Parses both mates of a read pair, the second one in reverse complement.
+ *
+ * @param pair Pointer to the read pair to initialize.
+ * @param mate1 The first mate.
+ * @param len1 Length of the first mate.
+ * @param mate2 The second mate.
+ * @param len2 Length of the second mate.
+ * @param lcp_level The level both mates will be deepened to.
+ */
+void init_read_pair(struct read_pair *pair, const char *mate1, int len1, const char *mate2, int len2, int lcp_level);
+
+/**
+ * @brief Frees the cores of both mates.
+ *
+ * @param pair Pointer to the read pair to deallocate.
+ */
+void free_read_pair(struct read_pair *pair);
+
+/**
+ * @brief Finds the best chain of a single read.
+ *
+ * @param index The index of the reference.
+ * @param read The cores of the read.
+ * @param chain Pointer where the best chain will be stored.
+ * @return 1 if a chain is found, 0 otherwise.
+ */
+int map_single(const struct lcp_index *index, const struct lps *read, struct map_chain *chain);
+
+/**
+ * @brief Finds the best chains of the mates of a read pair under the insert size constraint.
+ *
+ * The insert size of a pair is the distance from the first base of the first mate
+ * to the last base of the second mate on the reference. The position of the second
+ * mate is the reference position of its reverse complement. If no chains satisfy
+ * the constraint, the best chain of each mate is reported and `proper` is 0.
+ *
+ * @param index The index of the reference.
+ * @param pair The cores of the read pair, see `init_read_pair`.
+ * @param len2 Length of the second mate.
+ * @param min_insert Minimum insert size.
+ * @param max_insert Maximum insert size.
+ * @param result Pointer where the chains of the mates will be stored. Score 0
+ * denotes a mate without chain.
+ * @return 1 if a proper pair is found, 0 otherwise.
+ */
+int map_pair(const struct lcp_index *index, const struct read_pair *pair, int len2, int64_t min_insert, int64_t max_insert, struct map_pair *result);
+
+/**
+ * @brief Parses and maps a batch of single reads on both strands with multiple threads.
+ *
+ * Each read is parsed as is and in reverse complement, and the chain with more seeds
+ * is reported, the forward one on ties. The position of a reverse chain is the
+ * reference position of the first base of the reverse complement of the read. The
+ * seeding buffers are reused across the reads of a thread.
+ *
+ * @param index The index of the reference.
+ * @param reads The reads.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param lcp_level The level the reads will be deepened to.
+ * @param results Array of at least `count` results. Score 0 denotes a read without
+ * chain.
+ * @param thread_count Number of threads to be used.
+ * @return Number of reads with a chain.
+ */
+int map_reads(const struct lcp_index *index, const char **reads, const int *lengths, int count, int lcp_level,
+              struct map_read *results, int thread_count);
+
+/**
+ * @brief Parses and maps a batch of read pairs with multiple threads.
+ *
+ * Both mates of a pair are processed in the same task, and the seeding buffers are
+ * reused across the pairs of a thread.
+ *
+ * @param index The index of the reference.
+ * @param mates1 The first mates.
+ * @param lengths1 Lengths of the first mates.
+ * @param mates2 The second mates.
+ * @param lengths2 Lengths of the second mates.
+ * @param count Number of read pairs.
+ * @param lcp_level The level the mates will be deepened to.
+ * @param min_insert Minimum insert size.
+ * @param max_insert Maximum insert size.
+ * @param results Array of at least `count` results.
+ * @param thread_count Number of threads to be used.
+ * @return Number of proper pairs.
+ */
+int map_pairs(const struct lcp_index *index, const char **mates1, const int *lengths1, const char **mates2, const int *lengths2, int count,
+              int lcp_level, int64_t min_insert, int64_t max_insert, struct map_pair *results, int thread_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
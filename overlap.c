@@ -0,0 +1,372 @@
+/**
+ * @file overlap.c
+ * @brief Implementation of the all-vs-all overlapper.
+ *
+ * For each read, the labels of its forward cores are looked up in the index of all
+ * tuples, and the entries of later reads are expanded into (target, strand,
+ * diagonal) hits. Entries are sorted by record, so the entries of earlier reads are
+ * skipped with a binary search. The hits are sorted and split into chains wherever
+ * the target or the strand changes, or two consecutive diagonals are more than
+ * `OVERLAP_DIAGONAL_TOLERANCE` apart.
+ */
+
+#include "overlap.h"
+#include "pool.h"
+#include <inttypes.h>
+
+struct overlap_hit {
+    uint32_t target;
+    uint32_t reverse;
+    int64_t diagonal;
+    uint64_t query_start;
+    uint64_t query_end;
+    uint64_t target_start;
+};
+
+struct overlap_context {
+    const char **reads;
+    const int *lengths;
+    int count;
+    int lcp_level;
+    struct lps *forward;
+    struct lps *reverse;
+    const struct lcp_index *index;
+    uint32_t min_shared;
+    uint32_t max_occurrence;
+    int next_task;
+};
+
+struct overlap_worker {
+    struct overlap_context *ctx;
+    struct overlap_set set;
+    ulabel *labels;
+    struct index_span *spans;
+    int capacity;
+    struct overlap_hit *hits;
+    uint64_t hit_capacity;
+};
+
+void init_overlap_set(struct overlap_set *set) {
+    set->size = 0;
+    set->capacity = 0;
+    set->overlaps = NULL;
+}
+
+void free_overlap_set(struct overlap_set *set) {
+    free(set->overlaps);
+    init_overlap_set(set);
+}
+
+static struct read_overlap *push_overlap(struct overlap_set *set) {
+    if (set->size == set->capacity) {
+        set->capacity = set->capacity ? 2 * set->capacity : 64;
+        set->overlaps = (struct read_overlap *)realloc(set->overlaps, set->capacity * sizeof(struct read_overlap));
+    }
+    return &(set->overlaps[set->size++]);
+}
+
+static int hit_cmp(const void *lhs, const void *rhs) {
+    const struct overlap_hit *a = (const struct overlap_hit *)lhs;
+    const struct overlap_hit *b = (const struct overlap_hit *)rhs;
+    if (a->target != b->target) {
+        return a->target < b->target ? -1 : 1;
+    }
+    if (a->reverse != b->reverse) {
+        return a->reverse < b->reverse ? -1 : 1;
+    }
+    return (a->diagonal > b->diagonal) - (a->diagonal < b->diagonal);
+}
+
+static int query_start_cmp(const void *lhs, const void *rhs) {
+    const struct overlap_hit *a = (const struct overlap_hit *)lhs;
+    const struct overlap_hit *b = (const struct overlap_hit *)rhs;
+    return (a->query_start > b->query_start) - (a->query_start < b->query_start);
+}
+
+static int overlap_cmp(const void *lhs, const void *rhs) {
+    const struct read_overlap *a = (const struct read_overlap *)lhs;
+    const struct read_overlap *b = (const struct read_overlap *)rhs;
+    if (a->query != b->query) {
+        return a->query < b->query ? -1 : 1;
+    }
+    if (a->target != b->target) {
+        return a->target < b->target ? -1 : 1;
+    }
+    return (a->reverse > b->reverse) - (a->reverse < b->reverse);
+}
+
+/**
+ * @brief Returns the index of the first entry of the span whose record is not less than `record`.
+ */
+static uint32_t first_entry(const struct index_span *span, uint32_t record) {
+    uint32_t lo = 0, hi = span->size;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (span->entries[mid].record < record) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Reports the overlap of the chain of hits [first, last) of a query.
+ */
+static void report_chain(struct overlap_worker *worker, uint32_t query, struct overlap_hit *first, struct overlap_hit *last) {
+    struct read_overlap *ov = push_overlap(&(worker->set));
+    ov->query = query;
+    ov->target = first->target;
+    ov->reverse = first->reverse;
+    ov->shared = last - first;
+    ov->matches = 0;
+    ov->query_start = UINT64_MAX;
+    ov->query_end = 0;
+
+    uint64_t target_start = UINT64_MAX, target_end = 0, covered_end = 0;
+
+    // count the query bases covered by the cores in the order of their positions
+    qsort(first, last - first, sizeof(struct overlap_hit), query_start_cmp);
+    for (struct overlap_hit *hit = first; hit < last; hit++) {
+        uint64_t length = hit->query_end - hit->query_start;
+        ov->query_start = minimum(ov->query_start, hit->query_start);
+        ov->query_end = maximum(ov->query_end, hit->query_end);
+        target_start = minimum(target_start, hit->target_start);
+        target_end = maximum(target_end, hit->target_start + length);
+
+        uint64_t from = maximum(covered_end, hit->query_start);
+        if (from < hit->query_end) {
+            ov->matches += hit->query_end - from;
+            covered_end = hit->query_end;
+        }
+    }
+
+    // positions of reverse hits are on the reverse complement of the target
+    uint64_t length = worker->ctx->lengths[ov->target];
+    target_end = minimum(target_end, length);
+    if (ov->reverse) {
+        ov->target_start = length - target_end;
+        ov->target_end = length - target_start;
+    } else {
+        ov->target_start = target_start;
+        ov->target_end = target_end;
+    }
+}
+
+/**
+ * @brief Expands the shared cores of a read with the later reads into hits, chains
+ * them, and reports the best chain of each target and strand.
+ */
+static void overlap_read(struct overlap_worker *worker, uint32_t query) {
+    struct overlap_context *ctx = worker->ctx;
+    const struct lps *read = &(ctx->forward[query]);
+
+    if (worker->capacity < read->size) {
+        worker->capacity = read->size;
+        worker->labels = (ulabel *)realloc(worker->labels, worker->capacity * sizeof(ulabel));
+        worker->spans = (struct index_span *)realloc(worker->spans, worker->capacity * sizeof(struct index_span));
+    }
+    for (int i = 0; i < read->size; i++) {
+        worker->labels[i] = read->cores[i].label;
+    }
+    index_lookup_batch(ctx->index, worker->labels, read->size, worker->spans);
+
+    uint64_t hit_count = 0;
+    for (int i = 0; i < read->size; i++) {
+        const struct index_span *span = &(worker->spans[i]);
+        if (ctx->max_occurrence < span->size) {
+            continue;
+        }
+
+        uint32_t j = first_entry(span, 2 * (query + 1));
+        if (worker->hit_capacity < hit_count + (span->size - j)) {
+            worker->hit_capacity = maximum(2 * worker->hit_capacity, hit_count + (span->size - j));
+            worker->hits = (struct overlap_hit *)realloc(worker->hits, worker->hit_capacity * sizeof(struct overlap_hit));
+        }
+        for (; j < span->size; j++) {
+            struct overlap_hit *hit = &(worker->hits[hit_count++]);
+            hit->target = span->entries[j].record >> 1;
+            hit->reverse = span->entries[j].record & 1;
+            hit->diagonal = (int64_t)read->cores[i].start - (int64_t)span->entries[j].position;
+            hit->query_start = read->cores[i].start;
+            hit->query_end = read->cores[i].end;
+            hit->target_start = span->entries[j].position;
+        }
+    }
+
+    qsort(worker->hits, hit_count, sizeof(struct overlap_hit), hit_cmp);
+
+    // keep the longest chain of each target and strand
+    uint64_t first = 0, best_first = 0, best_last = 0;
+    for (uint64_t i = 1; i <= hit_count; i++) {
+        int new_group = i == hit_count || worker->hits[i].target != worker->hits[i-1].target ||
+                        worker->hits[i].reverse != worker->hits[i-1].reverse;
+
+        if (new_group || OVERLAP_DIAGONAL_TOLERANCE < worker->hits[i].diagonal - worker->hits[i-1].diagonal) {
+            if (best_last - best_first < i - first) {
+                best_first = first;
+                best_last = i;
+            }
+            first = i;
+        }
+
+        if (new_group) {
+            if (ctx->min_shared <= best_last - best_first) {
+                report_chain(worker, query, &(worker->hits[best_first]), &(worker->hits[best_last]));
+            }
+            best_first = best_last = i;
+        }
+    }
+}
+
+static void *parse_work(void *arg) {
+    struct overlap_worker *worker = (struct overlap_worker *)arg;
+    struct overlap_context *ctx = worker->ctx;
+    int i;
+
+    while ((i = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < ctx->count) {
+        init_lps(&(ctx->forward[i]), ctx->reads[i], ctx->lengths[i]);
+        lps_deepen(&(ctx->forward[i]), ctx->lcp_level);
+        init_lps2(&(ctx->reverse[i]), ctx->reads[i], ctx->lengths[i]);
+        lps_deepen(&(ctx->reverse[i]), ctx->lcp_level);
+    }
+
+    return NULL;
+}
+
+static void *overlap_work(void *arg) {
+    struct overlap_worker *worker = (struct overlap_worker *)arg;
+    struct overlap_context *ctx = worker->ctx;
+    int task;
+
+    while ((task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * OVERLAP_TASK_SIZE < ctx->count) {
+        for (int i = task * OVERLAP_TASK_SIZE; i < minimum(ctx->count, (task + 1) * OVERLAP_TASK_SIZE); i++) {
+            overlap_read(worker, i);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs `fn` over the workers.
+ */
+static void run_workers(void *(*fn)(void *), struct overlap_worker *workers, int thread_count) {
+    workers[0].ctx->next_task = 0;
+    run_pool(fn, workers, sizeof(struct overlap_worker), thread_count);
+}
+
+/**
+ * @brief Allocates a pool of workers sharing the context.
+ */
+static struct overlap_worker *init_workers(struct overlap_context *ctx, int thread_count) {
+    struct overlap_worker *workers = (struct overlap_worker *)calloc(thread_count, sizeof(struct overlap_worker));
+    for (int t = 0; t < thread_count; t++) {
+        workers[t].ctx = ctx;
+        init_overlap_set(&(workers[t].set));
+    }
+    return workers;
+}
+
+static void free_workers(struct overlap_worker *workers, int thread_count) {
+    for (int t = 0; t < thread_count; t++) {
+        free_overlap_set(&(workers[t].set));
+        free(workers[t].labels);
+        free(workers[t].spans);
+        free(workers[t].hits);
+    }
+    free(workers);
+}
+
+uint64_t find_overlaps_lps(const struct lps *forward, const struct lps *reverse, const int *lengths, int count,
+                           uint32_t min_shared, uint32_t max_occurrence, struct overlap_set *set, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    // bucket the cores of both strands by label
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += forward[i].size + reverse[i].size;
+    }
+
+    struct ltuples tuples;
+    init_ltuples(&tuples, total);
+    for (int i = 0; i < count; i++) {
+        ltuples_add_lps(&tuples, &(forward[i]), 2 * i);
+        ltuples_add_lps(&tuples, &(reverse[i]), 2 * i + 1);
+    }
+    ltuples_sort(&tuples, thread_count);
+
+    struct lcp_index index;
+    init_index(&index, &tuples);
+    free_ltuples(&tuples);
+
+    struct overlap_context ctx = {NULL, lengths, count, 0, (struct lps *)forward, (struct lps *)reverse, &index, min_shared, max_occurrence, 0};
+    struct overlap_worker *workers = init_workers(&ctx, thread_count);
+    run_workers(overlap_work, workers, thread_count);
+
+    // gather the overlaps of the workers
+    uint64_t first = set->size;
+    for (int t = 0; t < thread_count; t++) {
+        for (uint64_t i = 0; i < workers[t].set.size; i++) {
+            *push_overlap(set) = workers[t].set.overlaps[i];
+        }
+    }
+    qsort(set->overlaps + first, set->size - first, sizeof(struct read_overlap), overlap_cmp);
+
+    free_workers(workers, thread_count);
+    free_index(&index);
+
+    return set->size - first;
+}
+
+uint64_t find_overlaps(const char **reads, const int *lengths, int count, int lcp_level,
+                       uint32_t min_shared, uint32_t max_occurrence, struct overlap_set *set, int thread_count) {
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    struct lps *forward = (struct lps *)malloc((count ? count : 1) * sizeof(struct lps));
+    struct lps *reverse = (struct lps *)malloc((count ? count : 1) * sizeof(struct lps));
+
+    struct overlap_context ctx = {reads, lengths, count, lcp_level, forward, reverse, NULL, 0, 0, 0};
+    struct overlap_worker *workers = init_workers(&ctx, thread_count);
+    run_workers(parse_work, workers, thread_count);
+    free_workers(workers, thread_count);
+
+    uint64_t found = find_overlaps_lps(forward, reverse, lengths, count, min_shared, max_occurrence, set, thread_count);
+
+    for (int i = 0; i < count; i++) {
+        free_lps(&(forward[i]));
+        free_lps(&(reverse[i]));
+    }
+    free(forward);
+    free(reverse);
+
+    return found;
+}
+
+int write_overlaps_paf(const struct overlap_set *set, const char **names, const int *lengths, FILE *out) {
+    int success = 1;
+
+    for (uint64_t i = 0; i < set->size && success; i++) {
+        const struct read_overlap *ov = &(set->overlaps[i]);
+        uint64_t block = maximum(ov->query_end - ov->query_start, ov->target_end - ov->target_start);
+
+        if (names) {
+            success = fprintf(out, "%s\t%d\t%" PRIu64 "\t%" PRIu64 "\t%c\t%s\t%d\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t255\tcm:i:%u\n",
+                              names[ov->query], lengths[ov->query], ov->query_start, ov->query_end, ov->reverse ? '-' : '+',
+                              names[ov->target], lengths[ov->target], ov->target_start, ov->target_end, ov->matches, block, ov->shared) > 0;
+        } else {
+            success = fprintf(out, "%u\t%d\t%" PRIu64 "\t%" PRIu64 "\t%c\t%u\t%d\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t255\tcm:i:%u\n",
+                              ov->query, lengths[ov->query], ov->query_start, ov->query_end, ov->reverse ? '-' : '+',
+                              ov->target, lengths[ov->target], ov->target_start, ov->target_end, ov->matches, block, ov->shared) > 0;
+        }
+    }
+
+    return success;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file overlap.h
+ * @brief All-vs-all detection of overlaps between reads through shared cores.
+ *
+ * De novo assembly of long reads starts from the candidate overlaps between all
+ * pairs of reads. Comparing every pair is quadratic, so the overlapper only looks at
+ * the pairs of reads that share cores.
+ *
+ * Key functionalities include:
+ * - Parsing all reads on both strands with multiple threads, the reverse complement
+ * with `init_lps2`.
+ * - Bucketing the (label, read, position, strand) tuples of the cores by label with
+ * the parallel radix sort of `sort.h`, and indexing the buckets (see `index.h`).
+ * - Enumerating, for each read, the later reads sharing its cores. Labels with more
+ * than a given number of occurrences, e.g. cores of repeats, are skipped. The shared
+ * cores of a pair are chained by diagonal as in `map.h`, and the best chain of each
+ * pair and relative strand is reported if it has enough cores.
+ * - Writing the overlaps in PAF format.
+ *
+ * Since the cores are indexed on both strands, a label shared by the reads covering
+ * a region occurs about twice the coverage, which the repeat filter should allow.
+ *
+ * The strand of a tuple is stored in the lowest bit of its record, i.e. the tuples
+ * of read `r` have record `2r` on the forward strand and `2r + 1` on the reverse
+ * strand. Each pair is found once, from the forward cores of its first read.
+ *
+ * @see index.h
+ * @see map.h
+ *
+ * @struct read_overlap
+ * @struct overlap_set
+ *
+ */
+
+#ifndef OVERLAP_H
+#define OVERLAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "index.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define OVERLAP_MAX_OCCURRENCE      64
+#define OVERLAP_MIN_SHARED          3
+#define OVERLAP_DIAGONAL_TOLERANCE  100
+#define OVERLAP_TASK_SIZE           64
+
+struct read_overlap {
+    uint32_t query;
+    uint32_t target;
+    int reverse;
+    uint32_t shared;
+    uint64_t matches;
+    uint64_t query_start;
+    uint64_t query_end;
+    uint64_t target_start;
+    uint64_t target_end;
+};
+
+struct overlap_set {
+    uint64_t size;
+    uint64_t capacity;
+    struct read_overlap *overlaps;
+};
+
+/**
+ * @brief Initializes an empty set of overlaps.
+ *
+ * @param set Pointer to the set to initialize.
+ */
+void init_overlap_set(struct overlap_set *set);
+
+/**
+ * @brief Frees the memory allocated for the overlaps.
+ *
+ * @param set Pointer to the set to deallocate.
+ */
+void free_overlap_set(struct overlap_set *set);
+
+/**
+ * @brief Finds the overlaps between reads whose cores are already computed.
+ *
+ * The query of an overlap is its first read and the target its second read.
+ * Coordinates are 0-based and half-open on the forward strand of both reads; on
+ * reverse overlaps, the target interval is the one whose reverse complement
+ * overlaps the query. The overlaps are ordered by query, target and strand.
+ *
+ * @param forward The cores of the reads.
+ * @param reverse The cores of the reverse complements of the reads, from `init_lps2`,
+ * deepened to the same level.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param min_shared Minimum number of cores in the chain of an overlap.
+ * @param max_occurrence Labels occurring more often than this are skipped.
+ * @param set Pointer to the set where the overlaps will be appended.
+ * @param thread_count Number of threads to be used.
+ * @return Number of overlaps found.
+ */
+uint64_t find_overlaps_lps(const struct lps *forward, const struct lps *reverse, const int *lengths, int count,
+                           uint32_t min_shared, uint32_t max_occurrence, struct overlap_set *set, int thread_count);
+
+/**
+ * @brief Parses the reads on both strands and finds the overlaps between them.
+ *
+ * @param reads The reads.
+ * @param lengths Lengths of the reads.
+ * @param count Number of reads.
+ * @param lcp_level The level the cores will be deepened to.
+ * @param min_shared Minimum number of cores in the chain of an overlap.
+ * @param max_occurrence Labels occurring more often than this are skipped.
+ * @param set Pointer to the set where the overlaps will be appended.
+ * @param thread_count Number of threads to be used.
+ * @return Number of overlaps found.
+ * @see find_overlaps_lps
+ */
+uint64_t find_overlaps(const char **reads, const int *lengths, int count, int lcp_level,
+                       uint32_t min_shared, uint32_t max_occurrence, struct overlap_set *set, int thread_count);
+
+/**
+ * @brief Writes the overlaps in PAF format.
+ *
+ * Each overlap is written as a line with the 12 mandatory columns. The number of
+ * matching bases is estimated as the number of bases covered by the chained cores,
+ * the block length is the longer of the two intervals, and the mapping quality is
+ * 255 (missing). The number of chained cores is written in the `cm` tag.
+ *
+ * @param set The overlaps.
+ * @param names Names of the reads, or NULL to name the reads by their 0-based index.
+ * @param lengths Lengths of the reads.
+ * @param out File pointer to the output.
+ * @return 1 on success, 0 otherwise.
+ */
+int write_overlaps_paf(const struct overlap_set *set, const char **names, const int *lengths, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
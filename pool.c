@@ -0,0 +1,78 @@
+/**
+ * @file pool.c
+ * @brief Implementation of the fork-join worker pool.
+ */
+
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct pool_task {
+    uint64_t size;
+    int index;
+};
+
+static int compare_pool_tasks(const void *lhs, const void *rhs) {
+    const struct pool_task *a = (const struct pool_task *)lhs;
+    const struct pool_task *b = (const struct pool_task *)rhs;
+    if (a->size != b->size) {
+        return a->size > b->size ? -1 : 1;
+    }
+    return (a->index > b->index) - (a->index < b->index);
+}
+
+void run_pool(void *(*fn)(void *), void *workers, size_t worker_size, int worker_count) {
+    char *base = (char *)workers;
+    worker_count = worker_count < 1 ? 1 : worker_count;
+    pthread_t *threads = (pthread_t *)malloc(worker_count * sizeof(pthread_t));
+    int *threaded = (int *)calloc(worker_count, sizeof(int));
+
+    if (threads == NULL || threaded == NULL) {
+        // no room to track the threads, run every worker in the calling thread
+        for (int t = 0; t < worker_count; t++) {
+            fn(base + t * worker_size);
+        }
+        free(threads);
+        free(threaded);
+        return;
+    }
+
+    for (int t = 1; t < worker_count; t++) {
+        void *arg = base + t * worker_size;
+        threaded[t] = pthread_create(&(threads[t]), NULL, fn, arg) == 0;
+        if (!threaded[t]) {
+            // fall back to running the worker in the calling thread
+            fn(arg);
+        }
+    }
+
+    fn(base);
+
+    for (int t = 1; t < worker_count; t++) {
+        if (threaded[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    free(threads);
+    free(threaded);
+}
+
+int *pool_order(const uint64_t *sizes, int count) {
+    count = count < 0 ? 0 : count;
+    struct pool_task *tasks = (struct pool_task *)malloc((count ? count : 1) * sizeof(struct pool_task));
+    int *order = (int *)malloc((count ? count : 1) * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        tasks[i].size = sizes[i];
+        tasks[i].index = i;
+    }
+    qsort(tasks, count, sizeof(struct pool_task), compare_pool_tasks);
+
+    for (int i = 0; i < count; i++) {
+        order[i] = tasks[i].index;
+    }
+
+    free(tasks);
+    return order;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file pool.h
+ * @brief Fork-join execution of a worker function over an array of workers.
+ *
+ * The multi-threaded routines of the library share the same structure: each thread
+ * owns a worker holding its scratch state and a pointer to a shared context, from
+ * which it claims tasks until none are left. This file declares the routine that
+ * runs such workers, so that thread creation and joining live in a single place.
+ *
+ * Key functionalities include:
+ * - Running the first worker in the calling thread and every other worker in a
+ * thread of its own.
+ * - Running a worker in the calling thread if its thread cannot be created, so that
+ * every worker is run exactly once, also when it owns a fixed share of the work.
+ * - Passing the same argument to all threads when the workers have no state of their
+ * own.
+ * - Ordering tasks of uneven sizes largest first for workers claiming them from a
+ * shared counter.
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Runs `fn` once for each worker and returns when all of them are done.
+ *
+ * The first worker is run in the calling thread. Workers whose thread cannot be
+ * created are run in the calling thread before it, and if the thread handles
+ * cannot be allocated all workers are run in the calling thread one after another.
+ *
+ * @param fn The worker function.
+ * @param workers Array of `worker_count` workers, each `worker_size` bytes.
+ * @param worker_size Size of a worker in bytes; 0 passes `workers` itself to all
+ * threads.
+ * @param worker_count Number of workers, i.e. of threads; a single worker is run if
+ * it is less than 1.
+ */
+void run_pool(void *(*fn)(void *), void *workers, size_t worker_size, int worker_count);
+
+/**
+ * @brief Orders tasks by decreasing size, and tasks of the same size by index.
+ *
+ * When workers claim tasks one at a time from a shared counter, the last task to be
+ * claimed bounds the running time from below. Claiming the largest tasks first
+ * leaves the small ones to even out the finishing times of the workers.
+ *
+ * @param sizes Sizes of the tasks, in any unit.
+ * @param count Number of tasks.
+ * @return Newly allocated array of the `count` task indices in order, to be freed
+ * by the caller.
+ */
+int *pool_order(const uint64_t *sizes, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file probe.h
+ * @brief Hashing and batched probing of the open addressing tables keyed by core
+ * labels.
+ *
+ * The index and the classification database both store core labels in tables of
+ * a power of two size with linear probing. This file holds what their lookups
+ * share. It is internal to the library and is not installed.
+ *
+ * Key functionalities include:
+ * - Hashing labels with the 32-bit MurmurHash3 finalizer before probing, since
+ * labels of level 1 cores are small structured integers and would otherwise
+ * cluster in the table.
+ * - Probing many labels in order with the home slot of each label prefetched a
+ * fixed number of labels ahead of its probe, so that the latency of the cache
+ * misses overlap.
+ *
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include "core.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Hashes a label with the 32-bit MurmurHash3 finalizer.
+ *
+ * @param label The label.
+ * @return The hash.
+ */
+static inline uint32_t label_hash(ulabel label) {
+    uint32_t h = label;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * @brief Probes the home slots of many labels in order, prefetching each home slot
+ * `distance` labels ahead of its probe.
+ *
+ * The home slot is recomputed when a label is probed, which is cheaper than
+ * keeping the prefetched slots in a ring. Being inlined, `visit` is usually
+ * inlined as well.
+ *
+ * @param slots The slots of the table.
+ * @param slot_size Size of a slot in bytes.
+ * @param slot_count Number of slots, a power of two.
+ * @param labels Labels to probe.
+ * @param count Number of labels.
+ * @param distance Number of labels between the prefetch of a slot and its probe.
+ * @param visit Probes label `i` from its home slot `slot`.
+ * @param arg Argument passed to `visit`.
+ */
+static inline void probe_batch(const void *slots, size_t slot_size, uint64_t slot_count, const ulabel *labels,
+                               uint64_t count, uint64_t distance, void (*visit)(void *arg, uint64_t i, uint64_t slot),
+                               void *arg) {
+    const char *base = (const char *)slots;
+    uint64_t mask = slot_count - 1;
+
+    // fill the pipeline
+    for (uint64_t i = 0; i < count && i < distance; i++) {
+        __builtin_prefetch(base + (label_hash(labels[i]) & mask) * slot_size, 0, 1);
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        visit(arg, i, label_hash(labels[i]) & mask);
+
+        // issue the prefetch of the label `distance` ahead
+        if (i + distance < count) {
+            __builtin_prefetch(base + (label_hash(labels[i + distance]) & mask) * slot_size, 0, 1);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,466 @@
+/**
+ * @file sketch.c
+ * @brief Implementation of core label sketches and the banded sketch index.
+ *
+ * The index file consists of a fixed header, the sketches of the genomes and the
+ * bucket entries of all bands, band after band, so that the entries of a band form
+ * one sorted array which a query searches with binary search.
+ *
+ * Sketch comparisons count equal bins with 32-bit lane comparisons, whose all-ones
+ * results are subtracted from a vector of counters, so a pair of sketches costs
+ * `SKETCH_SIZE / 8` compare-and-subtract steps with AVX2 and twice as many with SSE2.
+ */
+
+#include "sketch.h"
+#include "pool.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SKETCH_X86
+#endif
+
+typedef void (*compare_fn)(const struct genome_sketch *query, const struct genome_sketch *targets, uint32_t count, uint16_t *equal_counts);
+
+struct sketch_header {
+    char magic[8];
+    uint32_t genome_count;
+    uint32_t sketch_size;
+    uint32_t band_size;
+    uint32_t padding;
+};
+
+struct sketch_file_header {
+    char magic[8];
+    uint32_t lcp_level;
+    uint32_t sketch_size;
+};
+
+struct sketch_context {
+    const char **seqs;
+    const int *lengths;
+    int count;
+    int lcp_level;
+    struct genome_sketch *sketches;
+    struct sketch_index *idx;
+    const struct genome_sketch *queries;
+    const struct genome_sketch *targets;
+    uint32_t target_count;
+    uint16_t *equal_counts;
+    compare_fn compare;
+    int next_task;
+};
+
+static inline uint64_t band_hash(const struct genome_sketch *sketch, int band) {
+    uint64_t h = lcp_mix64(band + 1);
+    for (int r = 0; r < SKETCH_BAND_SIZE; r++) {
+        h = lcp_mix64(h ^ sketch->mins[band * SKETCH_BAND_SIZE + r]);
+    }
+    return h;
+}
+
+void init_genome_sketch(struct genome_sketch *sketch) {
+    for (int j = 0; j < SKETCH_SIZE; j++) {
+        sketch->mins[j] = SKETCH_EMPTY;
+    }
+}
+
+void sketch_add_lps(const struct lps *lps_ptr, struct genome_sketch *sketch) {
+
+    // one permutation: the low bits of the hash select the bin, the high bits are kept
+    for (int c = 0; c < lps_ptr->size; c++) {
+        uint64_t h = lcp_mix64(lps_ptr->cores[c].label);
+        uint32_t value = (uint32_t)(h >> 32);
+        value = value == SKETCH_EMPTY ? value - 1 : value;
+        int bin = h & (SKETCH_SIZE - 1);
+        sketch->mins[bin] = minimum(sketch->mins[bin], value);
+    }
+}
+
+void sketch_densify(struct genome_sketch *sketch) {
+    uint32_t mins[SKETCH_SIZE];
+    int filled = 0;
+
+    for (int j = 0; j < SKETCH_SIZE; j++) {
+        mins[j] = sketch->mins[j];
+        filled |= mins[j] != SKETCH_EMPTY;
+    }
+
+    if (!filled) {
+        return;
+    }
+
+    // rotation densification: empty bins borrow the next non-empty bin, shifted by the distance
+    for (int j = 0; j < SKETCH_SIZE; j++) {
+        int k = 0;
+        while (mins[(j + k) & (SKETCH_SIZE - 1)] == SKETCH_EMPTY) {
+            k++;
+        }
+        uint32_t value = mins[(j + k) & (SKETCH_SIZE - 1)] + k * 0x9e3779b9U;
+        sketch->mins[j] = value == SKETCH_EMPTY ? value - 1 : value;
+    }
+}
+
+void sketch_lps(const struct lps *lps_ptr, struct genome_sketch *sketch) {
+    init_genome_sketch(sketch);
+    sketch_add_lps(lps_ptr, sketch);
+    sketch_densify(sketch);
+}
+
+void sketch_genome(const char *seq, int len, int lcp_level, struct genome_sketch *sketch) {
+    struct lps lps_obj;
+    init_lps(&lps_obj, seq, len);
+    lps_deepen(&lps_obj, lcp_level);
+    sketch_lps(&lps_obj, sketch);
+    free_lps(&lps_obj);
+}
+
+static void *sketch_work(void *arg) {
+    struct sketch_context *ctx = (struct sketch_context *)arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < ctx->count) {
+        sketch_genome(ctx->seqs[i], ctx->lengths[i], ctx->lcp_level, &(ctx->sketches[i]));
+    }
+
+    return NULL;
+}
+
+static int compare_entries(const void *lhs, const void *rhs) {
+    const struct sketch_entry *a = (const struct sketch_entry *)lhs;
+    const struct sketch_entry *b = (const struct sketch_entry *)rhs;
+    if (a->hash != b->hash) {
+        return a->hash < b->hash ? -1 : 1;
+    }
+    return (a->genome > b->genome) - (a->genome < b->genome);
+}
+
+static void *bucket_work(void *arg) {
+    struct sketch_context *ctx = (struct sketch_context *)arg;
+    struct sketch_index *idx = ctx->idx;
+    int band;
+
+    while ((band = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < SKETCH_BAND_COUNT) {
+        struct sketch_entry *entries = idx->entries + (uint64_t)band * idx->genome_count;
+        for (uint32_t g = 0; g < idx->genome_count; g++) {
+            entries[g].hash = band_hash(&(idx->sketches[g]), band);
+            entries[g].genome = g;
+            entries[g].padding = 0;
+        }
+        qsort(entries, idx->genome_count, sizeof(struct sketch_entry), compare_entries);
+    }
+
+    return NULL;
+}
+
+void sketch_genomes(const char **seqs, const int *lengths, int count, int lcp_level, struct genome_sketch *sketches,
+                    int thread_count) {
+    struct sketch_context ctx = {seqs, lengths, count, lcp_level, sketches, NULL, NULL, NULL, 0, NULL, NULL, 0};
+    run_pool(sketch_work, &ctx, 0, thread_count);
+}
+
+double sketch_similarity(const struct genome_sketch *lhs, const struct genome_sketch *rhs) {
+    if (lhs->mins[0] == SKETCH_EMPTY || rhs->mins[0] == SKETCH_EMPTY) {
+        return 0;
+    }
+
+    int equal = 0;
+    for (int j = 0; j < SKETCH_SIZE; j++) {
+        equal += lhs->mins[j] == rhs->mins[j];
+    }
+
+    return (double)equal / SKETCH_SIZE;
+}
+
+/**
+ * @brief Counts the equal bins of a query and each of `count` targets.
+ */
+static void compare_tile_generic(const struct genome_sketch *query, const struct genome_sketch *targets, uint32_t count, uint16_t *equal_counts) {
+    for (uint32_t t = 0; t < count; t++) {
+        int equal = 0;
+        for (int j = 0; j < SKETCH_SIZE; j++) {
+            equal += query->mins[j] == targets[t].mins[j];
+        }
+        equal_counts[t] = equal;
+    }
+}
+
+#ifdef SKETCH_X86
+__attribute__((target("sse2")))
+static void compare_tile_sse2(const struct genome_sketch *query, const struct genome_sketch *targets, uint32_t count, uint16_t *equal_counts) {
+    for (uint32_t t = 0; t < count; t++) {
+        __m128i acc = _mm_setzero_si128();
+        for (int j = 0; j < SKETCH_SIZE; j += 4) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(query->mins + j));
+            __m128i b = _mm_loadu_si128((const __m128i *)(targets[t].mins + j));
+            acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(a, b));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+        equal_counts[t] = _mm_cvtsi128_si32(acc);
+    }
+}
+
+__attribute__((target("avx2")))
+static void compare_tile_avx2(const struct genome_sketch *query, const struct genome_sketch *targets, uint32_t count, uint16_t *equal_counts) {
+    for (uint32_t t = 0; t < count; t++) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int j = 0; j < SKETCH_SIZE; j += 8) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(query->mins + j));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(targets[t].mins + j));
+            acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(a, b));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        equal_counts[t] = _mm_cvtsi128_si32(sum);
+    }
+}
+#endif
+
+static compare_fn select_compare(void) {
+#ifdef SKETCH_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return compare_tile_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        return compare_tile_sse2;
+    }
+#endif
+    return compare_tile_generic;
+}
+
+static void *compare_work(void *arg) {
+    struct sketch_context *ctx = (struct sketch_context *)arg;
+    uint32_t query_count = ctx->count, target_count = ctx->target_count;
+    int task;
+
+    while ((uint64_t)(task = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) * SKETCH_COMPARE_ROWS < query_count) {
+        uint32_t first = task * SKETCH_COMPARE_ROWS;
+        uint32_t last = minimum(query_count, first + SKETCH_COMPARE_ROWS);
+
+        // the queries of the task are compared with one tile of targets at a time
+        for (uint32_t tile = 0; tile < target_count; tile += SKETCH_COMPARE_TILE) {
+            uint32_t size = minimum(SKETCH_COMPARE_TILE, target_count - tile);
+            const struct genome_sketch *targets = ctx->targets + tile;
+
+            for (uint32_t q = first; q < last; q++) {
+                uint16_t *equal_counts = ctx->equal_counts + (uint64_t)q * target_count + tile;
+
+                if (ctx->queries[q].mins[0] == SKETCH_EMPTY) {
+                    memset(equal_counts, 0, size * sizeof(uint16_t));
+                    continue;
+                }
+
+                ctx->compare(&(ctx->queries[q]), targets, size, equal_counts);
+                for (uint32_t t = 0; t < size; t++) {
+                    if (targets[t].mins[0] == SKETCH_EMPTY) {
+                        equal_counts[t] = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void sketch_compare(const struct genome_sketch *queries, uint32_t query_count, const struct genome_sketch *targets, uint32_t target_count,
+                    uint16_t *equal_counts, int thread_count) {
+    struct sketch_context ctx = {NULL, NULL, (int)query_count, 0, NULL, NULL, queries, targets, target_count, equal_counts,
+                                 select_compare(), 0};
+    run_pool(compare_work, &ctx, 0, thread_count);
+}
+
+int sketch_save(const struct genome_sketch *sketch, int lcp_level, const char *filename) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        return 0;
+    }
+
+    struct sketch_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SKETCH_FILE_MAGIC, sizeof(header.magic));
+    header.lcp_level = lcp_level;
+    header.sketch_size = SKETCH_SIZE;
+
+    int success = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(sketch, sizeof(struct genome_sketch), 1, out) == 1;
+
+    return fclose(out) == 0 && success;
+}
+
+int sketch_load(struct genome_sketch *sketch, int lcp_level, const char *filename) {
+    FILE *in = fopen(filename, "rb");
+    if (!in) {
+        return 0;
+    }
+
+    struct sketch_file_header header;
+    struct genome_sketch loaded;
+    int success = fread(&header, sizeof(header), 1, in) == 1 &&
+                  memcmp(header.magic, SKETCH_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                  header.lcp_level == (uint32_t)lcp_level && header.sketch_size == SKETCH_SIZE &&
+                  fread(&loaded, sizeof(struct genome_sketch), 1, in) == 1 && fgetc(in) == EOF;
+    fclose(in);
+
+    if (success) {
+        *sketch = loaded;
+    }
+
+    return success;
+}
+
+void init_sketch_index(struct sketch_index *idx, const struct genome_sketch *sketches, uint32_t count, int thread_count) {
+    idx->genome_count = count;
+    idx->sketches = (struct genome_sketch *)malloc((count ? count : 1) * sizeof(struct genome_sketch));
+    idx->entries = (struct sketch_entry *)malloc(((uint64_t)count * SKETCH_BAND_COUNT + 1) * sizeof(struct sketch_entry));
+    idx->map = NULL;
+    idx->map_size = 0;
+    memcpy(idx->sketches, sketches, count * sizeof(struct genome_sketch));
+
+    struct sketch_context ctx = {NULL, NULL, 0, 0, NULL, idx, NULL, NULL, 0, NULL, NULL, 0};
+    run_pool(bucket_work, &ctx, 0, thread_count);
+}
+
+void free_sketch_index(struct sketch_index *idx) {
+    if (idx->map) {
+        munmap(idx->map, idx->map_size);
+    } else {
+        free(idx->sketches);
+        free(idx->entries);
+    }
+    idx->map = NULL;
+    idx->sketches = NULL;
+    idx->entries = NULL;
+    idx->genome_count = 0;
+}
+
+int sketch_index_save(const struct sketch_index *idx, const char *filename) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        return 0;
+    }
+
+    struct sketch_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SKETCH_MAGIC, sizeof(header.magic));
+    header.genome_count = idx->genome_count;
+    header.sketch_size = SKETCH_SIZE;
+    header.band_size = SKETCH_BAND_SIZE;
+
+    uint64_t entry_count = (uint64_t)idx->genome_count * SKETCH_BAND_COUNT;
+    int success = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  fwrite(idx->sketches, sizeof(struct genome_sketch), idx->genome_count, out) == idx->genome_count &&
+                  fwrite(idx->entries, sizeof(struct sketch_entry), entry_count, out) == entry_count;
+
+    return fclose(out) == 0 && success;
+}
+
+int sketch_index_open(struct sketch_index *idx, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(struct sketch_header)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    const struct sketch_header *header = (const struct sketch_header *)map;
+    uint64_t sketches_size = (uint64_t)header->genome_count * sizeof(struct genome_sketch);
+    uint64_t entries_size = (uint64_t)header->genome_count * SKETCH_BAND_COUNT * sizeof(struct sketch_entry);
+
+    if (memcmp(header->magic, SKETCH_MAGIC, sizeof(header->magic)) != 0 || header->sketch_size != SKETCH_SIZE ||
+        header->band_size != SKETCH_BAND_SIZE || (uint64_t)st.st_size != sizeof(struct sketch_header) + sketches_size + entries_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    idx->genome_count = header->genome_count;
+    idx->sketches = (struct genome_sketch *)((char *)map + sizeof(struct sketch_header));
+    idx->entries = (struct sketch_entry *)((char *)map + sizeof(struct sketch_header) + sketches_size);
+    idx->map = map;
+    idx->map_size = st.st_size;
+
+    // the buckets are read in random order
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    return 1;
+}
+
+static int compare_genomes(const void *lhs, const void *rhs) {
+    uint32_t a = *(const uint32_t *)lhs;
+    uint32_t b = *(const uint32_t *)rhs;
+    return (a > b) - (a < b);
+}
+
+int sketch_index_query(const struct sketch_index *idx, const struct genome_sketch *sketch, int k, struct sketch_hit *hits) {
+    if (k <= 0 || !idx->genome_count || sketch->mins[0] == SKETCH_EMPTY) {
+        return 0;
+    }
+
+    uint64_t candidate_count = 0, candidate_capacity = 64;
+    uint32_t *candidates = (uint32_t *)malloc(candidate_capacity * sizeof(uint32_t));
+
+    // collect the genomes of the buckets of all bands
+    for (int band = 0; band < SKETCH_BAND_COUNT; band++) {
+        const struct sketch_entry *entries = idx->entries + (uint64_t)band * idx->genome_count;
+        uint64_t h = band_hash(sketch, band);
+
+        uint64_t low = 0, high = idx->genome_count;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (entries[mid].hash < h) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        for (; low < idx->genome_count && entries[low].hash == h; low++) {
+            if (candidate_count == candidate_capacity) {
+                candidate_capacity *= 2;
+                candidates = (uint32_t *)realloc(candidates, candidate_capacity * sizeof(uint32_t));
+            }
+            candidates[candidate_count++] = entries[low].genome;
+        }
+    }
+
+    qsort(candidates, candidate_count, sizeof(uint32_t), compare_genomes);
+
+    // rank the distinct candidates by the similarity of their sketches
+    int hit_count = 0;
+    for (uint64_t i = 0; i < candidate_count; i++) {
+        if (i && candidates[i] == candidates[i-1]) {
+            continue;
+        }
+
+        double similarity = sketch_similarity(sketch, &(idx->sketches[candidates[i]]));
+        if (hit_count == k && similarity <= hits[k-1].similarity) {
+            continue;
+        }
+
+        int j = hit_count < k ? hit_count++ : k - 1;
+        while (0 < j && hits[j-1].similarity < similarity) {
+            hits[j] = hits[j-1];
+            j--;
+        }
+        hits[j].genome = candidates[i];
+        hits[j].similarity = similarity;
+    }
+
+    free(candidates);
+
+    return hit_count;
+}
@@ -0,0 +1,247 @@
+/**
+ * @file sketch.h
+ * @brief Nearest genome search with MinHash sketches of core label sets.
+ *
+ * A genome is summarized by a sketch of the set of its core labels at a given LCP
+ * level. Sketches are computed with one permutation hashing: each label is hashed
+ * once, the hash selects one of `SKETCH_SIZE` bins and the bin keeps the minimum of
+ * the remaining bits. Empty bins are filled by rotation densification, borrowing
+ * the value of the next non-empty bin, so that sketches of small genomes remain
+ * comparable. The fraction of equal bins of two sketches estimates the Jaccard
+ * similarity of their label sets.
+ *
+ * Key functionalities include:
+ * - Sketching genomes, one at a time or in batches with multiple threads, and
+ * genomes of many records by adding the cores of each record before densifying.
+ * - Saving the sketch of a single genome into a small file, e.g. to cache it next to
+ * the genome.
+ * - Comparing many sketches against many others with multiple threads. The equal
+ * bins of two sketches are counted with AVX2 or SSE2 comparisons, selected at
+ * runtime, over tiles of sketches that stay in the L1 cache.
+ * - Indexing sketches with locality-sensitive hashing: each sketch is split into
+ * `SKETCH_BAND_COUNT` bands of `SKETCH_BAND_SIZE` bins, and each band is hashed
+ * into a bucket. Buckets are stored per band as arrays of (hash, genome) entries
+ * sorted by hash.
+ * - Saving the index into a single file and opening it with `mmap`, so that a query
+ * only touches the buckets of its bands and the sketches of its candidates.
+ * - Querying the genomes sharing at least one bucket with a sketch, ranked by the
+ * similarity of their sketches.
+ *
+ * Two genomes with Jaccard similarity `s` share a bucket with probability
+ * `1 - (1 - s^SKETCH_BAND_SIZE)^SKETCH_BAND_COUNT`, which is above 0.98 for `s` of
+ * 0.6 and below 0.001 for `s` of 0.05.
+ *
+ * @see lps.h
+ *
+ * @struct genome_sketch
+ * @struct sketch_entry
+ * @struct sketch_hit
+ * @struct sketch_index
+ *
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+
+#define SKETCH_SIZE             128
+#define SKETCH_BAND_SIZE        4
+#define SKETCH_BAND_COUNT       (SKETCH_SIZE / SKETCH_BAND_SIZE)
+#define SKETCH_EMPTY            UINT32_MAX
+#define SKETCH_MAGIC            "LCPSKI1"
+#define SKETCH_FILE_MAGIC       "LCPSKF1"
+#define SKETCH_COMPARE_ROWS     16
+#define SKETCH_COMPARE_TILE     64
+
+struct genome_sketch {
+    uint32_t mins[SKETCH_SIZE];
+};
+
+struct sketch_entry {
+    uint64_t hash;
+    uint32_t genome;
+    uint32_t padding;
+};
+
+struct sketch_hit {
+    uint32_t genome;
+    double similarity;
+};
+
+struct sketch_index {
+    uint32_t genome_count;
+    struct genome_sketch *sketches;
+    struct sketch_entry *entries;
+    void *map;
+    uint64_t map_size;
+};
+
+/**
+ * @brief Computes the sketch of the labels of the cores.
+ *
+ * @param lps_ptr The cores.
+ * @param sketch Pointer where the sketch will be stored. All bins are
+ * `SKETCH_EMPTY` if there are no cores.
+ */
+void sketch_lps(const struct lps *lps_ptr, struct genome_sketch *sketch);
+
+/**
+ * @brief Initializes a sketch without labels, to which cores are added with
+ * `sketch_add_lps`.
+ *
+ * @param sketch Pointer to the sketch to initialize.
+ */
+void init_genome_sketch(struct genome_sketch *sketch);
+
+/**
+ * @brief Adds the labels of the cores to a sketch which is not densified yet.
+ *
+ * Adding the cores of several records and densifying the result with
+ * `sketch_densify` yields the sketch of the union of their label sets. Adding the
+ * cores of a single object is the same as `sketch_lps`.
+ *
+ * @param lps_ptr The cores.
+ * @param sketch Pointer to the sketch.
+ */
+void sketch_add_lps(const struct lps *lps_ptr, struct genome_sketch *sketch);
+
+/**
+ * @brief Fills the empty bins of a sketch by rotation densification. Sketches without
+ * labels are left empty.
+ *
+ * @param sketch Pointer to the sketch.
+ */
+void sketch_densify(struct genome_sketch *sketch);
+
+/**
+ * @brief Parses a genome, deepens it and computes the sketch of its cores.
+ *
+ * @param seq The genome.
+ * @param len Length of the genome.
+ * @param lcp_level The level of the sketched cores.
+ * @param sketch Pointer where the sketch will be stored.
+ */
+void sketch_genome(const char *seq, int len, int lcp_level, struct genome_sketch *sketch);
+
+/**
+ * @brief Sketches a batch of genomes with multiple threads.
+ *
+ * @param seqs The genomes.
+ * @param lengths Lengths of the genomes.
+ * @param count Number of genomes.
+ * @param lcp_level The level of the sketched cores.
+ * @param sketches Array of at least `count` sketches.
+ * @param thread_count Number of threads to be used.
+ */
+void sketch_genomes(const char **seqs, const int *lengths, int count, int lcp_level, struct genome_sketch *sketches,
+                    int thread_count);
+
+/**
+ * @brief Estimates the Jaccard similarity of the label sets of two sketches.
+ *
+ * @param lhs The first sketch.
+ * @param rhs The second sketch.
+ * @return Fraction of equal bins, 0 if either sketch is empty.
+ */
+double sketch_similarity(const struct genome_sketch *lhs, const struct genome_sketch *rhs);
+
+/**
+ * @brief Counts the equal bins of every pair of a query and a target sketch with
+ * multiple threads.
+ *
+ * Each task compares `SKETCH_COMPARE_ROWS` queries with all targets, going through
+ * the targets in tiles of `SKETCH_COMPARE_TILE` sketches.
+ *
+ * @param queries The query sketches.
+ * @param query_count Number of queries.
+ * @param targets The target sketches.
+ * @param target_count Number of targets.
+ * @param equal_counts Array of at least `query_count * target_count` counts in row
+ * major order, i.e. the count of query `i` and target `j` is stored at
+ * `i * target_count + j`. The count is 0 if either sketch is empty, so the
+ * similarity of the pair is `count / SKETCH_SIZE`, as with `sketch_similarity`.
+ * @param thread_count Number of threads to be used.
+ */
+void sketch_compare(const struct genome_sketch *queries, uint32_t query_count, const struct genome_sketch *targets, uint32_t target_count,
+                    uint16_t *equal_counts, int thread_count);
+
+/**
+ * @brief Saves a single sketch and the level of its cores into a file.
+ *
+ * @param sketch The sketch.
+ * @param lcp_level The level of the sketched cores.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 otherwise.
+ */
+int sketch_save(const struct genome_sketch *sketch, int lcp_level, const char *filename);
+
+/**
+ * @brief Loads a sketch saved with `sketch_save`.
+ *
+ * @param sketch Pointer where the sketch will be stored.
+ * @param lcp_level The expected level of the sketched cores.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 if the file cannot be read, is not a sketch, or holds a
+ * sketch of another level or size.
+ */
+int sketch_load(struct genome_sketch *sketch, int lcp_level, const char *filename);
+
+/**
+ * @brief Builds an index over sketches, sorting the buckets of the bands with
+ * multiple threads.
+ *
+ * @param idx Pointer to the index to initialize.
+ * @param sketches The sketches, copied into the index. Genome `i` is `sketches[i]`.
+ * @param count Number of sketches.
+ * @param thread_count Number of threads to be used.
+ */
+void init_sketch_index(struct sketch_index *idx, const struct genome_sketch *sketches, uint32_t count, int thread_count);
+
+/**
+ * @brief Frees or unmaps the memory of the index.
+ *
+ * @param idx Pointer to the index to deallocate.
+ */
+void free_sketch_index(struct sketch_index *idx);
+
+/**
+ * @brief Saves the index into a file which can be opened with `sketch_index_open`.
+ *
+ * @param idx The index.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 otherwise.
+ */
+int sketch_index_save(const struct sketch_index *idx, const char *filename);
+
+/**
+ * @brief Opens an index saved with `sketch_index_save` by mapping it into memory.
+ *
+ * @param idx Pointer to the index to initialize.
+ * @param filename Path of the file.
+ * @return 1 on success, 0 if the file cannot be mapped or is not an index.
+ */
+int sketch_index_open(struct sketch_index *idx, const char *filename);
+
+/**
+ * @brief Finds the genomes most similar to a sketch among those sharing a bucket
+ * with it.
+ *
+ * @param idx The index.
+ * @param sketch The sketch of the query.
+ * @param k Maximum number of hits.
+ * @param hits Array of at least `k` hits, filled in decreasing order of similarity.
+ * @return Number of hits.
+ */
+int sketch_index_query(const struct sketch_index *idx, const struct genome_sketch *sketch, int k, struct sketch_hit *hits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
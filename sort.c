@@ -0,0 +1,338 @@
+/**
+ * @file sort.c
+ * @brief Implementation of tuple extraction and parallel radix sorting.
+ *
+ * The in-memory sort is a least significant digit radix sort over the 32-bit
+ * labels with `SORT_RADIX_BITS` bits per pass. Every pass is split into a counting
+ * phase and a scattering phase, both executed over contiguous slices of the array
+ * by separate threads, which keeps the sort stable.
+ *
+ * The external sort writes sorted runs into temporary files and merges them with a
+ * binary heap keyed by (label, run index) so that the merge is stable as well.
+ */
+
+#include "sort.h"
+#include "pool.h"
+
+struct sort_task {
+    const struct ltuple *src;
+    struct ltuple *dst;
+    uint64_t begin;
+    uint64_t end;
+    int shift;
+    uint64_t counts[SORT_RADIX_SIZE];
+};
+
+struct sort_run {
+    FILE *file;
+    struct ltuple head;
+};
+
+void init_ltuples(struct ltuples *arr, uint64_t capacity) {
+    arr->size = 0;
+    arr->capacity = capacity;
+    arr->tuples = NULL;
+    if (capacity) {
+        arr->tuples = (struct ltuple *)malloc(capacity * sizeof(struct ltuple));
+    }
+}
+
+void free_ltuples(struct ltuples *arr) {
+    free(arr->tuples);
+    arr->tuples = NULL;
+    arr->size = 0;
+    arr->capacity = 0;
+}
+
+void ltuples_push(struct ltuples *arr, ulabel label, uint32_t record, uint64_t position) {
+    if (arr->size == arr->capacity) {
+        arr->capacity = arr->capacity ? 2 * arr->capacity : 1024;
+        arr->tuples = (struct ltuple *)realloc(arr->tuples, arr->capacity * sizeof(struct ltuple));
+    }
+
+    struct ltuple *tuple = &(arr->tuples[arr->size++]);
+    tuple->label = label;
+    tuple->record = record;
+    tuple->position = position;
+}
+
+void ltuples_add_lps(struct ltuples *arr, const struct lps *lps_ptr, uint32_t record) {
+    if (arr->capacity < arr->size + lps_ptr->size) {
+        arr->capacity = arr->size + lps_ptr->size;
+        arr->tuples = (struct ltuple *)realloc(arr->tuples, arr->capacity * sizeof(struct ltuple));
+    }
+
+    for (int i = 0; i < lps_ptr->size; i++) {
+        ltuples_push(arr, lps_ptr->cores[i].label, record, lps_ptr->cores[i].start);
+    }
+}
+
+void ltuples_add_sigs(struct ltuples *arr, const struct lps *lps_ptr, const ulabel *sigs, uint32_t record) {
+    for (int i = 0; i < lps_ptr->size; i++) {
+        for (int j = 0; j < CORE_SIGNATURE_COUNT; j++) {
+            ltuples_push(arr, sigs[CORE_SIGNATURE_COUNT * i + j], record, lps_ptr->cores[i].start);
+        }
+    }
+}
+
+int ltuples_add_lcpt(struct ltuples *arr, FILE *in) {
+    struct lps record;
+    int record_count = 0, status;
+
+    while ((status = read_lps(&record, in)) == 1) {
+        ltuples_add_lps(arr, &record, record_count);
+        free_lps(&record);
+        record_count++;
+    }
+
+    return status < 0 ? -1 : record_count;
+}
+
+static void *count_digits(void *arg) {
+    struct sort_task *task = (struct sort_task *)arg;
+
+    memset(task->counts, 0, sizeof(task->counts));
+    for (uint64_t i = task->begin; i < task->end; i++) {
+        task->counts[(task->src[i].label >> task->shift) & (SORT_RADIX_SIZE - 1)]++;
+    }
+
+    return NULL;
+}
+
+static void *scatter_digits(void *arg) {
+    struct sort_task *task = (struct sort_task *)arg;
+
+    for (uint64_t i = task->begin; i < task->end; i++) {
+        task->dst[task->counts[(task->src[i].label >> task->shift) & (SORT_RADIX_SIZE - 1)]++] = task->src[i];
+    }
+
+    return NULL;
+}
+
+void ltuples_sort(struct ltuples *arr, int thread_count) {
+
+    if (arr->size < 2) {
+        return;
+    }
+
+    if (thread_count < 1 || arr->size < SORT_PARALLEL_THRESHOLD) {
+        thread_count = 1;
+    }
+
+    struct ltuple *src = arr->tuples;
+    struct ltuple *dst = (struct ltuple *)malloc(arr->size * sizeof(struct ltuple));
+    struct sort_task *tasks = (struct sort_task *)malloc(thread_count * sizeof(struct sort_task));
+
+    uint64_t slice = (arr->size + thread_count - 1) / thread_count;
+
+    for (int shift = 0; shift < (int)(8 * sizeof(ulabel)); shift += SORT_RADIX_BITS) {
+
+        for (int t = 0; t < thread_count; t++) {
+            tasks[t].src = src;
+            tasks[t].dst = dst;
+            tasks[t].begin = minimum(t * slice, arr->size);
+            tasks[t].end = minimum((t + 1) * slice, arr->size);
+            tasks[t].shift = shift;
+        }
+
+        run_pool(count_digits, tasks, sizeof(struct sort_task), thread_count);
+
+        // convert counts into scatter offsets, skipping the pass if it is a no-op
+        uint64_t offset = 0;
+        int skip = 0;
+
+        for (int digit = 0; digit < SORT_RADIX_SIZE; digit++) {
+            uint64_t digit_total = 0;
+            for (int t = 0; t < thread_count; t++) {
+                uint64_t count = tasks[t].counts[digit];
+                tasks[t].counts[digit] = offset;
+                offset += count;
+                digit_total += count;
+            }
+            if (digit_total == arr->size) {
+                skip = 1;
+                break;
+            }
+        }
+
+        if (skip) {
+            continue;
+        }
+
+        run_pool(scatter_digits, tasks, sizeof(struct sort_task), thread_count);
+
+        struct ltuple *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    // `src` holds the sorted tuples after the last swap
+    free(dst);
+    arr->tuples = src;
+    arr->capacity = arr->size;
+
+    free(tasks);
+}
+
+/**
+ * @brief Sorts the tuples and writes them into a new temporary file.
+ *
+ * @return 0 on success, -1 if the temporary file cannot be created or written.
+ */
+static int spill_run(struct ltuples *arr, struct sort_run **runs, int *run_count, int thread_count) {
+
+    FILE *file = tmpfile();
+    if (!file) {
+        fprintf(stderr, "Error creating temporary file for sorted run\n");
+        return -1;
+    }
+
+    ltuples_sort(arr, thread_count);
+
+    if (fwrite(arr->tuples, sizeof(struct ltuple), arr->size, file) != arr->size) {
+        fprintf(stderr, "Error writing sorted run\n");
+        fclose(file);
+        return -1;
+    }
+    rewind(file);
+
+    *runs = (struct sort_run *)realloc(*runs, (*run_count + 1) * sizeof(struct sort_run));
+    (*runs)[*run_count].file = file;
+    (*run_count)++;
+    arr->size = 0;
+
+    return 0;
+}
+
+static int run_less(const struct sort_run *runs, int lhs, int rhs) {
+    if (runs[lhs].head.label != runs[rhs].head.label) {
+        return runs[lhs].head.label < runs[rhs].head.label;
+    }
+    return lhs < rhs;
+}
+
+static void sift_down(const struct sort_run *runs, int *heap, int heap_size, int index) {
+    while (1) {
+        int smallest = index, left = 2 * index + 1, right = 2 * index + 2;
+
+        if (left < heap_size && run_less(runs, heap[left], heap[smallest])) {
+            smallest = left;
+        }
+        if (right < heap_size && run_less(runs, heap[right], heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+
+        int temp = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = temp;
+        index = smallest;
+    }
+}
+
+/**
+ * @brief Merges the sorted runs into `out` in label order.
+ *
+ * @return Number of tuples written, or -1 on a write error.
+ */
+static int64_t merge_runs(struct sort_run *runs, int run_count, FILE *out) {
+
+    int *heap = (int *)malloc(run_count * sizeof(int));
+    int heap_size = 0;
+    int64_t written = 0;
+
+    for (int r = 0; r < run_count; r++) {
+        if (fread(&(runs[r].head), sizeof(struct ltuple), 1, runs[r].file) == 1) {
+            heap[heap_size++] = r;
+        }
+    }
+
+    for (int i = heap_size / 2 - 1; 0 <= i; i--) {
+        sift_down(runs, heap, heap_size, i);
+    }
+
+    while (heap_size) {
+        struct sort_run *run = &(runs[heap[0]]);
+
+        if (fwrite(&(run->head), sizeof(struct ltuple), 1, out) != 1) {
+            free(heap);
+            return -1;
+        }
+        written++;
+
+        if (fread(&(run->head), sizeof(struct ltuple), 1, run->file) != 1) {
+            heap[0] = heap[--heap_size];
+        }
+        sift_down(runs, heap, heap_size, 0);
+    }
+
+    free(heap);
+    return written;
+}
+
+int64_t ltuples_sort_lcpt(FILE *in, FILE *out, uint64_t memory_budget, int thread_count) {
+
+    // the radix sort needs a scratch buffer as large as the tuples
+    uint64_t capacity = memory_budget / (2 * sizeof(struct ltuple));
+    if (capacity < 1) {
+        capacity = 1;
+    }
+
+    struct ltuples arr;
+    init_ltuples(&arr, capacity);
+
+    struct sort_run *runs = NULL;
+    int run_count = 0, status;
+    int64_t result = 0;
+    uint32_t record_index = 0;
+    struct lps record;
+
+    while ((status = read_lps(&record, in)) == 1) {
+        for (int i = 0; i < record.size; i++) {
+            if (arr.size == capacity && spill_run(&arr, &runs, &run_count, thread_count) < 0) {
+                free_lps(&record);
+                result = -1;
+                goto cleanup;
+            }
+            ltuples_push(&arr, record.cores[i].label, record_index, record.cores[i].start);
+        }
+        free_lps(&record);
+        record_index++;
+    }
+
+    if (status < 0) {
+        result = -1;
+        goto cleanup;
+    }
+
+    if (run_count == 0) {
+        ltuples_sort(&arr, thread_count);
+        if (fwrite(arr.tuples, sizeof(struct ltuple), arr.size, out) != arr.size) {
+            result = -1;
+            goto cleanup;
+        }
+        result = arr.size;
+        goto cleanup;
+    }
+
+    if (arr.size && spill_run(&arr, &runs, &run_count, thread_count) < 0) {
+        result = -1;
+        goto cleanup;
+    }
+
+    // release the in-memory tuples before merging
+    free_ltuples(&arr);
+
+    result = merge_runs(runs, run_count, out);
+
+cleanup:
+    for (int r = 0; r < run_count; r++) {
+        fclose(runs[r].file);
+    }
+    free(runs);
+    free_ltuples(&arr);
+
+    return result;
+}
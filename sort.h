@@ -0,0 +1,146 @@
+/**
+ * @file sort.h
+ * @brief Extraction and sorting of (label, position, record) tuples of LCP cores.
+ *
+ * Building a label index, a sketch or a diff over LCP cores requires the cores to be
+ * grouped by their labels. This file declares the `ltuple` struct, which holds the
+ * label of a core together with its position and the record (e.g. chromosome or
+ * read) it belongs to, and the routines to collect and sort such tuples.
+ *
+ * Key functionalities include:
+ * - Extracting tuples from `lps` objects or from `.lcpt` streams.
+ * - Sorting tuples by label with a stable, multi-threaded LSD radix sort.
+ * - Sorting `.lcpt` streams larger than the available memory by spilling sorted
+ * runs to temporary files and merging them afterwards.
+ *
+ * Since the radix sort is stable, tuples sharing the same label keep the order in
+ * which they are added, i.e. they remain sorted by record and position when the
+ * records are added in order.
+ *
+ * @see lps.h
+ *
+ * @struct ltuple
+ * @struct ltuples
+ *
+ */
+
+#ifndef SORT_H
+#define SORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+#define SORT_PARALLEL_THRESHOLD 65536
+
+struct ltuple {
+    ulabel label;
+    uint32_t record;
+    uint64_t position;
+};
+
+struct ltuples {
+    uint64_t size;
+    uint64_t capacity;
+    struct ltuple *tuples;
+};
+
+/**
+ * @brief Initializes an empty tuple array.
+ *
+ * @param arr Pointer to the tuple array to initialize.
+ * @param capacity Initial number of tuples that can be stored without reallocation.
+ */
+void init_ltuples(struct ltuples *arr, uint64_t capacity);
+
+/**
+ * @brief Frees the memory allocated for the tuples.
+ *
+ * @param arr Pointer to the tuple array to deallocate.
+ */
+void free_ltuples(struct ltuples *arr);
+
+/**
+ * @brief Appends a single tuple to the array, growing it if necessary.
+ *
+ * @param arr Pointer to the tuple array.
+ * @param label Label of the core.
+ * @param record Index of the record the core belongs to.
+ * @param position Start position of the core.
+ */
+void ltuples_push(struct ltuples *arr, ulabel label, uint32_t record, uint64_t position);
+
+/**
+ * @brief Appends the (label, start, record) tuples of all cores of an `lps` object.
+ *
+ * @param arr Pointer to the tuple array.
+ * @param lps_ptr The `lps` object whose cores will be extracted.
+ * @param record Index of the record assigned to the extracted tuples.
+ */
+void ltuples_add_lps(struct ltuples *arr, const struct lps *lps_ptr, uint32_t record);
+
+/**
+ * @brief Appends the (signature, start, record) tuples of all cores of an `lps` object.
+ *
+ * Each core contributes `CORE_SIGNATURE_COUNT` tuples, one per signature computed by
+ * `lps_deepen_sigs`. An index built from these tuples matches cores that differ in
+ * a single child.
+ *
+ * @param arr Pointer to the tuple array.
+ * @param lps_ptr The `lps` object whose cores will be extracted.
+ * @param sigs Signatures of the cores as computed by `lps_deepen_sigs`.
+ * @param record Index of the record assigned to the extracted tuples.
+ */
+void ltuples_add_sigs(struct ltuples *arr, const struct lps *lps_ptr, const ulabel *sigs, uint32_t record);
+
+/**
+ * @brief Appends the tuples of all records of a `.lcpt` stream.
+ *
+ * Records are numbered in the order they appear in the stream, starting from 0.
+ *
+ * @param arr Pointer to the tuple array.
+ * @param in File pointer to the `.lcpt` stream.
+ * @return Number of records read, or -1 if the stream is malformed.
+ */
+int ltuples_add_lcpt(struct ltuples *arr, FILE *in);
+
+/**
+ * @brief Sorts the tuples by their labels using a stable LSD radix sort.
+ *
+ * Each pass counts the digits of the slices of the array in parallel, computes
+ * the scatter offsets per thread and digit, and scatters the slices in parallel.
+ * Passes in which all tuples share the same digit are skipped.
+ *
+ * @param arr Pointer to the tuple array to sort.
+ * @param thread_count Number of threads to be used.
+ */
+void ltuples_sort(struct ltuples *arr, int thread_count);
+
+/**
+ * @brief Sorts all tuples of a `.lcpt` stream by label within a memory budget.
+ *
+ * Tuples are collected until the budget is exhausted, then sorted and spilled to
+ * a temporary file as a run. Once the stream is consumed, the runs are merged with
+ * a k-way merge and written to `out` as a raw array of `struct ltuple`. If all the
+ * tuples fit in the budget, no temporary file is created. The output is identical
+ * to reading the whole stream with `ltuples_add_lcpt` and sorting it.
+ *
+ * @param in File pointer to the `.lcpt` stream.
+ * @param out File pointer where the sorted tuples will be written.
+ * @param memory_budget Maximum number of bytes to be used for the tuples.
+ * @param thread_count Number of threads to be used while sorting the runs.
+ * @return Number of tuples written, or -1 on error.
+ */
+int64_t ltuples_sort_lcpt(FILE *in, FILE *out, uint64_t memory_budget, int thread_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
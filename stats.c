@@ -0,0 +1,356 @@
+#include "stats.h"
+#include "batch.h"
+#include "pool.h"
+#include "stream.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct stats_link {
+    struct level_stats *level;
+    struct deepen_stage *next;
+};
+
+struct stats_context {
+    const char **seqs;
+    const int *lengths;
+    const int *order;
+    int count;
+    int next_task;
+};
+
+struct stats_worker {
+    struct stats_context *ctx;
+    struct lcp_stats stats;
+};
+
+/**
+ * @brief Returns the histogram bucket of a length: lengths below `STATS_EXACT_LENGTH`
+ * have their own bucket, longer ones share `STATS_SUB_BUCKETS` buckets per power of two.
+ */
+static inline int length_bucket(uint64_t length) {
+    if (length < STATS_EXACT_LENGTH) {
+        return (int)length;
+    }
+    int msb = 63 - __builtin_clzll(length);
+    int sub = (int)((length >> (msb - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+    return STATS_EXACT_LENGTH + (msb - STATS_SUB_BITS - 1) * STATS_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Returns the smallest length of a histogram bucket.
+ */
+static inline uint64_t bucket_length(int bucket) {
+    if (bucket < STATS_EXACT_LENGTH) {
+        return bucket;
+    }
+    int msb = (bucket - STATS_EXACT_LENGTH) / STATS_SUB_BUCKETS + STATS_SUB_BITS + 1;
+    uint64_t sub = (bucket - STATS_EXACT_LENGTH) % STATS_SUB_BUCKETS;
+    return (STATS_SUB_BUCKETS + sub) << (msb - STATS_SUB_BITS);
+}
+
+static void init_level_stats(struct level_stats *level) {
+    memset(level, 0, sizeof(struct level_stats));
+    level->min_length = UINT64_MAX;
+}
+
+/**
+ * @brief Records the length and the label of a core.
+ */
+static inline void record_core(struct level_stats *level, const struct core *cr) {
+    uint64_t length = cr->end - cr->start;
+
+    level->core_count++;
+    level->total_length += length;
+    level->min_length = minimum(level->min_length, length);
+    level->max_length = maximum(level->max_length, length);
+    level->buckets[length_bucket(length)]++;
+
+    // the first bits of the hash select the register, the rank of the rest is kept
+    uint64_t h = lcp_mix64(cr->label);
+    uint64_t rest = h << STATS_REGISTER_BITS;
+    uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - STATS_REGISTER_BITS + 1;
+    uint8_t *reg = &(level->registers[h >> (64 - STATS_REGISTER_BITS)]);
+    *reg = maximum(*reg, rank);
+}
+
+void init_lcp_stats(struct lcp_stats *stats, int lcp_level) {
+    stats->lcp_level = lcp_level < 1 ? 1 : lcp_level;
+    stats->sequence_count = 0;
+    stats->base_count = 0;
+    stats->levels = (struct level_stats *)malloc(stats->lcp_level * sizeof(struct level_stats));
+    for (int i = 0; i < stats->lcp_level; i++) {
+        init_level_stats(&(stats->levels[i]));
+    }
+}
+
+void free_lcp_stats(struct lcp_stats *stats) {
+    free(stats->levels);
+    stats->levels = NULL;
+    stats->lcp_level = 0;
+}
+
+/**
+ * @brief Callback recording the cores emitted by a stage and passing them to the stage
+ * of the next level, or freeing them after the last level.
+ */
+static void record_emit(struct core *cr, void *arg) {
+    struct stats_link *link = (struct stats_link *)arg;
+    record_core(link->level, cr);
+    if (link->next) {
+        deepen_stage_push(link->next, cr);
+    } else {
+        free_core(cr);
+    }
+}
+
+/**
+ * @brief Records the level 1 cores in [begin, end) of `cores` and passes them to the
+ * first stage, or frees them if there is no deeper level.
+ */
+static void pass_cores(struct stats_link *first, struct core *cores, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        record_core(first->level, &(cores[i]));
+    }
+    if (first->next) {
+        deepen_stage_push_cores(first->next, cores + begin, end - begin);
+    } else {
+        for (int i = begin; i < end; i++) {
+            free_core(&(cores[i]));
+        }
+    }
+}
+
+/**
+ * @brief Frees the cores in [begin, end) of `cores`.
+ */
+static void drop_cores(struct core *cores, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        free_core(&(cores[i]));
+    }
+}
+
+void lcp_stats_add(struct lcp_stats *stats, const char *seq, int len) {
+    stats->sequence_count++;
+    stats->base_count += len;
+
+    // one stage per deeper level, recording the cores it emits
+    int stage_count = stats->lcp_level - 1;
+    struct deepen_stage *stages = (struct deepen_stage *)malloc((stage_count ? stage_count : 1) * sizeof(struct deepen_stage));
+    struct stats_link *links = (struct stats_link *)malloc((stage_count ? stage_count : 1) * sizeof(struct stats_link));
+
+    for (int i = 0; i < stage_count; i++) {
+        links[i].level = &(stats->levels[i + 1]);
+        links[i].next = i + 1 < stage_count ? &(stages[i + 1]) : NULL;
+        init_deepen_stage(&(stages[i]), i + 1, record_emit, &(links[i]));
+    }
+
+    struct stats_link first = {&(stats->levels[0]), stage_count ? &(stages[0]) : NULL};
+
+    // the cores of the last window that may still be replaced by those of the next one
+    int held_begin = 0;
+    int held_end = minimum(len, STATS_WINDOW_SIZE + STATS_WINDOW_OVERLAP);
+    struct lps held;
+    init_lps_offset(&held, seq, held_end, 0);
+
+    for (int begin = STATS_WINDOW_SIZE; held_end < len; begin += STATS_WINDOW_SIZE) {
+        int end = len - begin <= STATS_WINDOW_SIZE + STATS_WINDOW_OVERLAP ? len : begin + STATS_WINDOW_SIZE + STATS_WINDOW_OVERLAP;
+        int i, j;
+
+        struct lps window;
+        init_lps_offset(&window, seq + begin, end - begin, begin);
+
+        if (batch_join(held.cores, held.size, window.cores, window.size, begin + STATS_WINDOW_OVERLAP / 2, &i, &j)) {
+            // the held cores before the joining core are final
+            pass_cores(&first, held.cores, 0, i);
+            drop_cores(held.cores, i, held.size);
+            drop_cores(window.cores, 0, j);
+            memmove(window.cores, window.cores + j, (window.size - j) * sizeof(struct core));
+            window.size -= j;
+            free(held.cores);
+            held = window;
+            held_begin = begin;
+        } else {
+            // the windows disagree, e.g. inside a long run, so the held window is grown
+            free_lps(&window);
+            init_lps_offset(&window, seq + held_begin, end - held_begin, held_begin);
+
+            // cores before the first held one have been passed on already
+            int k = 0;
+            while (held.size && k < window.size && window.cores[k].start < held.cores[0].start) {
+                k++;
+            }
+            drop_cores(window.cores, 0, k);
+            memmove(window.cores, window.cores + k, (window.size - k) * sizeof(struct core));
+            window.size -= k;
+            free_lps(&held);
+            held = window;
+        }
+
+        held_end = end;
+    }
+
+    pass_cores(&first, held.cores, 0, held.size);
+    free(held.cores);
+
+    for (int i = 0; i < stage_count; i++) {
+        deepen_stage_finish(&(stages[i]));
+    }
+
+    free(stages);
+    free(links);
+}
+
+void lcp_stats_merge(struct lcp_stats *dst, const struct lcp_stats *src) {
+    dst->sequence_count += src->sequence_count;
+    dst->base_count += src->base_count;
+
+    for (int l = 0; l < dst->lcp_level && l < src->lcp_level; l++) {
+        struct level_stats *a = &(dst->levels[l]);
+        const struct level_stats *b = &(src->levels[l]);
+
+        a->core_count += b->core_count;
+        a->total_length += b->total_length;
+        a->min_length = minimum(a->min_length, b->min_length);
+        a->max_length = maximum(a->max_length, b->max_length);
+        for (int i = 0; i < STATS_BUCKET_COUNT; i++) {
+            a->buckets[i] += b->buckets[i];
+        }
+        for (int i = 0; i < STATS_REGISTER_COUNT; i++) {
+            a->registers[i] = maximum(a->registers[i], b->registers[i]);
+        }
+    }
+}
+
+static void *stats_work(void *arg) {
+    struct stats_worker *worker = (struct stats_worker *)arg;
+    struct stats_context *ctx = worker->ctx;
+    int i;
+
+    while ((i = __atomic_fetch_add(&(ctx->next_task), 1, __ATOMIC_RELAXED)) < ctx->count) {
+        int s = ctx->order[i];
+        lcp_stats_add(&(worker->stats), ctx->seqs[s], ctx->lengths[s]);
+    }
+
+    return NULL;
+}
+
+void lcp_stats_add_batch(struct lcp_stats *stats, const char **seqs, const int *lengths, int count, int thread_count) {
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    // sequences are taken longest first, as a chromosome can outlast all the contigs of an assembly
+    uint64_t *sizes = (uint64_t *)malloc((count ? count : 1) * sizeof(uint64_t));
+    for (int i = 0; i < count; i++) {
+        sizes[i] = lengths[i];
+    }
+    int *order = pool_order(sizes, count);
+    free(sizes);
+
+    struct stats_context ctx = {seqs, lengths, order, count, 0};
+    struct stats_worker *workers = (struct stats_worker *)malloc(thread_count * sizeof(struct stats_worker));
+
+    for (int t = 0; t < thread_count; t++) {
+        workers[t].ctx = &ctx;
+        init_lcp_stats(&(workers[t].stats), stats->lcp_level);
+    }
+
+    run_pool(stats_work, workers, sizeof(struct stats_worker), thread_count);
+
+    for (int t = 0; t < thread_count; t++) {
+        lcp_stats_merge(stats, &(workers[t].stats));
+        free_lcp_stats(&(workers[t].stats));
+    }
+
+    free(workers);
+    free(order);
+}
+
+uint64_t level_stats_distinct(const struct level_stats *level) {
+    if (!level->core_count) {
+        return 0;
+    }
+
+    double m = STATS_REGISTER_COUNT, sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < STATS_REGISTER_COUNT; i++) {
+        sum += ldexp(1.0, -level->registers[i]);
+        zeros += level->registers[i] == 0;
+    }
+
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+    // linear counting is more accurate for small cardinalities
+    if (estimate <= 2.5 * m && zeros) {
+        estimate = m * log(m / zeros);
+    }
+
+    uint64_t distinct = (uint64_t)(estimate + 0.5);
+    return minimum(distinct, level->core_count);
+}
+
+uint64_t level_stats_quantile(const struct level_stats *level, double q) {
+    if (!level->core_count) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(q * (level->core_count - 1));
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_BUCKET_COUNT; i++) {
+        seen += level->buckets[i];
+        if (rank < seen) {
+            return maximum(bucket_length(i), level->min_length);
+        }
+    }
+
+    return level->max_length;
+}
+
+int write_lcp_stats_tsv(const struct lcp_stats *stats, FILE *out) {
+    int ok = fprintf(out, "level\tcores\tdistinct\tmean_length\tmin_length\tmedian_length\tp90_length\tmax_length\tbases_per_core\n") > 0;
+
+    for (int l = 0; l < stats->lcp_level; l++) {
+        const struct level_stats *level = &(stats->levels[l]);
+        uint64_t count = level->core_count;
+
+        ok &= fprintf(out, "%d\t%" PRIu64 "\t%" PRIu64 "\t%.2f\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.2f\n", l + 1,
+                      count,
+                      level_stats_distinct(level),
+                      count ? (double)level->total_length / count : 0.0,
+                      (count ? level->min_length : 0),
+                      level_stats_quantile(level, 0.5),
+                      level_stats_quantile(level, 0.9),
+                      level->max_length,
+                      count ? (double)stats->base_count / count : 0.0) > 0;
+    }
+
+    return ok;
+}
+
+int write_lcp_stats_json(const struct lcp_stats *stats, FILE *out) {
+    int ok = fprintf(out, "{\"sequences\":%" PRIu64 ",\"bases\":%" PRIu64 ",\"levels\":[",
+                     stats->sequence_count, stats->base_count) > 0;
+
+    for (int l = 0; l < stats->lcp_level; l++) {
+        const struct level_stats *level = &(stats->levels[l]);
+        uint64_t count = level->core_count;
+
+        ok &= fprintf(out, "%s{\"level\":%d,\"cores\":%" PRIu64 ",\"distinct\":%" PRIu64 ",\"mean_length\":%.2f,\"min_length\":%" PRIu64 ","
+                      "\"median_length\":%" PRIu64 ",\"p90_length\":%" PRIu64 ",\"max_length\":%" PRIu64 ",\"bases_per_core\":%.2f}",
+                      l ? "," : "", l + 1,
+                      count,
+                      level_stats_distinct(level),
+                      count ? (double)level->total_length / count : 0.0,
+                      (count ? level->min_length : 0),
+                      level_stats_quantile(level, 0.5),
+                      level_stats_quantile(level, 0.9),
+                      level->max_length,
+                      count ? (double)stats->base_count / count : 0.0) > 0;
+    }
+
+    ok &= fprintf(out, "]}\n") > 0;
+
+    return ok;
+}
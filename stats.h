@@ -0,0 +1,169 @@
+/**
+ * @file stats.h
+ * @brief Per-level statistics of the cores of sequences without storing the cores.
+ *
+ * Many analyses only need summaries of the cores at each level, e.g. how many cores
+ * there are, how long they are and how many distinct labels they have, as reported
+ * by the experiment programs. Keeping all the cores of all levels, or writing them
+ * to `.lcpt` files, is not needed for that.
+ *
+ * Key functionalities include:
+ * - Parsing each sequence in windows of `STATS_WINDOW_SIZE` bases overlapping by
+ * `STATS_WINDOW_OVERLAP` bases, joined where their cores agree as in `batch.h`, so
+ * the level 1 cores of a sequence are never held all at once.
+ * - Deepening each sequence through a chain of stages (see `stream.h`), recording
+ * every core of every level as it is emitted, so only the cores that the next
+ * level still needs are kept.
+ * - Collecting the core count, the total length and a log-linear histogram of the
+ * lengths of the cores of each level, from which length quantiles are estimated.
+ * - Estimating the number of distinct labels of each level with a HyperLogLog
+ * sketch of `STATS_REGISTER_COUNT` registers.
+ * - Processing many sequences with multiple threads, each one collecting its own
+ * statistics, which are merged at the end.
+ * - Writing the statistics as TSV or JSON.
+ *
+ * The histogram counts lengths below `STATS_EXACT_LENGTH` exactly. Longer lengths
+ * are grouped into `STATS_SUB_BUCKETS` buckets per power of two, so quantiles have
+ * a relative error below `1 / STATS_SUB_BUCKETS`. The distinct label estimates
+ * have a standard error of about `1.04 / sqrt(STATS_REGISTER_COUNT)`.
+ *
+ * @see batch.h
+ * @see stream.h
+ *
+ * @struct level_stats
+ * @struct lcp_stats
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_REGISTER_BITS     12
+#define STATS_REGISTER_COUNT    (1 << STATS_REGISTER_BITS)
+#define STATS_SUB_BITS          4
+#define STATS_SUB_BUCKETS       (1 << STATS_SUB_BITS)
+#define STATS_EXACT_LENGTH      (2 * STATS_SUB_BUCKETS)
+#define STATS_BUCKET_COUNT      (STATS_EXACT_LENGTH + (64 - STATS_SUB_BITS - 1) * STATS_SUB_BUCKETS)
+#define STATS_WINDOW_SIZE       65536
+#define STATS_WINDOW_OVERLAP    4096
+
+struct level_stats {
+    uint64_t core_count;
+    uint64_t total_length;
+    uint64_t min_length;
+    uint64_t max_length;
+    uint64_t buckets[STATS_BUCKET_COUNT];
+    uint8_t registers[STATS_REGISTER_COUNT];
+};
+
+struct lcp_stats {
+    int lcp_level;
+    uint64_t sequence_count;
+    uint64_t base_count;
+    struct level_stats *levels;
+};
+
+/**
+ * @brief Initializes empty statistics for the levels from 1 to `lcp_level`.
+ *
+ * @param stats Pointer to the statistics to initialize.
+ * @param lcp_level The deepest level.
+ */
+void init_lcp_stats(struct lcp_stats *stats, int lcp_level);
+
+/**
+ * @brief Frees the memory allocated for the statistics.
+ *
+ * @param stats Pointer to the statistics to deallocate.
+ */
+void free_lcp_stats(struct lcp_stats *stats);
+
+/**
+ * @brief Adds the cores of all levels of a sequence to the statistics.
+ *
+ * The cores are identical to those of `init_lps` followed by `lps_deepen`, but only
+ * the level 1 cores of the current window and the cores that the next levels still
+ * need are stored. If two windows do not agree on their overlap, e.g. inside a run
+ * longer than the overlap, the former is grown to the end of the latter.
+ *
+ * @param stats Pointer to the statistics.
+ * @param seq The sequence.
+ * @param len Length of the sequence.
+ */
+void lcp_stats_add(struct lcp_stats *stats, const char *seq, int len);
+
+/**
+ * @brief Adds the cores of many sequences to the statistics with multiple threads.
+ *
+ * The result is identical to adding the sequences one by one with `lcp_stats_add`.
+ *
+ * @param stats Pointer to the statistics.
+ * @param seqs The sequences.
+ * @param lengths Lengths of the sequences.
+ * @param count Number of sequences.
+ * @param thread_count Number of threads to be used.
+ */
+void lcp_stats_add_batch(struct lcp_stats *stats, const char **seqs, const int *lengths, int count, int thread_count);
+
+/**
+ * @brief Merges the statistics of `src` into `dst`. Both must have the same depth.
+ *
+ * @param dst Pointer to the statistics to merge into.
+ * @param src Pointer to the statistics to merge.
+ */
+void lcp_stats_merge(struct lcp_stats *dst, const struct lcp_stats *src);
+
+/**
+ * @brief Estimates the number of distinct labels of the cores of a level.
+ *
+ * @param level Pointer to the statistics of the level.
+ * @return The estimated number of distinct labels.
+ */
+uint64_t level_stats_distinct(const struct level_stats *level);
+
+/**
+ * @brief Estimates a quantile of the lengths of the cores of a level.
+ *
+ * @param level Pointer to the statistics of the level.
+ * @param q The quantile, between 0 and 1.
+ * @return The smallest length of the bucket holding the quantile, or 0 if there is
+ * no core.
+ */
+uint64_t level_stats_quantile(const struct level_stats *level, double q);
+
+/**
+ * @brief Writes one line per level in TSV format, after a header line.
+ *
+ * The columns are the level, the number of cores, the estimated number of distinct
+ * labels, the mean, minimum, median, 90th percentile and maximum core lengths, and
+ * the number of bases per core.
+ *
+ * @param stats Pointer to the statistics.
+ * @param out File pointer to the output.
+ * @return 1 on success, 0 otherwise.
+ */
+int write_lcp_stats_tsv(const struct lcp_stats *stats, FILE *out);
+
+/**
+ * @brief Writes the statistics as a JSON object with the same fields as the TSV
+ * output, the levels being an array of objects.
+ *
+ * @param stats Pointer to the statistics.
+ * @param out File pointer to the output.
+ * @return 1 on success, 0 otherwise.
+ */
+int write_lcp_stats_json(const struct lcp_stats *stats, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,463 @@
+#include "stream.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_CORE UINT64_MAX
+
+/**
+ * @brief Copies a core, expanding its bit representation if it is run-length encoded.
+ */
+static void copy_core(struct core *dst, const struct core *src) {
+    ubit_size block_number = (src->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+    ublock *bit_rep = (ublock *)malloc((block_number ? block_number : 1) * sizeof(ublock));
+    for (ubit_size i = 0; i < block_number; i++) {
+        bit_rep[i] = core_block(src, i);
+    }
+    init_core4(dst, src->bit_size, bit_rep, src->label, src->start, src->end);
+}
+
+/**
+ * @brief Returns the buffered core at the given position of the stream.
+ */
+static inline struct core *core_at(struct deepen_stage *stage, uint64_t index) {
+    return stage->window + (index - stage->window_first);
+}
+
+void init_deepen_stage(struct deepen_stage *stage, int level, void (*emit)(struct core *cr, void *arg), void *arg) {
+    stage->level = level;
+    for (int i = 0; i < DCT_ITERATION_COUNT; i++) {
+        stage->held[i].bit_rep = NULL;
+    }
+    stage->window = NULL;
+    stage->window_first = 0;
+    stage->window_begin = 0;
+    stage->window_size = 0;
+    stage->window_capacity = 0;
+    stage->dct_end = 0;
+    stage->it1 = DCT_ITERATION_COUNT;
+    stage->it2 = NO_CORE;
+    stage->run_end = 0;
+    stage->input_count = 0;
+    stage->output_count = 0;
+    stage->batch_size = STREAM_BATCH_SIZE;
+    stage->emit = emit;
+    stage->arg = arg;
+}
+
+/**
+ * @brief Compresses the cores pushed since the last batch, as `lcp_dct` does.
+ *
+ * Each iteration compresses the batch from right to left. The first core of the batch
+ * is compressed against the copy of the last core of the previous batch taken before
+ * the same iteration.
+ */
+static void stage_dct(struct deepen_stage *stage) {
+    uint64_t begin = stage->dct_end, end = stage->window_first + stage->window_size;
+
+    if (begin == end) {
+        return;
+    }
+
+    for (uint64_t dct_index = 0; dct_index < DCT_ITERATION_COUNT; dct_index++) {
+        struct core last;
+        copy_core(&last, core_at(stage, end - 1));
+
+        for (uint64_t i = end - 1; begin <= i && dct_index < i; i--) {
+            const struct core *left = begin < i ? core_at(stage, i - 1) : &(stage->held[dct_index]);
+            core_compress(left, core_at(stage, i));
+        }
+
+        free_core(&(stage->held[dct_index]));
+        stage->held[dct_index] = last;
+    }
+
+    stage->dct_end = end;
+}
+
+/**
+ * @brief Creates the core spanning `distance` buffered cores starting at `begin` and
+ * passes it to the callback of the stage.
+ *
+ * As in `parse3`, which builds the new cores over the old ones, the bit representation
+ * of the oldest core that is no longer needed, if any, is released by `init_core3` right
+ * before the new one is allocated. `keep` is the first core that may still be needed.
+ */
+static inline void stage_emit(struct deepen_stage *stage, uint64_t begin, uint64_t distance, uint64_t keep) {
+    struct core cr;
+    cr.bit_rep = NULL;
+    if (stage->window_begin < keep) {
+        cr.bit_rep = core_at(stage, stage->window_begin)->bit_rep;
+        stage->window_begin++;
+    }
+    init_core3(&cr, core_at(stage, begin), distance);
+    stage->output_count++;
+    stage->emit(&cr, stage->arg);
+}
+
+/**
+ * @brief Finds the cores of the next level among the compressed cores, as `parse3` does.
+ *
+ * Unless the stream has ended, a position is only evaluated once the three cores
+ * following it are compressed, and a run of equal cores reaching the end of the
+ * buffer is left for the next batch.
+ */
+static void stage_parse(struct deepen_stage *stage, int final) {
+
+    // the buffer does not move while parsing, so it is addressed relative to its start
+    struct core *window = stage->window;
+    uint64_t first = stage->window_first;
+
+    uint64_t end = stage->dct_end;
+    uint64_t it1 = stage->it1;
+    uint64_t it2 = stage->it2;
+
+    for (; it1 + 2 < end; it1++) {
+
+        if (!final && end <= it1 + 3) {
+            break;
+        }
+
+        struct core *curr = window + (it1 - first);
+
+        // skip invalid character
+        if (core_eq(curr, curr+1)) {
+            continue;
+        }
+
+        // check for RINT core
+        if (core_eq(curr+1, curr+2)) {
+
+            // the cores up to `run_end` are known to be equal to their predecessors
+            uint64_t temp = maximum(it1 + 2, stage->run_end);
+            while (temp < end && core_eq(window + (temp - 1 - first), window + (temp - first))) {
+                temp++;
+            }
+            if (temp != end) {
+                // check if there is any SSEQ cores left behind
+                if (it2 < it1) {
+                    stage_emit(stage, it2-1, it1-it2+2, minimum(it1, it2) - 1);
+                }
+
+                // create RINT core
+                it2 = temp + 1;
+                stage_emit(stage, it1, it2-it1, minimum(it1, it2) - 1);
+
+                continue;
+            }
+            if (!final) {
+                stage->run_end = temp;
+                break;
+            }
+        }
+
+        // check for LMIN
+        if (core_gt(curr, curr+1) && core_lt(curr+1, curr+2)) {
+
+            // check if there is any SSEQ cores left behind
+            if (it2 < it1) {
+                stage_emit(stage, it2-1, it1-it2+2, minimum(it1, it2) - 1);
+            }
+
+            // create LMIN core
+            it2 = it1 + 3;
+            stage_emit(stage, it1, it2-it1, minimum(it1, it2) - 1);
+
+            continue;
+        }
+
+        if (it1 == DCT_ITERATION_COUNT) {
+            continue;
+        }
+
+        // check for LMAX
+        if (it1+3 < end &&
+            core_lt(curr, curr+1) &&
+            core_gt(curr+1, curr+2) &&
+            core_leq(curr-1, curr) &&
+            core_geq(curr+2, curr+3)) {
+
+            // check if there is any SSEQ cores left behind
+            if (it2 < it1) {
+                stage_emit(stage, it2-1, it1-it2+2, minimum(it1, it2) - 1);
+            }
+
+            // create LMAX core
+            it2 = it1 + 3;
+            stage_emit(stage, it1, it2-it1, minimum(it1, it2) - 1);
+
+            continue;
+        }
+    }
+
+    stage->it1 = it1;
+    stage->it2 = it2;
+}
+
+/**
+ * @brief Frees the buffered cores that no new core can start from, i.e. the cores
+ * before the predecessor of the next position and before the first core of a
+ * pending SSEQ core.
+ */
+static void stage_discard(struct deepen_stage *stage) {
+    uint64_t keep = minimum(stage->it1 - 1, stage->it2 - 1);
+    keep = minimum(keep, stage->dct_end);
+
+    for (; stage->window_begin < keep; stage->window_begin++) {
+        free_core(core_at(stage, stage->window_begin));
+    }
+}
+
+/**
+ * @brief Makes room for `count` more cores in the buffer of a stage, moving the retained
+ * cores to the front before growing it.
+ */
+static void stage_reserve(struct deepen_stage *stage, uint64_t count) {
+
+    if (stage->window_size + count <= stage->window_capacity) {
+        return;
+    }
+
+    uint64_t discarded = stage->window_begin - stage->window_first;
+    if (discarded) {
+        memmove(stage->window, stage->window + discarded, (stage->window_size - discarded) * sizeof(struct core));
+        stage->window_first = stage->window_begin;
+        stage->window_size -= discarded;
+    }
+
+    if (stage->window_capacity < 2 * stage->window_size + count) {
+        stage->window_capacity = maximum(2 * stage->window_capacity, maximum(2 * stage->window_size + count, stage->batch_size));
+        stage->window = (struct core *)realloc(stage->window, stage->window_capacity * sizeof(struct core));
+    }
+}
+
+/**
+ * @brief Processes the pending cores of a stage once they fill a batch.
+ */
+static inline void stage_flush(struct deepen_stage *stage) {
+    if (stage->batch_size <= stage->window_first + stage->window_size - stage->dct_end) {
+        stage_dct(stage);
+        stage_parse(stage, 0);
+        stage_discard(stage);
+    }
+}
+
+void deepen_stage_push(struct deepen_stage *stage, struct core *cr) {
+
+    stage_reserve(stage, 1);
+
+    stage->window[stage->window_size] = *cr;
+    stage->window_size++;
+    stage->input_count++;
+
+    stage_flush(stage);
+}
+
+void deepen_stage_push_cores(struct deepen_stage *stage, struct core *cores, uint64_t count) {
+
+    while (count) {
+        uint64_t pending = stage->window_first + stage->window_size - stage->dct_end;
+        uint64_t n = stage->batch_size <= pending ? 1 : minimum(count, stage->batch_size - pending);
+
+        stage_reserve(stage, n);
+
+        memcpy(stage->window + stage->window_size, cores, n * sizeof(struct core));
+        stage->window_size += n;
+        stage->input_count += n;
+        cores += n;
+        count -= n;
+
+        stage_flush(stage);
+    }
+}
+
+void deepen_stage_finish(struct deepen_stage *stage) {
+
+    stage_dct(stage);
+    stage_parse(stage, 1);
+
+    for (uint64_t i = stage->window_begin; i < stage->window_first + stage->window_size; i++) {
+        free_core(core_at(stage, i));
+    }
+    for (int i = 0; i < DCT_ITERATION_COUNT; i++) {
+        free_core(&(stage->held[i]));
+    }
+    free(stage->window);
+
+    stage->window = NULL;
+    stage->window_first = stage->window_begin = stage->dct_end;
+    stage->window_size = 0;
+    stage->window_capacity = 0;
+}
+
+/**
+ * @brief Callback passing the cores of a stage to the stage of the next level.
+ */
+static void emit_stage(struct core *cr, void *arg) {
+    deepen_stage_push((struct deepen_stage *)arg, cr);
+}
+
+/**
+ * @brief Callback writing the cores of the last stage to the output.
+ */
+static void emit_file(struct core *cr, void *arg) {
+    write_core(cr, (FILE *)arg);
+    free_core(cr);
+}
+
+/**
+ * @brief Initializes one stage per level, each one passing its cores to the next, and
+ * the last one passing its cores to `emit`.
+ */
+static void init_stage_chain(struct deepen_stage *stages, int stage_count, int level, uint64_t batch_size, void (*emit)(struct core *cr, void *arg), void *arg) {
+    for (int i = 0; i < stage_count; i++) {
+        if (i + 1 < stage_count) {
+            init_deepen_stage(&(stages[i]), level + i, emit_stage, &(stages[i+1]));
+        } else {
+            init_deepen_stage(&(stages[i]), level + i, emit, arg);
+        }
+        stages[i].batch_size = batch_size;
+    }
+}
+
+/**
+ * @brief Flushes a chain of stages and returns the level of its output. As in
+ * `lps_deepen`, deepening stops at the first level with too few cores for the dct.
+ */
+static int finish_stage_chain(struct deepen_stage *stages, int stage_count, int level) {
+
+    // the remaining cores of each stage are flushed into the next one
+    for (int i = 0; i < stage_count; i++) {
+        deepen_stage_finish(&(stages[i]));
+    }
+
+    for (int i = 0; i < stage_count; i++) {
+        level++;
+        if (stages[i].input_count < DCT_ITERATION_COUNT + 1) {
+            break;
+        }
+    }
+
+    return level;
+}
+
+int lcpt_deepen_record(FILE *in, FILE *out, int lcp_level) {
+    unsigned char header[sizeof(int)];
+
+    // the stream ends either with eof or with the single `done` byte
+    size_t read = fread(header, 1, sizeof(int), in);
+    if (read == 0 || (read == 1 && header[0] == 0)) {
+        return 0;
+    }
+    if (read != sizeof(int)) {
+        fprintf(stderr, "Error reading level from file\n");
+        return -1;
+    }
+
+    int level, size;
+    memcpy(&level, header, sizeof(int));
+    if (fread(&size, sizeof(int), 1, in) != 1 || size < 0) {
+        fprintf(stderr, "Error reading size from file\n");
+        return -1;
+    }
+
+    int stage_count = level < lcp_level ? lcp_level - level : 0;
+
+    long header_offset = ftell(out);
+    if (stage_count && header_offset < 0) {
+        fprintf(stderr, "Error: output is not seekable\n");
+        return -1;
+    }
+    fwrite(&level, sizeof(int), 1, out);
+    fwrite(&size, sizeof(int), 1, out);
+
+    struct deepen_stage *stages = (struct deepen_stage *)malloc((stage_count ? stage_count : 1) * sizeof(struct deepen_stage));
+    init_stage_chain(stages, stage_count, level, STREAM_BATCH_SIZE, emit_file, out);
+
+    int status = 1;
+    for (int i = 0; i < size; i++) {
+        struct core cr;
+        if (read_core(&cr, in) < 0) {
+            fprintf(stderr, "Error reading core from file at %d\n", i);
+            status = -1;
+            break;
+        }
+        if (stage_count) {
+            deepen_stage_push(&(stages[0]), &cr);
+        } else {
+            write_core(&cr, out);
+            free_core(&cr);
+        }
+    }
+
+    int new_level = finish_stage_chain(stages, stage_count, level);
+
+    if (status == 1 && stage_count) {
+
+        int new_size = (int)stages[stage_count-1].output_count;
+
+        long end_offset = ftell(out);
+        if (end_offset < 0 || fseek(out, header_offset, SEEK_SET) != 0) {
+            fprintf(stderr, "Error: output is not seekable\n");
+            status = -1;
+        } else {
+            fwrite(&new_level, sizeof(int), 1, out);
+            fwrite(&new_size, sizeof(int), 1, out);
+            fseek(out, end_offset, SEEK_SET);
+        }
+    }
+
+    free(stages);
+
+    return status;
+}
+
+int64_t lcpt_deepen(FILE *in, FILE *out, int lcp_level) {
+    int64_t count = 0;
+    int status;
+
+    while ((status = lcpt_deepen_record(in, out, lcp_level)) == 1) {
+        count++;
+    }
+    if (status < 0) {
+        return -1;
+    }
+
+    char done = 0;
+    fwrite(&done, 1, 1, out);
+
+    return count;
+}
+
+/**
+ * @brief Callback storing the cores of the last stage into the core array of an `lps`
+ * object. The stages only emit a core after consuming more cores than they emitted,
+ * so the cores are stored into slots whose cores are already pushed.
+ */
+static void emit_lps(struct core *cr, void *arg) {
+    struct lps *lps_ptr = (struct lps *)arg;
+    lps_ptr->cores[lps_ptr->size] = *cr;
+    lps_ptr->size++;
+}
+
+int lps_deepen_tiled(struct lps *lps_ptr, int lcp_level, int tile_size) {
+
+    if (lcp_level <= lps_ptr->level)
+        return 0;
+
+    int stage_count = lcp_level - lps_ptr->level;
+    struct deepen_stage *stages = (struct deepen_stage *)malloc(stage_count * sizeof(struct deepen_stage));
+    init_stage_chain(stages, stage_count, lps_ptr->level, tile_size < 1 ? STREAM_TILE_SIZE : tile_size, emit_lps, lps_ptr);
+
+    // the cores are moved into the first stage and the new cores are stored in place
+    int size = lps_ptr->size;
+    lps_ptr->size = 0;
+    deepen_stage_push_cores(&(stages[0]), lps_ptr->cores, size);
+
+    lps_ptr->level = finish_stage_chain(stages, stage_count, lps_ptr->level);
+    free(stages);
+
+    if (lps_ptr->size)
+        lps_ptr->cores = (struct core*)realloc(lps_ptr->cores, lps_ptr->size * sizeof(struct core));
+
+    return 1;
+}
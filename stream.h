@@ -0,0 +1,161 @@
+/**
+ * @file stream.h
+ * @brief Deepening of `.lcpt` records with memory independent of their size.
+ *
+ * `lps_deepen` keeps all cores of a sequence in memory, which is not feasible for
+ * very large inputs. However, the DCT of a core only depends on its predecessor and
+ * the cores of the next level are found by looking at a few neighbouring cores.
+ * This module deepens the cores of a record as a stream: the cores are pushed one
+ * by one into a chain of stages, one stage per level, each of which buffers only the
+ * cores that the cores of the next level may still be built from.
+ *
+ * Key functionalities include:
+ * - Compressing the cores of a stream with the DCT in batches, keeping for each DCT
+ * iteration a copy of the last core of the previous batch.
+ * - Finding the RINT, LMIN, LMAX and SSEQ cores of a stream exactly as `parse3` does.
+ * - Deepening the records of a `.lcpt` file into another `.lcpt` file, all levels at
+ * once in a single pass over the input.
+ * - Deepening an `lps` object in memory tile by tile: each tile of cores is taken
+ * through all levels before the next one is touched, so that the cores passed between
+ * levels stay in cache instead of being streamed through memory once per level.
+ *
+ * The output of a stage is identical to that of `lps_deepen1`, and a record deepened
+ * through `lcpt_deepen_record` is identical to the one written after `lps_deepen`.
+ * The memory used by a stage is proportional to the longest stretch of cores that
+ * does not contain the start of a new core, which is short except for long SSEQ
+ * cores, e.g. over runs of unknown characters, plus `STREAM_BATCH_SIZE` cores.
+ *
+ * @see lps.h
+ *
+ * @struct deepen_stage
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lps.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define STREAM_BATCH_SIZE   1024
+#define STREAM_TILE_SIZE    2048
+
+struct deepen_stage {
+    int level;
+    struct core held[DCT_ITERATION_COUNT];
+    struct core *window;
+    uint64_t window_first;
+    uint64_t window_begin;
+    uint64_t window_size;
+    uint64_t window_capacity;
+    uint64_t dct_end;
+    uint64_t it1;
+    uint64_t it2;
+    uint64_t run_end;
+    uint64_t input_count;
+    uint64_t output_count;
+    uint64_t batch_size;
+    void (*emit)(struct core *cr, void *arg);
+    void *arg;
+};
+
+/**
+ * @brief Initializes a stage that deepens a stream of cores by one level.
+ *
+ * The new cores are passed to `emit` in order. The callback takes ownership of the
+ * core, i.e. it is responsible for freeing its bit representation. The cores are
+ * processed in batches of `STREAM_BATCH_SIZE` cores, which can be changed through
+ * `batch_size` before the first core is pushed.
+ *
+ * @param stage Pointer to the stage to initialize.
+ * @param level The level of the cores pushed into the stage.
+ * @param emit Callback receiving the cores of the next level.
+ * @param arg Argument passed to `emit`.
+ */
+void init_deepen_stage(struct deepen_stage *stage, int level, void (*emit)(struct core *cr, void *arg), void *arg);
+
+/**
+ * @brief Pushes the next core of the stream into a stage.
+ *
+ * The stage takes ownership of the core. The cores of the next level that can be
+ * determined are emitted.
+ *
+ * @param stage Pointer to the stage.
+ * @param cr The core, whose contents are moved into the stage.
+ */
+void deepen_stage_push(struct deepen_stage *stage, struct core *cr);
+
+/**
+ * @brief Pushes the next cores of the stream into a stage.
+ *
+ * Equivalent to pushing the cores one by one with `deepen_stage_push`, but the cores
+ * are copied into the stage a batch at a time.
+ *
+ * @param stage Pointer to the stage.
+ * @param cores The cores, whose contents are moved into the stage.
+ * @param count Number of cores.
+ */
+void deepen_stage_push_cores(struct deepen_stage *stage, struct core *cores, uint64_t count);
+
+/**
+ * @brief Ends the stream of a stage, emits its remaining cores and frees its memory.
+ *
+ * @param stage Pointer to the stage.
+ */
+void deepen_stage_finish(struct deepen_stage *stage);
+
+/**
+ * @brief Deepens an lps object to the given level tile by tile.
+ *
+ * Unlike `lps_deepen`, which runs each level over all cores before starting the next,
+ * the cores are pushed through a chain of stages, one per level, and each stage
+ * processes `tile_size` cores at a time. Only the few cores around the end of a tile
+ * are carried over to the next tile of a level. The resulting cores and level are
+ * identical to those of `lps_deepen`, and the new cores are stored in place.
+ *
+ * @param lps_ptr The `lps` object to deepen.
+ * @param lcp_level The target level.
+ * @param tile_size Number of cores of a tile, or 0 for `STREAM_TILE_SIZE`.
+ * @return 1 if the object is deepened, 0 if it is already at or above `lcp_level`.
+ */
+int lps_deepen_tiled(struct lps *lps_ptr, int lcp_level, int tile_size);
+
+/**
+ * @brief Deepens the next record of a `.lcpt` stream and writes it to another stream.
+ *
+ * The cores of the record are read one by one and deepened through all levels up to
+ * `lcp_level` at once. Records that are already at or above `lcp_level` are copied
+ * unchanged. As in `lps_deepen`, deepening stops at the first level with too few
+ * cores for the DCT.
+ *
+ * @param in File pointer to the binary stream written by `write_lps`.
+ * @param out File pointer to the output. It must be seekable, since the level and
+ * the size of the record are written after its cores.
+ * @param lcp_level The level the record will be deepened to.
+ * @return 1 if a record is deepened, 0 if the end of the stream is reached, -1 on error.
+ */
+int lcpt_deepen_record(FILE *in, FILE *out, int lcp_level);
+
+/**
+ * @brief Deepens all records of a `.lcpt` stream and writes them to another stream.
+ *
+ * The output ends with the single zero byte that marks the end of a `.lcpt` stream.
+ *
+ * @param in File pointer to the binary stream written by `write_lps`.
+ * @param out File pointer to the seekable output.
+ * @param lcp_level The level the records will be deepened to.
+ * @return Number of records deepened, or -1 on error.
+ * @see lcpt_deepen_record
+ */
+int64_t lcpt_deepen(FILE *in, FILE *out, int lcp_level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
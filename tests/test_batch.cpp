@@ -0,0 +1,191 @@
+#include "batch.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+bool lps_positions_eq(const struct lps *lhs, const struct lps *rhs) {
+	if (!lps_eq(lhs, rhs)) {
+		return false;
+	}
+	for (int i = 0; i < lhs->size; i++) {
+		if (lhs->cores[i].start != rhs->cores[i].start || lhs->cores[i].end != rhs->cores[i].end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void test_lps_batch_mixed_lengths() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(42);
+
+	// short reads interleaved with long reads of various lengths
+	std::vector<std::string> reads;
+	for (int i = 0; i < 2000; i++) {
+		int len = i % 50 == 0 ? 0 : 100 + rng() % 200;
+		reads.push_back(sequence.substr(rng() % 1000000, len));
+		if (i % 500 == 0) {
+			reads.push_back(sequence.substr(rng() % 500000, 70000 + rng() % 200000));
+		}
+	}
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	for (int lcp_level : {1, 3, 4}) {
+		for (int thread_count : {1, 3}) {
+			std::vector<struct lps> batch(reads.size());
+			int fallback = lps_batch(batch.data(), ptrs.data(), lengths.data(), reads.size(), lcp_level, thread_count);
+			assert(fallback == 0 && "Chunks of long reads should agree on their overlaps");
+
+			for (size_t i = 0; i < reads.size(); i++) {
+				struct lps expected;
+				init_lps(&expected, reads[i].c_str(), reads[i].size());
+				lps_deepen(&expected, lcp_level);
+
+				assert(lps_positions_eq(&expected, &(batch[i])) && "Batch processing should match processing each read");
+
+				free_lps(&expected);
+				free_lps(&(batch[i]));
+			}
+		}
+	}
+
+	log("...  test_lps_batch_mixed_lengths passed!");
+}
+
+void test_lps_batch_invalid_characters() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	// a long read with runs of invalid characters around the chunk boundaries
+	std::string read = sequence.substr(200000, 150000);
+	for (int k = 1; k * BATCH_CHUNK_SIZE < (int)read.size(); k++) {
+		for (int i = 0; i < 300; i++) {
+			read[k * BATCH_CHUNK_SIZE + i] = 'N';
+		}
+	}
+
+	const char *ptr = read.c_str();
+	int length = read.size();
+
+	struct lps batch;
+	lps_batch(&batch, &ptr, &length, 1, 4, 2);
+
+	struct lps expected;
+	init_lps(&expected, read.c_str(), read.size());
+	lps_deepen(&expected, 4);
+
+	assert(lps_positions_eq(&expected, &batch) && "Invalid characters should be handled while chunking");
+
+	free_lps(&expected);
+	free_lps(&batch);
+
+	log("...  test_lps_batch_invalid_characters passed!");
+}
+
+void test_lps_batch_lockstep() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(7);
+
+	for (int len : {3, 7, 150, 251}) {
+		// a count which is not a multiple of the lane count
+		std::vector<std::string> reads;
+		for (int i = 0; i < 3 * BATCH_LANE_COUNT + 5; i++) {
+			std::string read = sequence.substr(rng() % 1000000, len);
+			if (i % 3 == 0) {
+				// runs of invalid characters
+				read[rng() % len] = 'N';
+				read[rng() % len] = 'N';
+			}
+			if (i % 4 == 1) {
+				// run reaching the end of the read
+				for (int j = std::max(0, len - 1 - (int)(rng() % 5)); j < len; j++) {
+					read[j] = 'A';
+				}
+			}
+			if (i % 5 == 2) {
+				// run at the beginning of the read
+				for (int j = 0; j < 1 + (int)(rng() % 6) && j < len; j++) {
+					read[j] = 'G';
+				}
+			}
+			reads.push_back(read);
+		}
+
+		std::vector<const char *> ptrs;
+		std::vector<int> lengths;
+		for (const std::string &read : reads) {
+			ptrs.push_back(read.c_str());
+			lengths.push_back(read.size());
+		}
+
+		for (int lcp_level : {1, 3}) {
+			std::vector<struct lps> batch(reads.size());
+			lps_batch(batch.data(), ptrs.data(), lengths.data(), reads.size(), lcp_level, 2);
+
+			for (size_t i = 0; i < reads.size(); i++) {
+				struct lps expected;
+				init_lps(&expected, reads[i].c_str(), reads[i].size());
+				lps_deepen(&expected, lcp_level);
+
+				assert(lps_positions_eq(&expected, &(batch[i])) && "Lockstep parsing should match parsing each read");
+
+				free_lps(&expected);
+				free_lps(&(batch[i]));
+			}
+		}
+	}
+
+	log("...  test_lps_batch_lockstep passed!");
+}
+
+int main() {
+
+	log("Running test_batch...");
+
+	test_lps_batch_mixed_lengths();
+	test_lps_batch_invalid_characters();
+	test_lps_batch_lockstep();
+
+	log("All tests in test_batch completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,236 @@
+#include "classify.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+// root 0, genus 1 with species 2 and 3, and taxon 4
+const uint32_t parents[] = {0, 0, 1, 1, 0};
+
+struct sample {
+	std::vector<std::string> refs;
+	std::vector<uint32_t> ref_taxa;
+	std::vector<std::string> reads;
+	std::vector<uint32_t> read_taxa;
+};
+
+sample make_sample(const std::string &sequence) {
+	sample s;
+	std::string shared = sequence.substr(900000, 50000);
+
+	s.refs.push_back(sequence.substr(100000, 200000) + shared);
+	s.ref_taxa.push_back(2);
+	s.refs.push_back(sequence.substr(300000, 200000) + shared);
+	s.ref_taxa.push_back(3);
+	s.refs.push_back(sequence.substr(600000, 200000));
+	s.ref_taxa.push_back(4);
+
+	std::mt19937 rng(42);
+	const uint32_t begins[] = {100000, 300000, 600000, 900000};
+	const uint32_t taxa[] = {2, 3, 4, 1};
+	for (int i = 0; i < 2000; i++) {
+		int k = i % 4;
+		uint32_t span = k == 3 ? 50000 : 200000;
+		s.reads.push_back(sequence.substr(begins[k] + rng() % (span - 150), 150));
+		s.read_taxa.push_back(taxa[k]);
+	}
+
+	return s;
+}
+
+void test_taxonomy_lca() {
+
+	assert(taxonomy_lca(parents, 2, 3) == 1 && "Species should meet at their genus");
+	assert(taxonomy_lca(parents, 2, 1) == 1 && "A taxon should meet its ancestor at the ancestor");
+	assert(taxonomy_lca(parents, 3, 4) == 0 && "Unrelated taxa should meet at the root");
+	assert(taxonomy_lca(parents, 4, 4) == 4 && "A taxon should be its own LCA");
+
+	log("...  test_taxonomy_lca passed!");
+}
+
+void test_classify_reads() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	sample s = make_sample(sequence);
+
+	std::vector<const char *> ref_ptrs;
+	std::vector<int> ref_lengths;
+	for (const std::string &ref : s.refs) {
+		ref_ptrs.push_back(ref.c_str());
+		ref_lengths.push_back(ref.size());
+	}
+
+	struct classify_db db;
+	init_classify_db(&db, ref_ptrs.data(), ref_lengths.data(), s.ref_taxa.data(), s.refs.size(), parents, 5, 3, 1);
+
+	assert(0 < db.label_count && db.label_count * CLASSIFY_LOAD_FACTOR <= db.slot_count && "Table should hold the labels");
+
+	// labels of the shared segment belong to the genus
+	struct lps shared;
+	init_lps(&shared, sequence.c_str() + 910000, 1000);
+	lps_deepen(&shared, 3);
+	int genus = 0;
+	for (int i = 0; i < shared.size; i++) {
+		uint32_t taxon = classify_db_lookup(&db, shared.cores[i].label);
+		assert(taxon != CLASSIFY_NONE && "Reference labels should be found");
+		genus += taxon == 1;
+	}
+	assert(shared.size * 0.9 <= genus && "Shared labels should be mapped to the LCA");
+	free_lps(&shared);
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : s.reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	std::vector<struct classify_result> results(s.reads.size());
+	int classified = classify_reads(&db, ptrs.data(), lengths.data(), s.reads.size(), results.data(), 1);
+
+	int correct = 0;
+	for (size_t i = 0; i < s.reads.size(); i++) {
+		assert(results[i].hits <= results[i].cores && "Hits should be a subset of the cores");
+		assert((results[i].hits == 0) == (results[i].taxon == CLASSIFY_NONE) && "Reads without hits should be unclassified");
+		correct += results[i].taxon == s.read_taxa[i];
+	}
+
+	assert(classified == (int)s.reads.size() && "Reads from the references should be classified");
+	assert(s.reads.size() * 0.95 <= correct && "Reads should be classified to their taxa");
+
+	// multiple threads should give the same results
+	struct classify_db db_threads;
+	init_classify_db(&db_threads, ref_ptrs.data(), ref_lengths.data(), s.ref_taxa.data(), s.refs.size(), parents, 5, 3, 4);
+	assert(db_threads.label_count == db.label_count && "Parallel build should find the same labels");
+
+	std::vector<struct classify_result> results_threads(s.reads.size());
+	classify_reads(&db_threads, ptrs.data(), lengths.data(), s.reads.size(), results_threads.data(), 4);
+	for (size_t i = 0; i < s.reads.size(); i++) {
+		assert(results_threads[i].taxon == results[i].taxon && results_threads[i].hits == results[i].hits &&
+		       "Parallel classification should match the sequential one");
+	}
+
+	free_classify_db(&db_threads);
+	free_classify_db(&db);
+
+	log("...  test_classify_reads passed!");
+}
+
+void test_classify_db_file() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	sample s = make_sample(sequence);
+
+	std::vector<const char *> ref_ptrs;
+	std::vector<int> ref_lengths;
+	for (const std::string &ref : s.refs) {
+		ref_ptrs.push_back(ref.c_str());
+		ref_lengths.push_back(ref.size());
+	}
+
+	struct classify_db db;
+	init_classify_db(&db, ref_ptrs.data(), ref_lengths.data(), s.ref_taxa.data(), s.refs.size(), parents, 5, 3, 2);
+
+	const char *filename = "test_classify.lcpdb";
+	assert(classify_db_save(&db, filename) && "Database should be saved");
+
+	struct classify_db mapped;
+	assert(classify_db_open(&mapped, filename) && "Database should be opened");
+	assert(mapped.map != NULL && "Database should be mapped");
+	assert(mapped.level == db.level && mapped.taxon_count == db.taxon_count && mapped.slot_count == db.slot_count &&
+	       mapped.label_count == db.label_count && "Header should round trip");
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : s.reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	std::vector<struct classify_result> results(s.reads.size()), results_mapped(s.reads.size());
+	classify_reads(&db, ptrs.data(), lengths.data(), s.reads.size(), results.data(), 2);
+	classify_reads(&mapped, ptrs.data(), lengths.data(), s.reads.size(), results_mapped.data(), 2);
+	for (size_t i = 0; i < s.reads.size(); i++) {
+		assert(results_mapped[i].taxon == results[i].taxon && results_mapped[i].hits == results[i].hits &&
+		       "Mapped database should classify as the built one");
+	}
+
+	free_classify_db(&mapped);
+
+	// tables without an empty slot or a power of two size would not stop probing
+	std::ifstream saved(filename, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(saved)), std::istreambuf_iterator<char>());
+	saved.close();
+
+	auto open_patched = [&](uint64_t slot_count, uint64_t label_count) {
+		std::vector<char> patched(bytes.begin(), bytes.end() - (db.slot_count - slot_count) * sizeof(uint64_t));
+		memcpy(patched.data() + 16, &slot_count, sizeof(uint64_t));
+		memcpy(patched.data() + 24, &label_count, sizeof(uint64_t));
+		std::ofstream out(filename, std::ios::binary);
+		out.write(patched.data(), patched.size());
+		out.close();
+
+		struct classify_db patched_db;
+		int opened = classify_db_open(&patched_db, filename);
+		if (opened) {
+			free_classify_db(&patched_db);
+		}
+		return opened;
+	};
+
+	assert(open_patched(db.slot_count, db.label_count) && "An intact database should be opened");
+	assert(!open_patched(0, 0) && "Empty tables should be rejected");
+	assert(!open_patched(db.slot_count - 1, db.label_count) && "Tables whose size is not a power of two should be rejected");
+	assert(!open_patched(db.slot_count, db.slot_count) && "Tables without an empty slot should be rejected");
+
+	free_classify_db(&db);
+	remove(filename);
+
+	struct classify_db missing;
+	assert(!classify_db_open(&missing, "data/test.fasta") && "Other files should be rejected");
+
+	log("...  test_classify_db_file passed!");
+}
+
+int main() {
+
+	log("Running test_classify...");
+
+	test_taxonomy_lca();
+	test_classify_reads();
+	test_classify_db_file();
+
+	log("All tests in test_classify completed successfully!");
+
+	return 0;
+}
@@ -1,7 +1,10 @@
 #include "core.h"
 #include <cassert>
 #include <fstream>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <string>
 #include <vector>
 
 void log(const std::string &message) {
@@ -80,12 +83,217 @@ void test_core_operator_overloads() {
 	log("...  test_core_operator_overloads passed!");
 };
 
+/**
+ * Encodes a string as `init_core1` does, from the most significant block.
+ */
+std::vector<ublock> encode(const std::string &str, const int *table) {
+	ubit_size bit_size = alphabet_bit_size * str.size();
+	std::vector<ublock> blocks((bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE, 0);
+	for (size_t i = 0; i < str.size(); i++) {
+		ubit_size pos = alphabet_bit_size * (str.size() - 1 - i);
+		for (int b = 0; b < alphabet_bit_size; b++) {
+			if ((table[(int)str[i]] >> b) & 1) {
+				blocks[blocks.size() - 1 - (pos + b) / UBLOCK_BIT_SIZE] |= 1U << ((pos + b) % UBLOCK_BIT_SIZE);
+			}
+		}
+	}
+	return blocks;
+}
+
+void test_core_run_length() {
+
+	LCP_INIT();
+
+	for (int middle : {300, 1000, 1013, 50000}) {
+		std::string str = "T" + std::string(middle, 'A') + "G";
+		std::string reversed(str.rbegin(), str.rend());
+
+		struct core run1, run2;
+		init_core1(&run1, str.c_str(), str.size(), 0, str.size());
+		init_core2(&run2, reversed.c_str() + reversed.size() - 1, reversed.size(), 0, reversed.size());
+
+		std::vector<ublock> expected = encode(str, alphabet), expected_rc = encode(str, rc_alphabet);
+		assert(run1.run && run2.run && "Long RINT cores should be run-length encoded");
+		assert(run1.bit_size == alphabet_bit_size * str.size() && "Bit size should be the expanded size");
+		assert(core_memsize(&run1) < 100 && "Run-length encoded cores should be small");
+		for (size_t i = 0; i < expected.size(); i++) {
+			assert(core_block(&run1, i) == expected[i] && "Blocks should match the expanded core");
+			assert(core_block(&run2, i) == expected_rc[i] && "Blocks should match the expanded reverse complement core");
+		}
+
+		// comparisons should match the expanded representation
+		ublock *p1 = (ublock *)malloc(expected.size() * sizeof(ublock));
+		memcpy(p1, expected.data(), expected.size() * sizeof(ublock));
+		struct core plain;
+		init_core4(&plain, run1.bit_size, p1, run1.label, 0, str.size());
+
+		assert(core_eq(&run1, &plain) && core_eq(&plain, &run1) && "Run-length encoded core should equal the expanded core");
+		assert(!core_lt(&run1, &plain) && !core_gt(&run1, &plain) && core_leq(&run1, &plain) && core_geq(&run1, &plain) && "Orders should match");
+
+		plain.bit_rep[expected.size() / 2] ^= 1;
+		assert(core_neq(&run1, &plain) && "A changed bit should be detected");
+		assert(core_lt(&run1, &plain) == (core_block(&run1, expected.size() / 2) < plain.bit_rep[expected.size() / 2]) && "Order should follow the first differing block");
+		assert(core_gt(&plain, &run1) == core_lt(&run1, &plain) && "Order should be antisymmetric");
+		plain.bit_rep[expected.size() / 2] ^= 1;
+
+		// compression should be the same
+		struct core left;
+		init_core1(&left, "CAAT", 4, 0, 4);
+		struct core plain_copy;
+		ublock *p2 = (ublock *)malloc(expected.size() * sizeof(ublock));
+		memcpy(p2, expected.data(), expected.size() * sizeof(ublock));
+		init_core4(&plain_copy, plain.bit_size, p2, plain.label, 0, 0);
+		core_compress(&left, &run1);
+		core_compress(&left, &plain_copy);
+		assert(!run1.run && run1.bit_size == plain_copy.bit_size && run1.bit_rep[0] == plain_copy.bit_rep[0] && "Compression should match");
+
+		core_expand(&run2);
+		assert(!run2.run && "Expanded core should not be run-length encoded");
+		for (size_t i = 0; i < expected.size(); i++) {
+			assert(run2.bit_rep[i] == expected_rc[i] && "Expanded blocks should match");
+		}
+
+		free_core(&run1);
+		free_core(&run2);
+		free_core(&plain);
+		free_core(&plain_copy);
+		free_core(&left);
+	}
+
+	// short runs and other cores should not be run-length encoded
+	std::string short_run = "T" + std::string(CORE_RUN_MIN_LENGTH - 1, 'A') + "G";
+	std::string mixed = "T" + std::string(CORE_RUN_MIN_LENGTH, 'A') + "CG";
+	struct core short_core, mixed_core;
+	init_core1(&short_core, short_run.c_str(), short_run.size(), 0, 0);
+	init_core1(&mixed_core, mixed.c_str(), mixed.size(), 0, 0);
+	assert(!short_core.run && !mixed_core.run && "Only long runs should be run-length encoded");
+	free_core(&short_core);
+	free_core(&mixed_core);
+
+	log("...  test_core_run_length passed!");
+}
+
+void test_core_run_length_children() {
+
+	// children of 5, 7 and 6 bits, with the middle child repeated
+	const ubit_size sizes[3] = {5, 7, 6};
+	const ublock reps[3] = {0b10110, 0b1011001, 0b110101};
+
+	for (int middle : {300, 1000, 1003}) {
+		std::vector<struct core> children(middle + 2);
+		std::string bits;
+		for (int i = 0; i < middle + 2; i++) {
+			int k = i == 0 ? 0 : (i == middle + 1 ? 2 : 1);
+			ublock *p = (ublock *)malloc(sizeof(ublock));
+			p[0] = reps[k];
+			init_core4(&(children[i]), sizes[k], p, k, i, i + 1);
+			for (int b = sizes[k] - 1; 0 <= b; b--) {
+				bits += ((reps[k] >> b) & 1) ? '1' : '0';
+			}
+		}
+
+		struct core parent;
+		parent.bit_rep = NULL;
+		init_core3(&parent, children.data(), children.size());
+		assert(parent.run && parent.bit_size == bits.size() && "Repeated children should be run-length encoded");
+
+		// the most significant block holds the remaining bits
+		ubit_size block_number = (parent.bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+		ubit_size first = parent.bit_size - (block_number - 1) * UBLOCK_BIT_SIZE;
+		for (ubit_size i = 0; i < block_number; i++) {
+			size_t begin = i ? first + (i - 1) * UBLOCK_BIT_SIZE : 0;
+			size_t len = i ? UBLOCK_BIT_SIZE : first;
+			assert(core_block(&parent, i) == (ublock)std::stoul(bits.substr(begin, len), nullptr, 2) && "Blocks should match the concatenated children");
+		}
+
+		free_core(&parent);
+		for (struct core &child : children) {
+			free_core(&child);
+		}
+	}
+
+	log("...  test_core_run_length_children passed!");
+}
+
+void test_core_packing() {
+
+	LCP_INIT();
+
+	std::mt19937 rng(42);
+	const char *bases = "ACGTacgt";
+
+	// characters of every count modulo the packing width
+	for (int len = 3; len < 300; len++) {
+		std::string str;
+		for (int i = 0; i < len; i++) {
+			str += bases[rng() % 8];
+		}
+		std::string reversed(str.rbegin(), str.rend());
+
+		struct core cr1, cr2;
+		init_core1(&cr1, str.c_str(), str.size(), 0, str.size());
+		init_core2(&cr2, reversed.c_str() + reversed.size() - 1, reversed.size(), 0, reversed.size());
+
+		std::vector<ublock> expected = encode(str, alphabet), expected_rc = encode(str, rc_alphabet);
+		for (size_t i = 0; i < expected.size(); i++) {
+			assert(cr1.bit_rep[i] == expected[i] && "Packed characters should match");
+			assert(cr2.bit_rep[i] == expected_rc[i] && "Packed reverse complement characters should match");
+		}
+
+		free_core(&cr1);
+		free_core(&cr2);
+	}
+
+	// children of random sizes, including multiples of the block size
+	for (int r = 0; r < 200; r++) {
+		int count = 3 + rng() % 10;
+		std::vector<struct core> children(count);
+		std::string bits;
+		for (int i = 0; i < count; i++) {
+			ubit_size bit_size = 1 + rng() % 100;
+			ubit_size block_number = (bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+			ublock *p = (ublock *)malloc(block_number * sizeof(ublock));
+			std::string child;
+			for (ubit_size b = 0; b < bit_size; b++) {
+				child += (rng() % 2) ? '1' : '0';
+			}
+			std::string padded = std::string(block_number * UBLOCK_BIT_SIZE - bit_size, '0') + child;
+			for (ubit_size b = 0; b < block_number; b++) {
+				p[b] = (ublock)std::stoul(padded.substr(b * UBLOCK_BIT_SIZE, UBLOCK_BIT_SIZE), nullptr, 2);
+			}
+			init_core4(&(children[i]), bit_size, p, i, i, i + 1);
+			bits += child;
+		}
+
+		struct core parent;
+		parent.bit_rep = NULL;
+		init_core3(&parent, children.data(), children.size());
+		assert(parent.bit_size == bits.size() && "Bit size should be the sum of the children");
+
+		ubit_size block_number = (parent.bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE;
+		std::string padded = std::string(block_number * UBLOCK_BIT_SIZE - bits.size(), '0') + bits;
+		for (ubit_size b = 0; b < block_number; b++) {
+			assert(parent.bit_rep[b] == (ublock)std::stoul(padded.substr(b * UBLOCK_BIT_SIZE, UBLOCK_BIT_SIZE), nullptr, 2) && "Concatenated children should match");
+		}
+
+		free_core(&parent);
+		for (struct core &child : children) {
+			free_core(&child);
+		}
+	}
+
+	log("...  test_core_packing passed!");
+}
+
 int main() {
 	log("Running test_core...");
 
 	test_core_constructors();
 	test_core_compress();
 	test_core_operator_overloads();
+	test_core_run_length();
+	test_core_run_length_children();
+	test_core_packing();
 
 	log("All tests in test_core completed successfully!");
 
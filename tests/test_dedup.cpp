@@ -0,0 +1,235 @@
+#include "dedup.h"
+#include "trace.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+void substitute(std::string &read, std::mt19937 &rng) {
+	size_t pos = rng() % read.size();
+	read[pos] = (read[pos] == 'A' || read[pos] == 'a') ? 'C' : 'A';
+}
+
+void test_dedup_reads() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(42);
+
+	// originals, followed by exact copies, copies with a substitution and unrelated reads
+	std::vector<std::string> reads;
+	std::vector<int> origin;
+	for (int i = 0; i < 1000; i++) {
+		reads.push_back(sequence.substr(100000 + rng() % 900000, 150));
+		origin.push_back(i);
+	}
+	for (int i = 0; i < 300; i++) {
+		int k = rng() % 1000;
+		reads.push_back(reads[k]);
+		origin.push_back(k);
+	}
+	for (int i = 0; i < 300; i++) {
+		int k = rng() % 1000;
+		reads.push_back(reads[k]);
+		substitute(reads.back(), rng);
+		origin.push_back(k);
+	}
+	for (int i = 0; i < 300; i++) {
+		reads.push_back(sequence.substr(100000 + rng() % 900000, 150));
+		origin.push_back(-1);
+	}
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	// stream the reads in two batches
+	struct dedup d;
+	init_dedup(&d, reads.size());
+
+	std::vector<struct dedup_result> results(reads.size());
+	int duplicates = dedup_reads(&d, ptrs.data(), lengths.data(), 1000, 2, 0, results.data(), 1);
+	duplicates += dedup_reads(&d, ptrs.data() + 1000, lengths.data() + 1000, reads.size() - 1000, 2, 1000, results.data() + 1000, 1);
+
+	int exact = 0, near = 0, false_positive = 0;
+	for (size_t i = 1000; i < reads.size(); i++) {
+		const struct dedup_result &result = results[i];
+		if (result.kind == DEDUP_EXACT) {
+			assert(reads[result.representative] == reads[i] && "Exact duplicates should be identical");
+			exact++;
+		}
+		if (result.kind == DEDUP_NEAR) {
+			origin[i] == -1 ? false_positive++ : near++;
+		}
+		if (i < 1300) {
+			assert(result.kind == DEDUP_EXACT && "Copies should be exact duplicates");
+		}
+		if (result.kind == DEDUP_UNIQUE) {
+			assert(result.representative == i && "Unique reads should represent themselves");
+		}
+	}
+
+	assert(300 <= exact && "Every copy should be found");
+	assert(300 * 0.8 <= near && "Most reads with a substitution should be near duplicates");
+	assert(false_positive <= 3 && "Unrelated reads should rarely be near duplicates");
+	assert(duplicates == exact + near + false_positive + (int)std::count_if(results.begin(), results.begin() + 1000,
+	       [](const struct dedup_result &r) { return r.kind != DEDUP_UNIQUE; }) && "Duplicates should be counted");
+
+	free_dedup(&d);
+
+	log("...  test_dedup_reads passed!");
+}
+
+void test_dedup_reads_threads() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(7);
+
+	std::vector<std::string> reads;
+	for (int i = 0; i < 5000; i++) {
+		if (i < 2000) {
+			reads.push_back(sequence.substr(rng() % 1000000, 100));
+		} else {
+			reads.push_back(reads[rng() % 2000]);
+		}
+	}
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	struct dedup d;
+	init_dedup(&d, reads.size());
+
+	std::vector<struct dedup_result> results(reads.size());
+	dedup_reads(&d, ptrs.data(), lengths.data(), reads.size(), 2, 0, results.data(), 4);
+
+	// representatives should be the first copies registered
+	for (size_t i = 0; i < reads.size(); i++) {
+		if (results[i].kind == DEDUP_EXACT) {
+			assert(reads[results[i].representative] == reads[i] && "Exact duplicates should be identical");
+			assert(results[results[i].representative].kind != DEDUP_EXACT && "Representatives should not be exact duplicates");
+		}
+	}
+
+	free_dedup(&d);
+
+	log("...  test_dedup_reads_threads passed!");
+}
+
+void count_parses(const struct trace_event *event, void *arg) {
+	if (event->probe == TRACE_PARSE1 && event->phase == TRACE_PHASE_BEGIN) {
+		__atomic_fetch_add((uint64_t *)arg, 1, __ATOMIC_RELAXED);
+	}
+}
+
+void test_dedup_exact_not_parsed() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	// 500 distinct reads, each copied three times within the batch
+	std::vector<std::string> reads;
+	for (int i = 0; i < 2000; i++) {
+		reads.push_back(sequence.substr(100000 + (i % 500) * 1000, 150));
+	}
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	uint64_t parses = 0;
+	trace_set_callback(count_parses, &parses);
+	trace_start(0);
+
+	struct dedup d;
+	init_dedup(&d, reads.size());
+
+	std::vector<struct dedup_result> results(reads.size());
+	int duplicates = dedup_reads(&d, ptrs.data(), lengths.data(), reads.size(), 2, 0, results.data(), 4);
+	assert(duplicates == 1500 && "Every copy should be an exact duplicate");
+	assert(d.parse_count == 500 && "Only the first copy of a read should be parsed");
+
+	// a later batch of copies is not parsed at all
+	duplicates = dedup_reads(&d, ptrs.data(), lengths.data(), 500, 2, reads.size(), results.data(), 4);
+	assert(duplicates == 500 && d.parse_count == 500 && "Exact duplicates should never be parsed");
+
+	trace_stop();
+	trace_set_callback(NULL, NULL);
+	trace_free();
+
+#ifdef LCP_TRACE
+	assert(parses == 500 && "parse1 should only run for reads which are not exact duplicates");
+#endif
+
+	free_dedup(&d);
+
+	// keys 0 and 1 are stored alike, so they should be found alike
+	struct read_signature sig = {};
+	struct dedup_result result;
+	init_dedup(&d, 16);
+	dedup_insert(&d, &sig, 0, &result);
+	sig.exact = 1;
+	dedup_insert(&d, &sig, 1, &result);
+	assert(result.kind == DEDUP_EXACT && result.representative == 0 && "Key 0 should be probed as key 1");
+
+	// equal hashes with different checks are different reads
+	sig.check = 2;
+	dedup_insert(&d, &sig, 2, &result);
+	assert(result.kind == DEDUP_UNIQUE && result.representative == 2 && "A hash collision should not be a duplicate");
+	dedup_insert(&d, &sig, 3, &result);
+	assert(result.kind == DEDUP_EXACT && result.representative == 2 && "The read behind the collision should be found");
+	free_dedup(&d);
+
+	log("...  test_dedup_exact_not_parsed passed!");
+}
+
+int main() {
+
+	log("Running test_dedup...");
+
+	test_dedup_reads();
+	test_dedup_reads_threads();
+	test_dedup_exact_not_parsed();
+
+	log("All tests in test_dedup completed successfully!");
+
+	return 0;
+}
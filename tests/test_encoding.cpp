@@ -71,11 +71,59 @@ void test_encoding_initialization_from_file() {
 	log("...  test_encoding_initialization_from_file passed!");
 };
 
+void test_encoding_context() {
+
+	struct lcp_context dna;
+	lcp_context_init(&dna);
+
+	assert(dna.encode['A'] == 0 && dna.encode['c'] == 1 && dna.encode['G'] == 2 && dna.encode['t'] == 3 && "DNA codes should be set");
+	assert(dna.complement['A'] == 3 && dna.complement['T'] == 0 && "DNA complements should be set");
+	assert(dna.encode['N'] == LCP_NO_CODE && dna.rank['N'] == 0 && dna.encode[200] == LCP_NO_CODE && "Other characters should have no code");
+	assert(dna.rank['A'] == 1 && dna.rc_rank['A'] == 4 && "Ranks should be the codes plus one");
+	assert(dna.bit_size == 2 && dna.characters[2] == 'G' && "Bit size and characters should be set");
+
+	// the default context should mirror the global tables
+	LCP_INIT();
+	for (int c = 0; c < 128; c++) {
+		assert(alphabet[c] == (lcp_default_context.encode[c] == LCP_NO_CODE ? -1 : lcp_default_context.encode[c]) && "Globals should mirror the default context");
+	}
+
+	// a custom context should leave the default one unchanged
+	std::ofstream encoding_file("encoding_context.txt");
+	const char *amino_acids = "ACDEFGHIKLMNPQRSTVWY";
+	for (int i = 0; i < 20; i++) {
+		encoding_file << amino_acids[i] << " " << i << " " << i << "\n";
+	}
+	encoding_file.close();
+
+	struct lcp_context protein;
+	assert(lcp_context_init_file(&protein, "encoding_context.txt") == 0 && "Context should be read from the file");
+	assert(protein.bit_size == 5 && protein.encode['Y'] == 19 && protein.characters[19] == 'Y' && "Protein codes should be set");
+	assert(alphabet_bit_size == 2 && lcp_default_context.bit_size == 2 && "Default context should be unchanged");
+	std::remove("encoding_context.txt");
+
+	std::ofstream invalid_file("encoding_invalid.txt");
+	invalid_file << "W 7 7\nA 300 0\n";
+	invalid_file.close();
+	assert(lcp_context_init_file(&protein, "encoding_invalid.txt") == -1 && "Codes out of range should be rejected");
+	assert(protein.bit_size == 5 && protein.encode['Y'] == 19 && protein.encode['W'] == 18 && "A failed read should keep the context");
+	assert(lcp_context_init_file(&protein, "encoding_missing.txt") == -1 && "Missing files should be rejected");
+
+	// the default context and the global tables are kept as well
+	assert(LCP_INIT_FILE("encoding_invalid.txt", 0) == -1 && "Codes out of range should be rejected");
+	assert(lcp_default_context.encode['A'] == 0 && lcp_default_context.encode['W'] == LCP_NO_CODE && "Default context should be kept");
+	assert(alphabet['A'] == 0 && alphabet['W'] == -1 && alphabet_bit_size == 2 && "Global tables should be kept");
+	std::remove("encoding_invalid.txt");
+
+	log("...  test_encoding_context passed!");
+}
+
 int main() {
 	log("Running test_encoding...");
 
 	test_encoding_initialization_default();
 	test_encoding_initialization_from_file();
+	test_encoding_context();
 
 	log("All tests in test_encoding completed successfully!");
 
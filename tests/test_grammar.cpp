@@ -0,0 +1,284 @@
+#include "grammar.h"
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+std::string decompress(const struct grammar *g, uint32_t sequence) {
+	std::string out(grammar_length(g, sequence), ' ');
+	grammar_decompress(g, sequence, &out[0]);
+	return out;
+}
+
+void test_grammar_roundtrip() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(42);
+
+	struct grammar g;
+	init_grammar(&g, 6);
+
+	std::vector<std::string> seqs = {sequence.substr(0, 200000), sequence.substr(500000, 150000), "", "ACG",
+	                                 std::string(3000, 'A') + sequence.substr(800000, 5000)};
+	for (size_t i = 0; i < seqs.size(); i++) {
+		assert(grammar_add(&g, seqs[i].c_str(), seqs[i].size()) == i && "Sequence ids should be consecutive");
+	}
+
+	for (size_t i = 0; i < seqs.size(); i++) {
+		assert(grammar_length(&g, i) == seqs[i].size() && "Lengths should be kept");
+		assert(decompress(&g, i) == seqs[i] && "Sequences should be decompressed exactly");
+	}
+
+	// random access
+	char buffer[1000];
+	for (int i = 0; i < 1000; i++) {
+		uint64_t position = rng() % seqs[0].size();
+		uint64_t len = rng() % 1000;
+		uint64_t written = grammar_extract(&g, 0, position, len, buffer);
+		assert(written == std::min<uint64_t>(len, seqs[0].size() - position) && "Extraction should be clipped at the end");
+		assert(std::string(buffer, written) == seqs[0].substr(position, len) && "Substrings should be extracted exactly");
+	}
+
+	free_grammar(&g);
+
+	log("...  test_grammar_roundtrip passed!");
+}
+
+void test_grammar_collection() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string reference = sequence.substr(300000, 100000);
+	std::mt19937 rng(7);
+
+	struct grammar g;
+	init_grammar(&g, 8);
+
+	// copies of a region with a few substitutions each
+	std::vector<std::string> genomes;
+	for (int i = 0; i < 40; i++) {
+		std::string genome = reference;
+		for (int j = 0; j < 10; j++) {
+			size_t pos = rng() % genome.size();
+			genome[pos] = (genome[pos] == 'A' || genome[pos] == 'a') ? 'C' : 'A';
+		}
+		genomes.push_back(genome);
+		grammar_add(&g, genome.c_str(), genome.size());
+	}
+
+	for (size_t i = 0; i < genomes.size(); i++) {
+		assert(decompress(&g, i) == genomes[i] && "Genomes should be decompressed exactly");
+	}
+
+	uint64_t two_bit_size = genomes.size() * reference.size() / 4;
+	assert(grammar_memsize(&g) < two_bit_size / 3 && "Similar genomes should share most of their rules");
+
+	// the grammar should be written and read back, and sequences added afterwards
+	FILE *out = fopen("test_grammar.lcpg", "wb");
+	assert(write_grammar(&g, out) && "Grammar should be written");
+	assert((uint64_t)ftell(out) == grammar_memsize(&g) && "Written size should match");
+	fclose(out);
+
+	struct grammar read;
+	FILE *in = fopen("test_grammar.lcpg", "rb");
+	assert(read_grammar(&read, in) && "Grammar should be read");
+	fclose(in);
+	remove("test_grammar.lcpg");
+
+	assert(read.sequence_count == g.sequence_count && read.rule_count == g.rule_count && "Grammar should round trip");
+	for (size_t i = 0; i < genomes.size(); i++) {
+		assert(decompress(&read, i) == genomes[i] && "Read genomes should be decompressed exactly");
+	}
+
+	uint32_t rule_count = read.rule_count;
+	uint32_t id = grammar_add(&read, genomes[0].c_str(), genomes[0].size());
+	assert(id == genomes.size() && decompress(&read, id) == genomes[0] && "Sequences should be added to read grammars");
+	assert(read.rule_count == rule_count && "Known sequences should not add rules");
+
+	free_grammar(&read);
+	free_grammar(&g);
+
+	log("...  test_grammar_collection passed!");
+}
+
+void test_grammar_escapes() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(86);
+
+	// soft-masked regions, runs of N and other characters without a code
+	std::string masked = sequence.substr(100000, 50000);
+	for (size_t i = 10000; i < 20000; i++) {
+		masked[i] = std::tolower(masked[i]);
+	}
+	masked.replace(30000, 2000, 2000, 'N');
+	for (int i = 0; i < 100; i++) {
+		masked[40000 + rng() % 10000] = "NnRYkm-"[rng() % 7];
+	}
+
+	std::vector<std::string> seqs = {masked, "nnnnACGTacgtNNNN", std::string(5000, 'n'), sequence.substr(200000, 50000)};
+	for (char &c : seqs[3]) {
+		c = std::toupper(c) == 'N' ? 'A' : std::toupper(c);
+	}
+
+	struct grammar g;
+	init_grammar(&g, 6);
+	for (const std::string &seq : seqs) {
+		grammar_add(&g, seq.c_str(), seq.size());
+	}
+	assert(g.bit_size == 2 && "Bases should be packed at the bit size of the context");
+
+	for (size_t i = 0; i < seqs.size(); i++) {
+		assert(decompress(&g, i) == seqs[i] && "Escaped bases should be decompressed exactly");
+	}
+
+	char buffer[3000];
+	for (int i = 0; i < 1000; i++) {
+		uint64_t position = rng() % seqs[0].size();
+		uint64_t len = rng() % 3000;
+		uint64_t written = grammar_extract(&g, 0, position, len, buffer);
+		assert(std::string(buffer, written) == seqs[0].substr(position, len) && "Substrings with escapes should be extracted exactly");
+	}
+
+	// bases of ACGT only should take 2 bits each besides the symbols
+	struct grammar plain;
+	init_grammar(&plain, 6);
+	grammar_add(&plain, seqs[3].c_str(), seqs[3].size());
+	assert(plain.escape_count == 0 && "Uppercase ACGT bases should not be escaped");
+	uint64_t symbol_size = (plain.rule_count + plain.item_count + plain.top_count) * sizeof(uint32_t);
+	assert(grammar_memsize(&plain) <= symbol_size + plain.base_count / 4 + 512 && "Terminals should be packed");
+	free_grammar(&plain);
+
+	FILE *file = tmpfile();
+	assert(write_grammar(&g, file) && "Grammar should be written");
+	rewind(file);
+	struct grammar read;
+	assert(read_grammar(&read, file) && "Grammar should be read");
+	fclose(file);
+
+	assert(read.escape_count == g.escape_count && "Escapes should round trip");
+	for (size_t i = 0; i < seqs.size(); i++) {
+		assert(decompress(&read, i) == seqs[i] && "Read sequences with escapes should be decompressed exactly");
+	}
+
+	uint32_t rule_count = read.rule_count;
+	grammar_add(&read, seqs[0].c_str(), seqs[0].size());
+	assert(read.rule_count == rule_count && "Known sequences with escapes should not add rules");
+
+	free_grammar(&read);
+	free_grammar(&g);
+
+	log("...  test_grammar_escapes passed!");
+}
+
+// writes the grammar, applies `patch` to the bytes and reads them back
+bool read_patched(const struct grammar *g, void (*patch)(const struct grammar *, std::vector<char> &)) {
+	FILE *file = tmpfile();
+	assert(write_grammar(g, file) && "Grammar should be written");
+	std::vector<char> bytes(ftell(file));
+	rewind(file);
+	assert(fread(bytes.data(), 1, bytes.size(), file) == bytes.size() && "Grammar should be read back");
+	fclose(file);
+
+	patch(g, bytes);
+
+	file = tmpfile();
+	fwrite(bytes.data(), 1, bytes.size(), file);
+	rewind(file);
+	struct grammar read;
+	bool ok = read_grammar(&read, file);
+	fclose(file);
+	if (ok) {
+		free_grammar(&read);
+	}
+	return ok;
+}
+
+// the tops are the last part of the file, preceded by the sequence offsets
+uint32_t *file_tops(const struct grammar *g, std::vector<char> &bytes) {
+	return (uint32_t *)(bytes.data() + bytes.size() - g->top_count * sizeof(uint32_t));
+}
+
+uint64_t *file_sequences(const struct grammar *g, std::vector<char> &bytes) {
+	return (uint64_t *)((char *)file_tops(g, bytes) - (g->sequence_count + 1) * sizeof(uint64_t));
+}
+
+void test_grammar_malformed() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	struct grammar g;
+	init_grammar(&g, 4);
+	grammar_add(&g, sequence.c_str() + 100000, 20000);
+	grammar_add(&g, sequence.c_str() + 200000, 20000);
+	grammar_add(&g, sequence.c_str() + 300000, 20000);
+
+	assert(read_patched(&g, [](const struct grammar *, std::vector<char> &) {}) && "An intact grammar should be read");
+
+	assert(!read_patched(&g, [](const struct grammar *g, std::vector<char> &bytes) {
+		file_tops(g, bytes)[g->top_count / 2] = g->rule_count;
+	}) && "Top level symbols out of range should be rejected");
+
+	assert(!read_patched(&g, [](const struct grammar *g, std::vector<char> &bytes) {
+		uint64_t *sequences = file_sequences(g, bytes);
+		sequences[1] = sequences[2] + 1;
+	}) && "Decreasing sequence offsets should be rejected");
+
+	assert(!read_patched(&g, [](const struct grammar *g, std::vector<char> &bytes) {
+		file_sequences(g, bytes)[0] = 1;
+	}) && "Sequence offsets not starting at 0 should be rejected");
+
+	assert(!read_patched(&g, [](const struct grammar *g, std::vector<char> &bytes) {
+		file_sequences(g, bytes)[g->sequence_count] = g->top_count - 1;
+	}) && "Sequence offsets not ending at the top count should be rejected");
+
+	free_grammar(&g);
+
+	log("...  test_grammar_malformed passed!");
+}
+
+int main() {
+
+	log("Running test_grammar...");
+
+	test_grammar_roundtrip();
+	test_grammar_collection();
+	test_grammar_escapes();
+	test_grammar_malformed();
+
+	log("All tests in test_grammar completed successfully!");
+
+	return 0;
+}
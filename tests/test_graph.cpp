@@ -0,0 +1,251 @@
+#include "graph.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+std::string core_string(const struct core *cr) {
+	std::string key = std::to_string(cr->label) + ":" + std::to_string(cr->bit_size) + ":";
+	for (ubit_size i = 0; i < (cr->bit_size + UBLOCK_BIT_SIZE - 1) / UBLOCK_BIT_SIZE; i++) {
+		key += std::to_string(core_block(cr, i)) + ",";
+	}
+	return key;
+}
+
+std::vector<struct lps> make_reads(const std::string &sequence, int count, int level) {
+	std::mt19937 rng(42);
+	std::vector<struct lps> reads(count);
+	for (int i = 0; i < count; i++) {
+		std::string read = sequence.substr(200000 + rng() % 20000, 1000);
+		init_lps(&(reads[i]), read.c_str(), read.size());
+		lps_deepen(&(reads[i]), level);
+	}
+	return reads;
+}
+
+void test_graph_builder() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<struct lps> reads = make_reads(sequence, 400, 2);
+
+	// expected nodes and edges
+	std::map<std::string, uint32_t> nodes;
+	std::map<std::pair<std::string, std::string>, uint32_t> edges;
+	for (const struct lps &read : reads) {
+		for (int i = 0; i < read.size; i++) {
+			nodes[core_string(&(read.cores[i]))]++;
+			if (0 < i) {
+				edges[{core_string(&(read.cores[i-1])), core_string(&(read.cores[i]))}]++;
+			}
+		}
+	}
+
+	struct graph_builder b;
+	init_graph_builder(&b, nodes.size(), edges.size());
+	assert(graph_builder_add_batch(&b, reads.data(), reads.size(), 1) && "Tables should hold the graph");
+
+	struct core_graph g;
+	init_core_graph(&g, &b);
+
+	assert(g.node_count == nodes.size() && "Nodes should be deduplicated");
+	assert(g.edge_count == edges.size() && "Edges should be deduplicated");
+	assert(g.offsets[g.node_count] == g.edge_count && "Offsets should cover all edges");
+
+	uint64_t total = 0, expected_total = 0;
+	for (uint32_t i = 0; i < g.node_count; i++) {
+		total += g.node_counts[i];
+		for (uint64_t j = g.offsets[i] + 1; j < g.offsets[i + 1]; j++) {
+			assert(g.targets[j-1] < g.targets[j] && "Edges should be ordered by targets");
+		}
+	}
+	for (const auto &node : nodes) {
+		expected_total += node.second;
+	}
+	assert(total == expected_total && "Node counts should add up to the cores");
+
+	// edge counts of the first read should match the expected ones
+	struct graph_builder single;
+	init_graph_builder(&single, nodes.size(), edges.size());
+	graph_builder_add_lps(&single, &(reads[0]));
+	struct core_graph first;
+	init_core_graph(&first, &single);
+	for (uint32_t i = 0; i < first.node_count; i++) {
+		for (uint64_t j = first.offsets[i]; j < first.offsets[i + 1]; j++) {
+			assert(core_graph_edge(&first, i, first.targets[j]) == first.edge_counts[j] && "Edges should be found");
+		}
+	}
+	uint32_t counted = 0;
+	for (uint64_t j = 0; j < first.edge_count; j++) {
+		counted += first.edge_counts[j];
+	}
+	assert(counted == (uint32_t)reads[0].size - 1 && "Adjacencies of a read should be counted");
+
+	free_core_graph(&first);
+	free_graph_builder(&single);
+
+	// multiple threads should build the same graph
+	struct graph_builder b_threads;
+	init_graph_builder(&b_threads, nodes.size(), edges.size());
+	graph_builder_add_batch(&b_threads, reads.data(), reads.size(), 4);
+	struct core_graph g_threads;
+	init_core_graph(&g_threads, &b_threads);
+
+	assert(g_threads.node_count == g.node_count && g_threads.edge_count == g.edge_count && "Parallel graph should match");
+	for (uint32_t i = 0; i < g.node_count; i++) {
+		assert(g_threads.labels[i] == g.labels[i] && g_threads.node_counts[i] == g.node_counts[i] && "Nodes should match");
+		assert(g_threads.offsets[i + 1] == g.offsets[i + 1] && "Offsets should match");
+	}
+	for (uint64_t j = 0; j < g.edge_count; j++) {
+		assert(g_threads.targets[j] == g.targets[j] && g_threads.edge_counts[j] == g.edge_counts[j] && "Edges should match");
+	}
+
+	free_core_graph(&g_threads);
+	free_graph_builder(&b_threads);
+
+	// a small table should report being full
+	struct graph_builder small;
+	init_graph_builder(&small, 10, 10);
+	assert(!graph_builder_add_batch(&small, reads.data(), reads.size(), 2) && small.full && "Full tables should be reported");
+	free_graph_builder(&small);
+
+	// a core whose key matches a node of another label should get a node of its own
+	struct graph_builder collide;
+	assert(init_graph_builder(&collide, 10, 10) && "Builder should be initialized");
+	struct lps one = {reads[0].level, 1, reads[0].cores};
+	graph_builder_add_lps(&collide, &one);
+	uint64_t claimed = 0;
+	while (collide.node_keys[claimed] == GRAPH_EMPTY_KEY) {
+		claimed++;
+	}
+	collide.node_labels[claimed]++;
+	graph_builder_add_lps(&collide, &one);
+	graph_builder_add_lps(&collide, &one);
+	struct core_graph collided;
+	init_core_graph(&collided, &collide);
+	assert(collided.node_count == 2 && "Nodes sharing a key should be told apart by their labels");
+	assert(collided.node_counts[0] + collided.node_counts[1] == 3 && "Nodes sharing a key should be counted apart");
+	free_core_graph(&collided);
+	free_graph_builder(&collide);
+
+	// edges are keyed by two 32-bit slots
+	struct graph_builder huge;
+	assert(!init_graph_builder(&huge, GRAPH_MAX_NODE_SLOTS, 10) && huge.node_slot_count == 0 && "Too many node slots should be rejected");
+	free_graph_builder(&huge);
+
+	free_core_graph(&g);
+	free_graph_builder(&b);
+	for (struct lps &read : reads) {
+		free_lps(&read);
+	}
+
+	log("...  test_graph_builder passed!");
+}
+
+void test_graph_lcpt_gfa() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<struct lps> reads = make_reads(sequence, 600, 3);
+
+	const char *lcpt = "test_graph.lcpt";
+	FILE *out = fopen(lcpt, "wb");
+	for (struct lps &read : reads) {
+		write_lps(&read, out);
+	}
+	fclose(out);
+
+	struct graph_builder b, b_stream;
+	init_graph_builder(&b, 100000, 100000);
+	init_graph_builder(&b_stream, 100000, 100000);
+	graph_builder_add_batch(&b, reads.data(), reads.size(), 1);
+
+	FILE *in = fopen(lcpt, "rb");
+	assert(graph_builder_add_lcpt(&b_stream, in, 3) == (int)reads.size() && "All records should be added");
+	fclose(in);
+
+	// a stream which does not fit should be reported
+	struct graph_builder b_small;
+	init_graph_builder(&b_small, 8, 8);
+	in = fopen(lcpt, "rb");
+	assert(graph_builder_add_lcpt(&b_small, in, 3) == -1 && "A full table should be reported");
+	fclose(in);
+	free_graph_builder(&b_small);
+	remove(lcpt);
+
+	struct core_graph g, g_stream;
+	init_core_graph(&g, &b);
+	init_core_graph(&g_stream, &b_stream);
+	assert(g.node_count == g_stream.node_count && g.edge_count == g_stream.edge_count && "Streamed graph should match");
+	for (uint64_t j = 0; j < g.edge_count; j++) {
+		assert(g.targets[j] == g_stream.targets[j] && g.edge_counts[j] == g_stream.edge_counts[j] && "Edges should match");
+	}
+
+	const char *gfa = "test_graph.gfa";
+	out = fopen(gfa, "w");
+	assert(core_graph_write_gfa(&g, out) && "GFA should be written");
+	fclose(out);
+
+	std::ifstream gfa_in(gfa);
+	std::string line;
+	uint64_t headers = 0, segments = 0, links = 0;
+	while (getline(gfa_in, line)) {
+		headers += line[0] == 'H';
+		segments += line[0] == 'S';
+		links += line[0] == 'L';
+	}
+	gfa_in.close();
+	remove(gfa);
+
+	assert(headers == 1 && segments == g.node_count && links == g.edge_count && "GFA should hold the graph");
+
+	free_core_graph(&g);
+	free_core_graph(&g_stream);
+	free_graph_builder(&b);
+	free_graph_builder(&b_stream);
+	for (struct lps &read : reads) {
+		free_lps(&read);
+	}
+
+	log("...  test_graph_lcpt_gfa passed!");
+}
+
+int main() {
+
+	log("Running test_graph...");
+
+	test_graph_builder();
+	test_graph_lcpt_gfa();
+
+	log("All tests in test_graph completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,273 @@
+#include "index.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unistd.h>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+void test_index_lookup() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	struct lps lps_obj;
+	init_lps(&lps_obj, sequence.c_str(), sequence.size());
+	lps_deepen(&lps_obj, 3);
+
+	struct ltuples tuples;
+	init_ltuples(&tuples, 0);
+	ltuples_add_lps(&tuples, &lps_obj, 0);
+	ltuples_sort(&tuples, 2);
+
+	struct lcp_index index;
+	init_index(&index, &tuples);
+
+	// expected positions of each label in the order of the cores
+	std::map<ulabel, std::vector<uint64_t>> expected;
+	for (int i = 0; i < lps_obj.size; i++) {
+		expected[lps_obj.cores[i].label].push_back(lps_obj.cores[i].start);
+	}
+
+	assert(index.label_count == expected.size() && "Index should contain every distinct label");
+	assert(index.entry_count == (uint64_t)lps_obj.size && "Index should contain every core");
+
+	for (const auto &pair : expected) {
+		struct index_span span = index_lookup(&index, pair.first);
+		assert(span.size == pair.second.size() && "Span size should match label frequency");
+		for (uint32_t i = 0; i < span.size; i++) {
+			assert(span.entries[i].position == pair.second[i] && "Entries should be ordered by position");
+			assert(span.entries[i].record == 0 && "Entries should keep their record");
+		}
+	}
+
+	// absent label
+	ulabel absent = 0;
+	while (expected.count(absent)) {
+		absent++;
+	}
+	assert(index_lookup(&index, absent).size == 0 && "Absent label should produce an empty span");
+
+	free_index(&index);
+	free_ltuples(&tuples);
+	free_lps(&lps_obj);
+
+	log("...  test_index_lookup passed!");
+}
+
+void test_index_lookup_batch() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	struct lps reference;
+	init_lps(&reference, sequence.c_str(), 600000);
+	lps_deepen(&reference, 2);
+
+	struct ltuples tuples;
+	init_ltuples(&tuples, 0);
+	ltuples_add_lps(&tuples, &reference, 0);
+	ltuples_sort(&tuples, 1);
+
+	struct lcp_index index;
+	init_index(&index, &tuples);
+
+	// query with cores of a different region, so both hits and misses occur
+	struct lps query;
+	init_lps(&query, sequence.c_str() + 500000, 200000);
+	lps_deepen(&query, 2);
+
+	std::vector<ulabel> labels;
+	for (int i = 0; i < query.size; i++) {
+		labels.push_back(query.cores[i].label);
+	}
+
+	std::vector<struct index_span> spans(labels.size());
+	index_lookup_batch(&index, labels.data(), labels.size(), spans.data());
+
+	int hit = 0, miss = 0;
+	for (size_t i = 0; i < labels.size(); i++) {
+		struct index_span span = index_lookup(&index, labels[i]);
+		assert(span.size == spans[i].size && "Batched lookup should match single lookup");
+		assert(span.entries == spans[i].entries && "Batched lookup should return spans in input order");
+		span.size ? hit++ : miss++;
+	}
+	assert(hit && miss && "Query should contain both hits and misses");
+
+	// batches shorter than the prefetch distance
+	index_lookup_batch(&index, labels.data(), 3, spans.data());
+	for (size_t i = 0; i < 3; i++) {
+		assert(index_lookup(&index, labels[i]).entries == spans[i].entries && "Short batches should be handled");
+	}
+
+	free_index(&index);
+	free_ltuples(&tuples);
+	free_lps(&reference);
+	free_lps(&query);
+
+	log("...  test_index_lookup_batch passed!");
+}
+
+void test_index_approximate_match() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string reference(sequence.begin() + 600000, sequence.begin() + 900000);
+
+	struct lps lps_obj;
+	ulabel *sigs;
+	init_lps(&lps_obj, reference.c_str(), reference.size());
+	lps_deepen_sigs(&lps_obj, 4, &sigs);
+
+	struct ltuples tuples, sig_tuples;
+	init_ltuples(&tuples, 0);
+	init_ltuples(&sig_tuples, 0);
+	ltuples_add_lps(&tuples, &lps_obj, 0);
+	ltuples_add_sigs(&sig_tuples, &lps_obj, sigs, 0);
+	ltuples_sort(&tuples, 1);
+	ltuples_sort(&sig_tuples, 1);
+
+	assert(sig_tuples.size == CORE_SIGNATURE_COUNT * tuples.size && "Each core should contribute all of its signatures");
+
+	struct lcp_index index, sig_index;
+	init_index(&index, &tuples);
+	init_index(&sig_index, &sig_tuples);
+
+	// substitute every 500th base of a region
+	std::string read(reference.begin() + 100000, reference.begin() + 150000);
+	for (size_t i = 250; i < read.size(); i += 500) {
+		read[i] = (read[i] == 'A' || read[i] == 'a') ? 'C' : 'A';
+	}
+
+	struct lps read_lps;
+	ulabel *read_sigs;
+	init_lps(&read_lps, read.c_str(), read.size());
+	lps_deepen_sigs(&read_lps, 4, &read_sigs);
+
+	std::vector<struct index_span> spans(CORE_SIGNATURE_COUNT * read_lps.size);
+	index_lookup_batch(&sig_index, read_sigs, spans.size(), spans.data());
+
+	int exact = 0, approximate = 0;
+	for (int i = 0; i < read_lps.size; i++) {
+		int exact_hit = index_lookup(&index, read_lps.cores[i].label).size > 0;
+		int approximate_hit = 0;
+		for (int j = 0; j < CORE_SIGNATURE_COUNT; j++) {
+			approximate_hit |= spans[CORE_SIGNATURE_COUNT * i + j].size > 0;
+		}
+
+		// every exact match is an approximate match as well
+		assert((!exact_hit || approximate_hit) && "Exact matches should be found by signatures");
+
+		exact += exact_hit;
+		approximate += approximate_hit;
+	}
+
+	assert(exact < approximate && "Signatures should match cores affected by substitutions");
+
+	free(sigs);
+	free(read_sigs);
+	free_index(&index);
+	free_index(&sig_index);
+	free_ltuples(&tuples);
+	free_ltuples(&sig_tuples);
+	free_lps(&lps_obj);
+	free_lps(&read_lps);
+
+	log("...  test_index_approximate_match passed!");
+}
+
+void test_index_save_open() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	struct ltuples tuples;
+	init_ltuples(&tuples, 0);
+	for (uint32_t r = 0; r < 2; r++) {
+		struct lps lps_obj;
+		init_lps(&lps_obj, sequence.c_str() + r * 300000, 300000);
+		lps_deepen(&lps_obj, 3);
+		ltuples_add_lps(&tuples, &lps_obj, r);
+		free_lps(&lps_obj);
+	}
+	ltuples_sort(&tuples, 2);
+
+	struct lcp_index index;
+	init_index(&index, &tuples);
+
+	const char names[] = "chr1\0chr2";
+	struct index_info info = {3, 2, sizeof(names), names};
+	const char *filename = "test_index.lcpi";
+	assert(index_save(&index, &info, filename) && "Index should be saved");
+
+	struct lcp_index opened;
+	struct index_info opened_info;
+	assert(index_open(&opened, &opened_info, filename) && "Index should be opened");
+	assert(opened.map && "Opened index should be mapped");
+	assert(opened_info.lcp_level == 3 && opened_info.record_count == 2 && "Level and record count should be kept");
+	assert(opened_info.names_size == sizeof(names) && memcmp(opened_info.names, names, sizeof(names)) == 0 && "Names should be kept");
+	assert(opened.slot_count == index.slot_count && opened.label_count == index.label_count && opened.entry_count == index.entry_count && "Sizes should be kept");
+
+	for (uint64_t i = 0; i < tuples.size; i++) {
+		struct index_span expected = index_lookup(&index, tuples.tuples[i].label);
+		struct index_span span = index_lookup(&opened, tuples.tuples[i].label);
+		assert(span.size == expected.size && memcmp(span.entries, expected.entries, span.size * sizeof(struct index_entry)) == 0 && "Opened index should match");
+	}
+
+	free_index(&opened);
+	assert(!opened.map && !opened.slots && "Freed index should be unmapped");
+
+	// truncated files and other files should be rejected
+	assert(truncate(filename, index_memsize(&index) / 2) == 0 && "Index file should be truncated");
+	assert(!index_open(&opened, &opened_info, filename) && "Truncated index should be rejected");
+	assert(!index_open(&opened, &opened_info, "data/test.fasta") && "Other files should be rejected");
+	assert(!index_open(&opened, &opened_info, "missing.lcpi") && "Missing files should be rejected");
+
+	remove(filename);
+	free_index(&index);
+	free_ltuples(&tuples);
+
+	log("...  test_index_save_open passed!");
+}
+
+int main() {
+
+	log("Running test_index...");
+
+	test_index_lookup();
+	test_index_lookup_batch();
+	test_index_approximate_match();
+	test_index_save_open();
+
+	log("All tests in test_index completed successfully!");
+
+	return 0;
+}
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 void log(const std::string &message) {
@@ -322,6 +323,37 @@ void test_lps_reverse_complement() {
 	log("...  test_lps_reverse_complement passed!");
 }
 
+void test_lps_reverse_complement_labels() {
+
+    LCP_INIT();
+
+    std::string test_string = "AGGACTGTGATCTCCTCACACCTGAGCTCAGCTGGCGCTTGGCTGTCGTGGGCTGGGGTCACCAGGTCCCAAATTTGCGCATATC";
+    std::string rc_string(test_string.rbegin(), test_string.rend());
+    for (char &c : rc_string) {
+        c = c == 'A' ? 'T' : c == 'T' ? 'A' : c == 'C' ? 'G' : 'C';
+    }
+
+    // parsing in reverse complement should be the same as parsing the reverse complement
+    struct lps lps_obj1, lps_obj2;
+    init_lps2(&lps_obj1, test_string.c_str(), test_string.size());
+    init_lps(&lps_obj2, rc_string.c_str(), rc_string.size());
+
+    for (int level = 1; level <= 2; level++) {
+        assert(lps_eq(&lps_obj1, &lps_obj2) && "Reverse complement cores should match");
+        for (int i = 0; i < lps_obj1.size; i++) {
+            assert(lps_obj1.cores[i].label == lps_obj2.cores[i].label && "Reverse complement labels should match");
+            assert(lps_obj1.cores[i].start == lps_obj2.cores[i].start && "Reverse complement positions should match");
+        }
+        lps_deepen1(&lps_obj1);
+        lps_deepen1(&lps_obj2);
+    }
+
+    free_lps(&lps_obj1);
+    free_lps(&lps_obj2);
+
+    log("...  test_lps_reverse_complement_labels passed!");
+}
+
 void test_lps_split_init() {
 
     LCP_INIT();
@@ -590,16 +622,431 @@ void test_lps_consistency() {
     log("...  test_lps_consistency passed!");
 }
 
+void test_lps_deepen_sigs() {
+
+    LCP_INIT();
+
+    std::ifstream genome("data/test.fasta");
+    std::string sequence, line;
+
+    getline(genome, line); // skip first header line
+
+    while (getline(genome, line)) {
+        if (line[0] != '>') {
+            sequence += line;
+        } else {
+            break;
+        }
+    }
+    genome.close();
+
+    struct lps lps_obj1;
+    init_lps(&lps_obj1, sequence.c_str(), 200000);
+    lps_deepen(&lps_obj1, 4);
+
+    struct lps lps_obj2;
+    ulabel *sigs;
+    init_lps(&lps_obj2, sequence.c_str(), 200000);
+    int success = lps_deepen_sigs(&lps_obj2, 4, &sigs);
+
+    assert(success && "Deepening with signatures should be successful");
+    assert(lps_eq(&lps_obj1, &lps_obj2) && "Deepening with signatures should produce the same cores");
+    assert(sigs != NULL && "Signatures should be computed");
+
+    for (int i = 0; i < lps_obj2.size; i++) {
+        assert(lps_obj1.cores[i].label == lps_obj2.cores[i].label && "Labels should not be affected by signatures");
+        for (int j = 0; j < CORE_SIGNATURE_COUNT; j++) {
+            assert(sigs[CORE_SIGNATURE_COUNT * i + j] != lps_obj2.cores[i].label && "Signatures should differ from labels");
+        }
+    }
+
+    // identical cores should have identical signatures
+    for (int i = 1; i < lps_obj2.size; i++) {
+        for (int k = 0; k < i; k++) {
+            if (lps_obj2.cores[i].label == lps_obj2.cores[k].label) {
+                for (int j = 0; j < CORE_SIGNATURE_COUNT; j++) {
+                    assert(sigs[CORE_SIGNATURE_COUNT * i + j] == sigs[CORE_SIGNATURE_COUNT * k + j] && "Same cores should have same signatures");
+                }
+                break;
+            }
+        }
+    }
+
+    free(sigs);
+    free_lps(&lps_obj1);
+    free_lps(&lps_obj2);
+
+    log("...  test_lps_deepen_sigs passed!");
+}
+
+void test_lps_quality_filter() {
+
+    LCP_INIT();
+
+    std::ifstream genome("data/test.fasta");
+    std::string sequence, line;
+
+    getline(genome, line); // skip first header line
+
+    while (getline(genome, line)) {
+        if (line[0] != '>') {
+            sequence += line;
+        } else {
+            break;
+        }
+    }
+    genome.close();
+
+    std::string read(sequence.begin() + 300000, sequence.begin() + 320000);
+    int len = read.size();
+
+    // high quality everywhere, with a few low quality bases and a low quality tail
+    std::string quality(len, 'I');
+    for (int i = 97; i < len; i += 1000) {
+        quality[i] = '#';
+    }
+    for (int i = len - 50; i < len; i++) {
+        quality[i] = '+';
+    }
+
+    // no base is below the threshold, so nothing should be dropped
+    struct lps plain, filtered;
+    init_lps(&plain, read.c_str(), len);
+    init_lps_qual(&filtered, read.c_str(), quality.c_str(), len, 2);
+    assert(lps_eq(&plain, &filtered) && "Cores should not be dropped when qualities are above the threshold");
+    free_lps(&filtered);
+
+    init_lps_qual(&filtered, read.c_str(), quality.c_str(), len, 20);
+
+    int index = 0;
+    for (int i = 0; i < plain.size; i++) {
+        bool low = false;
+        for (uint64_t j = plain.cores[i].start; j < plain.cores[i].end; j++) {
+            low |= quality[j] < 20 + QUALITY_OFFSET;
+        }
+        if (!low) {
+            assert(index < filtered.size && "Every high quality core should be kept");
+            assert(core_eq(&(plain.cores[i]), &(filtered.cores[index])) && "Kept cores should be identical to unfiltered cores");
+            assert(plain.cores[i].start == filtered.cores[index].start && "Kept cores should keep their positions");
+            index++;
+        }
+    }
+    assert(index == filtered.size && "Exactly the cores covering low quality bases should be dropped");
+    assert(filtered.size < plain.size && "Some cores should be dropped");
+
+    free_lps(&plain);
+    free_lps(&filtered);
+
+    // reverse complement, positions are relative to the end of the read
+    init_lps2(&plain, read.c_str(), len);
+    init_lps2_qual(&filtered, read.c_str(), quality.c_str(), len, 20);
+
+    index = 0;
+    for (int i = 0; i < plain.size; i++) {
+        bool low = false;
+        for (uint64_t j = len - plain.cores[i].end; j < len - plain.cores[i].start; j++) {
+            low |= quality[j] < 20 + QUALITY_OFFSET;
+        }
+        if (!low) {
+            assert(index < filtered.size && "Every high quality core should be kept");
+            assert(core_eq(&(plain.cores[i]), &(filtered.cores[index])) && "Kept cores should be identical to unfiltered cores");
+            index++;
+        }
+    }
+    assert(index == filtered.size && "Exactly the cores covering low quality bases should be dropped");
+    assert(filtered.size < plain.size && "Some cores should be dropped");
+
+    free_lps(&plain);
+    free_lps(&filtered);
+
+    log("...  test_lps_quality_filter passed!");
+}
+
+void test_lps_run_length() {
+
+    LCP_INIT();
+
+    std::ifstream genome("data/test.fasta");
+    std::string sequence, line;
+
+    getline(genome, line); // skip first header line
+
+    while (getline(genome, line)) {
+        if (line[0] != '>') {
+            sequence += line;
+        } else {
+            break;
+        }
+    }
+    genome.close();
+
+    // a homopolymer and a tandem repeat between unique regions
+    std::string tandem;
+    for (int i = 0; i < 5000; i++) {
+        tandem += "ACGT";
+    }
+    std::string str = sequence.substr(100000, 20000) + std::string(50000, 'A') + sequence.substr(300000, 20000) +
+                      tandem + sequence.substr(500000, 20000);
+
+    struct lps run_obj, plain_obj;
+    init_lps(&run_obj, str.c_str(), str.size());
+    init_lps(&plain_obj, str.c_str(), str.size());
+    for (int i = 0; i < plain_obj.size; i++) {
+        core_expand(&(plain_obj.cores[i]));
+    }
+
+    int run_count = 0;
+    for (int i = 0; i < run_obj.size; i++) {
+        run_count += run_obj.cores[i].run != 0;
+    }
+    assert(run_count == 1 && "The homopolymer should be a single run-length encoded core");
+    assert(lps_memsize(&run_obj) + 12000 < lps_memsize(&plain_obj) && "Run-length encoding should save memory");
+
+    // written cores should be expanded
+    FILE *out = fopen("test_run_length.lcpt", "wb");
+    write_lps(&run_obj, out);
+    fclose(out);
+
+    struct lps read_obj;
+    FILE *in = fopen("test_run_length.lcpt", "rb");
+    assert(read_lps(&read_obj, in) == 1 && "Written object should be read");
+    fclose(in);
+    remove("test_run_length.lcpt");
+    assert(lps_eq(&read_obj, &run_obj) && lps_memsize(&read_obj) == lps_memsize(&plain_obj) && "Read object should be expanded");
+    free_lps(&read_obj);
+
+    for (int level = 1; level <= 5; level++) {
+        assert(run_obj.size == plain_obj.size && lps_eq(&run_obj, &plain_obj) && "Cores should be equal at every level");
+
+        for (int i = 0; i < run_obj.size; i++) {
+            const struct core *lhs = &(run_obj.cores[i]), *rhs = &(plain_obj.cores[i]);
+            assert(lhs->label == rhs->label && lhs->start == rhs->start && lhs->end == rhs->end && "Core metadata should match");
+            assert(core_eq(lhs, rhs) && "Cores should match their expanded forms");
+            if (0 < i) {
+                assert(core_lt(lhs - 1, lhs) == core_lt(rhs - 1, rhs) && core_gt(lhs - 1, lhs) == core_gt(rhs - 1, rhs) && "Orders should match");
+            }
+        }
+
+        lps_deepen(&run_obj, level + 1);
+        lps_deepen(&plain_obj, level + 1);
+        for (int i = 0; i < plain_obj.size; i++) {
+            core_expand(&(plain_obj.cores[i]));
+        }
+    }
+
+    free_lps(&run_obj);
+    free_lps(&plain_obj);
+
+    log("...  test_lps_run_length passed!");
+}
+
+void test_lps_context() {
+
+    LCP_INIT();
+
+    std::ifstream genome("data/test.fasta");
+    std::string sequence, line;
+
+    getline(genome, line); // skip first header line
+
+    while (getline(genome, line)) {
+        if (line[0] != '>') {
+            sequence += line;
+        } else {
+            break;
+        }
+    }
+    genome.close();
+
+    std::string dna = sequence.substr(200000, 200000);
+
+    // a protein alphabet, and a protein sequence derived from the DNA sequence
+    const char *amino_acids = "ACDEFGHIKLMNPQRSTVWY";
+    std::ofstream encoding_file("encoding_protein.txt");
+    for (int i = 0; i < 20; i++) {
+        encoding_file << amino_acids[i] << " " << i << " " << i << "\n";
+    }
+    encoding_file.close();
+
+    struct lcp_context dna_ctx, protein_ctx;
+    lcp_context_init(&dna_ctx);
+    assert(lcp_context_init_file(&protein_ctx, "encoding_protein.txt") == 0 && "Protein context should be read");
+    remove("encoding_protein.txt");
+
+    std::string protein;
+    for (size_t i = 0; i + 3 <= dna.size(); i += 3) {
+        protein += amino_acids[(lcp_default_context.encode[(unsigned char)dna[i]] * 7 + lcp_default_context.encode[(unsigned char)dna[i+1]] * 3 + lcp_default_context.encode[(unsigned char)dna[i+2]]) % 20];
+    }
+
+    // the DNA context should produce the same cores as the default one
+    struct lps expected, dna_obj, dna_rc, expected_rc;
+    init_lps(&expected, dna.c_str(), dna.size());
+    init_lps_ctx(&dna_obj, dna.c_str(), dna.size(), &dna_ctx);
+    init_lps2(&expected_rc, dna.c_str(), dna.size());
+    init_lps2_ctx(&dna_rc, dna.c_str(), dna.size(), &dna_ctx);
+    assert(lps_eq(&expected, &dna_obj) && lps_eq(&expected_rc, &dna_rc) && "DNA context should match the default context");
+    for (int i = 0; i < expected.size; i++) {
+        assert(expected.cores[i].label == dna_obj.cores[i].label && "Labels should match");
+    }
+
+    // protein cores should use 5 bits per character
+    struct lps protein_expected;
+    init_lps_ctx(&protein_expected, protein.c_str(), protein.size(), &protein_ctx);
+    assert(protein_expected.size && "Protein sequence should have cores");
+    for (int i = 0; i < protein_expected.size; i++) {
+        const struct core *cr = &(protein_expected.cores[i]);
+        assert(cr->bit_size == 5 * (cr->end - cr->start) && "Protein cores should be encoded with 5 bits");
+    }
+    lps_deepen(&protein_expected, 3);
+    lps_deepen(&expected, 3);
+
+    // both alphabets should be used concurrently
+    for (int r = 0; r < 4; r++) {
+        struct lps dna_thread, protein_thread;
+        std::thread t1([&]() {
+            init_lps_ctx(&dna_thread, dna.c_str(), dna.size(), &dna_ctx);
+            lps_deepen(&dna_thread, 3);
+        });
+        std::thread t2([&]() {
+            init_lps_ctx(&protein_thread, protein.c_str(), protein.size(), &protein_ctx);
+            lps_deepen(&protein_thread, 3);
+        });
+        t1.join();
+        t2.join();
+
+        assert(lps_eq(&dna_thread, &expected) && lps_eq(&protein_thread, &protein_expected) && "Concurrent parses should match");
+
+        free_lps(&dna_thread);
+        free_lps(&protein_thread);
+    }
+
+    free_lps(&expected);
+    free_lps(&dna_obj);
+    free_lps(&expected_rc);
+    free_lps(&dna_rc);
+    free_lps(&protein_expected);
+
+    log("...  test_lps_context passed!");
+}
+
+void test_lps_hierarchy() {
+
+    LCP_INIT();
+
+    std::ifstream genome("data/test.fasta");
+    std::string sequence, line;
+
+    getline(genome, line); // skip first header line
+
+    while (getline(genome, line)) {
+        if (line[0] != '>') {
+            sequence += line;
+        } else {
+            break;
+        }
+    }
+    genome.close();
+
+    std::string str = sequence.substr(300000, 200000);
+
+    struct lps obj;
+    init_lps(&obj, str.c_str(), str.size());
+
+    struct lps_hierarchy h;
+    init_lps_hierarchy(&h, &obj, 1);
+    assert(lps_deepen_hierarchy(&obj, 6, &h) && "Hierarchy should be deepened");
+    assert(h.first_level == 1 && h.level_count == 6 && "All levels should be kept");
+
+    // every level should match the cores of a plain deepening
+    for (int level = 1; level <= 6; level++) {
+        struct lps expected;
+        init_lps(&expected, str.c_str(), str.size());
+        lps_deepen(&expected, level);
+
+        const struct lps_level *lvl = &(h.levels[level - 1]);
+        assert(lvl->size == expected.size && "Level sizes should match");
+        for (int i = 0; i < expected.size; i++) {
+            assert(lvl->labels[i] == expected.cores[i].label && "Labels should match");
+            assert(lvl->starts[i] == expected.cores[i].start && lvl->ends[i] == expected.cores[i].end && "Positions should match");
+        }
+        if (level == 6) {
+            assert(lps_eq(&expected, &obj) && "Deepened object should match");
+        }
+        free_lps(&expected);
+    }
+
+    // children should be consecutive cores of the level below spanning their parent
+    for (int level = 2; level <= 6; level++) {
+        const struct lps_level *lvl = &(h.levels[level - 1]), *below = &(h.levels[level - 2]);
+        for (int i = 0; i < lvl->size; i++) {
+            uint32_t first;
+            uint32_t count = lps_children(&h, level, i, &first);
+            assert(2 <= count && first >= DCT_ITERATION_COUNT && first + count <= (uint32_t)below->size && "Children should exist");
+            assert(lvl->ends[i] == below->ends[first + count - 1] && "Cores should end with their last child");
+            assert(lvl->starts[i] == below->starts[first - DCT_ITERATION_COUNT] && "Cores should start with the context of their first child");
+        }
+    }
+
+    assert(lps_hierarchy_memsize(&h) > 0 && "Memory size should be reported");
+
+    // cores outside the hierarchy have no children
+    uint32_t first;
+    assert(lps_children(&h, 1, 0, &first) == 0 && "First level cores should have no children");
+    assert(lps_children(&h, 7, 0, &first) == 0 && "Levels above the hierarchy should have no children");
+    assert(lps_children(&h, 6, h.levels[5].size, &first) == 0 && first == 0 && "Indices past the level should have no children");
+
+    // a hierarchy of links only should recover the positions of every level
+    struct lps linked;
+    init_lps(&linked, str.c_str(), str.size());
+    struct lps_hierarchy links;
+    init_lps_hierarchy(&links, &linked, 0);
+    assert(lps_deepen_hierarchy(&linked, 6, &links) && "Hierarchy should be deepened");
+    for (int level = 1; level <= 6; level++) {
+        const struct lps_level *lvl = &(h.levels[level - 1]);
+        assert(links.levels[level - 1].size == lvl->size && "Level sizes should match");
+        assert((level == 1) == (links.levels[level - 1].labels != NULL) && "Only the first level should be kept");
+        for (int i = 0; i < lvl->size; i++) {
+            assert(lps_hierarchy_start(&links, level, i) == lvl->starts[i] && "Starts should be recovered");
+            assert(lps_hierarchy_end(&links, level, i) == lvl->ends[i] && "Ends should be recovered");
+        }
+    }
+    uint64_t kept_size = 0;
+    for (int level = 2; level <= 6; level++) {
+        kept_size += h.levels[level - 1].size * (sizeof(ulabel) + 2 * sizeof(uint64_t));
+    }
+    assert(lps_hierarchy_memsize(&links) + kept_size == lps_hierarchy_memsize(&h) && "Only the kept levels should cost more");
+    free_lps_hierarchy(&links);
+    free_lps(&linked);
+
+    // a hierarchy not matching the object should be rejected
+    struct lps other;
+    init_lps(&other, str.c_str(), str.size());
+    lps_deepen(&other, 2);
+    assert(!lps_deepen_hierarchy(&other, 4, &h) && "Hierarchy should match the object");
+
+    free_lps(&other);
+    free_lps_hierarchy(&h);
+    free_lps(&obj);
+
+    log("...  test_lps_hierarchy passed!");
+}
+
 int main() {
 
 	log("Running test_lps...");
 
 	test_lps_constructor();
     test_lps_reverse_complement();
+    test_lps_reverse_complement_labels();
     test_lps_split_init();
     test_lps_file_io();
 	test_lps_deepen();
     test_lps_consistency();
+    test_lps_deepen_sigs();
+    test_lps_quality_filter();
+    test_lps_run_length();
+    test_lps_context();
+    test_lps_hierarchy();
 
 	log("All tests in test_lps completed successfully!");
 
@@ -0,0 +1,289 @@
+#include "map.h"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+std::string reverse_complement(const std::string &sequence) {
+	std::string result(sequence.rbegin(), sequence.rend());
+	for (char &c : result) {
+		switch (c) {
+			case 'A': case 'a': c = 'T'; break;
+			case 'C': case 'c': c = 'G'; break;
+			case 'G': case 'g': c = 'C'; break;
+			case 'T': case 't': c = 'A'; break;
+		}
+	}
+	return result;
+}
+
+void build_index(const std::vector<std::string> &records, struct lcp_index *index) {
+	struct ltuples tuples;
+	init_ltuples(&tuples, 0);
+	for (size_t r = 0; r < records.size(); r++) {
+		struct lps lps_obj;
+		init_lps(&lps_obj, records[r].c_str(), records[r].size());
+		lps_deepen(&lps_obj, 2);
+		ltuples_add_lps(&tuples, &lps_obj, r);
+		free_lps(&lps_obj);
+	}
+	ltuples_sort(&tuples, 1);
+	init_index(index, &tuples);
+	free_ltuples(&tuples);
+}
+
+void test_map_pair() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<std::string> records = {sequence.substr(600000, 300000)};
+
+	struct lcp_index index;
+	build_index(records, &index);
+
+	std::mt19937 rng(42);
+	int correct = 0, total = 200;
+
+	for (int i = 0; i < total; i++) {
+		int64_t fragment = 1000 + rng() % 290000;
+		int64_t insert = 300 + rng() % 200;
+		std::string mate1 = records[0].substr(fragment, 150);
+		std::string mate2 = reverse_complement(records[0].substr(fragment + insert - 150, 150));
+
+		struct read_pair pair;
+		init_read_pair(&pair, mate1.c_str(), mate1.size(), mate2.c_str(), mate2.size(), 2);
+
+		struct map_chain chain;
+		if (map_single(&index, &(pair.mate1), &chain)) {
+			assert(chain.score && "Found chains should have seeds");
+		}
+
+		struct map_pair result;
+		int proper = map_pair(&index, &pair, mate2.size(), 250, 550, &result);
+		assert(proper == result.proper && "Return value should match the result");
+
+		if (proper) {
+			int64_t insert_size = result.mate2.position + (int64_t)mate2.size() - result.mate1.position;
+			assert(250 - MAP_DIAGONAL_TOLERANCE <= insert_size && insert_size <= 550 + MAP_DIAGONAL_TOLERANCE && "Proper pairs should satisfy the insert size");
+		}
+
+		correct += proper && result.mate1.record == 0 && result.mate1.position == fragment &&
+		           result.mate2.position == fragment + insert - 150;
+
+		free_read_pair(&pair);
+	}
+
+	assert(total * 0.95 <= correct && "Most pairs should be mapped to their origin");
+
+	free_index(&index);
+
+	log("...  test_map_pair passed!");
+}
+
+void test_map_pair_rescue() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string repeat = sequence.substr(100000, 1000);
+
+	// records sharing a repeat more frequent than the occurrence limit
+	std::vector<std::string> records;
+	for (int r = 0; r < MAP_MAX_OCCURRENCE + 16; r++) {
+		records.push_back(sequence.substr(200000 + r * 5000, 2000) + repeat + sequence.substr(202000 + r * 5000, 2000));
+	}
+
+	struct lcp_index index;
+	build_index(records, &index);
+
+	int correct = 0, total = 0;
+
+	for (int r = 0; r < (int)records.size(); r += 7) {
+		// the first mate in the unique flank, the second one in the repeat
+		std::string mate1 = records[r].substr(1800, 150);
+		std::string mate2 = reverse_complement(records[r].substr(2300, 150));
+
+		struct read_pair pair;
+		init_read_pair(&pair, mate1.c_str(), mate1.size(), mate2.c_str(), mate2.size(), 2);
+
+		struct map_pair result;
+		map_pair(&index, &pair, mate2.size(), 400, 800, &result);
+
+		correct += result.proper && result.mate1.record == (uint32_t)r && result.mate2.record == (uint32_t)r &&
+		           result.mate2.position == 2300;
+		total++;
+
+		free_read_pair(&pair);
+	}
+
+	assert(correct == total && "Repetitive mates should be rescued by their unique mates");
+
+	free_index(&index);
+
+	log("...  test_map_pair_rescue passed!");
+}
+
+void test_map_pairs() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<std::string> records = {sequence.substr(600000, 300000)};
+
+	struct lcp_index index;
+	build_index(records, &index);
+
+	std::mt19937 rng(7);
+	std::vector<std::string> mates1, mates2;
+	for (int i = 0; i < 600; i++) {
+		int64_t fragment = 1000 + rng() % 290000;
+		mates1.push_back(records[0].substr(fragment, 150));
+		mates2.push_back(reverse_complement(records[0].substr(fragment + 250, 150)));
+	}
+
+	std::vector<const char *> ptrs1, ptrs2;
+	std::vector<int> lengths1, lengths2;
+	for (size_t i = 0; i < mates1.size(); i++) {
+		ptrs1.push_back(mates1[i].c_str());
+		ptrs2.push_back(mates2[i].c_str());
+		lengths1.push_back(mates1[i].size());
+		lengths2.push_back(mates2[i].size());
+	}
+
+	std::vector<struct map_pair> results(mates1.size());
+	int proper_count = map_pairs(&index, ptrs1.data(), lengths1.data(), ptrs2.data(), lengths2.data(), mates1.size(), 2, 300, 500, results.data(), 3);
+
+	int expected_count = 0;
+	for (size_t i = 0; i < mates1.size(); i++) {
+		struct read_pair pair;
+		init_read_pair(&pair, ptrs1[i], lengths1[i], ptrs2[i], lengths2[i], 2);
+
+		struct map_pair expected;
+		expected_count += map_pair(&index, &pair, lengths2[i], 300, 500, &expected);
+
+		assert(expected.proper == results[i].proper && "Batch mapping should match single pair mapping");
+		assert(expected.mate1.position == results[i].mate1.position && "Batch mapping should match single pair mapping");
+		assert(expected.mate2.position == results[i].mate2.position && "Batch mapping should match single pair mapping");
+
+		free_read_pair(&pair);
+	}
+
+	assert(proper_count == expected_count && "Proper pairs should be counted");
+
+	free_index(&index);
+
+	log("...  test_map_pairs passed!");
+}
+
+void test_map_reads() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<std::string> records = {sequence.substr(0, 200000), sequence.substr(600000, 300000)};
+
+	struct lcp_index index;
+	build_index(records, &index);
+
+	// reads from both strands of both records, and random reads
+	std::mt19937 rng(97);
+	std::vector<std::string> reads;
+	std::vector<uint32_t> record_ids;
+	std::vector<int64_t> positions;
+	for (int i = 0; i < 700; i++) {
+		uint32_t r = rng() % 2;
+		int64_t position = rng() % (records[r].size() - 2000);
+		std::string read = records[r].substr(position, 150 + rng() % 1500);
+		if (i % 7 == 6) {
+			for (char &c : read) {
+				c = "ACGT"[rng() % 4];
+			}
+		} else if (i % 2) {
+			read = reverse_complement(read);
+		}
+		reads.push_back(read);
+		record_ids.push_back(r);
+		positions.push_back(position);
+	}
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &read : reads) {
+		ptrs.push_back(read.c_str());
+		lengths.push_back(read.size());
+	}
+
+	std::vector<struct map_read> results(reads.size());
+	int mapped_count = map_reads(&index, ptrs.data(), lengths.data(), reads.size(), 2, results.data(), 4);
+
+	int expected_count = 0, correct = 0, simulated = 0;
+	for (size_t i = 0; i < reads.size(); i++) {
+		struct lps forward, reverse;
+		init_lps(&forward, ptrs[i], lengths[i]);
+		lps_deepen(&forward, 2);
+		init_lps2(&reverse, ptrs[i], lengths[i]);
+		lps_deepen(&reverse, 2);
+
+		struct map_chain chain1, chain2;
+		map_single(&index, &forward, &chain1);
+		map_single(&index, &reverse, &chain2);
+		struct map_chain expected = chain1.score < chain2.score ? chain2 : chain1;
+
+		assert(results[i].chain.score == expected.score && results[i].chain.position == expected.position && "Batch mapping should match single read mapping");
+		assert(results[i].reverse == (chain1.score < chain2.score) && "Strand should be the one of the better chain");
+		expected_count += expected.score != 0;
+
+		if (i % 7 != 6) {
+			simulated++;
+			correct += results[i].reverse == (int)(i % 2) && results[i].chain.record == record_ids[i] && results[i].chain.position == positions[i];
+		}
+
+		free_lps(&forward);
+		free_lps(&reverse);
+	}
+
+	assert(mapped_count == expected_count && "Reads with a chain should be counted");
+	assert(simulated * 0.95 <= correct && "Most simulated reads should map to their origin");
+
+	free_index(&index);
+
+	log("...  test_map_reads passed!");
+}
+
+int main() {
+
+	log("Running test_map...");
+
+	test_map_pair();
+	test_map_pair_rescue();
+	test_map_pairs();
+	test_map_reads();
+
+	log("All tests in test_map completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+#include "overlap.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+std::string reverse_complement(const std::string &str) {
+	std::string rc(str.rbegin(), str.rend());
+	for (char &c : rc) {
+		switch (c) {
+			case 'A': c = 'T'; break;
+			case 'C': c = 'G'; break;
+			case 'G': c = 'C'; break;
+			case 'T': c = 'A'; break;
+			case 'a': c = 't'; break;
+			case 'c': c = 'g'; break;
+			case 'g': c = 'c'; break;
+			case 't': c = 'a'; break;
+		}
+	}
+	return rc;
+}
+
+struct simulated_read {
+	std::string seq;
+	int64_t start;
+	int64_t end;
+	bool reverse;
+};
+
+std::vector<simulated_read> simulate_reads(const std::string &region, int count, std::mt19937 &rng) {
+	std::vector<simulated_read> reads;
+	for (int i = 0; i < count; i++) {
+		int64_t len = 3000 + rng() % 3000;
+		int64_t start = rng() % (region.size() - len);
+		std::string seq = region.substr(start, len);
+		for (int j = 0; j < len / 200; j++) {
+			size_t pos = rng() % seq.size();
+			seq[pos] = "ACGT"[rng() % 4];
+		}
+		bool reverse = rng() % 2;
+		reads.push_back({reverse ? reverse_complement(seq) : seq, start, start + len, reverse});
+	}
+	return reads;
+}
+
+void test_overlap_simulated() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string region = sequence.substr(200000, 60000);
+	std::mt19937 rng(92);
+
+	std::vector<simulated_read> reads = simulate_reads(region, 150, rng);
+	std::vector<const char *> seqs;
+	std::vector<int> lengths;
+	for (const simulated_read &read : reads) {
+		seqs.push_back(read.seq.c_str());
+		lengths.push_back(read.seq.size());
+	}
+
+	struct overlap_set set;
+	init_overlap_set(&set);
+	uint64_t found = find_overlaps(seqs.data(), lengths.data(), reads.size(), 4, OVERLAP_MIN_SHARED, OVERLAP_MAX_OCCURRENCE, &set, 1);
+	assert(found == set.size && "All overlaps should be returned");
+
+	// every reported overlap should be a true one, on the right strand and diagonal
+	std::vector<std::vector<int>> reported(reads.size(), std::vector<int>(reads.size(), 0));
+	for (uint64_t i = 0; i < set.size; i++) {
+		const struct read_overlap *ov = &(set.overlaps[i]);
+		const simulated_read &q = reads[ov->query], &t = reads[ov->target];
+
+		assert(ov->query < ov->target && "Each pair should be reported from its first read");
+		if (0 < i) {
+			const struct read_overlap *prev = &(set.overlaps[i-1]);
+			assert((prev->query < ov->query || (prev->query == ov->query && (prev->target < ov->target ||
+			       (prev->target == ov->target && prev->reverse < ov->reverse)))) && "Overlaps should be ordered");
+		}
+		assert(ov->query_start < ov->query_end && ov->query_end <= (uint64_t)lengths[ov->query] && "Query interval should lie in the query");
+		assert(ov->target_start < ov->target_end && ov->target_end <= (uint64_t)lengths[ov->target] && "Target interval should lie in the target");
+		assert(std::min(q.end, t.end) > std::max(q.start, t.start) && "Overlapping reads should share a region");
+		assert(ov->reverse == (q.reverse != t.reverse) && "Strands should match");
+		assert(ov->matches <= ov->query_end - ov->query_start && 0 < ov->matches && "Matches should lie in the query interval");
+
+		if (!q.reverse && !t.reverse) {
+			int64_t diagonal = (int64_t)ov->query_start - (int64_t)ov->target_start;
+			assert(std::abs(diagonal - (t.start - q.start)) <= OVERLAP_DIAGONAL_TOLERANCE && "Diagonal should match the offset of the reads");
+		}
+		reported[ov->query][ov->target] = 1;
+	}
+
+	// long true overlaps should be found
+	int expected = 0, recalled = 0;
+	for (size_t a = 0; a < reads.size(); a++) {
+		for (size_t b = a + 1; b < reads.size(); b++) {
+			if (2000 <= std::min(reads[a].end, reads[b].end) - std::max(reads[a].start, reads[b].start)) {
+				expected++;
+				recalled += reported[a][b];
+			}
+		}
+	}
+	assert(0 < expected && expected <= recalled * 100 / 98 && "Long overlaps should be found");
+
+	// multiple threads should find the same overlaps
+	struct overlap_set set_threads;
+	init_overlap_set(&set_threads);
+	find_overlaps(seqs.data(), lengths.data(), reads.size(), 4, OVERLAP_MIN_SHARED, OVERLAP_MAX_OCCURRENCE, &set_threads, 4);
+	assert(set_threads.size == set.size && "Parallel overlaps should match");
+	for (uint64_t i = 0; i < set.size; i++) {
+		const struct read_overlap *a = &(set.overlaps[i]), *b = &(set_threads.overlaps[i]);
+		assert(a->query == b->query && a->target == b->target && a->reverse == b->reverse && a->shared == b->shared &&
+		       a->query_start == b->query_start && a->target_end == b->target_end && "Overlaps should match");
+	}
+	free_overlap_set(&set_threads);
+
+	// a strict repeat filter should drop overlaps
+	struct overlap_set filtered;
+	init_overlap_set(&filtered);
+	find_overlaps(seqs.data(), lengths.data(), reads.size(), 4, OVERLAP_MIN_SHARED, 2, &filtered, 2);
+	assert(filtered.size < set.size && "Frequent labels should be skipped");
+	free_overlap_set(&filtered);
+
+	// PAF output
+	const char *paf = "test_overlap.paf";
+	FILE *out = fopen(paf, "w");
+	assert(write_overlaps_paf(&set, NULL, lengths.data(), out) && "PAF should be written");
+	fclose(out);
+
+	std::ifstream paf_in(paf);
+	std::string line;
+	uint64_t lines = 0;
+	while (getline(paf_in, line)) {
+		int columns = 1;
+		for (char c : line) {
+			columns += c == '\t';
+		}
+		assert(columns == 13 && "PAF lines should have 12 columns and a tag");
+		lines++;
+	}
+	paf_in.close();
+	remove(paf);
+	assert(lines == set.size && "PAF should hold all overlaps");
+
+	free_overlap_set(&set);
+
+	log("...  test_overlap_simulated passed!");
+}
+
+int main() {
+
+	log("Running test_overlap...");
+
+	test_overlap_simulated();
+
+	log("All tests in test_overlap completed successfully!");
+
+	return 0;
+}
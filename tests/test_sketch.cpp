@@ -0,0 +1,244 @@
+#include "sketch.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+std::vector<std::string> make_genomes(const std::string &sequence, int count, int len) {
+	std::vector<std::string> genomes;
+	for (int i = 0; i < count; i++) {
+		genomes.push_back(sequence.substr(100000 + i * len, len));
+	}
+	return genomes;
+}
+
+void mutate(std::string &genome, int count, std::mt19937 &rng) {
+	for (int i = 0; i < count; i++) {
+		size_t pos = rng() % genome.size();
+		genome[pos] = (genome[pos] == 'A' || genome[pos] == 'a') ? 'C' : 'A';
+	}
+}
+
+void test_sketch_similarity() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(42);
+
+	struct genome_sketch sketch, copy, other, tiny, empty;
+	std::string genome = sequence.substr(200000, 5000);
+	std::string mutated = genome;
+	mutate(mutated, 10, rng);
+
+	sketch_genome(genome.c_str(), genome.size(), 2, &sketch);
+	sketch_genome(mutated.c_str(), mutated.size(), 2, &copy);
+	sketch_genome(sequence.c_str() + 500000, 5000, 2, &other);
+	sketch_genome(sequence.c_str() + 300000, 40, 1, &tiny);
+	sketch_genome("", 0, 2, &empty);
+
+	assert(sketch_similarity(&sketch, &sketch) == 1 && "A sketch should be identical to itself");
+	assert(sketch_similarity(&sketch, &copy) >= 0.5 && "A mutated copy should be similar");
+	assert(sketch_similarity(&sketch, &other) <= 0.2 && "Unrelated genomes should not be similar");
+	assert(sketch_similarity(&sketch, &empty) == 0 && "Empty sketches should not be similar to anything");
+
+	for (int j = 0; j < SKETCH_SIZE; j++) {
+		assert(tiny.mins[j] != SKETCH_EMPTY && "Densification should fill all bins");
+		assert(empty.mins[j] == SKETCH_EMPTY && "Sketches without cores should be empty");
+	}
+
+	log("...  test_sketch_similarity passed!");
+}
+
+void test_sketch_index_query() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::vector<std::string> genomes = make_genomes(sequence, 300, 3000);
+	std::mt19937 rng(7);
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &genome : genomes) {
+		ptrs.push_back(genome.c_str());
+		lengths.push_back(genome.size());
+	}
+
+	std::vector<struct genome_sketch> sketches(genomes.size()), sketches_threads(genomes.size());
+	sketch_genomes(ptrs.data(), lengths.data(), genomes.size(), 2, sketches.data(), 1);
+	sketch_genomes(ptrs.data(), lengths.data(), genomes.size(), 2, sketches_threads.data(), 4);
+	for (size_t i = 0; i < genomes.size(); i++) {
+		assert(sketch_similarity(&(sketches[i]), &(sketches_threads[i])) == 1 && "Parallel sketches should match");
+	}
+
+	struct sketch_index idx;
+	init_sketch_index(&idx, sketches.data(), sketches.size(), 4);
+
+	// mutated copies of indexed genomes should find their origin first
+	struct sketch_hit hits[5];
+	int found = 0;
+	for (int i = 0; i < 100; i++) {
+		int g = rng() % genomes.size();
+		std::string query = genomes[g];
+		mutate(query, 6, rng);
+
+		struct genome_sketch sketch;
+		sketch_genome(query.c_str(), query.size(), 2, &sketch);
+		int hit_count = sketch_index_query(&idx, &sketch, 5, hits);
+
+		assert(hit_count <= 5 && "Hits should be limited to k");
+		for (int j = 1; j < hit_count; j++) {
+			assert(hits[j].similarity <= hits[j-1].similarity && "Hits should be ranked by similarity");
+		}
+		found += 0 < hit_count && hits[0].genome == (uint32_t)g;
+	}
+	assert(95 <= found && "Mutated copies should find their origin");
+
+	// genomes outside the index should retrieve few candidates, none of them similar
+	struct genome_sketch outside;
+	sketch_genome(sequence.c_str() + 1000000, 3000, 2, &outside);
+	int hit_count = sketch_index_query(&idx, &outside, 5, hits);
+	assert((hit_count == 0 || hits[0].similarity < 0.3) && "Unrelated queries should not be similar");
+
+	// the mapped index should answer as the built one
+	const char *filename = "test_sketch.lcpski";
+	assert(sketch_index_save(&idx, filename) && "Index should be saved");
+
+	struct sketch_index mapped;
+	assert(sketch_index_open(&mapped, filename) && "Index should be opened");
+	assert(mapped.genome_count == idx.genome_count && "Genome count should round trip");
+
+	struct sketch_hit mapped_hits[5];
+	for (int g = 0; g < 300; g += 30) {
+		int count = sketch_index_query(&idx, &(sketches[g]), 5, hits);
+		int mapped_count = sketch_index_query(&mapped, &(sketches[g]), 5, mapped_hits);
+		assert(count == mapped_count && 0 < count && "Mapped index should find the same hits");
+		assert(hits[0].genome == (uint32_t)g && hits[0].similarity == 1 && "A genome should find itself");
+		for (int j = 0; j < count; j++) {
+			assert(hits[j].genome == mapped_hits[j].genome && hits[j].similarity == mapped_hits[j].similarity &&
+			       "Mapped index should rank hits the same");
+		}
+	}
+
+	free_sketch_index(&mapped);
+	free_sketch_index(&idx);
+	remove(filename);
+
+	struct sketch_index missing;
+	assert(!sketch_index_open(&missing, "data/test.fasta") && "Other files should be rejected");
+
+	log("...  test_sketch_index_query passed!");
+}
+
+void test_sketch_compare() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(98);
+
+	// related and unrelated genomes, one of them empty, in counts that are not multiples of the tiles
+	std::vector<std::string> genomes = make_genomes(sequence, 37, 8000);
+	for (int i = 0; i < 40; i++) {
+		std::string genome = genomes[rng() % genomes.size()];
+		mutate(genome, rng() % 200, rng);
+		genomes.push_back(genome);
+	}
+	genomes.push_back("");
+
+	std::vector<const char *> ptrs;
+	std::vector<int> lengths;
+	for (const std::string &genome : genomes) {
+		ptrs.push_back(genome.c_str());
+		lengths.push_back(genome.size());
+	}
+	std::vector<struct genome_sketch> sketches(genomes.size());
+	sketch_genomes(ptrs.data(), lengths.data(), genomes.size(), 3, sketches.data(), 4);
+
+	uint32_t query_count = 21, target_count = sketches.size();
+	std::vector<uint16_t> equal_counts(query_count * target_count);
+	sketch_compare(sketches.data() + 60, query_count, sketches.data(), target_count, equal_counts.data(), 3);
+
+	for (uint32_t q = 0; q < query_count; q++) {
+		for (uint32_t t = 0; t < target_count; t++) {
+			double similarity = sketch_similarity(&(sketches[60 + q]), &(sketches[t]));
+			assert(equal_counts[q * target_count + t] == similarity * SKETCH_SIZE && "Counts should match the similarities");
+		}
+	}
+	assert(equal_counts[(query_count - 1) * target_count] == 0 && "Empty sketches should have no equal bins");
+
+	// the sketch of two records is the sketch of the union of their labels
+	struct lps first, second;
+	init_lps(&first, ptrs[0], lengths[0]);
+	init_lps(&second, ptrs[1], lengths[1]);
+	lps_deepen(&first, 3);
+	lps_deepen(&second, 3);
+
+	struct lps both;
+	both.size = first.size + second.size;
+	both.cores = (struct core *)malloc(both.size * sizeof(struct core));
+	memcpy(both.cores, first.cores, first.size * sizeof(struct core));
+	memcpy(both.cores + first.size, second.cores, second.size * sizeof(struct core));
+
+	struct genome_sketch merged, expected;
+	init_genome_sketch(&merged);
+	sketch_add_lps(&first, &merged);
+	sketch_add_lps(&second, &merged);
+	sketch_densify(&merged);
+	sketch_lps(&both, &expected);
+	assert(memcmp(&merged, &expected, sizeof(struct genome_sketch)) == 0 && "Sketches of records should merge");
+
+	free(both.cores);
+	free_lps(&first);
+	free_lps(&second);
+
+	// cached sketches should only be loaded at the same level
+	const char *filename = "test_sketch.sketch";
+	struct genome_sketch loaded;
+	assert(sketch_save(&(sketches[5]), 3, filename) && "Sketch should be saved");
+	assert(sketch_load(&loaded, 3, filename) && memcmp(&loaded, &(sketches[5]), sizeof(struct genome_sketch)) == 0 && "Sketch should be loaded");
+	assert(!sketch_load(&loaded, 4, filename) && "Sketches of other levels should be rejected");
+	assert(!sketch_load(&loaded, 3, "data/test.fasta") && "Other files should be rejected");
+	remove(filename);
+
+	log("...  test_sketch_compare passed!");
+}
+
+int main() {
+
+	log("Running test_sketch...");
+
+	test_sketch_similarity();
+	test_sketch_index_query();
+	test_sketch_compare();
+
+	log("All tests in test_sketch completed successfully!");
+
+	return 0;
+}
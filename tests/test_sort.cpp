@@ -0,0 +1,158 @@
+#include "sort.h"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+bool tuple_label_less(const struct ltuple &lhs, const struct ltuple &rhs) {
+	return lhs.label < rhs.label;
+}
+
+bool tuple_eq(const struct ltuple &lhs, const struct ltuple &rhs) {
+	return lhs.label == rhs.label && lhs.record == rhs.record && lhs.position == rhs.position;
+}
+
+void test_ltuples_sort() {
+
+	std::mt19937 rng(42);
+
+	for (int thread_count : {1, 4}) {
+		struct ltuples arr;
+		init_ltuples(&arr, 0);
+
+		// few distinct labels to exercise stability
+		for (uint64_t i = 0; i < 200000; i++) {
+			ltuples_push(&arr, rng() % 5000 * 0x10001, i % 7, i);
+		}
+
+		std::vector<struct ltuple> expected(arr.tuples, arr.tuples + arr.size);
+		std::stable_sort(expected.begin(), expected.end(), tuple_label_less);
+
+		ltuples_sort(&arr, thread_count);
+
+		assert(arr.size == expected.size() && "Sorting should not change the tuple count");
+		for (uint64_t i = 0; i < arr.size; i++) {
+			assert(tuple_eq(arr.tuples[i], expected[i]) && "Radix sort should match stable sort");
+		}
+
+		free_ltuples(&arr);
+	}
+
+	log("...  test_ltuples_sort passed!");
+}
+
+void test_ltuples_add_lps() {
+
+	LCP_INIT();
+
+	std::string test_string = "GGGACCTGGTGACCCCAGCCCACGACAGCCAAGCGCCAGCTGAGCTCAGGTGTGAGGAGATCACAGTCCT";
+	struct lps lps_obj;
+	init_lps(&lps_obj, test_string.c_str(), test_string.size());
+
+	struct ltuples arr;
+	init_ltuples(&arr, 0);
+	ltuples_add_lps(&arr, &lps_obj, 3);
+
+	assert(arr.size == (uint64_t)lps_obj.size && "Each core should produce a tuple");
+	for (int i = 0; i < lps_obj.size; i++) {
+		assert(arr.tuples[i].label == lps_obj.cores[i].label && "Tuple label should match core label");
+		assert(arr.tuples[i].position == lps_obj.cores[i].start && "Tuple position should match core start");
+		assert(arr.tuples[i].record == 3 && "Tuple record should match given record");
+	}
+
+	free_ltuples(&arr);
+	free_lps(&lps_obj);
+
+	log("...  test_ltuples_add_lps passed!");
+}
+
+void test_ltuples_sort_lcpt() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	// write a two-record lcpt stream
+	FILE *out = fopen("sort_test.lcpt", "wb");
+	for (int r = 0; r < 2; r++) {
+		struct lps lps_obj;
+		init_lps(&lps_obj, sequence.c_str() + r * 100000, 400000);
+		lps_deepen(&lps_obj, 3);
+		write_lps(&lps_obj, out);
+		free_lps(&lps_obj);
+	}
+	char done = 0;
+	fwrite(&done, 1, 1, out);
+	fclose(out);
+
+	// in-memory reference
+	FILE *in = fopen("sort_test.lcpt", "rb");
+	struct ltuples arr;
+	init_ltuples(&arr, 0);
+	int records = ltuples_add_lcpt(&arr, in);
+	fclose(in);
+	assert(records == 2 && "Both records should be read from the stream");
+	ltuples_sort(&arr, 2);
+
+	// external sort with a budget forcing multiple runs
+	for (uint64_t budget : {(uint64_t)1 << 30, (uint64_t)50000}) {
+		in = fopen("sort_test.lcpt", "rb");
+		FILE *sorted = tmpfile();
+		int64_t written = ltuples_sort_lcpt(in, sorted, budget, 2);
+		fclose(in);
+
+		assert(written == (int64_t)arr.size && "External sort should write every tuple");
+
+		rewind(sorted);
+		std::vector<struct ltuple> result(arr.size);
+		size_t read = fread(result.data(), sizeof(struct ltuple), arr.size, sorted);
+		assert(read == arr.size && "Sorted tuples should be read back");
+		fclose(sorted);
+
+		for (uint64_t i = 0; i < arr.size; i++) {
+			assert(tuple_eq(result[i], arr.tuples[i]) && "External sort should match in-memory sort");
+		}
+	}
+
+	free_ltuples(&arr);
+	std::remove("sort_test.lcpt");
+
+	log("...  test_ltuples_sort_lcpt passed!");
+}
+
+int main() {
+
+	log("Running test_sort...");
+
+	test_ltuples_sort();
+	test_ltuples_add_lps();
+	test_ltuples_sort_lcpt();
+
+	log("All tests in test_sort completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include "stats.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+void test_stats_levels() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(96);
+
+	std::vector<std::string> seqs;
+	for (int len : {600000, 100000, 5000, 20, 0}) {
+		seqs.push_back(sequence.substr(rng() % (sequence.size() - len), len));
+	}
+
+	const int lcp_level = 6;
+	struct lcp_stats stats;
+	init_lcp_stats(&stats, lcp_level);
+	for (const std::string &seq : seqs) {
+		lcp_stats_add(&stats, seq.c_str(), seq.size());
+	}
+	assert(stats.sequence_count == seqs.size() && "All sequences should be counted");
+
+	// expected statistics from the cores of each level
+	std::vector<std::vector<uint64_t>> lengths(lcp_level);
+	std::vector<std::set<ulabel>> labels(lcp_level);
+	for (const std::string &seq : seqs) {
+		struct lps str;
+		init_lps(&str, seq.c_str(), seq.size());
+		for (int level = 1; level <= lcp_level; level++) {
+			if (1 < level) {
+				lps_deepen(&str, level);
+			}
+			for (int i = 0; str.level == level && i < str.size; i++) {
+				lengths[level-1].push_back(str.cores[i].end - str.cores[i].start);
+				labels[level-1].insert(str.cores[i].label);
+			}
+		}
+		free_lps(&str);
+	}
+
+	for (int l = 0; l < lcp_level; l++) {
+		const struct level_stats *level = &(stats.levels[l]);
+		std::vector<uint64_t> &expected = lengths[l];
+		std::sort(expected.begin(), expected.end());
+
+		assert(level->core_count == expected.size() && "Core counts should match");
+		assert(0 < level->core_count && "Every level should have cores");
+
+		uint64_t total = 0;
+		for (uint64_t len : expected) {
+			total += len;
+		}
+		assert(level->total_length == total && "Total lengths should match");
+		assert(level->min_length == expected.front() && level->max_length == expected.back() && "Extreme lengths should match");
+
+		for (double q : {0.1, 0.5, 0.9}) {
+			uint64_t exact = expected[(uint64_t)(q * (expected.size() - 1))];
+			uint64_t estimate = level_stats_quantile(level, q);
+			assert(estimate <= exact && exact - estimate <= exact / STATS_SUB_BUCKETS && "Quantiles should be close");
+		}
+
+		double distinct = level_stats_distinct(level);
+		assert(std::fabs(distinct - labels[l].size()) <= 0.05 * labels[l].size() + 2 && "Distinct labels should be close");
+	}
+
+	// multiple threads should collect the same statistics
+	std::vector<const char *> ptrs;
+	std::vector<int> lens;
+	for (const std::string &seq : seqs) {
+		ptrs.push_back(seq.c_str());
+		lens.push_back(seq.size());
+	}
+	struct lcp_stats batch;
+	init_lcp_stats(&batch, lcp_level);
+	lcp_stats_add_batch(&batch, ptrs.data(), lens.data(), seqs.size(), 4);
+	assert(batch.sequence_count == stats.sequence_count && batch.base_count == stats.base_count && "Totals should match");
+	assert(memcmp(batch.levels, stats.levels, lcp_level * sizeof(struct level_stats)) == 0 && "Parallel statistics should match");
+	free_lcp_stats(&batch);
+
+	// outputs
+	const char *tsv = "test_stats.tsv";
+	FILE *out = fopen(tsv, "w");
+	assert(write_lcp_stats_tsv(&stats, out) && "TSV should be written");
+	fclose(out);
+
+	std::ifstream tsv_in(tsv);
+	std::string line;
+	int lines = 0;
+	while (getline(tsv_in, line)) {
+		int columns = 1;
+		for (char c : line) {
+			columns += c == '\t';
+		}
+		assert(columns == 9 && "TSV lines should have 9 columns");
+		lines++;
+	}
+	tsv_in.close();
+	remove(tsv);
+	assert(lines == lcp_level + 1 && "TSV should have a header and a line per level");
+
+	const char *json = "test_stats.json";
+	out = fopen(json, "w");
+	assert(write_lcp_stats_json(&stats, out) && "JSON should be written");
+	fclose(out);
+
+	std::ifstream json_in(json);
+	getline(json_in, line);
+	json_in.close();
+	remove(json);
+	int objects = 0;
+	for (size_t pos = line.find("\"level\":"); pos != std::string::npos; pos = line.find("\"level\":", pos + 1)) {
+		objects++;
+	}
+	assert(line.front() == '{' && line.back() == '}' && objects == lcp_level && "JSON should hold every level");
+
+	free_lcp_stats(&stats);
+
+	log("...  test_stats_levels passed!");
+}
+
+void test_stats_windows() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+
+	// runs longer than the overlap of two windows force the windows to be grown
+	std::string seq = sequence.substr(200000, 3 * STATS_WINDOW_SIZE);
+	seq.replace(STATS_WINDOW_SIZE - 1000, 3 * STATS_WINDOW_OVERLAP, 3 * STATS_WINDOW_OVERLAP, 'N');
+	seq.replace(2 * STATS_WINDOW_SIZE - 500, 2 * STATS_WINDOW_OVERLAP, 2 * STATS_WINDOW_OVERLAP, 'A');
+	seq += std::string(STATS_WINDOW_SIZE + STATS_WINDOW_OVERLAP, 'N');
+	seq += sequence.substr(900000, 3 * STATS_WINDOW_SIZE);
+
+	const int lcp_level = 4;
+	struct lcp_stats stats;
+	init_lcp_stats(&stats, lcp_level);
+	lcp_stats_add(&stats, seq.c_str(), seq.size());
+
+	struct lps str;
+	init_lps(&str, seq.c_str(), seq.size());
+	for (int level = 1; level <= lcp_level; level++) {
+		if (1 < level) {
+			lps_deepen(&str, level);
+		}
+		uint64_t total = 0, min_length = UINT64_MAX, max_length = 0;
+		for (int i = 0; str.level == level && i < str.size; i++) {
+			uint64_t length = str.cores[i].end - str.cores[i].start;
+			total += length;
+			min_length = std::min(min_length, length);
+			max_length = std::max(max_length, length);
+		}
+
+		const struct level_stats *level_stats = &(stats.levels[level-1]);
+		assert(str.level == level && level_stats->core_count == (uint64_t)str.size && "Windowed core counts should match");
+		assert(level_stats->total_length == total && "Windowed total lengths should match");
+		assert(level_stats->min_length == min_length && level_stats->max_length == max_length && "Windowed extreme lengths should match");
+	}
+	free_lps(&str);
+
+	free_lcp_stats(&stats);
+
+	log("...  test_stats_windows passed!");
+}
+
+int main() {
+
+	log("Running test_stats...");
+
+	test_stats_levels();
+	test_stats_windows();
+
+	log("All tests in test_stats completed successfully!");
+
+	return 0;
+}
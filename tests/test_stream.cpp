@@ -0,0 +1,214 @@
+#include "stream.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+bool same_cores(const struct lps *lhs, const struct lps *rhs) {
+	if (lhs->level != rhs->level || lps_neq(lhs, rhs)) {
+		return false;
+	}
+	for (int i = 0; i < lhs->size; i++) {
+		if (lhs->cores[i].label != rhs->cores[i].label || lhs->cores[i].start != rhs->cores[i].start ||
+		    lhs->cores[i].end != rhs->cores[i].end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void collect(struct core *cr, void *arg) {
+	std::vector<struct core> *cores = (std::vector<struct core> *)arg;
+	cores->push_back(*cr);
+}
+
+void test_stream_stage() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string str = sequence.substr(0, 300000);
+
+	struct lps expected, input;
+	init_lps(&expected, str.c_str(), str.size());
+	init_lps(&input, str.c_str(), str.size());
+	lps_deepen1(&expected);
+
+	// the cores of a single stage should match those of `lps_deepen1`
+	std::vector<struct core> cores;
+	struct deepen_stage stage;
+	init_deepen_stage(&stage, 1, collect, &cores);
+	for (int i = 0; i < input.size; i++) {
+		deepen_stage_push(&stage, &(input.cores[i]));
+	}
+	deepen_stage_finish(&stage);
+	free(input.cores);
+
+	assert(stage.input_count == (uint64_t)input.size && "All cores should be pushed");
+	assert(stage.output_count == cores.size() && (int)cores.size() == expected.size && "Sizes should match");
+
+	struct lps streamed;
+	streamed.level = 2;
+	streamed.size = cores.size();
+	streamed.cores = cores.data();
+	assert(same_cores(&expected, &streamed) && "Streamed cores should match");
+
+	for (struct core &cr : cores) {
+		free_core(&cr);
+	}
+	free_lps(&expected);
+
+	log("...  test_stream_stage passed!");
+}
+
+void test_stream_lcpt() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(94);
+
+	// records at different levels, including ones too short for all levels
+	std::vector<struct lps> records;
+	std::vector<int> levels = {1, 1, 3, 2, 1, 1, 1, 6};
+	std::vector<int> lengths = {500000, 3000, 200000, 50000, 40, 0, 2, 100000};
+	for (size_t i = 0; i < levels.size(); i++) {
+		std::string str = sequence.substr(rng() % (sequence.size() - lengths[i]), lengths[i]);
+		struct lps record;
+		init_lps(&record, str.c_str(), str.size());
+		lps_deepen(&record, levels[i]);
+		records.push_back(record);
+	}
+
+	const char *lcpt = "test_stream.lcpt", *deep = "test_stream_deep.lcpt";
+	FILE *out = fopen(lcpt, "wb");
+	for (struct lps &record : records) {
+		write_lps(&record, out);
+	}
+	char done = 0;
+	fwrite(&done, 1, 1, out);
+	fclose(out);
+
+	for (int lcp_level : {2, 5}) {
+
+		FILE *in = fopen(lcpt, "rb");
+		out = fopen(deep, "wb");
+		assert(lcpt_deepen(in, out, lcp_level) == (int64_t)records.size() && "All records should be deepened");
+		fclose(in);
+		fclose(out);
+
+		in = fopen(deep, "rb");
+		for (struct lps &record : records) {
+			struct lps expected, streamed;
+
+			// deepen a copy of the record in memory
+			FILE *copy = tmpfile();
+			write_lps(&record, copy);
+			rewind(copy);
+			assert(read_lps(&expected, copy) == 1 && "Record should be copied");
+			fclose(copy);
+			lps_deepen(&expected, lcp_level);
+
+			assert(read_lps(&streamed, in) == 1 && "Record should be read");
+			assert(same_cores(&expected, &streamed) && "Deepened records should match");
+
+			free_lps(&expected);
+			free_lps(&streamed);
+		}
+
+		struct lps end;
+		assert(read_lps(&end, in) == 0 && "Stream should end after the records");
+		fclose(in);
+	}
+
+	remove(lcpt);
+	remove(deep);
+	for (struct lps &record : records) {
+		free_lps(&record);
+	}
+
+	log("...  test_stream_lcpt passed!");
+}
+
+void test_stream_tiled() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::mt19937 rng(95);
+
+	// tiles as small as a single core should still carry the margins between tiles
+	std::vector<int> lengths = {400000, 20000, 30, 0};
+	for (int len : lengths) {
+		std::string str = sequence.substr(rng() % (sequence.size() - len), len);
+		for (int lcp_level : {2, 4, 8}) {
+			struct lps expected;
+			init_lps(&expected, str.c_str(), str.size());
+			lps_deepen(&expected, lcp_level);
+
+			for (int tile_size : {0, 1, 5, 300}) {
+				struct lps tiled;
+				init_lps(&tiled, str.c_str(), str.size());
+				assert(lps_deepen_tiled(&tiled, lcp_level, tile_size) == 1 && "Object should be deepened");
+				assert(same_cores(&expected, &tiled) && "Tiled cores should match");
+				assert((tiled.level < lcp_level || lps_deepen_tiled(&tiled, lcp_level, tile_size) == 0) && "Deeper objects should be left unchanged");
+				free_lps(&tiled);
+			}
+
+			free_lps(&expected);
+		}
+	}
+
+	// objects above level 1 should be deepened from their level
+	struct lps expected, tiled;
+	std::string str = sequence.substr(100000, 300000);
+	init_lps(&expected, str.c_str(), str.size());
+	init_lps(&tiled, str.c_str(), str.size());
+	lps_deepen(&expected, 3);
+	lps_deepen(&tiled, 3);
+	lps_deepen(&expected, 6);
+	lps_deepen_tiled(&tiled, 6, 0);
+	assert(same_cores(&expected, &tiled) && "Tiled cores should match from higher levels");
+	free_lps(&expected);
+	free_lps(&tiled);
+
+	log("...  test_stream_tiled passed!");
+}
+
+int main() {
+
+	log("Running test_stream...");
+
+	test_stream_stage();
+	test_stream_lcpt();
+	test_stream_tiled();
+
+	log("All tests in test_stream completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+#include "lps.h"
+#include "trace.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void log(const std::string &message) {
+	std::cout << message << std::endl;
+};
+
+std::string read_first_record(const char *filename) {
+	std::ifstream genome(filename);
+	std::string sequence, line;
+
+	getline(genome, line); // skip first header line
+
+	while (getline(genome, line)) {
+		if (line[0] != '>') {
+			sequence += line;
+		} else {
+			break;
+		}
+	}
+	genome.close();
+
+	return sequence;
+}
+
+struct probe_counts {
+	uint64_t begins[TRACE_PROBE_COUNT];
+	uint64_t ends[TRACE_PROBE_COUNT];
+	uint64_t last_timestamp;
+	bool ordered;
+};
+
+void count_event(const struct trace_event *event, void *arg) {
+	struct probe_counts *counts = (struct probe_counts *)arg;
+	if (event->phase == TRACE_PHASE_BEGIN) {
+		counts->begins[event->probe]++;
+	} else {
+		counts->ends[event->probe]++;
+	}
+	counts->ordered &= counts->last_timestamp <= event->timestamp;
+	counts->last_timestamp = event->timestamp;
+}
+
+int count_occurrences(const std::string &text, const std::string &pattern) {
+	int count = 0;
+	for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+		count++;
+	}
+	return count;
+}
+
+void test_trace_ring() {
+
+	struct probe_counts counts = {};
+	counts.ordered = true;
+	trace_set_callback(count_event, &counts);
+
+	assert(trace_start(5) && "Tracing should start");
+	for (int i = 0; i < 20; i++) {
+		trace_record(i % TRACE_PROBE_COUNT, i % 2, i);
+	}
+	trace_stop();
+	trace_record(TRACE_PARSE1, TRACE_PHASE_BEGIN, 0);
+
+	assert(trace_event_count() == 20 && "Events should only be recorded while tracing");
+	assert(counts.begins[0] + counts.ends[0] == 3 && counts.ordered && "Callback should receive every event in order");
+
+	// the ring keeps the 8 most recent events
+	FILE *out = tmpfile();
+	assert(trace_write_chrome(out) == 8 && "Ring should keep the most recent events");
+	std::string json(ftell(out), '\0');
+	rewind(out);
+	assert(fread(&json[0], 1, json.size(), out) == json.size() && "Trace should be read back");
+	fclose(out);
+
+	assert(json.rfind("{\"traceEvents\":[", 0) == 0 && "Trace should be a Chrome trace object");
+	assert(count_occurrences(json, "\"ph\":") == 8 && "Every kept event should be written");
+	assert(count_occurrences(json, "\"value\":19}") == 1 && count_occurrences(json, "\"value\":11}") == 0 && "Oldest events should be overwritten");
+	assert(json.find("\"ts\":0.000") != std::string::npos && "Timestamps should start from the oldest event");
+
+	trace_set_callback(NULL, NULL);
+	trace_free();
+
+	log("...  test_trace_ring passed!");
+}
+
+void test_trace_probes() {
+
+	LCP_INIT();
+
+	std::string sequence = read_first_record("data/test.fasta");
+	std::string str = sequence.substr(0, 100000);
+
+	struct probe_counts counts = {};
+	counts.ordered = true;
+	trace_set_callback(count_event, &counts);
+	assert(trace_start(0) && "Tracing should start");
+
+	struct lps forward, reverse, copy;
+	init_lps(&forward, str.c_str(), str.size());
+	init_lps2(&reverse, str.c_str(), str.size());
+	lps_deepen(&forward, 4);
+
+	FILE *file = tmpfile();
+	write_lps(&forward, file);
+	rewind(file);
+	init_lps3(&copy, file);
+	fclose(file);
+
+	trace_stop();
+	trace_set_callback(NULL, NULL);
+
+#ifdef LCP_TRACE
+	for (int probe = 0; probe < TRACE_PROBE_COUNT; probe++) {
+		assert(counts.begins[probe] && counts.begins[probe] == counts.ends[probe] && "Every probe should begin and end");
+	}
+	assert(counts.begins[TRACE_DEEPEN1] == 3 && counts.begins[TRACE_PARSE3] == 3 && "Each level should be traced");
+	assert(trace_event_count() == 2 * (1 + 1 + 3 * 3 + 1 + 1) && "All probe hits should be recorded");
+#else
+	// probes are compiled out
+	assert(trace_event_count() == 0 && "Untraced builds should not record events");
+#endif
+
+	free_lps(&forward);
+	free_lps(&reverse);
+	free_lps(&copy);
+	trace_free();
+
+	log("...  test_trace_probes passed!");
+}
+
+int main() {
+
+	log("Running test_trace...");
+
+	test_trace_ring();
+	test_trace_probes();
+
+	log("All tests in test_trace completed successfully!");
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file trace.c
+ * @brief Implementation of the trace ring buffer and the Chrome trace output.
+ *
+ * A thread claims the slot of an event by incrementing the head of the ring buffer,
+ * so events of different threads never share a slot until the ring wraps around.
+ * Thread ids are assigned on the first event of each thread.
+ */
+
+#include "trace.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *probe_names[TRACE_PROBE_COUNT] = {
+    "parse1", "parse2", "parse3", "lcp_dct", "lps_deepen1", "write_lps", "init_lps3"
+};
+
+static struct trace_event *ring = NULL;
+static uint64_t ring_mask = 0;
+static uint64_t ring_head = 0;
+static int tracing = 0;
+static trace_callback user_callback = NULL;
+static void *user_arg = NULL;
+static uint32_t assigned_threads = 0;
+static __thread uint32_t thread_id = 0;
+
+int trace_start(uint64_t capacity) {
+    trace_stop();
+    trace_free();
+
+    uint64_t size = 1;
+    while (size < (capacity ? capacity : TRACE_RING_SIZE)) {
+        size *= 2;
+    }
+
+    ring = (struct trace_event *)malloc(size * sizeof(struct trace_event));
+    if (!ring) {
+        return 0;
+    }
+    ring_mask = size - 1;
+    ring_head = 0;
+
+    __atomic_store_n(&tracing, 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+void trace_stop(void) {
+    __atomic_store_n(&tracing, 0, __ATOMIC_RELEASE);
+}
+
+void trace_free(void) {
+    free(ring);
+    ring = NULL;
+    ring_mask = 0;
+    ring_head = 0;
+}
+
+void trace_set_callback(trace_callback callback, void *arg) {
+    user_arg = arg;
+    user_callback = callback;
+}
+
+void trace_record(int probe, int phase, uint64_t value) {
+    if (!__atomic_load_n(&tracing, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // ids start from 1 so that 0 marks a thread without id
+    if (!thread_id) {
+        thread_id = __atomic_add_fetch(&assigned_threads, 1, __ATOMIC_RELAXED);
+    }
+
+    struct trace_event event;
+    event.timestamp = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    event.value = value;
+    event.thread = thread_id - 1;
+    event.probe = probe;
+    event.phase = phase;
+
+    if (user_callback) {
+        user_callback(&event, user_arg);
+    }
+
+    uint64_t slot = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+    ring[slot & ring_mask] = event;
+}
+
+uint64_t trace_event_count(void) {
+    return __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+}
+
+const char *trace_probe_name(int probe) {
+    return 0 <= probe && probe < TRACE_PROBE_COUNT ? probe_names[probe] : "unknown";
+}
+
+int64_t trace_write_chrome(FILE *out) {
+    uint64_t head = trace_event_count();
+    uint64_t count = ring ? (head < ring_mask + 1 ? head : ring_mask + 1) : 0;
+    uint64_t first = head - count;
+
+    // slots are claimed after the timestamps are taken, so the oldest slot may not hold the oldest event
+    uint64_t origin = UINT64_MAX;
+    for (uint64_t i = first; i < head; i++) {
+        origin = ring[i & ring_mask].timestamp < origin ? ring[i & ring_mask].timestamp : origin;
+    }
+
+    int ok = fprintf(out, "{\"traceEvents\":[") > 0;
+
+    for (uint64_t i = first; i < head; i++) {
+        const struct trace_event *event = &(ring[i & ring_mask]);
+        ok &= fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"lcptools\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%" PRIu32 ",\"args\":{\"value\":%" PRIu64 "}}",
+                      i == first ? "" : ",\n", trace_probe_name(event->probe), event->phase == TRACE_PHASE_BEGIN ? 'B' : 'E',
+                      (event->timestamp - origin) / 1000.0, event->thread, event->value) > 0;
+    }
+
+    ok &= fprintf(out, "],\"displayTimeUnit\":\"ns\"}\n") > 0;
+
+    return ok ? (int64_t)count : -1;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file trace.h
+ * @brief Compile-time gated trace probes at the start and end of parsing and deepening.
+ *
+ * Probe points are placed at the start and the end of `parse1`, `parse2`, `parse3`,
+ * `lcp_dct`, `lps_deepen1`, `write_lps` and `init_lps3`. They are compiled only when
+ * the library is built with `LCP_TRACE` defined (`make TRACE=1`); otherwise the
+ * `TRACE_BEGIN` and `TRACE_END` macros expand to nothing and the library is identical
+ * to an untraced build.
+ *
+ * Key functionalities include:
+ * - Recording each probe hit as a `trace_event` with a monotonic timestamp, the id of
+ * the calling thread and a probe specific value, once tracing is started.
+ * - Keeping the most recent events in a ring buffer shared by all threads, whose
+ * slots are claimed with a single atomic increment.
+ * - Passing every event to an optional user callback, e.g. to aggregate the time spent
+ * per level without keeping the events.
+ * - Writing the events of the ring buffer in the Chrome trace event format, which can
+ * be opened with `chrome://tracing` or Perfetto.
+ * - Emitting the probes as USDT probes of the `lcptools` provider when built with
+ * `LCP_TRACE_USDT` defined and `<sys/sdt.h>` available, so that they can be attached
+ * to with `bpftrace` or `perf` without recompiling.
+ *
+ * The value of a probe is the length of the input in bases at the start of `parse1`
+ * and `parse2`, the number of input cores at the start of `parse3` and `lcp_dct`, the
+ * level at the start of `lps_deepen1`, and the number of cores otherwise.
+ *
+ * When tracing is compiled in but not started, each probe costs one relaxed load and
+ * a branch.
+ *
+ * @struct trace_event
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_RING_SIZE (1 << 16)
+
+enum trace_probe {
+    TRACE_PARSE1,
+    TRACE_PARSE2,
+    TRACE_PARSE3,
+    TRACE_DCT,
+    TRACE_DEEPEN1,
+    TRACE_WRITE_LPS,
+    TRACE_INIT_LPS3,
+    TRACE_PROBE_COUNT
+};
+
+enum trace_phase {
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END
+};
+
+struct trace_event {
+    uint64_t timestamp;
+    uint64_t value;
+    uint32_t thread;
+    uint8_t probe;
+    uint8_t phase;
+};
+
+typedef void (*trace_callback)(const struct trace_event *event, void *arg);
+
+#ifdef LCP_TRACE_USDT
+#include <sys/sdt.h>
+#define TRACE_USDT(phase, probe, value) STAP_PROBE2(lcptools, phase, (int)(probe), (uint64_t)(value))
+#else
+#define TRACE_USDT(phase, probe, value) ((void)0)
+#endif
+
+#ifdef LCP_TRACE
+#define TRACE_BEGIN(probe, value) (trace_record((probe), TRACE_PHASE_BEGIN, (uint64_t)(value)), TRACE_USDT(begin, probe, value))
+#define TRACE_END(probe, value) (trace_record((probe), TRACE_PHASE_END, (uint64_t)(value)), TRACE_USDT(end, probe, value))
+#else
+#define TRACE_BEGIN(probe, value) TRACE_USDT(begin, probe, value)
+#define TRACE_END(probe, value) TRACE_USDT(end, probe, value)
+#endif
+
+/**
+ * @brief Starts recording events into a ring buffer, replacing the events recorded so far.
+ *
+ * @param capacity Number of events kept, rounded up to a power of two; 0 selects
+ * `TRACE_RING_SIZE`.
+ * @return 1 on success, 0 if the ring buffer cannot be allocated.
+ */
+int trace_start(uint64_t capacity);
+
+/**
+ * @brief Stops recording events. The ring buffer is kept until `trace_free`.
+ */
+void trace_stop(void);
+
+/**
+ * @brief Frees the ring buffer.
+ */
+void trace_free(void);
+
+/**
+ * @brief Sets the callback receiving every recorded event, or removes it if `callback`
+ * is NULL. The callback is called on the thread hitting the probe.
+ *
+ * @param callback The callback.
+ * @param arg Argument passed to the callback.
+ */
+void trace_set_callback(trace_callback callback, void *arg);
+
+/**
+ * @brief Records an event if tracing is started. Called by the probes.
+ *
+ * @param probe The probe, see `trace_probe`.
+ * @param phase `TRACE_PHASE_BEGIN` or `TRACE_PHASE_END`.
+ * @param value The probe specific value.
+ */
+void trace_record(int probe, int phase, uint64_t value);
+
+/**
+ * @brief Returns the number of events recorded since the last `trace_start`, including
+ * those overwritten in the ring buffer.
+ */
+uint64_t trace_event_count(void);
+
+/**
+ * @brief Returns the name of a probe, e.g. "parse1".
+ */
+const char *trace_probe_name(int probe);
+
+/**
+ * @brief Writes the events of the ring buffer, oldest first, as a Chrome trace JSON
+ * object. Timestamps are relative to the oldest event.
+ *
+ * Tracing should be stopped, or no thread should hit a probe, while writing.
+ *
+ * @param out File pointer to the output.
+ * @return Number of events written, or -1 on a write error.
+ */
+int64_t trace_write_chrome(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif